@@ -0,0 +1,207 @@
+#ifndef __APRS_AFSK_H
+#define __APRS_AFSK_H
+
+/*******************************************************
+ * AFSK1200 / AX.25 telemetry packet.
+ * The frame is built, bit-stuffed and NRZI encoded into a tone bit
+ * buffer before PTT goes up; on air only the modulation runs, through
+ * the phase-continuous NCO of the sample engine.
+ *******************************************************/
+
+// ---------------------- AFSK1200 Parameters ----------------------
+/*******************************************************
+ * CONSTANT: afskBaud / afskMark / afskSpace
+ * DESCRIPTION: Bell 202 signalling: 1200 baud, mark 1200 Hz, space 2200 Hz.
+ *******************************************************/
+const uint32_t afskBaud  = 1200;
+const uint32_t afskMark  = 1200;
+const uint32_t afskSpace = 2200;
+/*******************************************************
+ * CONSTANT: afskAmplitude
+ * DESCRIPTION: Sine amplitude (Q15) of the AFSK tones (about -6 dBFS).
+ *******************************************************/
+const int16_t afskAmplitude = 16384;
+/*******************************************************
+ * CONSTANT: afskTxDelayFlags / afskTailFlags
+ * DESCRIPTION: HDLC flags sent before (TXDELAY, ~270 ms, lets the
+ * receiver's squelch open) and after the frame.
+ *******************************************************/
+const int afskTxDelayFlags = 40;
+const int afskTailFlags = 3;
+/*******************************************************
+ * CONSTANT: ax25MaxFrame
+ * DESCRIPTION: Largest AX.25 frame built here (addresses + info + FCS).
+ *******************************************************/
+const int ax25MaxFrame = 128;
+
+// ---------------------- Tone Bit Buffer ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: afskTones
+ * DESCRIPTION: Precomputed line signal, one bit per baud (1 = mark, 0 = space),
+ * packed LSB first. Sized for the worst case of flags + stuffed frame.
+ *******************************************************/
+uint8_t afskTones[afskTxDelayFlags + afskTailFlags + ax25MaxFrame * 6 / 5 + 2];
+/*******************************************************
+ * GLOBAL VARIABLE: afskToneCount
+ * DESCRIPTION: Number of valid bits in afskTones.
+ *******************************************************/
+int afskToneCount = 0;
+/*******************************************************
+ * GLOBAL VARIABLE: afskNrziState
+ * DESCRIPTION: Current line tone of the NRZI encoder (true = mark).
+ *******************************************************/
+bool afskNrziState = true;
+
+/*******************************************************
+ * FUNCTION: afskPutBit
+ * DESCRIPTION: NRZI encodes one HDLC bit (0 = change tone, 1 = keep tone)
+ * and appends the resulting tone to afskTones.
+ * INPUT: bool bit
+ * OUTPUT: None
+ *******************************************************/
+void afskPutBit(bool bit) {
+  if (!bit) afskNrziState = !afskNrziState;
+  if (afskNrziState) afskTones[afskToneCount >> 3] |= 1 << (afskToneCount & 7);
+  else               afskTones[afskToneCount >> 3] &= ~(1 << (afskToneCount & 7));
+  afskToneCount++;
+}
+
+/*******************************************************
+ * FUNCTION: afskPutFlags
+ * DESCRIPTION: Appends `count` HDLC flags (0x7E, never bit-stuffed).
+ * INPUT: int count
+ * OUTPUT: None
+ *******************************************************/
+void afskPutFlags(int count) {
+  for (int i = 0; i < count; i++) {
+    for (int b = 0; b < 8; b++) afskPutBit((0x7E >> b) & 1);
+  }
+}
+
+// ---------------------- AX.25 Framing ----------------------
+/*******************************************************
+ * FUNCTION: ax25PutAddress
+ * DESCRIPTION: Encodes "CALL" or "CALL-SSID" as a 7-byte AX.25 address field.
+ * INPUT: uint8_t* out (7 bytes), const char* address, uint8_t flags
+ * (bit 7 = C/H bit), bool last (Marks the final address of the header)
+ * OUTPUT: None
+ *******************************************************/
+void ax25PutAddress(uint8_t* out, const char* address, uint8_t flags, bool last) {
+  int i = 0;
+  for (; i < 6 && address[i] && address[i] != '-'; i++) out[i] = address[i] << 1;
+  for (int j = i; j < 6; j++) out[j] = ' ' << 1;
+  const char* dash = strchr(address, '-');
+  uint8_t ssid = dash ? atoi(dash + 1) & 0x0F : 0;
+  out[6] = 0x60 | flags | (ssid << 1) | (last ? 1 : 0);
+}
+
+/*******************************************************
+ * FUNCTION: ax25FCS
+ * DESCRIPTION: Frame Check Sequence (CRC-16/X.25) of an AX.25 frame.
+ * INPUT: const uint8_t* data, int len
+ * OUTPUT: uint16_t (sent low byte first)
+ *******************************************************/
+uint16_t ax25FCS(const uint8_t* data, int len) {
+  uint16_t crc = 0xFFFF;
+  for (int i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+  }
+  return ~crc;
+}
+
+/*******************************************************
+ * FUNCTION: buildAFSKPacket
+ * DESCRIPTION: Builds an AX.25 UI frame (destination, source, one digipeater,
+ * info field), appends the FCS, and encodes it with flags, bit stuffing
+ * and NRZI into afskTones.
+ * INPUT: const char* info (APRS information field)
+ * OUTPUT: None
+ *******************************************************/
+void buildAFSKPacket(const char* info) {
+  uint8_t frame[ax25MaxFrame];
+  int len = 0;
+  ax25PutAddress(frame, APRS_DESTINATION, 0x80, false);  len += 7;
+  ax25PutAddress(frame + len, APRS_CALLSIGN, 0x00, false); len += 7;
+  ax25PutAddress(frame + len, APRS_PATH, 0x00, true);    len += 7;
+  frame[len++] = 0x03;  // UI frame
+  frame[len++] = 0xF0;  // No layer 3
+  for (const char* p = info; *p && len < ax25MaxFrame - 2; p++) frame[len++] = *p;
+  uint16_t fcs = ax25FCS(frame, len);
+  frame[len++] = fcs & 0xFF;
+  frame[len++] = fcs >> 8;
+
+  afskToneCount = 0;
+  afskNrziState = true;
+  afskPutFlags(afskTxDelayFlags);
+  int ones = 0;
+  for (int i = 0; i < len; i++) {
+    for (int b = 0; b < 8; b++) {
+      bool bit = (frame[i] >> b) & 1;   // LSB first
+      afskPutBit(bit);
+      ones = bit ? ones + 1 : 0;
+      if (ones == 5) {                  // bit stuffing
+        afskPutBit(0);
+        ones = 0;
+      }
+    }
+  }
+  afskPutFlags(afskTailFlags);
+}
+
+// ---------------------- AFSK Transmission ----------------------
+/*******************************************************
+ * FUNCTION: transmitAFSKPacket
+ * DESCRIPTION: Plays the precomputed tone bits through the sample engine.
+ * Bit boundaries are placed with a fractional accumulator (8000/1200 =
+ * 6.67 samples per bit) and the NCO is never reset, so the tone
+ * changes are phase continuous. PTT must already be active.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void transmitAFSKPacket() {
+  const uint32_t markInc = ncoIncrement(afskMark);
+  const uint32_t spaceInc = ncoIncrement(afskSpace);
+  int16_t block[64];
+  int fill = 0;
+  uint32_t baudClock = 0;
+
+  Serial.printf("Sending AFSK packet (%d bits)...\n", afskToneCount);
+  sampleEngineBegin();
+  for (int bit = 0; bit < afskToneCount;) {
+    bool mark = (afskTones[bit >> 3] >> (bit & 7)) & 1;
+    block[fill++] = ncoNext(mark ? markInc : spaceInc, afskAmplitude);
+    if (fill == 64) {
+      sampleEngineWrite(block, fill);
+      fill = 0;
+    }
+    baudClock += afskBaud;
+    if (baudClock >= sampleEngineRate) {
+      baudClock -= sampleEngineRate;
+      bit++;
+    }
+  }
+  sampleEngineWrite(block, fill);
+  sampleEngineEnd();
+}
+
+/*******************************************************
+ * FUNCTION: buildTelemetryPacket
+ * DESCRIPTION: Prepares the APRS telemetry report for this picture:
+ * sequence = frame id, A1 = battery (20 mV/unit), A2 = chip temperature
+ * (degrees C + 100). Call before activating PTT.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void buildTelemetryPacket() {
+  char info[64];
+  uint32_t battery = readBatteryMillivolts() / 20;
+  int temperature = readTemperatureC() + 100;
+  snprintf(info, sizeof(info), "T#%03u,%03u,%03d,000,000,000,00000000",
+           (unsigned)(frameId % 1000), (unsigned)min(battery, (uint32_t)255),
+           temperature < 0 ? 0 : min(temperature, 255));
+  Serial.printf("APRS telemetry: %s\n", info);
+  buildAFSKPacket(info);
+}
+
+#endif
@@ -0,0 +1,363 @@
+#ifndef __ARCHIVE_H
+#define __ARCHIVE_H
+
+/*******************************************************
+ * SD card archive of the transmitted frames.
+ * Each picture sent is kept in a ring of ARCHIVE_SLOTS JPEG files on the
+ * card, with its metadata and 80x62 thumbnail in the index next to it
+ * (archive_format.h); browsing the archive needs only the index
+ * (tools/archive_thumbs.cpp prints it as a contact sheet).
+ * The SSTV modes send the composited canvas, so that is what is stored:
+ * a task on core 0 at the lowest priority re-encodes it band by band
+ * (jpeg_strip_encoder.h) while it is on air, following the rows as they
+ * become final, and streams the JPEG to the card. It is preempted by the
+ * pixel timer and every other task, so the transmission never waits for
+ * it; the thumbnail comes from the encoder's DC coefficients. OFDM sends
+ * the camera JPEG as is: it is stored directly, with a thumbnail decoded
+ * from its DC coefficients only (jpeg_dc_thumb.h, no IDCT).
+ * The card runs in 1-bit SD_MMC mode (CLK 14, CMD 15, D0 2), which shares
+ * its pins with the speaker, PTT and GPS power: see the pin check in the
+ * sketch.
+ *******************************************************/
+
+#include <SD_MMC.h>
+#include <time.h>
+#include "archive_format.h"
+#include "sstv_render.h"
+#include "jpeg_dc_thumb.h"
+#include "jpeg_strip_encoder.h"
+
+#ifndef ARCHIVE_SLOTS
+#define ARCHIVE_SLOTS 64
+#endif
+#ifndef ARCHIVE_JPEG_QUALITY
+#define ARCHIVE_JPEG_QUALITY 80
+#endif
+#ifndef ARCHIVE_TASK_PRIORITY
+#define ARCHIVE_TASK_PRIORITY 1   // Above the idle task only
+#endif
+
+/*******************************************************
+ * CONSTANT: archiveIndexPath
+ * DESCRIPTION: Index file on the card.
+ *******************************************************/
+const char* const archiveIndexPath = "/sstv/index.bin";
+
+/*******************************************************
+ * GLOBAL VARIABLE: archiveSequence / archiveHeadKnown (RTC memory)
+ * DESCRIPTION: Sequence of the next frame; read from the index header
+ * after a power-up.
+ *******************************************************/
+RTC_DATA_ATTR uint32_t archiveSequence = 0;
+RTC_DATA_ATTR bool archiveHeadKnown = false;
+
+/*******************************************************
+ * GLOBAL VARIABLE: archiveReady / archiveDecoder
+ * DESCRIPTION: Card mounted and index usable; thumbnail decoder state.
+ *******************************************************/
+bool archiveReady = false;
+static JpegDCDecoder archiveDecoder;
+
+/*******************************************************
+ * FUNCTION: archiveBegin
+ * DESCRIPTION: Mounts the card and opens (or creates) the index. An index
+ * made for another number of slots is started again.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void archiveBegin() {
+  if (!SD_MMC.begin("/sdcard", true)) {
+    Serial.println("Archive: no SD card");
+    return;
+  }
+  SD_MMC.mkdir("/sstv");
+
+  ArchiveIndexHeader header;
+  File index = SD_MMC.open(archiveIndexPath, "r+");
+  bool valid = index && index.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+               header.magic == archiveMagic && header.version == archiveVersion &&
+               header.slots == ARCHIVE_SLOTS && header.thumbWidth == archiveThumbWidth &&
+               header.thumbHeight == archiveThumbHeight;
+  if (index) index.close();
+  if (!valid) {
+    header = { archiveMagic, archiveVersion, ARCHIVE_SLOTS, archiveThumbWidth, archiveThumbHeight, 0 };
+    index = SD_MMC.open(archiveIndexPath, "w");
+    if (!index || index.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+      Serial.println("Archive: cannot create the index");
+      if (index) index.close();
+      return;
+    }
+    index.close();
+    archiveHeadKnown = false;
+    Serial.println("Archive: new index");
+  }
+  if (!archiveHeadKnown) {
+    archiveSequence = header.nextSequence;
+    archiveHeadKnown = true;
+  }
+  archiveReady = true;
+}
+
+/*******************************************************
+ * FUNCTION: archiveSlotPath
+ * DESCRIPTION: File name of a slot's JPEG.
+ * INPUT: uint32_t slot, char* path (24 bytes)
+ * OUTPUT: None
+ *******************************************************/
+void archiveSlotPath(uint32_t slot, char* path) {
+  snprintf(path, 24, "/sstv/%05lu.jpg", (unsigned long)slot);
+}
+
+/*******************************************************
+ * FUNCTION: archiveStoreRecord
+ * DESCRIPTION: Seals a record (sequence set here) and writes it to the
+ * index with the new next sequence, then advances the sequence.
+ * INPUT: ArchiveRecord* record
+ * OUTPUT: bool
+ *******************************************************/
+bool archiveStoreRecord(ArchiveRecord* record) {
+  uint32_t slot = archiveSequence % ARCHIVE_SLOTS;
+  record->sequence = archiveSequence;
+  archiveSeal(*record);
+
+  // Records past the end of a new index are preceded by empty ones
+  File index = SD_MMC.open(archiveIndexPath, "r+");
+  bool ok = index;
+  if (ok) {
+    uint32_t offset = archiveRecordOffset(slot);
+    if (index.size() < offset) {
+      static const uint8_t zeros[512] = { 0 };
+      index.seek(index.size());
+      for (uint32_t n = offset - index.size(); ok && n > 0;) {
+        uint32_t chunk = n > sizeof(zeros) ? sizeof(zeros) : n;
+        ok = index.write(zeros, chunk) == chunk;
+        n -= chunk;
+      }
+    }
+    ok = ok && index.seek(offset) && index.write((const uint8_t*)record, sizeof(ArchiveRecord)) == sizeof(ArchiveRecord);
+    uint32_t next = archiveSequence + 1;
+    ok = ok && index.seek(offsetof(ArchiveIndexHeader, nextSequence)) &&
+         index.write((const uint8_t*)&next, sizeof(next)) == sizeof(next);
+    index.close();
+  }
+  if (!ok) {
+    Serial.println("Archive: cannot update the index");
+    return false;
+  }
+  archiveSequence++;
+  return true;
+}
+
+/*******************************************************
+ * FUNCTION: archiveClockNow
+ * DESCRIPTION: UTC seconds, 0 while the clock is not set (before 2020).
+ * INPUT: None
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t archiveClockNow() {
+  time_t now = time(NULL);
+  return now > 1577836800 ? (uint32_t)now : 0;
+}
+
+// ---------------------- Camera Frames ----------------------
+/*******************************************************
+ * FUNCTION: archiveFrame
+ * DESCRIPTION: Stores a camera JPEG in the next slot and updates its index
+ * record with the metadata and the DC thumbnail. Used where the camera
+ * JPEG is what goes on air (OFDM).
+ * INPUT: const camera_fb_t* fb, uint8_t mode
+ * OUTPUT: None
+ *******************************************************/
+void archiveFrame(const camera_fb_t* fb, uint8_t mode) {
+  if (!archiveReady || !fb || fb->format != PIXFORMAT_JPEG) return;
+
+  ArchiveRecord* record = (ArchiveRecord*)heap_caps_calloc(1, sizeof(ArchiveRecord), MALLOC_CAP_SPIRAM);
+  if (!record) return;
+
+  char path[24];
+  archiveSlotPath(archiveSequence % ARCHIVE_SLOTS, path);
+  File jpeg = SD_MMC.open(path, "w");
+  bool written = jpeg && jpeg.write(fb->buf, fb->len) == fb->len;
+  if (jpeg) jpeg.close();
+  if (!written) {
+    Serial.printf("Archive: cannot write %s\n", path);
+    free(record);
+    return;
+  }
+
+  uint32_t start = micros();
+  int thumbWidth, thumbHeight;
+  if (jpegDCThumbnail(archiveDecoder, fb->buf, fb->len, record->thumb, archiveThumbWidth * archiveThumbHeight,
+                      thumbWidth, thumbHeight) && thumbWidth <= archiveThumbWidth) {
+    // A narrower thumbnail is spread out to the record's row stride, last row first
+    for (int y = thumbHeight - 1; y >= 0 && thumbWidth < archiveThumbWidth; y--) {
+      memmove(record->thumb + y * archiveThumbWidth, record->thumb + y * thumbWidth, thumbWidth * sizeof(uint16_t));
+      memset(record->thumb + y * archiveThumbWidth + thumbWidth, 0, (archiveThumbWidth - thumbWidth) * sizeof(uint16_t));
+    }
+    record->flags |= ARCHIVE_FLAG_THUMB;
+  } else {
+    memset(record->thumb, 0, sizeof(record->thumb));   // Partly decoded
+  }
+  uint32_t thumbUs = micros() - start;
+
+  record->frameId = frameId;
+  record->timestamp = archiveClockNow();
+  record->jpegBytes = fb->len;
+  record->width = fb->width;
+  record->height = fb->height;
+  record->mode = mode;
+  record->thumbUs = thumbUs > 65535 ? 65535 : thumbUs;
+  uint32_t sequence = archiveSequence;
+  if (archiveStoreRecord(record)) {
+    Serial.printf("Archive: frame %lu in %s, thumbnail %lu us\n", (unsigned long)sequence, path, (unsigned long)thumbUs);
+  }
+  free(record);
+}
+
+// ---------------------- On-Air Picture ----------------------
+/*******************************************************
+ * STRUCT: ArchiveEncodeJob
+ * DESCRIPTION: Re-encode of the canvas by archiveEncodeTask: the rows it
+ * may read (rowsReady, advanced by the caller), the output and the result.
+ *******************************************************/
+struct ArchiveEncodeJob {
+  const uint16_t* pixels;
+  const volatile int* rowsReady;
+  volatile bool lastRows;   // Set by the caller: rowsReady will not grow any more
+  volatile bool done;       // Set by the task when it has finished
+  bool ok;
+  int components;
+  File file;
+  JpegStripEncoder* encoder;
+  ArchiveRecord* record;
+  uint32_t encodeMs;
+};
+
+/*******************************************************
+ * GLOBAL VARIABLE: archiveJob / archiveJobActive
+ * DESCRIPTION: The running re-encode, if any.
+ *******************************************************/
+ArchiveEncodeJob archiveJob;
+bool archiveJobActive = false;
+
+/*******************************************************
+ * FUNCTION: archiveFileWrite
+ * DESCRIPTION: Encoder output callback: appends to the slot file.
+ * INPUT: void* context (File*), const uint8_t* data, size_t len
+ * OUTPUT: bool
+ *******************************************************/
+bool archiveFileWrite(void* context, const uint8_t* data, size_t len) {
+  return ((File*)context)->write(data, len) == len;
+}
+
+/*******************************************************
+ * FUNCTION: archiveEncodeTask
+ * DESCRIPTION: FreeRTOS task (core 0, ARCHIVE_TASK_PRIORITY) that encodes
+ * the canvas one band at a time as soon as its rows are final, then
+ * flags done and deletes itself. Every band ends with a one tick delay, so
+ * the idle task (and its watchdog) still runs on the core.
+ * INPUT: void* arg (unused, the job is archiveJob)
+ * OUTPUT: None
+ *******************************************************/
+void archiveEncodeTask(void* arg) {
+  ArchiveEncodeJob &job = archiveJob;
+  JpegStripEncoder &e = *job.encoder;
+  uint32_t busy = 0;
+  uint32_t start = millis();
+  job.ok = jpegStripBegin(e, imageWidth, imageHeight, job.components, ARCHIVE_JPEG_QUALITY, archiveFileWrite,
+                          &job.file, job.record->thumb);
+  busy += millis() - start;
+  while (job.ok && e.rowsDone < imageHeight) {
+    int needed = min(e.rowsDone + jpegStripBandHeight(e), imageHeight);
+    if (*job.rowsReady < needed) {
+      if (job.lastRows) {
+        job.ok = false;   // The picture was never completed
+        break;
+      }
+      vTaskDelay(pdMS_TO_TICKS(10));
+      continue;
+    }
+    start = millis();
+    job.ok = jpegStripEncodeBand(e, job.pixels, canvasStride);
+    busy += millis() - start;
+    vTaskDelay(1);
+  }
+  if (job.ok) job.ok = jpegStripEnd(e);
+  job.file.close();
+  job.encodeMs = busy;
+  job.done = true;
+  vTaskDelete(NULL);
+}
+
+/*******************************************************
+ * FUNCTION: archiveCanvasStart
+ * DESCRIPTION: Starts the re-encode of the canvas into the next slot,
+ * following rowsReady (rows of the canvas that are final). Greyscale for
+ * the luma-only modes.
+ * INPUT: const uint16_t* pixels, const volatile int* rowsReady, bool grey
+ * OUTPUT: None
+ *******************************************************/
+void archiveCanvasStart(const uint16_t* pixels, const volatile int* rowsReady, bool grey) {
+  if (!archiveReady || archiveJobActive) return;
+  ArchiveEncodeJob &job = archiveJob;
+  job.record = (ArchiveRecord*)heap_caps_calloc(1, sizeof(ArchiveRecord), MALLOC_CAP_SPIRAM);
+  job.encoder = (JpegStripEncoder*)heap_caps_malloc(sizeof(JpegStripEncoder), MALLOC_CAP_INTERNAL);
+  char path[24];
+  archiveSlotPath(archiveSequence % ARCHIVE_SLOTS, path);
+  if (job.record && job.encoder) job.file = SD_MMC.open(path, "w");
+  if (!job.record || !job.encoder || !job.file) {
+    Serial.println("Archive: cannot start the on-air picture");
+    free(job.record);
+    free(job.encoder);
+    return;
+  }
+  job.pixels = pixels;
+  job.rowsReady = rowsReady;
+  job.lastRows = false;
+  job.done = false;
+  job.ok = false;
+  job.components = grey ? 1 : 3;
+  job.record->frameId = frameId;
+  job.record->timestamp = archiveClockNow();
+  archiveJobActive = true;
+  xTaskCreatePinnedToCore(archiveEncodeTask, "archive", 6144, NULL, ARCHIVE_TASK_PRIORITY, NULL, 0);
+}
+
+/*******************************************************
+ * FUNCTION: archiveCanvasFinish
+ * DESCRIPTION: Called once the canvas is no longer changing (after the
+ * transmission, before it is freed): waits for the encoder task and
+ * writes the index record.
+ * INPUT: uint8_t mode
+ * OUTPUT: None
+ *******************************************************/
+void archiveCanvasFinish(uint8_t mode) {
+  if (!archiveJobActive) return;
+  ArchiveEncodeJob &job = archiveJob;
+  job.lastRows = true;
+  uint32_t waitStart = millis();
+  while (!job.done) delay(5);
+  uint32_t waitMs = millis() - waitStart;
+
+  ArchiveRecord* record = job.record;
+  uint32_t sequence = archiveSequence;
+  if (job.ok) {
+    record->jpegBytes = job.encoder->bytes;
+    record->width = imageWidth;
+    record->height = imageHeight;
+    record->mode = mode;
+    record->flags = ARCHIVE_FLAG_THUMB | ARCHIVE_FLAG_ON_AIR;
+    if (archiveStoreRecord(record)) {
+      Serial.printf("Archive: on-air picture %lu, %lu bytes, encoded in %lu ms (waited %lu ms)\n",
+                    (unsigned long)sequence, (unsigned long)record->jpegBytes, (unsigned long)job.encodeMs,
+                    (unsigned long)waitMs);
+    }
+  } else {
+    Serial.println("Archive: on-air picture not stored");
+  }
+  free(job.encoder);
+  free(record);
+  archiveJobActive = false;
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef __ARCHIVE_FORMAT_H
+#define __ARCHIVE_FORMAT_H
+
+/*******************************************************
+ * SD archive index format.
+ * The archive is a ring of archiveSlots JPEG files (/sstv/NNNNN.jpg, one
+ * per slot) and one index file (/sstv/index.bin): an ArchiveIndexHeader
+ * followed by one fixed-size ArchiveRecord per slot, holding the metadata
+ * of the frame in that slot and its 80x62 thumbnail. A frame is written to
+ * slot sequence % slots, so its record is updated in place with one seek.
+ * Plain C++ with no Arduino dependency (also used by tools/archive_thumbs.cpp).
+ *******************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "crc16.h"
+
+/*******************************************************
+ * CONSTANT: archiveMagic / archiveVersion
+ * DESCRIPTION: Identify an index file ("SSTA") and its layout.
+ *******************************************************/
+const uint32_t archiveMagic = 0x41545353;
+const uint16_t archiveVersion = 2;
+
+/*******************************************************
+ * CONSTANT: archiveThumbWidth / archiveThumbHeight
+ * DESCRIPTION: Thumbnail size (1/8 of the 640x496 on-air picture). A smaller
+ * frame leaves the rest black; a larger one gets no thumbnail.
+ *******************************************************/
+const int archiveThumbWidth = 80;
+const int archiveThumbHeight = 62;
+
+/*******************************************************
+ * ENUM: ArchiveFlags
+ * DESCRIPTION: ArchiveRecord.flags bits. ON_AIR: the JPEG is the picture as
+ * transmitted (overlays included), re-encoded on the beacon; otherwise it
+ * is the camera frame (OFDM sends it as is).
+ *******************************************************/
+enum ArchiveFlags { ARCHIVE_FLAG_THUMB = 1, ARCHIVE_FLAG_ON_AIR = 2 };
+
+/*******************************************************
+ * STRUCT: ArchiveIndexHeader
+ * DESCRIPTION: Start of the index file. nextSequence is the sequence the
+ * next frame gets (records with sequence < nextSequence may be in use).
+ *******************************************************/
+struct ArchiveIndexHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t slots;
+  uint16_t thumbWidth;
+  uint16_t thumbHeight;
+  uint32_t nextSequence;
+};
+
+/*******************************************************
+ * STRUCT: ArchiveRecord
+ * DESCRIPTION: One slot of the index. crc covers everything before it;
+ * a record whose crc does not match (never written, or torn by a power
+ * loss) is empty. The thumbnail is RGB565, row-major.
+ *******************************************************/
+struct ArchiveRecord {
+  uint32_t sequence;
+  uint32_t frameId;
+  uint32_t timestamp;   // UTC seconds (0 if the clock was not set)
+  uint32_t jpegBytes;
+  uint16_t width, height;
+  uint8_t mode;
+  uint8_t flags;
+  uint16_t thumbUs;     // Thumbnail decode time (0 for ON_AIR: made by the encoder)
+  uint16_t thumb[archiveThumbWidth * archiveThumbHeight];
+  uint16_t crc;
+};
+
+/*******************************************************
+ * FUNCTION: archiveRecordOffset
+ * DESCRIPTION: Position of a slot's record in the index file.
+ * INPUT: uint32_t slot
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t archiveRecordOffset(uint32_t slot) {
+  return sizeof(ArchiveIndexHeader) + slot * sizeof(ArchiveRecord);
+}
+
+/*******************************************************
+ * FUNCTION: archiveSeal / archiveValid
+ * DESCRIPTION: Set and check the CRC of a record.
+ * INPUT: ArchiveRecord &r
+ * OUTPUT: None / bool
+ *******************************************************/
+void archiveSeal(ArchiveRecord &r) {
+  r.crc = crc16CCITT((const uint8_t*)&r, offsetof(ArchiveRecord, crc));
+}
+
+bool archiveValid(const ArchiveRecord &r) {
+  return r.crc == crc16CCITT((const uint8_t*)&r, offsetof(ArchiveRecord, crc));
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef __COLOUR_CORRECTION_H
+#define __COLOUR_CORRECTION_H
+
+/*******************************************************
+ * Per-unit colour correction.
+ * A 3x3 matrix plus offsets (RGB -> RGB, 8-bit levels) measured for each
+ * camera with tools/ccm_calibrate.cpp and kept in NVS. It is never applied
+ * as a pass of its own: setColourCorrection() multiplies it into the
+ * RGB -> Y / R-Y / B-Y conversion, together with the RGB565 to 8-bit
+ * expansion, so the render kernels do the same number of operations with
+ * or without correction.
+ * Plain C++ with no Arduino dependency (also used by the host tools).
+ *******************************************************/
+
+#include <stdint.h>
+
+/*******************************************************
+ * STRUCT: ColourCorrection
+ * DESCRIPTION: Colour correction matrix in Q8 (256 = 1.0) and offsets in
+ * 8-bit levels: out = m * (R, G, B) / 256 + offset.
+ *******************************************************/
+struct ColourCorrection {
+  int16_t m[3][3];
+  int16_t offset[3];
+};
+
+/*******************************************************
+ * CONSTANT: colourIdentity
+ * DESCRIPTION: No correction.
+ *******************************************************/
+const ColourCorrection colourIdentity = { { { 256, 0, 0 }, { 0, 256, 0 }, { 0, 0, 256 } }, { 0, 0, 0 } };
+
+/*******************************************************
+ * GLOBAL VARIABLE: colourMatrix565
+ * DESCRIPTION: Fused conversion on the raw RGB565 fields (r5, g6, b5, 1)
+ * to Y, R-Y and B-Y, in Q16 of the "scaled by 256" outputs of pixelToYCC().
+ *******************************************************/
+int32_t colourMatrix565[3][4];
+/*******************************************************
+ * GLOBAL VARIABLE: colourMatrixRGB
+ * DESCRIPTION: Same conversion in floating point on 8-bit R, G, B
+ * (for the per-pixel path, convertToSSTV()).
+ *******************************************************/
+float colourMatrixRGB[3][4];
+
+/*******************************************************
+ * FUNCTION: setColourCorrection
+ * DESCRIPTION: Fuses a colour correction into colourMatrix565 and
+ * colourMatrixRGB: T * (M * rgb + offset), with T the PD120 rows
+ * Y = 0.299 R + 0.587 G + 0.114 B, R-Y = 0.713 (R - Y), B-Y = 0.564 (B - Y).
+ * INPUT: const ColourCorrection &cc
+ * OUTPUT: None
+ *******************************************************/
+void setColourCorrection(const ColourCorrection &cc) {
+  const float t[3][3] = {
+    { 0.299f, 0.587f, 0.114f },
+    { 0.713f * (1 - 0.299f), 0.713f * -0.587f, 0.713f * -0.114f },
+    { 0.564f * -0.299f, 0.564f * -0.587f, 0.564f * (1 - 0.114f) },
+  };
+  const float expand[3] = { 255.0f / 31, 255.0f / 63, 255.0f / 31 };
+  for (int row = 0; row < 3; row++) {
+    float offset = 0;
+    for (int col = 0; col < 3; col++) {
+      float k = 0;
+      for (int i = 0; i < 3; i++) k += t[row][i] * cc.m[i][col] / 256.0f;
+      colourMatrixRGB[row][col] = k;
+      float q = k * expand[col] * 65536.0f;
+      colourMatrix565[row][col] = (int32_t)(q < 0 ? q - 0.5f : q + 0.5f);
+      offset += t[row][col] * cc.offset[col];
+    }
+    colourMatrixRGB[row][3] = offset;
+    float q = offset * 65536.0f;
+    colourMatrix565[row][3] = (int32_t)(q < 0 ? q - 0.5f : q + 0.5f);
+  }
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef __CRC16_H
+#define __CRC16_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*******************************************************
+ * FUNCTION: crc16CCITT
+ * DESCRIPTION: CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), used by the
+ * OFDM header, the telemetry stripe and the journal records.
+ * INPUT: const uint8_t* data, size_t len
+ * OUTPUT: uint16_t
+ *******************************************************/
+uint16_t crc16CCITT(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+#endif
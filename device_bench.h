@@ -0,0 +1,627 @@
+#ifndef __DEVICE_BENCH_H
+#define __DEVICE_BENCH_H
+
+/*******************************************************
+ * On-device micro-benchmarks (DEVICE_BENCH).
+ * Runs the hot kernels of the transmission cycle on a synthetic canvas and
+ * prints their cost in CPU cycles, read from the Xtensa CCOUNT register:
+ * per pixel for the conversions, per line pair for the PD120 render, and
+ * MB/s for PSRAM and internal RAM. Short kernels run in a critical section
+ * (interrupts masked on this core), the long ones (JPEG decode, full-frame
+ * copy and fill) with the scheduler suspended, so other tasks do not land
+ * in a measurement. Every kernel runs DEVICE_BENCH_RUNS times; the minimum
+ * is the cost without cache misses from a cold start, the median the
+ * typical cost. Compare boards, chip revisions and PSRAM settings with the
+ * host figures of tools/pipeline_bench.cpp. A stride sweep times the
+ * line-pair read pattern from a cold cache for several canvas row strides
+ * (see CANVAS_ROW_PAD). The rotation of a sideways camera picture is timed
+ * row by row and in tiles (image_rotate.h). The DTMF decoder
+ * (dtmf_decoder.h) is timed per block, with its share of a core. The R-Y
+ * callback segment is timed from a cold cache on the canvas and on the
+ * line pair staged in internal RAM (radio_memory.h). The pixel
+ * clock jitter is measured on the esp_timer and on the isolated clock of
+ * tx_isolation.h, under the same camera and serial load, and on the
+ * isolated clock while another task writes the flash (tx_flash_safe.h).
+ *******************************************************/
+
+#include <xtensa/hal.h>
+#include <algorithm>
+#include "dtmf_decoder.h"
+#include "jpeg_strip_encoder.h"
+
+#ifndef DEVICE_BENCH_RUNS
+#define DEVICE_BENCH_RUNS 16
+#endif
+
+/*******************************************************
+ * CONSTANT: benchPsramBytes / benchInternalBytes
+ * DESCRIPTION: Sizes of the memory bandwidth buffers (the PSRAM one well
+ * beyond the 32 KB cache).
+ *******************************************************/
+const size_t benchPsramBytes = 256 * 1024;
+const size_t benchInternalBytes = 16 * 1024;
+
+/*******************************************************
+ * CONSTANT: benchStrides / benchStrideRows / benchEvictBytes
+ * DESCRIPTION: Row strides (pixels) of the line-pair sweep, rows read per
+ * run (well beyond the cache at any stride), and the PSRAM read before
+ * each run to evict them.
+ *******************************************************/
+const int benchStrides[] = { 640, 656, 672, 704, 768, 1024, 2048 };
+const int benchStrideRows = 64;
+const size_t benchEvictBytes = 64 * 1024;
+
+/*******************************************************
+ * CONSTANT: benchJitterSegments
+ * DESCRIPTION: PD120 scan segments played on each pixel clock by the
+ * jitter test (128 x 121.6 ms, 81920 ticks).
+ *******************************************************/
+const int benchJitterSegments = 128;
+/*******************************************************
+ * GLOBAL VARIABLE: benchLoadRunning / benchLoadEnded (volatile)
+ * DESCRIPTION: Keeps the load task of the jitter test running; set by the
+ * task once it has freed its buffer.
+ *******************************************************/
+volatile bool benchLoadRunning = false;
+volatile bool benchLoadEnded = false;
+
+/*******************************************************
+ * GLOBAL VARIABLE: benchMux
+ * DESCRIPTION: Critical section of the masked measurements.
+ *******************************************************/
+portMUX_TYPE benchMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ---------------------- Measurement ----------------------
+/*******************************************************
+ * FUNCTION: benchMeasure
+ * DESCRIPTION: Runs kernel(run) DEVICE_BENCH_RUNS times, each one timed
+ * with CCOUNT, either with interrupts masked or with the scheduler
+ * suspended, and returns the minimum and median cycles. prepare(run), if
+ * given, runs untimed before each run (e.g. to empty the cache).
+ * INPUT: Kernel kernel (void(int run)), bool masked, uint32_t &minCycles, uint32_t &medianCycles,
+ * Prepare prepare (void(int run), optional)
+ * OUTPUT: None
+ *******************************************************/
+template <typename Kernel, typename Prepare>
+void benchMeasure(Kernel kernel, bool masked, uint32_t &minCycles, uint32_t &medianCycles, Prepare prepare) {
+  uint32_t cycles[DEVICE_BENCH_RUNS];
+  for (int run = 0; run < DEVICE_BENCH_RUNS; run++) {
+    if (masked) portENTER_CRITICAL(&benchMux);
+    else vTaskSuspendAll();
+    prepare(run);
+    uint32_t start = xthal_get_ccount();
+    kernel(run);
+    cycles[run] = xthal_get_ccount() - start;
+    if (masked) portEXIT_CRITICAL(&benchMux);
+    else xTaskResumeAll();
+  }
+  std::sort(cycles, cycles + DEVICE_BENCH_RUNS);
+  minCycles = cycles[0];
+  medianCycles = cycles[DEVICE_BENCH_RUNS / 2];
+}
+
+template <typename Kernel>
+void benchMeasure(Kernel kernel, bool masked, uint32_t &minCycles, uint32_t &medianCycles) {
+  benchMeasure(kernel, masked, minCycles, medianCycles, [](int run) {});
+}
+
+/*******************************************************
+ * FUNCTION: benchReport
+ * DESCRIPTION: Prints one result: cycles per run (minimum, median), per
+ * unit (pixel or byte) and the median time.
+ * INPUT: const char* name, uint32_t minCycles, uint32_t medianCycles, uint32_t units, const char* unit
+ * OUTPUT: None
+ *******************************************************/
+void benchReport(const char* name, uint32_t minCycles, uint32_t medianCycles, uint32_t units, const char* unit) {
+  Serial.printf("%-22s %10lu %10lu %9.2f cyc/%-5s %9.1f us\n", name, (unsigned long)minCycles,
+                (unsigned long)medianCycles, (float)medianCycles / units, unit,
+                (float)medianCycles / getCpuFrequencyMhz());
+}
+
+/*******************************************************
+ * FUNCTION: benchReportBandwidth
+ * DESCRIPTION: Prints a memory result as MB/s (median) and cycles per byte.
+ * INPUT: const char* name, uint32_t medianCycles, size_t bytes
+ * OUTPUT: None
+ *******************************************************/
+void benchReportBandwidth(const char* name, uint32_t medianCycles, size_t bytes) {
+  Serial.printf("%-22s %9.1f MB/s %9.3f cyc/byte\n", name,
+                (float)bytes * getCpuFrequencyMhz() / medianCycles, (float)medianCycles / bytes);
+}
+
+// ---------------------- Synthetic Input ----------------------
+/*******************************************************
+ * FUNCTION: benchSyntheticPixel
+ * DESCRIPTION: Test pattern with gradients in every channel (the same as
+ * tools/pipeline_bench.cpp).
+ * INPUT: int x, int y
+ * OUTPUT: uint16_t (RGB565)
+ *******************************************************/
+uint16_t benchSyntheticPixel(int x, int y) {
+  return (uint16_t)(((x * 31 / imageWidth) << 11) | (((x + y) & 0x3F) << 5) | ((y * 31 / imageHeight) & 0x1F));
+}
+
+/*******************************************************
+ * STRUCT: BenchJpeg
+ * DESCRIPTION: Output of the synthetic JPEG encode (PSRAM).
+ *******************************************************/
+struct BenchJpeg {
+  uint8_t* data;
+  size_t length, capacity;
+};
+
+/*******************************************************
+ * FUNCTION: benchJpegWrite
+ * DESCRIPTION: Encoder writer: appends to a BenchJpeg.
+ * INPUT: void* context, const uint8_t* data, size_t len
+ * OUTPUT: bool
+ *******************************************************/
+bool benchJpegWrite(void* context, const uint8_t* data, size_t len) {
+  BenchJpeg &jpeg = *(BenchJpeg*)context;
+  if (jpeg.length + len > jpeg.capacity) return false;
+  memcpy(jpeg.data + jpeg.length, data, len);
+  jpeg.length += len;
+  return true;
+}
+
+// ---------------------- Stride Sweep ----------------------
+/*******************************************************
+ * FUNCTION: benchStrideSweep
+ * DESCRIPTION: Times the R-Y/B-Y read pattern (the two rows of a line
+ * pair read side by side) over benchStrideRows rows for every stride of
+ * benchStrides, each run from a cold cache. Rows that land in the same
+ * cache sets evict each other, which shows as more cycles per pair than
+ * the dense stride.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void benchStrideSweep() {
+  const int maxStride = benchStrides[sizeof(benchStrides) / sizeof(benchStrides[0]) - 1];
+  uint16_t* rows = (uint16_t*)heap_caps_aligned_alloc(canvasCacheLine, maxStride * benchStrideRows * sizeof(uint16_t),
+                                                      MALLOC_CAP_SPIRAM);
+  uint32_t* evict = (uint32_t*)heap_caps_malloc(benchEvictBytes, MALLOC_CAP_SPIRAM);
+  if (!rows || !evict) {
+    Serial.println("Bench: no memory for the stride sweep");
+    free(rows);
+    free(evict);
+    return;
+  }
+  for (int i = 0; i < maxStride * benchStrideRows; i++) rows[i] = benchSyntheticPixel(i % imageWidth, i / maxStride);
+  memset(evict, 0, benchEvictBytes);
+  Serial.printf("Line-pair reads, cold cache (canvas stride %d px = %d bytes):\n", canvasStride, canvasStride * 2);
+
+  uint32_t minCycles, medianCycles;
+  volatile uint32_t sink = 0;
+  for (int stride : benchStrides) {
+    benchMeasure([&](int run) {
+      for (int pair = 0; pair < benchStrideRows / 2; pair++) {
+        const uint16_t* odd = rows + 2 * pair * stride;
+        const uint16_t* even = odd + stride;
+        uint32_t sum = 0;
+        for (int x = 0; x < imageWidth; x++) sum += odd[x] + even[x];
+        sink += sum;
+      }
+    }, false, minCycles, medianCycles, [&](int run) {
+      uint32_t sum = 0;
+      for (size_t i = 0; i < benchEvictBytes / 4; i += canvasCacheLine / 4) sum += evict[i];
+      sink += sum;
+    });
+    char name[24];
+    snprintf(name, sizeof(name), "stride %d B%s", stride * 2, stride == canvasStride ? " *" : "");
+    benchReport(name, minCycles, medianCycles, benchStrideRows / 2, "pair");
+  }
+  free(rows);
+  free(evict);
+}
+
+// ---------------------- Pixel Clock Jitter ----------------------
+/*******************************************************
+ * FUNCTION: benchLoadTask
+ * DESCRIPTION: FreeRTOS task (other core, priority of the pipeline
+ * decoder) that loads the jitter test the way a cycle does: grabs camera
+ * frames and decodes them into PSRAM (camera DMA and VSYNC interrupts,
+ * PSRAM traffic), with a line on the serial port every second.
+ * INPUT: void* arg (unused)
+ * OUTPUT: None
+ *******************************************************/
+void benchLoadTask(void* arg) {
+  uint8_t* rgb565 = (uint8_t*)heap_caps_malloc(imageWidth * 480 * 2, MALLOC_CAP_SPIRAM);
+  uint32_t frames = 0, lastPrint = millis();
+  while (benchLoadRunning) {
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (fb) {
+      if (rgb565 && fb->width * fb->height <= imageWidth * 480) jpg2rgb565(fb->buf, fb->len, rgb565, (jpg_scale_t)0);
+      esp_camera_fb_return(fb);
+      frames++;
+    }
+    if (millis() - lastPrint >= 1000) {
+      lastPrint = millis();
+      Serial.printf("Bench: load, %lu camera frames\n", (unsigned long)frames);
+    }
+  }
+  free(rgb565);
+  benchLoadEnded = true;
+  vTaskDelete(NULL);
+}
+
+/*******************************************************
+ * FUNCTION: benchJitterRun
+ * DESCRIPTION: Plays benchJitterSegments scan segments on one pixel clock
+ * (output silent, PTT off) and keeps the jitter histogram they produced.
+ * INPUT: bool isolated, const uint8_t* levels (imageWidth), uint32_t* histogram (jitterBuckets),
+ * uint32_t &maxUs
+ * OUTPUT: None
+ *******************************************************/
+void benchJitterRun(bool isolated, const uint8_t* levels, uint32_t* histogram, uint32_t &maxUs) {
+  txClockEnabled = isolated;
+  memset(jitterHistogram, 0, sizeof(jitterHistogram));
+  jitterMaxUs = 0;
+  for (int s = 0; s < benchJitterSegments; s++) transmitLevelBuffer_HW(levels, imageWidth, pixelDuration);
+  toneOutputStop();
+  memcpy(histogram, jitterHistogram, sizeof(jitterHistogram));
+  maxUs = jitterMaxUs;
+}
+
+/*******************************************************
+ * FUNCTION: benchJitterTable
+ * DESCRIPTION: Prints two jitter histograms of |tick period - nominal|
+ * side by side (non-empty buckets), with p50, p99 and maximum.
+ * INPUT: const char* first, const char* second (Column titles),
+ * const uint32_t* histograms (2 x jitterBuckets), const uint32_t* maxUs (2)
+ * OUTPUT: None
+ *******************************************************/
+void benchJitterTable(const char* first, const char* second, const uint32_t* histograms, const uint32_t* maxUs) {
+  Serial.printf("%-10s %12s %12s\n", "|dev| us", first, second);
+  for (int i = 0; i < jitterBuckets; i++) {
+    if (!histograms[i] && !histograms[jitterBuckets + i]) continue;
+    char range[12];
+    if (i == jitterBuckets - 1) snprintf(range, sizeof(range), "%d+", i * jitterBucketUs);
+    else snprintf(range, sizeof(range), "%d-%d", i * jitterBucketUs, (i + 1) * jitterBucketUs);
+    Serial.printf("%-10s %12lu %12lu\n", range, (unsigned long)histograms[i], (unsigned long)histograms[jitterBuckets + i]);
+  }
+  for (int percent : { 50, 99 }) {
+    Serial.printf("p%-9d %9lu us %9lu us\n", percent, (unsigned long)jitterPercentileUs(percent, histograms),
+                  (unsigned long)jitterPercentileUs(percent, histograms + jitterBuckets));
+  }
+  Serial.printf("%-10s %9lu us %9lu us\n", "max", (unsigned long)maxUs[0], (unsigned long)maxUs[1]);
+}
+
+/*******************************************************
+ * FUNCTION: benchPixelClockJitter
+ * DESCRIPTION: Pixel clock jitter before and after isolation: the same
+ * segments on the esp_timer clock and on the isolated clock, with
+ * benchLoadTask running on the other core, printed as two histograms of
+ * |tick period - nominal| side by side. Without TX_ISOLATION the isolated
+ * clock is created here, but the peripheral interrupts stay on this core.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void benchPixelClockJitter() {
+  bool enabled = txClockEnabled;
+  uint8_t* levels = (uint8_t*)heap_caps_malloc(imageWidth, MALLOC_CAP_INTERNAL);
+  uint32_t* histograms = (uint32_t*)heap_caps_malloc(2 * sizeof(jitterHistogram), MALLOC_CAP_INTERNAL);
+  if (!levels || !histograms || !txClockBegin()) {
+    Serial.println("Bench: jitter test skipped");
+    free(levels);
+    free(histograms);
+    return;
+  }
+  for (int x = 0; x < imageWidth; x++) levels[x] = (uint8_t)(x * 255 / (imageWidth - 1));
+  int loadCore = 1 - xPortGetCoreID();
+  Serial.printf("Pixel clock jitter, %d segments per clock, camera load on core %d, peripheral interrupts %s:\n",
+                benchJitterSegments, loadCore, enabled ? "on that core too (TX_ISOLATION)" : "on this core");
+  benchLoadRunning = true;
+  benchLoadEnded = false;
+  xTaskCreatePinnedToCore(benchLoadTask, "benchload", 8192, NULL, 5, NULL, loadCore);
+  uint32_t maxUs[2];
+  benchJitterRun(false, levels, histograms, maxUs[0]);
+  benchJitterRun(true, levels, histograms + jitterBuckets, maxUs[1]);
+  benchLoadRunning = false;
+  while (!benchLoadEnded) delay(10);
+  txClockEnabled = enabled;
+  benchJitterTable("esp_timer", "isolated", histograms, maxUs);
+  free(levels);
+  free(histograms);
+}
+
+// ---------------------- Flash Writes on Air ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: benchFlashWrites
+ * DESCRIPTION: NVS writes completed by benchFlashTask.
+ *******************************************************/
+uint32_t benchFlashWrites = 0;
+
+/*******************************************************
+ * FUNCTION: benchFlashTask
+ * DESCRIPTION: FreeRTOS task (other core) that writes a 256-byte blob to
+ * NVS every 5 ms, alternating two keys, so pages fill and are erased as
+ * with a logger; the namespace is cleared at the end.
+ * INPUT: void* arg (unused)
+ * OUTPUT: None
+ *******************************************************/
+void benchFlashTask(void* arg) {
+  Preferences prefs;
+  uint8_t blob[256];
+  uint32_t writes = 0;
+  if (prefs.begin("benchflash", false)) {
+    while (benchLoadRunning) {
+      memset(blob, (uint8_t)writes, sizeof(blob));
+      if (prefs.putBytes(writes & 1 ? "b" : "a", blob, sizeof(blob)) == sizeof(blob)) writes++;
+      delay(5);
+    }
+    prefs.clear();
+    prefs.end();
+  }
+  benchFlashWrites = writes;
+  benchLoadEnded = true;
+  vTaskDelete(NULL);
+}
+
+/*******************************************************
+ * FUNCTION: benchFlashWriteJitter
+ * DESCRIPTION: Flash-write safety of the isolated clock: checks where the
+ * clock path was linked (txFlashSafeCheck()), then plays the same
+ * segments on it without flash writes and with benchFlashTask writing
+ * NVS on the other core, and prints both jitter histograms. A path that
+ * is safe keeps every tick of the second run in the first bucket, as in
+ * the first; the segment starts, issued by the loop task, still wait for
+ * the writes and are not counted.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void benchFlashWriteJitter() {
+  bool enabled = txClockEnabled;
+  uint8_t* levels = (uint8_t*)heap_caps_malloc(imageWidth, MALLOC_CAP_INTERNAL);
+  uint32_t* histograms = (uint32_t*)heap_caps_malloc(2 * sizeof(jitterHistogram), MALLOC_CAP_INTERNAL);
+  if (!levels || !histograms || !txClockBegin()) {
+    Serial.println("Bench: flash write test skipped");
+    free(levels);
+    free(histograms);
+    return;
+  }
+  for (int x = 0; x < imageWidth; x++) levels[x] = (uint8_t)(x * 255 / (imageWidth - 1));
+  bool safe = txFlashSafeCheck();
+  int writerCore = 1 - xPortGetCoreID();
+  Serial.printf("Isolated clock during flash writes, %d segments per run, NVS writes on core %d:\n",
+                benchJitterSegments, writerCore);
+  uint32_t maxUs[2];
+  benchJitterRun(true, levels, histograms, maxUs[0]);
+  benchLoadRunning = true;
+  benchLoadEnded = false;
+  xTaskCreatePinnedToCore(benchFlashTask, "benchflash", 4096, NULL, 5, NULL, writerCore);
+  benchJitterRun(true, levels, histograms + jitterBuckets, maxUs[1]);
+  benchLoadRunning = false;
+  while (!benchLoadEnded) delay(10);
+  txClockEnabled = enabled;
+  benchJitterTable("no writes", "NVS writes", histograms, maxUs);
+  uint32_t late = 0;
+  for (int i = 1; i < jitterBuckets; i++) late += histograms[jitterBuckets + i];
+  Serial.printf("Bench: %lu NVS writes, %lu ticks off by %d us or more (path %s)\n", (unsigned long)benchFlashWrites,
+                (unsigned long)late, jitterBucketUs, safe ? "flash-safe" : "NOT flash-safe");
+  free(levels);
+  free(histograms);
+}
+
+// ---------------------- Benchmarks ----------------------
+/*******************************************************
+ * FUNCTION: deviceBench
+ * DESCRIPTION: Prints the board configuration, then runs and reports every
+ * kernel. Needs initRenderTables() and loadColourCorrection() first; takes
+ * the place of the transmission cycle (nothing is keyed).
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void deviceBench() {
+  Serial.printf("Bench: chip rev %d, CPU %lu MHz, PSRAM %lu bytes, %d runs per kernel\n", ESP.getChipRevision(),
+                (unsigned long)getCpuFrequencyMhz(), (unsigned long)ESP.getPsramSize(), DEVICE_BENCH_RUNS);
+#if defined(CONFIG_SPIRAM_SPEED_80M)
+  Serial.println("Bench: PSRAM clock 80 MHz");
+#elif defined(CONFIG_SPIRAM_SPEED_40M)
+  Serial.println("Bench: PSRAM clock 40 MHz");
+#endif
+  generateBaseImage();
+  uint16_t* buffer = canvas->getBuffer();
+  for (int y = 0; y < imageHeight; y++) {
+    for (int x = 0; x < imageWidth; x++) canvasRow(buffer, y)[x] = benchSyntheticPixel(x, y);
+  }
+  Serial.printf("%-22s %10s %10s\n", "kernel", "min cyc", "median cyc");
+  uint32_t minCycles, medianCycles;
+  volatile uint32_t sink = 0;
+
+  // Real-time callback path: one scan segment, a different line per run
+  benchMeasure([&](int run) {
+    int row = (run * 31) % imageHeight;
+    for (int x = 0; x < imageWidth; x++) {
+      uint8_t R, G, B;
+      float Y, RY, BY;
+      getCanvasPixel(x, row, R, G, B);
+      convertToSSTV(R, G, B, Y, RY, BY);
+      sink += mapYToFrequency(Y);
+    }
+  }, true, minCycles, medianCycles);
+  benchReport("callback Y segment", minCycles, medianCycles, imageWidth, "pixel");
+
+  benchMeasure([&](int run) {
+    int row = (run * 62) % (imageHeight - 1) & ~1;
+    for (int x = 0; x < imageWidth; x++) {
+      uint8_t R1, G1, B1, R2, G2, B2;
+      float Y1, RY1, BY1, Y2, RY2, BY2;
+      getCanvasPixel(x, row, R1, G1, B1);
+      getCanvasPixel(x, row + 1, R2, G2, B2);
+      convertToSSTV(R1, G1, B1, Y1, RY1, BY1);
+      convertToSSTV(R2, G2, B2, Y2, RY2, BY2);
+      sink += mapDiffToFrequency((RY1 + RY2) / 2.0);
+    }
+  }, true, minCycles, medianCycles);
+  benchReport("callback R-Y segment", minCycles, medianCycles, imageWidth, "pixel");
+
+  // The same segment from a cold cache: on the canvas, and on the line pair staged during the sync pulse
+  uint16_t* stage = (uint16_t*)heap_caps_malloc(2 * imageWidth * sizeof(uint16_t), MALLOC_CAP_INTERNAL);
+  uint32_t* evict = (uint32_t*)heap_caps_malloc(benchEvictBytes, MALLOC_CAP_SPIRAM);
+  if (stage && evict) {
+    memset(evict, 0, benchEvictBytes);
+    for (int staged = 0; staged < 2; staged++) {
+      benchMeasure([&](int run) {
+        int row = 2 * ((run * 31) % (imageHeight / 2));
+        for (int x = 0; x < imageWidth; x++) {
+          uint8_t R1, G1, B1, R2, G2, B2;
+          float Y1, RY1, BY1, Y2, RY2, BY2;
+          getCanvasPixel(x, row, R1, G1, B1);
+          getCanvasPixel(x, row + 1, R2, G2, B2);
+          convertToSSTV(R1, G1, B1, Y1, RY1, BY1);
+          convertToSSTV(R2, G2, B2, Y2, RY2, BY2);
+          sink += mapDiffToFrequency((RY1 + RY2) / 2.0);
+        }
+      }, true, minCycles, medianCycles, [&](int run) {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < benchEvictBytes / 4; i += canvasCacheLine / 4) sum += evict[i];
+        sink += sum;
+        int pair = (run * 31) % (imageHeight / 2);
+        stagedPair = -1;
+        if (!staged) return;
+        memcpy(stage, canvasRow(buffer, 2 * pair), imageWidth * sizeof(uint16_t));
+        memcpy(stage + imageWidth, canvasRow(buffer, 2 * pair + 1), imageWidth * sizeof(uint16_t));
+        pairStage = stage;
+        stagedPair = pair;
+      });
+      benchReport(staged ? "R-Y cold, staged pair" : "R-Y cold, canvas", minCycles, medianCycles, imageWidth, "pixel");
+    }
+    stagedPair = -1;
+    pairStage = nullptr;
+    // Y, R-Y, B-Y, Y: each row of the pair is read three times by the callback
+    Serial.printf("%-22s %10d PSRAM cache lines per line pair in the callback from the canvas, 0 staged\n", "",
+                  6 * imageWidth * (int)sizeof(uint16_t) / canvasCacheLine);
+#ifdef RADIO_MEMORY_RELEASE
+    Serial.printf("%-22s %10u bytes of internal heap from the radio stacks\n", "", (unsigned)radioMemoryGained);
+#endif
+  }
+  free(stage);
+  free(evict);
+
+  // Pre-rendered path: one line pair (four segments)
+  LinePairTones* tones = (LinePairTones*)heap_caps_malloc(sizeof(LinePairTones), MALLOC_CAP_INTERNAL);
+  if (tones) {
+    benchMeasure([&](int run) { renderPD120LinePair(buffer, (run * 31) % (imageHeight / 2), *tones, 0, imageWidth); },
+                 true, minCycles, medianCycles);
+    benchReport("render line pair", minCycles, medianCycles, 2 * imageWidth, "pixel");
+    Serial.printf("%-22s %10lu cycles per line pair\n", "", (unsigned long)medianCycles);
+    free(tones);
+  }
+
+  // Camera picture: JPEG decode, then the copy into the canvas (640x480)
+  const int camWidth = imageWidth, camHeight = 480;
+  BenchJpeg jpeg = { (uint8_t*)heap_caps_malloc(128 * 1024, MALLOC_CAP_SPIRAM), 0, 128 * 1024 };
+  JpegStripEncoder* encoder = (JpegStripEncoder*)heap_caps_malloc(sizeof(JpegStripEncoder), MALLOC_CAP_SPIRAM);
+  uint8_t* rgb565 = (uint8_t*)heap_caps_malloc(camWidth * camHeight * 2, MALLOC_CAP_SPIRAM);
+  bool encoded = false;
+  if (jpeg.data && encoder && rgb565 &&
+      jpegStripBegin(*encoder, camWidth, camHeight, 3, 80, benchJpegWrite, &jpeg, NULL)) {
+    int band = jpegStripBandHeight(*encoder);
+    for (int y = 0; y < camHeight && encoder->ok; y += band) jpegStripEncodeBand(*encoder, canvasRow(buffer, y), canvasStride);
+    encoded = jpegStripEnd(*encoder);
+  }
+  if (encoded) {
+    Serial.printf("%-22s %10lu bytes, 4:2:0 q80 (camera JPEGs are 4:2:2)\n", "synthetic JPEG", (unsigned long)jpeg.length);
+    benchMeasure([&](int run) { sink += jpg2rgb565(jpeg.data, jpeg.length, rgb565, (jpg_scale_t)0); },
+                 false, minCycles, medianCycles);
+    benchReport("JPEG decode", minCycles, medianCycles, camWidth * camHeight, "pixel");
+    benchMeasure([&](int run) {
+      for (int y = 0; y < camHeight; y++) {
+        for (int x = 0; x < camWidth; x++) {
+          int srcIndex = (y * camWidth + x) * 2;
+          canvasRow(buffer, y)[x] = (((uint16_t)rgb565[srcIndex + 1]) << 8) | rgb565[srcIndex];
+        }
+      }
+    }, false, minCycles, medianCycles);
+    benchReport("decode -> canvas copy", minCycles, medianCycles, camWidth * camHeight, "pixel");
+
+    // Sideways camera: the same picture rotated into the canvas, row by row and in tiles
+    RotationMap* map = (RotationMap*)heap_caps_malloc(sizeof(RotationMap), MALLOC_CAP_INTERNAL);
+    if (map) {
+      rotationMapBuild(*map, camWidth, camHeight, camWidth, camHeight, 90);
+      benchMeasure([&](int run) { rotateNaive((const uint16_t*)rgb565, buffer, canvasStride, *map); },
+                   false, minCycles, medianCycles);
+      benchReport("rotate 90 row by row", minCycles, medianCycles, map->width * map->height, "pixel");
+      benchMeasure([&](int run) { rotateBlocked((const uint16_t*)rgb565, buffer, canvasStride, *map); },
+                   false, minCycles, medianCycles);
+      benchReport("rotate 90 tiled", minCycles, medianCycles, map->width * map->height, "pixel");
+      free(map);
+    }
+  } else {
+    Serial.println("Bench: synthetic JPEG failed, decode skipped");
+  }
+  free(jpeg.data);
+  free(encoder);
+  free(rgb565);
+
+  // Overlay text: rasterised every time, or composited from its RLE layer
+  const char* text = CALLSIGN " " LOCATOR " 12:00Z";
+  benchMeasure([&](int run) { drawOutlinedText(*canvas, text, TEXT_TOP_X, TEXT_TOP_Y, TEXT_TOP_SIZE, OVERLAY_COLOR_TOP, OUTLINE_TOP); },
+               true, minCycles, medianCycles);
+  benchReport("overlay rasterise", minCycles, medianCycles, strlen(text), "char");
+  uint8_t* blob = (uint8_t*)malloc(sizeof(OverlayLayerHeader) + 2 * overlayLayerMaxRuns);
+  if (blob && overlayLayerBuild(text, TEXT_TOP_X, TEXT_TOP_Y, TEXT_TOP_SIZE, OVERLAY_COLOR_TOP, OUTLINE_TOP,
+                                *(OverlayLayerHeader*)blob, blob + sizeof(OverlayLayerHeader))) {
+    const OverlayLayerHeader &header = *(OverlayLayerHeader*)blob;
+    benchMeasure([&](int run) { overlayLayerComposite(header, blob + sizeof(OverlayLayerHeader)); },
+                 true, minCycles, medianCycles);
+    benchReport("overlay composite", minCycles, medianCycles, strlen(text), "char");
+  }
+  free(blob);
+
+  // Fills
+  benchMeasure([&](int run) { canvas->fillRect(100, 100, 100, 100, run); }, true, minCycles, medianCycles);
+  benchReport("fillRect 100x100", minCycles, medianCycles, 100 * 100, "pixel");
+  benchMeasure([&](int run) { canvas->fillScreen(run); }, false, minCycles, medianCycles);
+  benchReport("fillScreen", minCycles, medianCycles, imageWidth * imageHeight, "pixel");
+
+  // DTMF decoder: one block of a key, and its share of a core at the decoder sample rate
+  DtmfDecoder* dtmf = (DtmfDecoder*)malloc(sizeof(DtmfDecoder));
+  if (dtmf) {
+    dtmfDecoderInit(*dtmf, "1234");
+    int16_t block[dtmfBlock];
+    for (int i = 0; i < dtmfBlock; i++) {
+      float t = (float)i / dtmfSampleRate;
+      block[i] = 2048 + (int16_t)(400.0f * (sinf(2.0f * (float)M_PI * 770.0f * t) + sinf(2.0f * (float)M_PI * 1336.0f * t)));
+    }
+    benchMeasure([&](int run) { sink += dtmfDecodeBlock(*dtmf, block).kind; }, true, minCycles, medianCycles);
+    benchReport("DTMF block", minCycles, medianCycles, dtmfBlock, "sample");
+    Serial.printf("%-22s %10.2f%% of a core at %d Hz\n", "",
+                  100.0 * medianCycles * dtmfSampleRate / dtmfBlock / (getCpuFrequencyMhz() * 1e6), dtmfSampleRate);
+    free(dtmf);
+  }
+
+  // Pixel clock jitter under load, esp_timer and isolated clock
+  benchPixelClockJitter();
+  benchFlashWriteJitter();
+
+  // Memory bandwidth: sequential 32-bit reads, memset, memcpy
+  free(canvas->getBuffer());
+  benchStrideSweep();
+  const char* names[2][3] = { { "PSRAM read", "PSRAM write", "PSRAM copy" },
+                              { "internal read", "internal write", "internal copy" } };
+  for (int m = 0; m < 2; m++) {
+    size_t bytes = m == 0 ? benchPsramBytes : benchInternalBytes;
+    uint32_t caps = m == 0 ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    uint32_t* a = (uint32_t*)heap_caps_malloc(bytes, caps);
+    uint32_t* b = (uint32_t*)heap_caps_malloc(bytes, caps);
+    if (a && b) {
+      memset(a, 0x5A, bytes);
+      benchMeasure([&](int run) {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < bytes / 4; i++) sum += a[i];
+        sink += sum;
+      }, m == 1, minCycles, medianCycles);
+      benchReportBandwidth(names[m][0], medianCycles, bytes);
+      benchMeasure([&](int run) { memset(b, run, bytes); }, m == 1, minCycles, medianCycles);
+      benchReportBandwidth(names[m][1], medianCycles, bytes);
+      benchMeasure([&](int run) { memcpy(b, a, bytes); }, m == 1, minCycles, medianCycles);
+      benchReportBandwidth(names[m][2], medianCycles, bytes);
+    }
+    free(a);
+    free(b);
+  }
+  Serial.println("Bench: done");
+}
+
+#endif
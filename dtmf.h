@@ -0,0 +1,263 @@
+#ifndef __DTMF_H
+#define __DTMF_H
+
+/*******************************************************
+ * DTMF remote control (DTMF_CONTROL).
+ * After a cycle the beacon listens to the receiver audio on
+ * DTMF_AUDIO_PIN instead of going straight to Deep Sleep: it light-sleeps
+ * DTMF_SLEEP_MS, listens DTMF_WINDOW_MS, and so on until the next cycle is
+ * due. A key heard in a window keeps it awake until DTMF_COMMAND_MS pass
+ * without one, so the sender holds '*' for longer than DTMF_SLEEP_MS plus
+ * a window, then keys the rest of the command (dtmf_decoder.h) at normal
+ * speed. "Transmit now" ends the listening at once; mode and interval are
+ * kept in RTC memory and used from the next cycle.
+ * The audio is sampled by the continuous ADC driver (DMA, no CPU per
+ * sample) on an ADC1 pin; on the ESP32-CAM that is GPIO 33, the red LED
+ * pad (remove the LED). The ESP32 continuous ADC runs at 20 kHz or more,
+ * so it samples at 3 x 8 kHz and averages each group of three. The ADC
+ * shares I2S0 with the camera, which is released first.
+ *******************************************************/
+
+#include <esp_adc/adc_continuous.h>
+#include <driver/gpio.h>
+#include "dtmf_decoder.h"
+#include "sstv_render.h"
+
+#ifndef DTMF_SLEEP_MS
+#define DTMF_SLEEP_MS 1000
+#endif
+#ifndef DTMF_WINDOW_MS
+#define DTMF_WINDOW_MS 100
+#endif
+#ifndef DTMF_COMMAND_MS
+#define DTMF_COMMAND_MS 10000
+#endif
+
+/*******************************************************
+ * CONSTANT: dtmfDecimation / dtmfFrameBytes / dtmfRestartUs
+ * DESCRIPTION: ADC samples averaged into one decoder sample; bytes of one
+ * ADC DMA frame; Deep Sleep that starts the next cycle after listening.
+ *******************************************************/
+const int dtmfDecimation = 3;
+const uint32_t dtmfFrameBytes = 256 * SOC_ADC_DIGI_RESULT_BYTES;
+const uint64_t dtmfRestartUs = 1000;
+
+/*******************************************************
+ * GLOBAL VARIABLE: dtmfMode / dtmfIntervalMin (RTC memory)
+ * DESCRIPTION: SSTV mode and interval (minutes) set over the air
+ * (-1 / 0: the sketch settings).
+ *******************************************************/
+RTC_DATA_ATTR int8_t dtmfMode = -1;
+RTC_DATA_ATTR uint16_t dtmfIntervalMin = 0;
+
+/*******************************************************
+ * GLOBAL VARIABLE: dtmfAdc
+ * DESCRIPTION: Continuous ADC handle while a window is open (NULL otherwise).
+ *******************************************************/
+adc_continuous_handle_t dtmfAdc = NULL;
+
+/*******************************************************
+ * FUNCTION: dtmfModeOverride
+ * DESCRIPTION: Replaces the mode with the one set over the air, if any
+ * (also after AUTO_MODE has chosen).
+ * INPUT: SSTVMode &mode
+ * OUTPUT: bool (true if replaced)
+ *******************************************************/
+bool dtmfModeOverride(SSTVMode &mode) {
+  if (dtmfMode < 0) return false;
+  mode = (SSTVMode)dtmfMode;
+  return true;
+}
+
+/*******************************************************
+ * FUNCTION: dtmfSleepSeconds
+ * DESCRIPTION: Time to the next cycle: the interval set over the air, or
+ * the one planned (TIME_TO_SLEEP, or the GPS slot).
+ * INPUT: uint32_t planned (seconds)
+ * OUTPUT: uint32_t (seconds)
+ *******************************************************/
+uint32_t dtmfSleepSeconds(uint32_t planned) {
+  return dtmfIntervalMin ? (uint32_t)dtmfIntervalMin * 60 : planned;
+}
+
+// ---------------------- Audio Input ----------------------
+/*******************************************************
+ * FUNCTION: dtmfAdcOpen
+ * DESCRIPTION: Starts DMA sampling of DTMF_AUDIO_PIN at
+ * dtmfDecimation x dtmfSampleRate.
+ * INPUT: None
+ * OUTPUT: bool (false if the pin is not on ADC1 or the driver failed)
+ *******************************************************/
+bool dtmfAdcOpen() {
+  adc_unit_t unit;
+  adc_channel_t channel;
+  if (adc_continuous_io_to_channel(DTMF_AUDIO_PIN, &unit, &channel) != ESP_OK || unit != ADC_UNIT_1) {
+    Serial.println("DTMF: DTMF_AUDIO_PIN is not an ADC1 pin");
+    return false;
+  }
+  // No output driver and no pull on the audio: released GPIO, then the ADC takes the pad
+  gpio_reset_pin((gpio_num_t)DTMF_AUDIO_PIN);
+  gpio_pullup_dis((gpio_num_t)DTMF_AUDIO_PIN);
+  adc_continuous_handle_cfg_t handleConfig = {};
+  handleConfig.max_store_buf_size = dtmfFrameBytes * 4;
+  handleConfig.conv_frame_size = dtmfFrameBytes;
+  if (adc_continuous_new_handle(&handleConfig, &dtmfAdc) != ESP_OK) {
+    Serial.println("DTMF: ADC driver failed");
+    dtmfAdc = NULL;
+    return false;
+  }
+  adc_digi_pattern_config_t pattern = {};
+  pattern.atten = ADC_ATTEN_DB_12;
+  pattern.channel = channel;
+  pattern.unit = unit;
+  pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  adc_continuous_config_t config = {};
+  config.pattern_num = 1;
+  config.adc_pattern = &pattern;
+  config.sample_freq_hz = dtmfSampleRate * dtmfDecimation;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+  if (adc_continuous_config(dtmfAdc, &config) != ESP_OK || adc_continuous_start(dtmfAdc) != ESP_OK) {
+    Serial.println("DTMF: ADC configuration failed");
+    adc_continuous_deinit(dtmfAdc);
+    dtmfAdc = NULL;
+    return false;
+  }
+  return true;
+}
+
+/*******************************************************
+ * FUNCTION: dtmfAdcClose
+ * DESCRIPTION: Stops sampling and frees the driver (before light sleep).
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void dtmfAdcClose() {
+  if (!dtmfAdc) return;
+  adc_continuous_stop(dtmfAdc);
+  adc_continuous_deinit(dtmfAdc);
+  dtmfAdc = NULL;
+}
+
+// ---------------------- Listening ----------------------
+/*******************************************************
+ * STRUCT: DtmfListenStats
+ * DESCRIPTION: Time spent awake listening and in the decoder (its share
+ * of one core while awake is the detector budget), and windows opened.
+ *******************************************************/
+struct DtmfListenStats {
+  int64_t awakeUs;
+  int64_t decodeUs;
+  uint32_t windows;
+};
+
+/*******************************************************
+ * FUNCTION: dtmfRun
+ * DESCRIPTION: Opens the ADC and decodes for `ms`, extended to
+ * DTMF_COMMAND_MS after every key, until a command completes. The first
+ * block (ADC settling) is dropped.
+ * INPUT: DtmfDecoder &d, uint32_t ms, DtmfListenStats &stats
+ * OUTPUT: DtmfCommand (DTMF_NONE: none completed)
+ *******************************************************/
+DtmfCommand dtmfRun(DtmfDecoder &d, uint32_t ms, DtmfListenStats &stats) {
+  DtmfCommand cmd = { DTMF_NONE, 0 };
+  int64_t start = esp_timer_get_time(), until = start + (int64_t)ms * 1000;
+  stats.windows++;
+  if (!dtmfAdcOpen()) return cmd;
+
+  static uint8_t raw[dtmfFrameBytes];
+  int16_t block[dtmfBlock];
+  int fill = 0, blocks = 0, sum = 0, summed = 0;
+  while (cmd.kind == DTMF_NONE && esp_timer_get_time() < until) {
+    uint32_t got = 0;
+    if (adc_continuous_read(dtmfAdc, raw, sizeof(raw), &got, 50) != ESP_OK) continue;
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= got && cmd.kind == DTMF_NONE; i += SOC_ADC_DIGI_RESULT_BYTES) {
+      sum += ((const adc_digi_output_data_t*)(raw + i))->type1.data;
+      if (++summed < dtmfDecimation) continue;
+      block[fill++] = sum / dtmfDecimation;
+      sum = summed = 0;
+      if (fill < dtmfBlock) continue;
+      fill = 0;
+      if (blocks++ == 0) continue;
+      int64_t t = esp_timer_get_time();
+      char key;
+      cmd = dtmfDecodeBlock(d, block, &key);
+      stats.decodeUs += esp_timer_get_time() - t;
+      if (!key) continue;
+      Serial.printf("DTMF: %c\n", key);
+      until = esp_timer_get_time() + (int64_t)DTMF_COMMAND_MS * 1000;
+    }
+  }
+  dtmfAdcClose();
+  stats.awakeUs += esp_timer_get_time() - start;
+  return cmd;
+}
+
+/*******************************************************
+ * FUNCTION: dtmfApply
+ * DESCRIPTION: Carries out a completed command.
+ * INPUT: const DtmfCommand &cmd
+ * OUTPUT: bool (true: transmit now)
+ *******************************************************/
+bool dtmfApply(const DtmfCommand &cmd) {
+  switch (cmd.kind) {
+    case DTMF_TRANSMIT:
+      Serial.println("DTMF: transmit now");
+      return true;
+    case DTMF_MODE:
+      if (cmd.value > MODE_OFDM) {
+        Serial.printf("DTMF: no mode %u\n", cmd.value);
+        break;
+      }
+      dtmfMode = cmd.value;
+      Serial.printf("DTMF: mode %u from the next cycle\n", cmd.value);
+      break;
+    case DTMF_INTERVAL:
+      dtmfIntervalMin = cmd.value;
+      Serial.printf("DTMF: interval %u min from the next cycle\n", cmd.value);
+      break;
+    case DTMF_CLEAR:
+      dtmfMode = -1;
+      dtmfIntervalMin = 0;
+      Serial.println("DTMF: back to the sketch settings");
+      break;
+    case DTMF_REJECTED:
+      Serial.println("DTMF: command rejected");
+      break;
+  }
+  return false;
+}
+
+/*******************************************************
+ * FUNCTION: dtmfListen
+ * DESCRIPTION: Replaces the Deep Sleep between cycles: light sleep and
+ * listen windows for `seconds`, or until "transmit now". Then sets a short
+ * Deep Sleep timer, so the next cycle starts from the usual wake-up.
+ * INPUT: uint32_t seconds
+ * OUTPUT: bool (true: ended by "transmit now")
+ *******************************************************/
+bool dtmfListen(uint32_t seconds) {
+  int64_t deadline = esp_timer_get_time() + (int64_t)seconds * uS_TO_S_FACTOR;
+  esp_camera_deinit();   // The continuous ADC uses I2S0 as well
+  DtmfDecoder d;
+  dtmfDecoderInit(d, DTMF_PIN);
+  DtmfListenStats stats = { 0, 0, 0 };
+  Serial.printf("DTMF: listening for %u s\n", seconds);
+
+  bool transmitNow = false;
+  while (esp_timer_get_time() < deadline) {
+    transmitNow = dtmfApply(dtmfRun(d, DTMF_WINDOW_MS, stats));
+    if (transmitNow) break;
+    int64_t left = deadline - esp_timer_get_time();
+    if (left <= 0) break;
+    Serial.flush();
+    esp_sleep_enable_timer_wakeup(left < (int64_t)DTMF_SLEEP_MS * 1000 ? left : (int64_t)DTMF_SLEEP_MS * 1000);
+    esp_light_sleep_start();
+  }
+  Serial.printf("DTMF: %u windows, awake %.1f s, decoder %.2f%% of a core while awake\n", stats.windows,
+                stats.awakeUs / 1e6, stats.awakeUs ? 100.0 * stats.decodeUs / stats.awakeUs : 0.0);
+  esp_sleep_enable_timer_wakeup(dtmfRestartUs);
+  return transmitNow;
+}
+
+#endif
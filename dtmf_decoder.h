@@ -0,0 +1,258 @@
+#ifndef __DTMF_DECODER_H
+#define __DTMF_DECODER_H
+
+/*******************************************************
+ * DTMF remote command decoder.
+ * A Goertzel filter bank on the eight DTMF tones over blocks of 205
+ * samples at 8 kHz (25.6 ms, bins about 39 Hz wide, narrower than the
+ * spacing of the row tones). A block holds a key when one row and one
+ * column tone stand clearly above the others of their group, their levels
+ * are within the allowed twist, and together they carry most of the block
+ * energy (speech, noise and the single tones of SSTV do not). A key is
+ * reported once after two consecutive blocks, so tones of 80 ms or more
+ * (radio keypads send about 100 ms) are decoded and a held key counts once.
+ * Keys then form commands:
+ *   *<PIN>1#       transmit now
+ *   *<PIN>2<m>#    SSTV mode m (SSTVMode: 0 PD120, 1 BW8, 2 BW12, 3 BW24, 4 OFDM)
+ *   *<PIN>3<min>#  interval between transmissions, minutes
+ *   *<PIN>0#       back to the sketch settings
+ * '*' always starts a new command, so a long '*' can wake the listener.
+ * Plain C++ with no Arduino dependency (also used by tools/dtmf_wav.cpp).
+ *******************************************************/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef DTMF_MIN_LEVEL
+#define DTMF_MIN_LEVEL 12.0f   // Minimum RMS level of a block (ADC counts, 12-bit)
+#endif
+
+// ---------------------- Tone Detection ----------------------
+/*******************************************************
+ * CONSTANT: dtmfSampleRate / dtmfBlock
+ * DESCRIPTION: Sample rate of the decoder input and samples per Goertzel
+ * block.
+ *******************************************************/
+const int dtmfSampleRate = 8000;
+const int dtmfBlock = 205;
+
+/*******************************************************
+ * CONSTANT: dtmfTones / dtmfKeys
+ * DESCRIPTION: Row (697-941 Hz) and column (1209-1633 Hz) frequencies, and
+ * the key of each row/column pair (row-major).
+ *******************************************************/
+const float dtmfTones[8] = { 697.0f, 770.0f, 852.0f, 941.0f, 1209.0f, 1336.0f, 1477.0f, 1633.0f };
+const char dtmfKeys[] = "123A456B789C*0#D";
+
+/*******************************************************
+ * CONSTANT: dtmfPeakRatio / dtmfMaxTwist / dtmfMinPurity / dtmfHits
+ * DESCRIPTION: Power of the strongest tone of a group over the second
+ * (6 dB); row/column power ratio allowed either way (8 dB); fraction of
+ * the block energy the two tones must carry; consecutive blocks before a
+ * key is reported.
+ *******************************************************/
+const float dtmfPeakRatio = 4.0f;
+const float dtmfMaxTwist = 6.3f;
+const float dtmfMinPurity = 0.5f;
+const int dtmfHits = 2;
+
+/*******************************************************
+ * STRUCT: DtmfTonePowers
+ * DESCRIPTION: Goertzel power of each tone over one block, normalised to
+ * the block energy (a pure tone on its frequency gives 1), and the RMS
+ * level of the block.
+ *******************************************************/
+struct DtmfTonePowers {
+  float tone[8];
+  float level;
+};
+
+// ---------------------- Commands ----------------------
+/*******************************************************
+ * ENUM: DtmfCommandKind
+ * DESCRIPTION: Result of a completed command ('#'). REJECTED: wrong PIN,
+ * unknown command or malformed value.
+ *******************************************************/
+enum DtmfCommandKind { DTMF_NONE, DTMF_TRANSMIT, DTMF_MODE, DTMF_INTERVAL, DTMF_CLEAR, DTMF_REJECTED };
+
+/*******************************************************
+ * STRUCT: DtmfCommand
+ * DESCRIPTION: Command kind and its value (mode, or minutes).
+ *******************************************************/
+struct DtmfCommand {
+  uint8_t kind;
+  uint32_t value;
+};
+
+/*******************************************************
+ * CONSTANT: dtmfMaxDigits
+ * DESCRIPTION: Longest command between '*' and '#' (PIN included).
+ *******************************************************/
+const int dtmfMaxDigits = 16;
+
+/*******************************************************
+ * STRUCT: DtmfDecoder
+ * DESCRIPTION: Goertzel coefficients, key debounce and the command being
+ * entered. Set up with dtmfDecoderInit().
+ *******************************************************/
+struct DtmfDecoder {
+  float coefficient[8];
+  float window[dtmfBlock];
+  float minLevel;
+  const char* pin;
+  char candidate;          // Key of the previous block (0: none)
+  uint8_t hits;            // Consecutive blocks with it
+  bool reported;
+  bool open;               // '*' seen
+  uint8_t length;
+  char digits[dtmfMaxDigits];
+};
+
+/*******************************************************
+ * FUNCTION: dtmfDecoderInit
+ * DESCRIPTION: Computes the Goertzel coefficients and clears the state.
+ * INPUT: DtmfDecoder &d, const char* pin (Digits after '*'), float minLevel
+ * OUTPUT: None
+ *******************************************************/
+void dtmfDecoderInit(DtmfDecoder &d, const char* pin, float minLevel = DTMF_MIN_LEVEL) {
+  memset(&d, 0, sizeof(d));
+  for (int k = 0; k < 8; k++) d.coefficient[k] = 2.0f * cosf(2.0f * (float)M_PI * dtmfTones[k] / dtmfSampleRate);
+  for (int i = 0; i < dtmfBlock; i++) d.window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * (i + 0.5f) / dtmfBlock);
+  d.minLevel = minLevel;
+  d.pin = pin;
+}
+
+/*******************************************************
+ * FUNCTION: dtmfTonePowers
+ * DESCRIPTION: Runs the filter bank over one block. The block mean is
+ * removed first (the ADC input sits on a bias), then a Hann window widens
+ * each bin enough for keypads off frequency by 1.5% while the neighbouring
+ * tones stay out. One tone per pass over the samples keeps the two
+ * Goertzel states and the coefficient in registers.
+ * INPUT: const DtmfDecoder &d, const int16_t* samples (dtmfBlock)
+ * OUTPUT: DtmfTonePowers
+ *******************************************************/
+DtmfTonePowers dtmfTonePowers(const DtmfDecoder &d, const int16_t* samples) {
+  float x[dtmfBlock];
+  int32_t sum = 0;
+  for (int i = 0; i < dtmfBlock; i++) sum += samples[i];
+  float mean = (float)sum / dtmfBlock, energy = 0.0f;
+  for (int i = 0; i < dtmfBlock; i++) {
+    float v = samples[i] - mean;
+    energy += v * v;
+    x[i] = v * d.window[i];
+  }
+
+  DtmfTonePowers p;
+  p.level = sqrtf(energy / dtmfBlock);
+  // A tone of amplitude A gives (A N / 4)^2 through the window, A^2 N / 2 of energy
+  float scale = energy > 0.0f ? 8.0f / (dtmfBlock * energy) : 0.0f;
+  for (int k = 0; k < 8; k++) {
+    float c = d.coefficient[k], s1 = 0.0f, s2 = 0.0f;
+    for (int i = 0; i < dtmfBlock; i++) {
+      float s0 = x[i] + c * s1 - s2;
+      s2 = s1;
+      s1 = s0;
+    }
+    p.tone[k] = (s1 * s1 + s2 * s2 - c * s1 * s2) * scale;
+  }
+  return p;
+}
+
+/*******************************************************
+ * FUNCTION: dtmfClassify
+ * DESCRIPTION: Key held in a block, from its tone powers.
+ * INPUT: const DtmfTonePowers &p, float minLevel
+ * OUTPUT: char (Key, 0: none)
+ *******************************************************/
+char dtmfClassify(const DtmfTonePowers &p, float minLevel) {
+  if (p.level < minLevel) return 0;
+  int peak[2];
+  for (int g = 0; g < 2; g++) {
+    const float* t = p.tone + 4 * g;
+    int best = 0;
+    for (int k = 1; k < 4; k++) if (t[k] > t[best]) best = k;
+    for (int k = 0; k < 4; k++) if (k != best && t[k] * dtmfPeakRatio > t[best]) return 0;
+    peak[g] = best;
+  }
+  float row = p.tone[peak[0]], column = p.tone[4 + peak[1]];
+  if (row > dtmfMaxTwist * column || column > dtmfMaxTwist * row) return 0;
+  if (row + column < dtmfMinPurity) return 0;
+  return dtmfKeys[peak[0] * 4 + peak[1]];
+}
+
+/*******************************************************
+ * FUNCTION: dtmfDebounce
+ * DESCRIPTION: Reports a key once it has been seen in dtmfHits consecutive
+ * blocks; it is reported again only after a block without it.
+ * INPUT: DtmfDecoder &d, char key (Key of this block, 0: none)
+ * OUTPUT: char (Key pressed, 0: none)
+ *******************************************************/
+char dtmfDebounce(DtmfDecoder &d, char key) {
+  if (key != d.candidate) {
+    d.candidate = key;
+    d.hits = 0;
+    d.reported = false;
+  }
+  if (!key || d.reported || ++d.hits < dtmfHits) return 0;
+  d.reported = true;
+  return key;
+}
+
+/*******************************************************
+ * FUNCTION: dtmfParseKey
+ * DESCRIPTION: Adds a key to the command being entered. Keys before the
+ * first '*' are ignored; '#' completes the command.
+ * INPUT: DtmfDecoder &d, char key
+ * OUTPUT: DtmfCommand (DTMF_NONE until '#')
+ *******************************************************/
+DtmfCommand dtmfParseKey(DtmfDecoder &d, char key) {
+  DtmfCommand cmd = { DTMF_NONE, 0 };
+  if (key == '*') {
+    d.open = true;
+    d.length = 0;
+    return cmd;
+  }
+  if (!d.open) return cmd;
+  if (key != '#') {
+    if (d.length < dtmfMaxDigits) d.digits[d.length] = key;
+    if (d.length <= dtmfMaxDigits) d.length++;   // One past: overflowed
+    return cmd;
+  }
+
+  d.open = false;
+  cmd.kind = DTMF_REJECTED;
+  size_t pinLength = strlen(d.pin);
+  if (d.length > dtmfMaxDigits || d.length < pinLength + 1 || memcmp(d.digits, d.pin, pinLength)) return cmd;
+  const char* arg = d.digits + pinLength + 1;
+  int argLength = d.length - pinLength - 1;
+  for (int i = 0; i < argLength; i++) {
+    if (arg[i] < '0' || arg[i] > '9') return cmd;
+    cmd.value = cmd.value * 10 + (arg[i] - '0');
+  }
+  switch (d.digits[pinLength]) {
+    case '0': if (argLength == 0) cmd.kind = DTMF_CLEAR; break;
+    case '1': if (argLength == 0) cmd.kind = DTMF_TRANSMIT; break;
+    case '2': if (argLength == 1) cmd.kind = DTMF_MODE; break;
+    case '3': if (argLength >= 1 && argLength <= 4 && cmd.value > 0) cmd.kind = DTMF_INTERVAL; break;
+  }
+  return cmd;
+}
+
+/*******************************************************
+ * FUNCTION: dtmfDecodeBlock
+ * DESCRIPTION: Runs one block through detection, debounce and the command
+ * parser.
+ * INPUT: DtmfDecoder &d, const int16_t* samples (dtmfBlock), char* key (Key
+ * pressed in this block, 0: none; may be NULL)
+ * OUTPUT: DtmfCommand
+ *******************************************************/
+DtmfCommand dtmfDecodeBlock(DtmfDecoder &d, const int16_t* samples, char* key = NULL) {
+  char pressed = dtmfDebounce(d, dtmfClassify(dtmfTonePowers(d, samples), d.minLevel));
+  if (key) *key = pressed;
+  if (!pressed) return { DTMF_NONE, 0 };
+  return dtmfParseKey(d, pressed);
+}
+
+#endif
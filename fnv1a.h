@@ -0,0 +1,22 @@
+#ifndef __FNV1A_H
+#define __FNV1A_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*******************************************************
+ * FUNCTION: fnv1a
+ * DESCRIPTION: 32-bit FNV-1a hash, for configuration keys (not for
+ * error detection: see crc16.h). Chain calls by passing the previous
+ * result as the seed.
+ * INPUT: const void* data, size_t len, uint32_t seed
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t fnv1a(const void* data, size_t len, uint32_t seed = 2166136261u) {
+  const uint8_t* p = (const uint8_t*)data;
+  uint32_t h = seed;
+  for (size_t i = 0; i < len; i++) h = (h ^ p[i]) * 16777619u;
+  return h;
+}
+
+#endif
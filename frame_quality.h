@@ -0,0 +1,159 @@
+#ifndef __FRAME_QUALITY_H
+#define __FRAME_QUALITY_H
+
+/*******************************************************
+ * Frame quality gate metrics, on the 1/8 scale DC thumbnail of the camera
+ * JPEG (jpeg_dc_thumb.h), so a bad frame is found before it is decoded:
+ *   sharpness   - variance of the 4-neighbour Laplacian of the luma.
+ *                 Shake, defocus, fog and water on the lens all remove
+ *                 the fine structure it measures.
+ *   obstruction - fraction of the thumbnail tiles that lost most of their
+ *                 structure: something over the lens, or a drop covering
+ *                 part of it.
+ * The beacon always looks at the same view, so both are judged against a
+ * running reference of the frames sent before (FrameQualityReference):
+ * the limits hold for any scene, and follow slow changes such as the
+ * light. Tiles that are featureless in the reference (a plain sky) are
+ * not counted.
+ * Plain C++ with no Arduino dependency (also used by tools/archive_thumbs.cpp).
+ *******************************************************/
+
+#include <stdint.h>
+
+#ifndef QUALITY_MIN_SHARPNESS
+#define QUALITY_MIN_SHARPNESS 10.0f      // Laplacian variance below which a frame is always retaken
+#endif
+#ifndef QUALITY_SHARPNESS_RATIO
+#define QUALITY_SHARPNESS_RATIO 0.5f     // Fraction of the reference sharpness a frame must keep
+#endif
+#ifndef QUALITY_MAX_OBSTRUCTION
+#define QUALITY_MAX_OBSTRUCTION 0.3f     // Fraction of obstructed tiles above which it is retaken
+#endif
+
+/*******************************************************
+ * CONSTANT: frameQualityTiles / frameQualityFlatTile / frameQualityTileDrop
+ * DESCRIPTION: Grid of the obstruction heuristic (tiles per side); the
+ * reference Laplacian variance below which a tile is featureless and not
+ * counted; the fraction of its reference below which a tile is obstructed.
+ *******************************************************/
+const int frameQualityTiles = 4;
+const float frameQualityFlatTile = 20.0f;
+const float frameQualityTileDrop = 0.2f;
+
+/*******************************************************
+ * CONSTANT: frameQualityWarmup / frameQualityWeight
+ * DESCRIPTION: Frames in the reference before it is used (until then only
+ * QUALITY_MIN_SHARPNESS applies), and weight of a new frame in it.
+ *******************************************************/
+const int frameQualityWarmup = 3;
+const float frameQualityWeight = 0.125f;
+
+/*******************************************************
+ * STRUCT: FrameQuality
+ * DESCRIPTION: Metrics of one frame: Laplacian variance of the whole
+ * thumbnail and of each tile (row-major), and the obstruction against the
+ * reference (filled in by frameQualityJudge).
+ *******************************************************/
+struct FrameQuality {
+  float sharpness;
+  float tiles[frameQualityTiles * frameQualityTiles];
+  float obstruction;   // 0..1
+};
+
+/*******************************************************
+ * STRUCT: FrameQualityReference
+ * DESCRIPTION: Running average of the metrics of the frames sent.
+ *******************************************************/
+struct FrameQualityReference {
+  float sharpness;
+  float tiles[frameQualityTiles * frameQualityTiles];
+  uint32_t frames;
+};
+
+/*******************************************************
+ * FUNCTION: frameQualityLuma
+ * DESCRIPTION: Luma (0..255) of an RGB565 thumbnail pixel.
+ * INPUT: uint16_t pixel
+ * OUTPUT: int
+ *******************************************************/
+inline int frameQualityLuma(uint16_t pixel) {
+  int r = (pixel >> 11) << 3, g = ((pixel >> 5) & 0x3F) << 2, b = (pixel & 0x1F) << 3;
+  return (77 * r + 150 * g + 29 * b) >> 8;
+}
+
+/*******************************************************
+ * FUNCTION: frameQualityMeasure
+ * DESCRIPTION: Computes the Laplacian variances of an RGB565 thumbnail in
+ * one pass over its interior pixels (the border has no Laplacian).
+ * INPUT: const uint16_t* thumb, int width, int height (at least 3x3)
+ * OUTPUT: FrameQuality
+ *******************************************************/
+FrameQuality frameQualityMeasure(const uint16_t* thumb, int width, int height) {
+  const int n = frameQualityTiles;
+  int64_t sum = 0, squares = 0;
+  int64_t tileSum[n * n] = { 0 }, tileSquares[n * n] = { 0 };
+  int32_t tileCount[n * n] = { 0 };
+  for (int y = 1; y < height - 1; y++) {
+    const uint16_t* row = thumb + y * width;
+    for (int x = 1; x < width - 1; x++) {
+      int lap = 4 * frameQualityLuma(row[x]) - frameQualityLuma(row[x - 1]) - frameQualityLuma(row[x + 1]) -
+                frameQualityLuma(row[x - width]) - frameQualityLuma(row[x + width]);
+      int t = (y * n / height) * n + x * n / width;
+      sum += lap;
+      squares += lap * lap;
+      tileSum[t] += lap;
+      tileSquares[t] += lap * lap;
+      tileCount[t]++;
+    }
+  }
+  FrameQuality q = {};
+  int64_t count = (int64_t)(width - 2) * (height - 2);
+  if (count <= 0) return q;
+  float mean = (float)sum / count;
+  q.sharpness = (float)squares / count - mean * mean;
+  for (int t = 0; t < n * n; t++) {
+    if (tileCount[t] == 0) continue;
+    float tileMean = (float)tileSum[t] / tileCount[t];
+    q.tiles[t] = (float)tileSquares[t] / tileCount[t] - tileMean * tileMean;
+  }
+  return q;
+}
+
+/*******************************************************
+ * FUNCTION: frameQualityJudge
+ * DESCRIPTION: Fills in the obstruction of a frame against the reference
+ * and decides whether it is good enough to send.
+ * INPUT: FrameQuality &q, const FrameQualityReference &ref, float minSharpness,
+ * float sharpnessRatio, float maxObstruction
+ * OUTPUT: bool (true: send it)
+ *******************************************************/
+bool frameQualityJudge(FrameQuality &q, const FrameQualityReference &ref, float minSharpness, float sharpnessRatio,
+                       float maxObstruction) {
+  q.obstruction = 0.0f;
+  if (q.sharpness < minSharpness) return false;
+  if (ref.frames < (uint32_t)frameQualityWarmup) return true;
+
+  int counted = 0, blocked = 0;
+  for (int t = 0; t < frameQualityTiles * frameQualityTiles; t++) {
+    if (ref.tiles[t] < frameQualityFlatTile) continue;
+    counted++;
+    if (q.tiles[t] < frameQualityTileDrop * ref.tiles[t]) blocked++;
+  }
+  if (counted) q.obstruction = (float)blocked / counted;
+  return q.sharpness >= sharpnessRatio * ref.sharpness && q.obstruction <= maxObstruction;
+}
+
+/*******************************************************
+ * FUNCTION: frameQualityLearn
+ * DESCRIPTION: Adds a sent frame to the reference (the first one sets it).
+ * INPUT: FrameQualityReference &ref, const FrameQuality &q
+ * OUTPUT: None
+ *******************************************************/
+void frameQualityLearn(FrameQualityReference &ref, const FrameQuality &q) {
+  float w = ref.frames ? frameQualityWeight : 1.0f;
+  ref.sharpness += w * (q.sharpness - ref.sharpness);
+  for (int t = 0; t < frameQualityTiles * frameQualityTiles; t++) ref.tiles[t] += w * (q.tiles[t] - ref.tiles[t]);
+  ref.frames++;
+}
+
+#endif
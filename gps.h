@@ -0,0 +1,168 @@
+#ifndef __GPS_H
+#define __GPS_H
+
+/*******************************************************
+ * GPS receiver (NMEA on a spare UART).
+ * The UART driver fills its RX ring buffer in the background; its receive
+ * callback (UART event task) drains it into the nmea_parser.h state
+ * machine, so nothing in the transmission cycle waits for the GPS. The
+ * last fix is kept in RTC memory and the system clock is set from it (the
+ * clock keeps running through Deep Sleep): the receiver is powered only
+ * while there is no fix or the clock is older than GPS_REFRESH_S, and it
+ * is switched off as soon as a fix arrives.
+ * The fix feeds the overlay text (locator, UTC time), the journal
+ * timestamps and the transmission slot scheduler (gpsSleepSeconds()).
+ *******************************************************/
+
+#include <sys/time.h>
+#include <time.h>
+#include "nmea_parser.h"
+
+#ifndef GPS_BAUD
+#define GPS_BAUD 9600
+#endif
+#ifndef GPS_REFRESH_S
+#define GPS_REFRESH_S 3600
+#endif
+
+// ---------------------- State ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: gpsCachedFix / gpsClockSetAt (RTC memory)
+ * DESCRIPTION: Last fix received and the time (UTC) the clock was last set
+ * from the GPS (0 = never since power-up).
+ *******************************************************/
+RTC_DATA_ATTR GpsFix gpsCachedFix = { false, 0, 0, 0, 0, 0, 0 };
+RTC_DATA_ATTR uint32_t gpsClockSetAt = 0;
+
+/*******************************************************
+ * GLOBAL VARIABLE: gpsParser / gpsSerial / gpsMux
+ * DESCRIPTION: Parser (used only by the UART event task), the GPS UART, and
+ * the lock that guards gpsCachedFix between that task and the main loop.
+ *******************************************************/
+NMEAParser gpsParser;
+HardwareSerial gpsSerial(1);
+portMUX_TYPE gpsMux = portMUX_INITIALIZER_UNLOCKED;
+/*******************************************************
+ * GLOBAL VARIABLE: gpsPowered (volatile)
+ * DESCRIPTION: The receiver is powered and its UART is running.
+ *******************************************************/
+volatile bool gpsPowered = false;
+
+/*******************************************************
+ * GLOBAL VARIABLE: gpsOverlay
+ * DESCRIPTION: Top overlay text (callsign, locator, UTC time), built once
+ * per cycle by gpsPrepareOverlay() so every stage draws the same string.
+ *******************************************************/
+char gpsOverlay[32] = CALLSIGN " " LOCATOR;
+
+// ---------------------- Receiver ----------------------
+/*******************************************************
+ * FUNCTION: gpsOnReceive
+ * DESCRIPTION: UART receive callback: parses what is in the RX buffer,
+ * publishes a new fix to RTC memory, sets the clock, and switches the
+ * receiver off once it has both position and time.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void gpsOnReceive() {
+  uint8_t chunk[64];
+  bool updated = false;
+  while (gpsSerial.available() > 0) {
+    size_t n = gpsSerial.readBytes(chunk, min(gpsSerial.available(), (int)sizeof(chunk)));
+    for (size_t i = 0; i < n; i++) updated |= nmeaFeed(gpsParser, (char)chunk[i]);
+  }
+  if (!updated || !gpsParser.fix.valid || gpsParser.fix.time == 0) return;
+
+  portENTER_CRITICAL(&gpsMux);
+  gpsCachedFix = gpsParser.fix;
+  portEXIT_CRITICAL(&gpsMux);
+  struct timeval now = { (time_t)gpsParser.fix.time, 0 };
+  settimeofday(&now, NULL);
+  gpsClockSetAt = gpsParser.fix.time;
+  if (gpsPowered) {
+    digitalWrite(GPS_POWER_PIN, LOW);
+    gpsPowered = false;
+  }
+}
+
+/*******************************************************
+ * FUNCTION: gpsBegin
+ * DESCRIPTION: Powers the receiver and starts its UART if there is no
+ * cached fix or the clock needs refreshing; otherwise leaves it off.
+ * Call early in the wake: acquisition runs during the cycle.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void gpsBegin() {
+  rtc_gpio_hold_dis((gpio_num_t)GPS_POWER_PIN);
+  pinMode(GPS_POWER_PIN, OUTPUT);
+  uint32_t now = (uint32_t)time(NULL);
+  if (gpsCachedFix.valid && gpsClockSetAt != 0 && now - gpsClockSetAt < GPS_REFRESH_S) {
+    digitalWrite(GPS_POWER_PIN, LOW);
+    Serial.printf("GPS: cached fix, clock set %lu s ago\n", (unsigned long)(now - gpsClockSetAt));
+    return;
+  }
+  memset(&gpsParser, 0, sizeof(gpsParser));
+  gpsPowered = true;
+  digitalWrite(GPS_POWER_PIN, HIGH);
+  gpsSerial.setRxBufferSize(1024);
+  gpsSerial.begin(GPS_BAUD, SERIAL_8N1, GPS_RX_PIN, -1);
+  gpsSerial.onReceive(gpsOnReceive);
+  Serial.println(gpsCachedFix.valid ? "GPS: refreshing the clock" : "GPS: acquiring");
+}
+
+/*******************************************************
+ * FUNCTION: gpsEnd
+ * DESCRIPTION: Stops the UART and keeps the receiver off through Deep Sleep.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void gpsEnd() {
+  if (gpsPowered) Serial.printf("GPS: no fix this wake (%lu sentences, %lu errors)\n",
+                                (unsigned long)gpsParser.sentences, (unsigned long)gpsParser.checksumErrors);
+  gpsSerial.end();
+  gpsPowered = false;
+  digitalWrite(GPS_POWER_PIN, LOW);
+  rtc_gpio_hold_en((gpio_num_t)GPS_POWER_PIN);
+}
+
+// ---------------------- Fix Consumers ----------------------
+/*******************************************************
+ * FUNCTION: gpsPrepareOverlay
+ * DESCRIPTION: Builds the top overlay text: callsign, locator (from the fix,
+ * else LOCATOR) and UTC time when the clock is set.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void gpsPrepareOverlay() {
+  portENTER_CRITICAL(&gpsMux);
+  GpsFix fix = gpsCachedFix;
+  portEXIT_CRITICAL(&gpsMux);
+  char locator[7] = LOCATOR;
+  if (fix.valid) maidenheadLocator(fix.latitude, fix.longitude, locator);
+  if (gpsClockSetAt != 0) {
+    time_t now = time(NULL);
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    snprintf(gpsOverlay, sizeof(gpsOverlay), "%s %s %02d:%02dZ", CALLSIGN, locator, utc.tm_hour, utc.tm_min);
+  } else {
+    snprintf(gpsOverlay, sizeof(gpsOverlay), "%s %s", CALLSIGN, locator);
+  }
+}
+
+/*******************************************************
+ * FUNCTION: gpsSleepSeconds
+ * DESCRIPTION: Deep Sleep time up to the next transmission slot (multiples
+ * of TX_SLOT_PERIOD seconds, UTC) once the clock is set, else TIME_TO_SLEEP.
+ * A slot closer than 10 s is skipped (the wake itself takes longer).
+ * INPUT: None
+ * OUTPUT: uint32_t (seconds)
+ *******************************************************/
+uint32_t gpsSleepSeconds() {
+  if (gpsClockSetAt == 0) return TIME_TO_SLEEP;
+  uint32_t now = (uint32_t)time(NULL);
+  uint32_t wait = TX_SLOT_PERIOD - now % TX_SLOT_PERIOD;
+  return wait < 10 ? wait + TX_SLOT_PERIOD : wait;
+}
+
+#endif
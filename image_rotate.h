@@ -0,0 +1,133 @@
+#ifndef __IMAGE_ROTATE_H
+#define __IMAGE_ROTATE_H
+
+/*******************************************************
+ * 90/270 degree rotation of the decoded camera picture, for cameras
+ * mounted sideways (the sensor itself can only mirror and flip). The
+ * rotated picture is scaled down to fit the picture area of the canvas
+ * (nearest sample) and centred, with black bars on the sides.
+ * A rotation reads the source down its columns. Walking the destination
+ * row by row, every pixel is then in another source row; rows 1280 bytes
+ * apart fall into only 64 sets of the 2-way PSRAM cache, so almost every
+ * read misses. rotateBlocked() writes the destination in
+ * rotateTile x rotateTile tiles instead: a tile reads fewer source rows
+ * than that, and their cache lines serve the whole tile.
+ * Plain C++ with no Arduino dependency (also used by tools/rotate_bench.cpp).
+ *******************************************************/
+
+#include <stdint.h>
+#include "sstv_render.h"
+
+#ifndef CAMERA_ROTATION
+#define CAMERA_ROTATION 0       // Clockwise: 0, 90 or 270
+#endif
+#if CAMERA_ROTATION != 0 && CAMERA_ROTATION != 90 && CAMERA_ROTATION != 270
+#error "CAMERA_ROTATION must be 0, 90 or 270"
+#endif
+
+/*******************************************************
+ * CONSTANT: rotateTile
+ * DESCRIPTION: Side of the destination tiles of rotateBlocked().
+ *******************************************************/
+const int rotateTile = 32;
+
+/*******************************************************
+ * STRUCT: RotationMap
+ * DESCRIPTION: Where the rotated picture lands in the area (left, top,
+ * width, height), and the source pixel of each destination pixel split in
+ * two tables: source index = column[x] + row[y].
+ *******************************************************/
+struct RotationMap {
+  int left, top, width, height;
+  int32_t column[imageWidth];
+  int32_t row[imageHeight];
+};
+
+/*******************************************************
+ * FUNCTION: rotationMapBuild
+ * DESCRIPTION: Fits a srcWidth x srcHeight picture, rotated clockwise by
+ * `rotation`, into an area of up to imageWidth x imageHeight (never
+ * enlarged), and fills in the source tables.
+ * INPUT: RotationMap &m, int srcWidth, int srcHeight, int areaWidth, int areaHeight, int rotation (90 or 270)
+ * OUTPUT: None
+ *******************************************************/
+void rotationMapBuild(RotationMap &m, int srcWidth, int srcHeight, int areaWidth, int areaHeight, int rotation) {
+  // Rotated size is srcHeight x srcWidth
+  m.width = srcHeight;
+  m.height = srcWidth;
+  if (m.width > areaWidth || m.height > areaHeight) {
+    if ((int64_t)areaWidth * srcWidth <= (int64_t)areaHeight * srcHeight) {
+      m.width = areaWidth;
+      m.height = (int)((int64_t)srcWidth * areaWidth / srcHeight);
+    } else {
+      m.height = areaHeight;
+      m.width = (int)((int64_t)srcHeight * areaHeight / srcWidth);
+    }
+  }
+  m.left = (areaWidth - m.width) / 2;
+  m.top = (areaHeight - m.height) / 2;
+
+  for (int x = 0; x < m.width; x++) {
+    int rx = (int)((int64_t)x * srcHeight / m.width);           // Column of the rotated picture
+    m.column[x] = (rotation == 90 ? srcHeight - 1 - rx : rx) * srcWidth;
+  }
+  for (int y = 0; y < m.height; y++) {
+    int ry = (int)((int64_t)y * srcWidth / m.height);           // Row of the rotated picture
+    m.row[y] = rotation == 90 ? ry : srcWidth - 1 - ry;
+  }
+}
+
+/*******************************************************
+ * FUNCTION: rotateNaive
+ * DESCRIPTION: Reference rotation, destination row by row (the access
+ * pattern rotateBlocked() avoids; kept for the benchmarks).
+ * INPUT: const uint16_t* src, uint16_t* dst (Area origin), int dstStride (pixels), const RotationMap &m
+ * OUTPUT: None
+ *******************************************************/
+void rotateNaive(const uint16_t* src, uint16_t* dst, int dstStride, const RotationMap &m) {
+  for (int y = 0; y < m.height; y++) {
+    uint16_t* out = dst + (m.top + y) * dstStride + m.left;
+    int32_t r = m.row[y];
+    for (int x = 0; x < m.width; x++) out[x] = src[m.column[x] + r];
+  }
+}
+
+/*******************************************************
+ * FUNCTION: rotateBlocked
+ * DESCRIPTION: Same result as rotateNaive(), written tile by tile.
+ * INPUT: const uint16_t* src, uint16_t* dst (Area origin), int dstStride (pixels), const RotationMap &m
+ * OUTPUT: None
+ *******************************************************/
+void rotateBlocked(const uint16_t* src, uint16_t* dst, int dstStride, const RotationMap &m) {
+  for (int ty = 0; ty < m.height; ty += rotateTile) {
+    int yEnd = ty + rotateTile < m.height ? ty + rotateTile : m.height;
+    for (int tx = 0; tx < m.width; tx += rotateTile) {
+      int xEnd = tx + rotateTile < m.width ? tx + rotateTile : m.width;
+      for (int y = ty; y < yEnd; y++) {
+        uint16_t* out = dst + (m.top + y) * dstStride + m.left;
+        int32_t r = m.row[y];
+        for (int x = tx; x < xEnd; x++) out[x] = src[m.column[x] + r];
+      }
+    }
+  }
+}
+
+/*******************************************************
+ * FUNCTION: rotateLetterbox
+ * DESCRIPTION: Fills the part of the area the rotated picture leaves
+ * free.
+ * INPUT: uint16_t* dst (Area origin), int dstStride, int areaWidth, int areaHeight, const RotationMap &m, uint16_t colour
+ * OUTPUT: None
+ *******************************************************/
+void rotateLetterbox(uint16_t* dst, int dstStride, int areaWidth, int areaHeight, const RotationMap &m, uint16_t colour) {
+  for (int y = 0; y < areaHeight; y++) {
+    uint16_t* out = dst + y * dstStride;
+    bool inside = y >= m.top && y < m.top + m.height;
+    for (int x = 0; x < areaWidth; x++) {
+      if (inside && x == m.left) x += m.width;
+      if (x < areaWidth) out[x] = colour;
+    }
+  }
+}
+
+#endif
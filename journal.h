@@ -0,0 +1,173 @@
+#ifndef __JOURNAL_H
+#define __JOURNAL_H
+
+/*******************************************************
+ * Persistent telemetry journal.
+ * Every wake appends one JournalRecord (journal_format.h) to a buffer in
+ * RTC memory, which survives Deep Sleep. Every JOURNAL_FLUSH_EVERY wakes
+ * the buffer is written to the "journal" data partition (partitions_beacon.csv)
+ * in one go: the partition is a ring of records written in order, and a
+ * sector is erased only when the write position enters it, so each sector
+ * is erased once per lap of the ring. Records still in RTC memory are lost
+ * on a power cycle (the next record is flagged JOURNAL_FLAG_POWER_ON).
+ * Dump with esptool.py read_flash and decode with tools/journal_decode.cpp.
+ *******************************************************/
+
+#include <esp_partition.h>
+#include <time.h>
+#include "journal_format.h"
+
+#ifndef JOURNAL_FLUSH_EVERY
+#define JOURNAL_FLUSH_EVERY 16
+#endif
+
+/*******************************************************
+ * CONSTANT: journalSubtype
+ * DESCRIPTION: Data subtype of the journal partition (custom range 0x40-0xFE).
+ *******************************************************/
+const uint8_t journalSubtype = 0x40;
+
+// ---------------------- RTC State ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: journalBuffer / journalCount (RTC memory)
+ * DESCRIPTION: Records not yet written to flash.
+ *******************************************************/
+RTC_DATA_ATTR JournalRecord journalBuffer[JOURNAL_FLUSH_EVERY];
+RTC_DATA_ATTR uint32_t journalCount = 0;
+/*******************************************************
+ * GLOBAL VARIABLE: journalOffset / journalSequence (RTC memory)
+ * DESCRIPTION: Next write position in the partition and next sequence
+ * number; valid once journalHeadKnown is set (after the first flush
+ * following a power-up, which scans the partition for them).
+ *******************************************************/
+RTC_DATA_ATTR uint32_t journalOffset = 0;
+RTC_DATA_ATTR uint32_t journalSequence = 0;
+RTC_DATA_ATTR bool journalHeadKnown = false;
+/*******************************************************
+ * GLOBAL VARIABLE: journalRunning / journalSkipped (RTC memory)
+ * DESCRIPTION: Set by the first record after power-up; frames skipped
+ * since power-up.
+ *******************************************************/
+RTC_DATA_ATTR bool journalRunning = false;
+RTC_DATA_ATTR uint32_t journalSkipped = 0;
+
+// ---------------------- Flash Ring ----------------------
+/*******************************************************
+ * FUNCTION: journalFindHead
+ * DESCRIPTION: Finds the write position after a power-up: the sector whose
+ * first record has the highest sequence holds the newest records, and the
+ * head is the first erased slot after them.
+ * INPUT: const esp_partition_t* part
+ * OUTPUT: None (sets journalOffset and journalSequence)
+ *******************************************************/
+void journalFindHead(const esp_partition_t* part) {
+  JournalRecord r;
+  uint32_t sectors = part->size / journalSectorSize;
+  uint32_t newestSector = 0, newest = 0;
+  bool found = false;
+  for (uint32_t s = 0; s < sectors; s++) {
+    if (esp_partition_read(part, s * journalSectorSize, &r, sizeof(r)) != ESP_OK) continue;
+    if (journalValid(r) && (!found || r.sequence > newest)) {
+      newest = r.sequence;
+      newestSector = s;
+      found = true;
+    }
+  }
+  journalOffset = 0;
+  journalSequence = 0;
+  if (!found) return;
+
+  uint32_t offset = newestSector * journalSectorSize;
+  uint32_t end = offset + journalSectorSize;
+  for (; offset < end; offset += sizeof(r)) {
+    if (esp_partition_read(part, offset, &r, sizeof(r)) != ESP_OK || journalErased(r)) break;
+    if (journalValid(r) && r.sequence > newest) newest = r.sequence;
+  }
+  journalOffset = offset < part->size ? offset : 0;
+  journalSequence = newest + 1;
+}
+
+/*******************************************************
+ * FUNCTION: journalFlush
+ * DESCRIPTION: Writes the buffered records to the journal partition,
+ * numbering them and erasing each sector as the write position enters it.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void journalFlush() {
+  const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                          (esp_partition_subtype_t)journalSubtype, "journal");
+  if (!part) {
+    Serial.println("Journal: no journal partition (see partitions_beacon.csv), records dropped");
+    journalCount = 0;
+    return;
+  }
+  if (!journalHeadKnown) {
+    journalFindHead(part);
+    journalHeadKnown = true;
+    Serial.printf("Journal: head at 0x%lx, next record %lu\n", (unsigned long)journalOffset, (unsigned long)journalSequence);
+  }
+
+  uint32_t i = 0;
+  while (i < journalCount) {
+    if (journalOffset >= part->size) journalOffset = 0;
+    if (journalOffset % journalSectorSize == 0 &&
+        esp_partition_erase_range(part, journalOffset, journalSectorSize) != ESP_OK) {
+      Serial.println("Journal: sector erase failed");
+      break;
+    }
+    uint32_t room = (journalSectorSize - journalOffset % journalSectorSize) / sizeof(JournalRecord);
+    uint32_t n = min(room, journalCount - i);
+    for (uint32_t k = i; k < i + n; k++) {
+      journalBuffer[k].sequence = journalSequence++;
+      journalSeal(journalBuffer[k]);
+    }
+    if (esp_partition_write(part, journalOffset, &journalBuffer[i], n * sizeof(JournalRecord)) != ESP_OK) {
+      Serial.println("Journal: write failed");
+      break;
+    }
+    journalOffset += n * sizeof(JournalRecord);
+    i += n;
+  }
+  journalCount = 0;
+}
+
+// ---------------------- Per-Cycle Record ----------------------
+/*******************************************************
+ * FUNCTION: journalCommit
+ * DESCRIPTION: Appends the metrics of this wake (cycleTimes, jitter
+ * histogram, battery, temperature) to the RTC buffer and flushes it every
+ * JOURNAL_FLUSH_EVERY wakes. Called once per wake, before Deep Sleep.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void journalCommit() {
+  if (cycleTimes.frameSkipped) journalSkipped++;
+
+  JournalRecord &r = journalBuffer[journalCount];
+  memset(&r, 0, sizeof(r));
+  r.timestamp = (uint32_t)time(NULL);
+  r.frames = frameId;
+  r.captureMs = min(cycleTimes.captureMs, (uint32_t)0xFFFF);
+  r.decodeMs = min(cycleTimes.decodeMs, (uint32_t)0xFFFF);
+  r.composeMs = min(cycleTimes.composeMs, (uint32_t)0xFFFF);
+  r.transmitDs = min(cycleTimes.transmitMs / 100, (uint32_t)0xFFFF);
+  r.jitterP99Us = min(jitterPercentileUs(99), (uint32_t)0xFFFF);
+  r.jitterMaxUs = min(jitterMaxUs, (uint32_t)0xFFFF);
+  r.batteryMv = min(readBatteryMillivolts(), (uint32_t)0xFFFF);
+  r.temperature = constrain(readTemperatureC(), -128, 127);
+  r.mode = sstvMode;
+  r.skipped = min(journalSkipped, (uint32_t)255);
+  r.flags = (journalRunning ? 0 : JOURNAL_FLAG_POWER_ON) | (cycleTimes.frameSkipped ? JOURNAL_FLAG_SKIPPED : 0) |
+            (cycleTimes.fallbackPair >= 0 ? JOURNAL_FLAG_FALLBACK : 0) |
+            (cycleTimes.retakes ? JOURNAL_FLAG_RETAKEN : 0) | (cycleTimes.poorFrame ? JOURNAL_FLAG_POOR : 0) |
+            (txClockEnabled ? JOURNAL_FLAG_ISOLATED : 0);
+  journalRunning = true;
+
+  Serial.printf("Journal: capture %u ms, decode %u ms, compose %u ms, tx %u.%u s, jitter p99 %u us max %u us\n",
+                r.captureMs, r.decodeMs, r.composeMs, r.transmitDs / 10, r.transmitDs % 10, r.jitterP99Us, r.jitterMaxUs);
+
+  if (++journalCount >= JOURNAL_FLUSH_EVERY) journalFlush();
+}
+
+#endif
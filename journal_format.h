@@ -0,0 +1,102 @@
+#ifndef __JOURNAL_FORMAT_H
+#define __JOURNAL_FORMAT_H
+
+/*******************************************************
+ * Telemetry journal record.
+ * One 32-byte record per wake (stage times, pixel timer jitter, battery,
+ * skipped frames), stored back to back in the "journal" flash partition
+ * by journal.h and read back by tools/journal_decode.cpp.
+ * Plain C++ with no Arduino dependency (also used by the host tools).
+ *******************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "crc16.h"
+
+// ---------------------- Record Layout ----------------------
+/*******************************************************
+ * STRUCT: JournalRecord
+ * DESCRIPTION: Metrics of one transmission cycle, little endian as the
+ * ESP32 stores it. An erased slot reads as all 0xFF.
+ *******************************************************/
+struct JournalRecord {
+  uint32_t sequence;     // Record number, never reused (also across power cycles)
+  uint32_t timestamp;    // time(NULL): seconds since power-up, unless the clock was set
+  uint32_t frames;       // Pictures transmitted since power-up (frameId)
+  uint16_t captureMs;    // Stage times of the cycle
+  uint16_t decodeMs;
+  uint16_t composeMs;
+  uint16_t transmitDs;   // Transmission time in tenths of a second (PD120 is 126 s)
+  uint16_t jitterP99Us;  // Pixel timer: 99th percentile and maximum deviation
+  uint16_t jitterMaxUs;
+  uint16_t batteryMv;
+  int8_t temperature;    // Chip temperature, degrees Celsius
+  uint8_t mode;          // SSTVMode of the cycle
+  uint8_t skipped;       // Frames skipped since power-up (saturates at 255)
+  uint8_t flags;         // JOURNAL_FLAG_*
+  uint16_t crc;          // crc16CCITT() of the bytes above
+};
+
+static_assert(sizeof(JournalRecord) == 32, "JournalRecord must stay 32 bytes");
+
+/*******************************************************
+ * CONSTANT: JOURNAL_FLAG_*
+ * DESCRIPTION: Record flags.
+ * POWER_ON: first record after a power-up or reset (RTC memory was lost,
+ *           so were the records still buffered there).
+ * SKIPPED:  the camera picture of this cycle was not sent.
+ * FALLBACK: PD120 overran its pixel deadlines and sent the rest of the
+ *           frame pre-rendered (see transmitPD120Image_HW()).
+ * RETAKEN:  the quality gate retook the picture at least once.
+ * POOR:     the picture sent still failed the quality gate.
+ * ISOLATED: the pixel clock was the isolated one (TX_ISOLATION).
+ *******************************************************/
+const uint8_t JOURNAL_FLAG_POWER_ON = 0x01;
+const uint8_t JOURNAL_FLAG_SKIPPED = 0x02;
+const uint8_t JOURNAL_FLAG_FALLBACK = 0x04;
+const uint8_t JOURNAL_FLAG_RETAKEN = 0x08;
+const uint8_t JOURNAL_FLAG_POOR = 0x10;
+const uint8_t JOURNAL_FLAG_ISOLATED = 0x20;
+
+/*******************************************************
+ * CONSTANT: journalSectorSize
+ * DESCRIPTION: Flash erase unit. Records never straddle a sector.
+ *******************************************************/
+const uint32_t journalSectorSize = 4096;
+
+/*******************************************************
+ * FUNCTION: journalSeal
+ * DESCRIPTION: Fills in the record CRC.
+ * INPUT: JournalRecord &r
+ * OUTPUT: None
+ *******************************************************/
+void journalSeal(JournalRecord &r) {
+  r.crc = crc16CCITT((const uint8_t*)&r, offsetof(JournalRecord, crc));
+}
+
+/*******************************************************
+ * FUNCTION: journalValid
+ * DESCRIPTION: True if the slot holds a complete record (not erased, CRC ok).
+ * INPUT: const JournalRecord &r
+ * OUTPUT: bool
+ *******************************************************/
+bool journalValid(const JournalRecord &r) {
+  return r.sequence != 0xFFFFFFFF && r.crc == crc16CCITT((const uint8_t*)&r, offsetof(JournalRecord, crc));
+}
+
+/*******************************************************
+ * FUNCTION: journalErased
+ * DESCRIPTION: True if the slot was never written since the sector erase
+ * (a torn write is neither valid nor erased).
+ * INPUT: const JournalRecord &r
+ * OUTPUT: bool
+ *******************************************************/
+bool journalErased(const JournalRecord &r) {
+  const uint8_t* p = (const uint8_t*)&r;
+  for (size_t i = 0; i < sizeof(JournalRecord); i++) {
+    if (p[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+#endif
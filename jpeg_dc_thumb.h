@@ -0,0 +1,375 @@
+#ifndef __JPEG_DC_THUMB_H
+#define __JPEG_DC_THUMB_H
+
+/*******************************************************
+ * 1/8 scale JPEG thumbnails from the DC coefficients.
+ * The DC coefficient of an 8x8 block is its mean level, so a thumbnail
+ * needs no IDCT: the entropy-coded data is walked block by block, the DC
+ * differences are accumulated and the AC coefficients are only skipped
+ * (their Huffman codes must still be decoded to find the next block, but
+ * their values are not extended or stored).
+ * Baseline (SOF0/SOF1) JPEG with Huffman coding, 1 or 3 components, any
+ * sampling factors (the OV2640 uses 4:2:2), restart intervals.
+ * No heap: the decoder state (JpegDCDecoder, ~5 KB) is passed in.
+ * Plain C++ with no Arduino dependency (also used by the host tools).
+ *******************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*******************************************************
+ * CONSTANT: jpegThumbMaxWidth
+ * DESCRIPTION: Widest thumbnail supported (JPEG up to 2048 pixels wide).
+ *******************************************************/
+const int jpegThumbMaxWidth = 256;
+
+/*******************************************************
+ * CONSTANT: jpegHuffmanLookupBits
+ * DESCRIPTION: Codes up to this length are decoded with one table lookup.
+ *******************************************************/
+const int jpegHuffmanLookupBits = 9;
+
+/*******************************************************
+ * STRUCT: JpegHuffman
+ * DESCRIPTION: One Huffman table: lookup for short codes
+ * ((length << 8) | symbol, 0 = longer code), canonical decoding otherwise.
+ *******************************************************/
+struct JpegHuffman {
+  uint16_t lookup[1 << jpegHuffmanLookupBits];
+  int32_t maxCode[18];   // Largest code of each length, -1 if none
+  int32_t valueOffset[17];
+  uint8_t symbols[256];
+};
+
+/*******************************************************
+ * STRUCT: JpegDCDecoder
+ * DESCRIPTION: Decoder state: tables, frame layout and the bit reader.
+ *******************************************************/
+struct JpegDCDecoder {
+  JpegHuffman dc[2], ac[2];
+  uint16_t dcQuant[4];    // DC quantiser of each quantisation table
+  int width, height;
+  int components;
+  struct {
+    uint8_t id, h, v, quant, dcTable, acTable;
+    int predictor;
+  } comp[3];
+  int maxH, maxV;
+  uint16_t restartInterval;
+  // Bit reader
+  const uint8_t* data;
+  const uint8_t* end;
+  uint32_t bits;
+  int bitCount;
+  bool markerHit;
+};
+
+// ---------------------- Huffman Decoding ----------------------
+/*******************************************************
+ * FUNCTION: jpegBuildHuffman
+ * DESCRIPTION: Builds a table from the DHT code counts and symbols.
+ * INPUT: JpegHuffman &t, const uint8_t* counts (16), const uint8_t* symbols
+ * OUTPUT: bool (false for an invalid table)
+ *******************************************************/
+bool jpegBuildHuffman(JpegHuffman &t, const uint8_t* counts, const uint8_t* symbols) {
+  int total = 0;
+  for (int i = 0; i < 16; i++) total += counts[i];
+  if (total > 256) return false;
+  memcpy(t.symbols, symbols, total);
+  memset(t.lookup, 0, sizeof(t.lookup));
+  int32_t code = 0;
+  int k = 0;
+  for (int length = 1; length <= 16; length++) {
+    t.valueOffset[length] = k - code;
+    for (int i = 0; i < counts[length - 1]; i++, k++, code++) {
+      if (length <= jpegHuffmanLookupBits) {
+        int shift = jpegHuffmanLookupBits - length;
+        for (int fill = 0; fill < (1 << shift); fill++) {
+          t.lookup[(code << shift) | fill] = (uint16_t)((length << 8) | t.symbols[k]);
+        }
+      }
+    }
+    t.maxCode[length] = counts[length - 1] ? code - 1 : -1;
+    code <<= 1;
+  }
+  t.maxCode[17] = 0x7FFFFFFF;
+  return true;
+}
+
+/*******************************************************
+ * FUNCTION: jpegFillBits
+ * DESCRIPTION: Tops up the bit buffer to at least 25 bits, removing the
+ * FF00 byte stuffing; past a marker or the end of data, zeros are fed.
+ * INPUT: JpegDCDecoder &d
+ * OUTPUT: None
+ *******************************************************/
+void jpegFillBits(JpegDCDecoder &d) {
+  while (d.bitCount <= 24) {
+    uint32_t byte = 0;
+    if (!d.markerHit && d.data < d.end) {
+      byte = *d.data;
+      if (byte == 0xFF) {
+        uint8_t next = d.data + 1 < d.end ? d.data[1] : 0xD9;
+        if (next == 0x00) {
+          d.data += 2;
+        } else {
+          d.markerHit = true;
+          byte = 0;
+        }
+      } else {
+        d.data++;
+      }
+    }
+    d.bits |= byte << (24 - d.bitCount);
+    d.bitCount += 8;
+  }
+}
+
+/*******************************************************
+ * FUNCTION: jpegGetBits
+ * DESCRIPTION: Removes n (0-16) bits from the reader.
+ * INPUT: JpegDCDecoder &d, int n
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t jpegGetBits(JpegDCDecoder &d, int n) {
+  if (n == 0) return 0;
+  jpegFillBits(d);
+  uint32_t value = d.bits >> (32 - n);
+  d.bits <<= n;
+  d.bitCount -= n;
+  return value;
+}
+
+/*******************************************************
+ * FUNCTION: jpegDecodeSymbol
+ * DESCRIPTION: Decodes one Huffman symbol (-1 on a corrupt code).
+ * INPUT: JpegDCDecoder &d, const JpegHuffman &t
+ * OUTPUT: int
+ *******************************************************/
+int jpegDecodeSymbol(JpegDCDecoder &d, const JpegHuffman &t) {
+  jpegFillBits(d);
+  uint16_t entry = t.lookup[d.bits >> (32 - jpegHuffmanLookupBits)];
+  if (entry) {
+    int length = entry >> 8;
+    d.bits <<= length;
+    d.bitCount -= length;
+    return entry & 0xFF;
+  }
+  int length = jpegHuffmanLookupBits + 1;
+  int32_t code = d.bits >> (32 - length);
+  while (length <= 16 && code > t.maxCode[length]) {
+    length++;
+    code = d.bits >> (32 - length);
+  }
+  if (length > 16) return -1;
+  d.bits <<= length;
+  d.bitCount -= length;
+  return t.symbols[code + t.valueOffset[length]];
+}
+
+/*******************************************************
+ * FUNCTION: jpegExtend
+ * DESCRIPTION: Sign extension of an s-bit coefficient value.
+ * INPUT: uint32_t value, int s
+ * OUTPUT: int
+ *******************************************************/
+int jpegExtend(uint32_t value, int s) {
+  return s && value < (1u << (s - 1)) ? (int)value - (1 << s) + 1 : (int)value;
+}
+
+// ---------------------- Markers ----------------------
+/*******************************************************
+ * FUNCTION: jpegReadHeaders
+ * DESCRIPTION: Parses the markers up to the start of scan (DQT, DHT, SOF0/1,
+ * DRI, SOS) and positions the bit reader on the entropy-coded data.
+ * INPUT: JpegDCDecoder &d, const uint8_t* jpeg, size_t len
+ * OUTPUT: bool (false for unsupported or corrupt files)
+ *******************************************************/
+bool jpegReadHeaders(JpegDCDecoder &d, const uint8_t* jpeg, size_t len) {
+  if (len < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) return false;
+  size_t pos = 2;
+  bool frame = false;
+  d.restartInterval = 0;
+  while (pos + 4 <= len) {
+    if (jpeg[pos] != 0xFF) return false;
+    uint8_t marker = jpeg[pos + 1];
+    if (marker == 0xFF) {
+      pos++;
+      continue;
+    }
+    size_t segment = (jpeg[pos + 2] << 8) | jpeg[pos + 3];
+    const uint8_t* p = jpeg + pos + 4;
+    size_t n = segment - 2;
+    if (segment < 2 || pos + 2 + segment > len) return false;
+
+    if (marker == 0xDB) {   // DQT
+      for (size_t i = 0; i < n;) {
+        int precision = p[i] >> 4, id = p[i] & 3;
+        d.dcQuant[id] = precision ? (p[i + 1] << 8) | p[i + 2] : p[i + 1];
+        i += 1 + (precision ? 128 : 64);
+      }
+    } else if (marker == 0xC4) {   // DHT
+      for (size_t i = 0; i < n;) {
+        int tableClass = p[i] >> 4, id = p[i] & 1;
+        int total = 0;
+        for (int k = 0; k < 16; k++) total += p[i + 1 + k];
+        if (i + 17 + total > n) return false;
+        JpegHuffman &t = tableClass ? d.ac[id] : d.dc[id];
+        if (!jpegBuildHuffman(t, p + i + 1, p + i + 17)) return false;
+        i += 17 + total;
+      }
+    } else if (marker == 0xC0 || marker == 0xC1) {   // SOF0/SOF1 (baseline, extended)
+      d.height = (p[1] << 8) | p[2];
+      d.width = (p[3] << 8) | p[4];
+      d.components = p[5];
+      if ((d.components != 1 && d.components != 3) || d.width == 0 || d.height == 0) return false;
+      d.maxH = d.maxV = 1;
+      for (int c = 0; c < d.components; c++) {
+        d.comp[c].id = p[6 + 3 * c];
+        d.comp[c].h = p[7 + 3 * c] >> 4;
+        d.comp[c].v = p[7 + 3 * c] & 15;
+        d.comp[c].quant = p[8 + 3 * c] & 3;
+        if (d.comp[c].h < 1 || d.comp[c].h > 2 || d.comp[c].v < 1 || d.comp[c].v > 2) return false;
+        if (d.comp[c].h > d.maxH) d.maxH = d.comp[c].h;
+        if (d.comp[c].v > d.maxV) d.maxV = d.comp[c].v;
+      }
+      // A single-component scan is not interleaved: one block per MCU
+      if (d.components == 1) d.comp[0].h = d.comp[0].v = 1;
+      frame = true;
+    } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+      return false;   // Progressive, lossless or arithmetic coding
+    } else if (marker == 0xDD) {   // DRI
+      d.restartInterval = (p[0] << 8) | p[1];
+    } else if (marker == 0xDA) {   // SOS
+      if (!frame || p[0] != d.components) return false;
+      for (int c = 0; c < d.components; c++) {
+        if (p[1 + 2 * c] != d.comp[c].id) return false;
+        d.comp[c].dcTable = (p[2 + 2 * c] >> 4) & 1;
+        d.comp[c].acTable = p[2 + 2 * c] & 1;
+        d.comp[c].predictor = 0;
+      }
+      d.data = p + n;
+      d.end = jpeg + len;
+      d.bits = 0;
+      d.bitCount = 0;
+      d.markerHit = false;
+      return true;
+    }
+    pos += 2 + segment;
+  }
+  return false;
+}
+
+/*******************************************************
+ * FUNCTION: jpegRestart
+ * DESCRIPTION: At a restart interval: drops the remaining bits, skips the
+ * RSTn marker and resets the DC predictors.
+ * INPUT: JpegDCDecoder &d
+ * OUTPUT: None
+ *******************************************************/
+void jpegRestart(JpegDCDecoder &d) {
+  d.bits = 0;
+  d.bitCount = 0;
+  while (d.data + 1 < d.end && !(d.data[0] == 0xFF && d.data[1] >= 0xD0 && d.data[1] <= 0xD7)) d.data++;
+  if (d.data + 1 < d.end) d.data += 2;
+  d.markerHit = false;
+  for (int c = 0; c < d.components; c++) d.comp[c].predictor = 0;
+}
+
+// ---------------------- Thumbnail ----------------------
+/*******************************************************
+ * FUNCTION: jpegLevelsToRGB565
+ * DESCRIPTION: JFIF YCbCr levels (0-255) to an RGB565 pixel, fixed point.
+ * INPUT: int luma, int cb, int cr
+ * OUTPUT: uint16_t
+ *******************************************************/
+inline uint16_t jpegLevelsToRGB565(int luma, int cb, int cr) {
+  cb -= 128;
+  cr -= 128;
+  int r = luma + ((91881 * cr) >> 16);
+  int g = luma - ((22554 * cb + 46802 * cr) >> 16);
+  int b = luma + ((116130 * cb) >> 16);
+  r = r < 0 ? 0 : (r > 255 ? 255 : r);
+  g = g < 0 ? 0 : (g > 255 ? 255 : g);
+  b = b < 0 ? 0 : (b > 255 ? 255 : b);
+  return (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+}
+
+/*******************************************************
+ * FUNCTION: jpegDCThumbnail
+ * DESCRIPTION: Decodes a 1/8 scale RGB565 thumbnail (one pixel per 8x8
+ * luma block, chroma replicated from its subsampled blocks).
+ * INPUT: JpegDCDecoder &d, const uint8_t* jpeg, size_t len, uint16_t* out,
+ * size_t outPixels, int &thumbWidth, int &thumbHeight
+ * OUTPUT: bool (false if unsupported, corrupt, or larger than outPixels)
+ *******************************************************/
+bool jpegDCThumbnail(JpegDCDecoder &d, const uint8_t* jpeg, size_t len, uint16_t* out, size_t outPixels,
+                     int &thumbWidth, int &thumbHeight) {
+  if (!jpegReadHeaders(d, jpeg, len)) return false;
+  thumbWidth = (d.width + 7) / 8;
+  thumbHeight = (d.height + 7) / 8;
+  if (thumbWidth > jpegThumbMaxWidth || (size_t)thumbWidth * thumbHeight > outPixels) return false;
+
+  const int mcuWidth = 8 * d.maxH, mcuHeight = 8 * d.maxV;
+  const int mcusX = (d.width + mcuWidth - 1) / mcuWidth;
+  const int mcusY = (d.height + mcuHeight - 1) / mcuHeight;
+  // Block levels of one MCU row, per component, at the component's own resolution
+  static uint8_t levels[3][2][2 * jpegThumbMaxWidth];
+  int mcusLeft = d.restartInterval;
+
+  for (int my = 0; my < mcusY; my++) {
+    for (int mx = 0; mx < mcusX; mx++) {
+      if (d.restartInterval) {
+        if (mcusLeft == 0) {
+          jpegRestart(d);
+          mcusLeft = d.restartInterval;
+        }
+        mcusLeft--;
+      }
+      for (int c = 0; c < d.components; c++) {
+        for (int by = 0; by < d.comp[c].v; by++) {
+          for (int bx = 0; bx < d.comp[c].h; bx++) {
+            int s = jpegDecodeSymbol(d, d.dc[d.comp[c].dcTable]);
+            if (s < 0 || s > 11) return false;
+            d.comp[c].predictor += jpegExtend(jpegGetBits(d, s), s);
+            // AC: decode the run/size symbols, skip the values
+            const JpegHuffman &ac = d.ac[d.comp[c].acTable];
+            for (int k = 1; k < 64; k++) {
+              int rs = jpegDecodeSymbol(d, ac);
+              if (rs < 0) return false;
+              int run = rs >> 4, size = rs & 15;
+              if (size == 0) {
+                if (run != 15) break;
+                k += 15;
+              } else {
+                k += run;
+                jpegGetBits(d, size);
+              }
+            }
+            int level = d.comp[c].predictor * d.dcQuant[d.comp[c].quant] / 8 + 128;
+            levels[c][by][mx * d.comp[c].h + bx] = level < 0 ? 0 : (level > 255 ? 255 : level);
+          }
+        }
+      }
+    }
+
+    // Colour conversion of the thumbnail rows covered by this MCU row
+    for (int row = 0; row < d.maxV && my * d.maxV + row < thumbHeight; row++) {
+      uint16_t* o = out + (my * d.maxV + row) * thumbWidth;
+      const uint8_t* y = levels[0][row * d.comp[0].v / d.maxV];
+      for (int x = 0; x < thumbWidth; x++) {
+        int luma = y[x * d.comp[0].h / d.maxH];
+        int cb = 128, cr = 128;
+        if (d.components == 3) {
+          cb = levels[1][row * d.comp[1].v / d.maxV][x * d.comp[1].h / d.maxH];
+          cr = levels[2][row * d.comp[2].v / d.maxV][x * d.comp[2].h / d.maxH];
+        }
+        o[x] = jpegLevelsToRGB565(luma, cb, cr);
+      }
+    }
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,434 @@
+#ifndef __JPEG_STRIP_ENCODER_H
+#define __JPEG_STRIP_ENCODER_H
+
+/*******************************************************
+ * Baseline JPEG encoder working one band (MCU row) at a time.
+ * Compresses an RGB565 picture as 4:2:0 colour (16-row bands) or
+ * greyscale (8-row bands) with the standard tables, so a band can be
+ * encoded as soon as its rows are final, and writes the output through a
+ * small buffer to a callback (a file on the card, on the beacon). The
+ * 1/8 scale thumbnail of the result falls out of the quantised DC
+ * coefficients and is produced on the way (as jpeg_dc_thumb.h would
+ * decode it from the file).
+ * No heap: the encoder state (JpegStripEncoder, ~6.5 KB) is passed in.
+ * Plain C++ with no Arduino dependency (also used by the host tools).
+ *******************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "jpeg_dc_thumb.h"
+
+/*******************************************************
+ * CONSTANT: jpegStripOutSize
+ * DESCRIPTION: Output buffer: bytes handed to the writer at a time.
+ *******************************************************/
+const size_t jpegStripOutSize = 4096;
+
+// ---------------------- Standard Tables (ITU T.81 Annex K) ----------------------
+/*******************************************************
+ * CONSTANT: jpegZigzag
+ * DESCRIPTION: Natural (row-major) index of each zigzag position.
+ *******************************************************/
+const uint8_t jpegZigzag[64] = {
+  0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48,
+  41, 34, 27, 20, 13, 6, 7, 14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22,
+  15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/*******************************************************
+ * CONSTANT: jpegStdQuant
+ * DESCRIPTION: Luminance and chrominance quantisers at quality 50 (natural order).
+ *******************************************************/
+const uint8_t jpegStdQuant[2][64] = {
+  { 16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99 },
+  { 17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99 }
+};
+
+/*******************************************************
+ * CONSTANT: jpegStdDCCounts / jpegStdDCSymbols / jpegStdACCounts / jpegStdACSymbols
+ * DESCRIPTION: Luminance and chrominance Huffman tables (code counts per
+ * length 1-16, then the symbols; both DC tables code sizes 0-11).
+ *******************************************************/
+const uint8_t jpegStdDCCounts[2][16] = {
+  { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
+  { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 }
+};
+const uint8_t jpegStdDCSymbols[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+const uint8_t jpegStdACCounts[2][16] = {
+  { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D },
+  { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 }
+};
+const uint8_t jpegStdACSymbols[2][162] = {
+  { 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA },
+  { 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA }
+};
+
+// ---------------------- Encoder State ----------------------
+/*******************************************************
+ * STRUCT: JpegStripEncoder
+ * DESCRIPTION: Tables (index 0 luminance, 1 chrominance), DC predictors,
+ * bit writer and output buffer. write() returns false to abort.
+ *******************************************************/
+struct JpegStripEncoder {
+  bool (*write)(void* context, const uint8_t* data, size_t len);
+  void* context;
+  int width, height;
+  int components;        // 3 = YCbCr 4:2:0, 1 = greyscale
+  int rowsDone;          // Rows encoded (multiple of the band height)
+  uint16_t* thumb;       // Optional (width+7)/8 x (height+7)/8 RGB565 thumbnail
+  uint8_t quant[2][64];  // Natural order
+  float divisors[2][64]; // 1 / (quantiser x AAN scale)
+  uint16_t dcCode[2][12];
+  uint8_t dcSize[2][12];
+  uint16_t acCode[2][256];
+  uint8_t acSize[2][256];
+  int predictor[3];
+  uint32_t bitBuffer;
+  int bitCount;
+  uint8_t out[jpegStripOutSize];
+  size_t outLen;
+  uint32_t bytes;        // Total written
+  bool ok;
+};
+
+// ---------------------- Output ----------------------
+/*******************************************************
+ * FUNCTION: jpegFlushOut / jpegPutByte
+ * DESCRIPTION: Hand the output buffer to the writer; append one byte.
+ * INPUT: JpegStripEncoder &e (, uint8_t b)
+ * OUTPUT: None
+ *******************************************************/
+void jpegFlushOut(JpegStripEncoder &e) {
+  if (e.outLen && e.ok) e.ok = e.write(e.context, e.out, e.outLen);
+  e.bytes += e.outLen;
+  e.outLen = 0;
+}
+
+inline void jpegPutByte(JpegStripEncoder &e, uint8_t b) {
+  e.out[e.outLen++] = b;
+  if (e.outLen == jpegStripOutSize) jpegFlushOut(e);
+}
+
+/*******************************************************
+ * FUNCTION: jpegPutBits
+ * DESCRIPTION: Appends the low n bits of value (n <= 16) to the
+ * entropy-coded data, stuffing a 0x00 after every 0xFF.
+ * INPUT: JpegStripEncoder &e, uint32_t value, int n
+ * OUTPUT: None
+ *******************************************************/
+inline void jpegPutBits(JpegStripEncoder &e, uint32_t value, int n) {
+  e.bitCount += n;
+  e.bitBuffer |= (value & ((1u << n) - 1)) << (24 - e.bitCount);
+  while (e.bitCount >= 8) {
+    uint8_t b = e.bitBuffer >> 16;
+    jpegPutByte(e, b);
+    if (b == 0xFF) jpegPutByte(e, 0);
+    e.bitBuffer <<= 8;
+    e.bitBuffer &= 0xFFFFFF;
+    e.bitCount -= 8;
+  }
+}
+
+/*******************************************************
+ * FUNCTION: jpegPutMarker
+ * DESCRIPTION: Writes a marker segment (marker, length, payload).
+ * INPUT: JpegStripEncoder &e, uint8_t marker, const uint8_t* payload, int len
+ * OUTPUT: None
+ *******************************************************/
+void jpegPutMarker(JpegStripEncoder &e, uint8_t marker, const uint8_t* payload, int len) {
+  jpegPutByte(e, 0xFF);
+  jpegPutByte(e, marker);
+  jpegPutByte(e, (len + 2) >> 8);
+  jpegPutByte(e, (len + 2) & 0xFF);
+  for (int i = 0; i < len; i++) jpegPutByte(e, payload[i]);
+}
+
+// ---------------------- Tables ----------------------
+/*******************************************************
+ * FUNCTION: jpegBuildCodes
+ * DESCRIPTION: Canonical Huffman codes of a table (per symbol).
+ * INPUT: const uint8_t* counts, const uint8_t* symbols, uint16_t* codes, uint8_t* sizes
+ * OUTPUT: None
+ *******************************************************/
+void jpegBuildCodes(const uint8_t* counts, const uint8_t* symbols, uint16_t* codes, uint8_t* sizes) {
+  uint16_t code = 0;
+  int k = 0;
+  for (int length = 1; length <= 16; length++) {
+    for (int i = 0; i < counts[length - 1]; i++, k++) {
+      codes[symbols[k]] = code++;
+      sizes[symbols[k]] = length;
+    }
+    code <<= 1;
+  }
+}
+
+/*******************************************************
+ * FUNCTION: jpegStripBegin
+ * DESCRIPTION: Sets up the tables for a quality (1-100, libjpeg scaling)
+ * and writes the headers.
+ * INPUT: JpegStripEncoder &e, int width, int height, int components (3 or 1),
+ * int quality, bool (*write)(void*, const uint8_t*, size_t), void* context,
+ * uint16_t* thumb (NULL for none)
+ * OUTPUT: bool (false if the writer failed)
+ *******************************************************/
+bool jpegStripBegin(JpegStripEncoder &e, int width, int height, int components, int quality,
+                    bool (*write)(void*, const uint8_t*, size_t), void* context, uint16_t* thumb) {
+  e.write = write;
+  e.context = context;
+  e.width = width;
+  e.height = height;
+  e.components = components == 1 ? 1 : 3;
+  e.rowsDone = 0;
+  e.thumb = thumb;
+  e.predictor[0] = e.predictor[1] = e.predictor[2] = 0;
+  e.bitBuffer = 0;
+  e.bitCount = 0;
+  e.outLen = 0;
+  e.bytes = 0;
+  e.ok = true;
+
+  quality = quality < 1 ? 1 : (quality > 100 ? 100 : quality);
+  int scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+  static const float aan[8] = { 1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+                                1.0f, 0.785694958f, 0.541196100f, 0.275899379f };
+  for (int t = 0; t < 2; t++) {
+    for (int i = 0; i < 64; i++) {
+      int q = (jpegStdQuant[t][i] * scale + 50) / 100;
+      e.quant[t][i] = q < 1 ? 1 : (q > 255 ? 255 : q);
+      e.divisors[t][i] = 1.0f / (e.quant[t][i] * aan[i / 8] * aan[i % 8] * 8.0f);
+    }
+    jpegBuildCodes(jpegStdDCCounts[t], jpegStdDCSymbols, e.dcCode[t], e.dcSize[t]);
+    jpegBuildCodes(jpegStdACCounts[t], jpegStdACSymbols[t], e.acCode[t], e.acSize[t]);
+  }
+
+  jpegPutByte(e, 0xFF);
+  jpegPutByte(e, 0xD8);
+  static const uint8_t jfif[14] = { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+  jpegPutMarker(e, 0xE0, jfif, sizeof(jfif));
+  int tables = e.components == 3 ? 2 : 1;
+  for (int t = 0; t < tables; t++) {
+    uint8_t dqt[65];
+    dqt[0] = t;
+    for (int i = 0; i < 64; i++) dqt[1 + i] = e.quant[t][jpegZigzag[i]];
+    jpegPutMarker(e, 0xDB, dqt, sizeof(dqt));
+  }
+  uint8_t sof[15] = { 8, (uint8_t)(height >> 8), (uint8_t)height, (uint8_t)(width >> 8), (uint8_t)width,
+                      (uint8_t)e.components, 1, 0x11, 0, 2, 0x11, 1, 3, 0x11, 1 };
+  if (e.components == 3) sof[7] = 0x22;   // Luma 2x2: chroma subsampled 4:2:0
+  jpegPutMarker(e, 0xC0, sof, 6 + 3 * e.components);
+  for (int t = 0; t < tables; t++) {
+    uint8_t dht[1 + 16 + 162];
+    dht[0] = t;
+    memcpy(dht + 1, jpegStdDCCounts[t], 16);
+    memcpy(dht + 17, jpegStdDCSymbols, 12);
+    jpegPutMarker(e, 0xC4, dht, 17 + 12);
+    dht[0] = 0x10 | t;
+    memcpy(dht + 1, jpegStdACCounts[t], 16);
+    memcpy(dht + 17, jpegStdACSymbols[t], 162);
+    jpegPutMarker(e, 0xC4, dht, sizeof(dht));
+  }
+  uint8_t sos[10] = { (uint8_t)e.components, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 };
+  if (e.components == 1) {
+    sos[3] = 0;
+    sos[4] = 63;
+    sos[5] = 0;
+  }
+  jpegPutMarker(e, 0xDA, sos, e.components == 3 ? 10 : 6);
+  return e.ok;
+}
+
+// ---------------------- Blocks ----------------------
+/*******************************************************
+ * FUNCTION: jpegFDCT8
+ * DESCRIPTION: Scaled 8-point forward DCT (AAN); the scale factors are
+ * folded into the quantiser divisors.
+ * INPUT: float* p, int step
+ * OUTPUT: None
+ *******************************************************/
+inline void jpegFDCT8(float* p, int step) {
+  float t0 = p[0] + p[7 * step], t7 = p[0] - p[7 * step];
+  float t1 = p[step] + p[6 * step], t6 = p[step] - p[6 * step];
+  float t2 = p[2 * step] + p[5 * step], t5 = p[2 * step] - p[5 * step];
+  float t3 = p[3 * step] + p[4 * step], t4 = p[3 * step] - p[4 * step];
+
+  float t10 = t0 + t3, t13 = t0 - t3, t11 = t1 + t2, t12 = t1 - t2;
+  p[0] = t10 + t11;
+  p[4 * step] = t10 - t11;
+  float z1 = (t12 + t13) * 0.707106781f;
+  p[2 * step] = t13 + z1;
+  p[6 * step] = t13 - z1;
+
+  t10 = t4 + t5;
+  t11 = t5 + t6;
+  t12 = t6 + t7;
+  float z5 = (t10 - t12) * 0.382683433f;
+  float z2 = 0.541196100f * t10 + z5;
+  float z4 = 1.306562965f * t12 + z5;
+  float z3 = t11 * 0.707106781f;
+  float z11 = t7 + z3, z13 = t7 - z3;
+  p[5 * step] = z13 + z2;
+  p[3 * step] = z13 - z2;
+  p[step] = z11 + z4;
+  p[7 * step] = z11 - z4;
+}
+
+/*******************************************************
+ * FUNCTION: jpegEncodeBlock
+ * DESCRIPTION: Transforms, quantises and entropy-codes one 8x8 block of
+ * level-shifted samples (-128..127).
+ * INPUT: JpegStripEncoder &e, float* block (destroyed), int component
+ * OUTPUT: int (Level 0-255 of the quantised DC, for the thumbnail)
+ *******************************************************/
+int jpegEncodeBlock(JpegStripEncoder &e, float* block, int component) {
+  int t = component ? 1 : 0;
+  for (int i = 0; i < 8; i++) jpegFDCT8(block + 8 * i, 1);
+  for (int i = 0; i < 8; i++) jpegFDCT8(block + i, 8);
+
+  int coef[64];
+  for (int i = 0; i < 64; i++) {
+    int n = jpegZigzag[i];
+    float v = block[n] * e.divisors[t][n];
+    coef[i] = (int)(v < 0 ? v - 0.5f : v + 0.5f);
+  }
+
+  // DC difference, then the AC run/size symbols
+  int diff = coef[0] - e.predictor[component];
+  e.predictor[component] = coef[0];
+  int magnitude = diff < 0 ? -diff : diff, size = 0;
+  while (magnitude >> size) size++;
+  jpegPutBits(e, e.dcCode[t][size], e.dcSize[t][size]);
+  if (size) jpegPutBits(e, diff < 0 ? diff - 1 : diff, size);
+
+  int run = 0;
+  for (int i = 1; i < 64; i++) {
+    int v = coef[i];
+    if (v == 0) {
+      run++;
+      continue;
+    }
+    while (run > 15) {
+      jpegPutBits(e, e.acCode[t][0xF0], e.acSize[t][0xF0]);
+      run -= 16;
+    }
+    magnitude = v < 0 ? -v : v;
+    size = 0;
+    while (magnitude >> size) size++;
+    int symbol = (run << 4) | size;
+    jpegPutBits(e, e.acCode[t][symbol], e.acSize[t][symbol]);
+    jpegPutBits(e, v < 0 ? v - 1 : v, size);
+    run = 0;
+  }
+  if (run) jpegPutBits(e, e.acCode[t][0x00], e.acSize[t][0x00]);
+
+  int level = coef[0] * e.quant[t][0] / 8 + 128;
+  return level < 0 ? 0 : (level > 255 ? 255 : level);
+}
+
+// ---------------------- Bands ----------------------
+/*******************************************************
+ * FUNCTION: jpegStripBandHeight
+ * DESCRIPTION: Rows encoded by one jpegStripEncodeBand() call.
+ * INPUT: const JpegStripEncoder &e
+ * OUTPUT: int
+ *******************************************************/
+inline int jpegStripBandHeight(const JpegStripEncoder &e) {
+  return e.components == 3 ? 16 : 8;
+}
+
+/*******************************************************
+ * FUNCTION: jpegStripEncodeBand
+ * DESCRIPTION: Encodes the next band (rows rowsDone .. rowsDone + band
+ * height - 1, edge pixels repeated past the picture) of an RGB565 picture.
+ * INPUT: JpegStripEncoder &e, const uint16_t* pixels (row 0), int stride (pixels)
+ * OUTPUT: bool (false if the writer failed)
+ *******************************************************/
+bool jpegStripEncodeBand(JpegStripEncoder &e, const uint16_t* pixels, int stride) {
+  const int band = jpegStripBandHeight(e), mcu = band;
+  const int thumbWidth = (e.width + 7) / 8, thumbHeight = (e.height + 7) / 8;
+  float y[4][64], cb[64], cr[64];
+
+  for (int x0 = 0; x0 < e.width; x0 += mcu) {
+    if (e.components == 3) {
+      memset(cb, 0, sizeof(cb));
+      memset(cr, 0, sizeof(cr));
+    }
+    for (int row = 0; row < mcu; row++) {
+      int sy = e.rowsDone + row;
+      const uint16_t* line = pixels + (sy < e.height ? sy : e.height - 1) * stride;
+      for (int col = 0; col < mcu; col++) {
+        int sx = x0 + col;
+        uint16_t p = line[sx < e.width ? sx : e.width - 1];
+        int r = ((p >> 11) << 3) | (p >> 13);
+        int g = (((p >> 5) & 63) << 2) | ((p >> 9) & 3);
+        int b = ((p & 31) << 3) | ((p >> 2) & 7);
+        float luma = 0.299f * r + 0.587f * g + 0.114f * b - 128.0f;
+        y[(row >> 3) * 2 + (col >> 3)][(row & 7) * 8 + (col & 7)] = luma;
+        if (e.components == 3) {
+          int k = (row >> 1) * 8 + (col >> 1);
+          cb[k] += 0.25f * (-0.168736f * r - 0.331264f * g + 0.5f * b);
+          cr[k] += 0.25f * (0.5f * r - 0.418688f * g - 0.081312f * b);
+        }
+      }
+    }
+
+    int levels[4], cbLevel = 128, crLevel = 128;
+    int blocks = e.components == 3 ? 4 : 1;
+    for (int i = 0; i < blocks; i++) levels[i] = jpegEncodeBlock(e, y[i], 0);
+    if (e.components == 3) {
+      cbLevel = jpegEncodeBlock(e, cb, 1);
+      crLevel = jpegEncodeBlock(e, cr, 2);
+    }
+
+    if (e.thumb) {
+      for (int i = 0; i < blocks; i++) {
+        int tx = (x0 >> 3) + (i & 1), ty = (e.rowsDone >> 3) + (i >> 1);
+        if (tx < thumbWidth && ty < thumbHeight) e.thumb[ty * thumbWidth + tx] = jpegLevelsToRGB565(levels[i], cbLevel, crLevel);
+      }
+    }
+  }
+  e.rowsDone += band;
+  return e.ok;
+}
+
+/*******************************************************
+ * FUNCTION: jpegStripEnd
+ * DESCRIPTION: Pads the last byte with 1 bits, writes EOI and flushes.
+ * INPUT: JpegStripEncoder &e
+ * OUTPUT: bool (false if the writer failed at any point)
+ *******************************************************/
+bool jpegStripEnd(JpegStripEncoder &e) {
+  if (e.bitCount) jpegPutBits(e, 0x7F, 8 - e.bitCount);
+  jpegPutByte(e, 0xFF);
+  jpegPutByte(e, 0xD9);
+  jpegFlushOut(e);
+  return e.ok;
+}
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef __NMEA_PARSER_H
+#define __NMEA_PARSER_H
+
+/*******************************************************
+ * Incremental NMEA 0183 parser.
+ * Fed one character at a time (as they come out of the UART), it keeps
+ * only the sentence being received (82 characters max, no heap) and
+ * updates a GpsFix from RMC (position, date and time) and GGA (fix
+ * quality, satellites, altitude) sentences with a valid checksum, from
+ * any talker (GP, GN, GL, GA...).
+ * Plain C++ with no Arduino dependency (also used by tools/nmea_replay.cpp).
+ *******************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+/*******************************************************
+ * STRUCT: GpsFix
+ * DESCRIPTION: Last known position and time. Coordinates in 1e-7 degrees
+ * (north and east positive).
+ *******************************************************/
+struct GpsFix {
+  bool valid;          // RMC status 'A' seen with a position
+  int32_t latitude;
+  int32_t longitude;
+  int16_t altitude;    // Metres above mean sea level (GGA)
+  uint8_t satellites;  // In use (GGA)
+  uint8_t quality;     // GGA fix quality (0 = none, 1 = GPS, 2 = DGPS...)
+  uint32_t time;       // UTC, seconds since 1970 (RMC), 0 if not known yet
+};
+
+/*******************************************************
+ * STRUCT: NMEAParser
+ * DESCRIPTION: Parser state: the sentence being received and counters.
+ *******************************************************/
+struct NMEAParser {
+  char sentence[83];   // '$' excluded, up to and including the checksum
+  uint8_t length;
+  bool receiving;
+  uint32_t sentences;       // Sentences with a valid checksum
+  uint32_t checksumErrors;  // Sentences dropped (bad checksum or too long)
+  GpsFix fix;
+};
+
+// ---------------------- Field Helpers ----------------------
+/*******************************************************
+ * FUNCTION: nmeaHex
+ * DESCRIPTION: Value of a hexadecimal digit, -1 if not one.
+ * INPUT: char c
+ * OUTPUT: int
+ *******************************************************/
+int nmeaHex(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+/*******************************************************
+ * FUNCTION: nmeaDigits
+ * DESCRIPTION: Reads `count` decimal digits; false if any is missing.
+ * INPUT: const char* s, int count, uint32_t &value
+ * OUTPUT: bool
+ *******************************************************/
+bool nmeaDigits(const char* s, int count, uint32_t &value) {
+  value = 0;
+  for (int i = 0; i < count; i++) {
+    if (s[i] < '0' || s[i] > '9') return false;
+    value = value * 10 + (s[i] - '0');
+  }
+  return true;
+}
+
+/*******************************************************
+ * FUNCTION: nmeaCoordinate
+ * DESCRIPTION: Converts an NMEA (d)ddmm.mmmm field and its hemisphere
+ * to 1e-7 degrees, without floating point.
+ * INPUT: const char* value, const char* hemisphere, int32_t &out
+ * OUTPUT: bool (false for an empty or malformed field)
+ *******************************************************/
+bool nmeaCoordinate(const char* value, const char* hemisphere, int32_t &out) {
+  int64_t whole = 0, fraction = 0;
+  int digits = 0, decimals = 0;
+  const char* p = value;
+  for (; *p >= '0' && *p <= '9'; p++, digits++) whole = whole * 10 + (*p - '0');
+  if (digits < 3) return false;
+  if (*p == '.') {
+    for (p++; *p >= '0' && *p <= '9'; p++) {
+      if (decimals < 5) {
+        fraction = fraction * 10 + (*p - '0');
+        decimals++;
+      }
+    }
+  }
+  for (; decimals < 5; decimals++) fraction *= 10;
+  int64_t minutes = (whole % 100) * 100000 + fraction;   // 1e-5 minutes
+  int64_t result = (whole / 100) * 10000000 + minutes * 100 / 60;
+  if (hemisphere[0] == 'S' || hemisphere[0] == 'W') result = -result;
+  else if (hemisphere[0] != 'N' && hemisphere[0] != 'E') return false;
+  out = (int32_t)result;
+  return true;
+}
+
+/*******************************************************
+ * FUNCTION: nmeaUnixTime
+ * DESCRIPTION: Seconds since 1970 from the RMC time (hhmmss) and date
+ * (ddmmyy, years 2000-2099) fields.
+ * INPUT: const char* time, const char* date, uint32_t &out
+ * OUTPUT: bool
+ *******************************************************/
+bool nmeaUnixTime(const char* time, const char* date, uint32_t &out) {
+  uint32_t hh, mm, ss, day, month, year;
+  if (!nmeaDigits(time, 2, hh) || !nmeaDigits(time + 2, 2, mm) || !nmeaDigits(time + 4, 2, ss)) return false;
+  if (!nmeaDigits(date, 2, day) || !nmeaDigits(date + 2, 2, month) || !nmeaDigits(date + 4, 2, year)) return false;
+  if (month < 1 || month > 12 || day < 1 || day > 31 || hh > 23 || mm > 59 || ss > 60) return false;
+  // Days from civil (proleptic Gregorian), March-based year
+  int32_t y = 2000 + year - (month <= 2);
+  int32_t era = y / 400;
+  int32_t yoe = y - era * 400;
+  int32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  int32_t days = era * 146097 + doe - 719468;
+  out = (uint32_t)days * 86400 + hh * 3600 + mm * 60 + ss;
+  return true;
+}
+
+// ---------------------- Sentences ----------------------
+/*******************************************************
+ * FUNCTION: nmeaSplit
+ * DESCRIPTION: Splits the received sentence in place at the commas (and
+ * at the '*' of the checksum).
+ * INPUT: char* sentence, const char** fields, int maxFields
+ * OUTPUT: int (number of fields)
+ *******************************************************/
+int nmeaSplit(char* sentence, const char** fields, int maxFields) {
+  int count = 0;
+  fields[count++] = sentence;
+  for (char* p = sentence; *p && count < maxFields; p++) {
+    if (*p == ',' || *p == '*') {
+      bool last = *p == '*';
+      *p = '\0';
+      if (last) break;
+      fields[count++] = p + 1;
+    }
+  }
+  return count;
+}
+
+/*******************************************************
+ * FUNCTION: nmeaSentence
+ * DESCRIPTION: Interprets one sentence with a verified checksum.
+ * INPUT: NMEAParser &parser
+ * OUTPUT: bool (true if the position or time was updated)
+ *******************************************************/
+bool nmeaSentence(NMEAParser &parser) {
+  const char* f[20];
+  int n = nmeaSplit(parser.sentence, f, 20);
+  if (strlen(f[0]) != 5) return false;
+  const char* type = f[0] + 2;
+  GpsFix &fix = parser.fix;
+
+  if (strcmp(type, "RMC") == 0 && n >= 10) {
+    // $xxRMC,time,status,lat,N,lon,E,speed,course,date,...
+    bool updated = false;
+    uint32_t t;
+    if (nmeaUnixTime(f[1], f[9], t)) {
+      fix.time = t;
+      updated = true;
+    }
+    int32_t lat, lon;
+    if (f[2][0] == 'A' && nmeaCoordinate(f[3], f[4], lat) && nmeaCoordinate(f[5], f[6], lon)) {
+      fix.latitude = lat;
+      fix.longitude = lon;
+      fix.valid = true;
+      updated = true;
+    }
+    return updated;
+  }
+  if (strcmp(type, "GGA") == 0 && n >= 10) {
+    // $xxGGA,time,lat,N,lon,E,quality,satellites,hdop,altitude,M,...
+    uint32_t value = 0;
+    fix.quality = f[6][0] >= '0' && f[6][0] <= '9' ? f[6][0] - '0' : 0;
+    for (const char* p = f[7]; *p >= '0' && *p <= '9'; p++) value = value * 10 + (*p - '0');
+    fix.satellites = value > 255 ? 255 : value;
+    int32_t altitude = 0;
+    const char* p = f[9];
+    bool negative = *p == '-';
+    if (negative) p++;
+    for (; *p >= '0' && *p <= '9'; p++) altitude = altitude * 10 + (*p - '0');
+    fix.altitude = (int16_t)(negative ? -altitude : altitude);
+    return false;
+  }
+  return false;
+}
+
+/*******************************************************
+ * FUNCTION: nmeaFeed
+ * DESCRIPTION: Feeds one received character to the parser. A sentence is
+ * interpreted when its line ends, if the checksum matches.
+ * INPUT: NMEAParser &parser, char c
+ * OUTPUT: bool (true when the fix position or time was updated)
+ *******************************************************/
+bool nmeaFeed(NMEAParser &parser, char c) {
+  if (c == '$') {
+    parser.receiving = true;
+    parser.length = 0;
+    return false;
+  }
+  if (!parser.receiving) return false;
+  if (c != '\r' && c != '\n') {
+    if (parser.length >= sizeof(parser.sentence) - 1) {
+      parser.receiving = false;
+      parser.checksumErrors++;
+      return false;
+    }
+    parser.sentence[parser.length++] = c;
+    return false;
+  }
+
+  parser.receiving = false;
+  parser.sentence[parser.length] = '\0';
+  // Checksum: XOR of everything between '$' and '*'
+  uint8_t sum = 0;
+  int i = 0;
+  for (; i < parser.length && parser.sentence[i] != '*'; i++) sum ^= (uint8_t)parser.sentence[i];
+  if (i + 2 >= parser.length || nmeaHex(parser.sentence[i + 1]) < 0 || nmeaHex(parser.sentence[i + 2]) < 0 ||
+      ((nmeaHex(parser.sentence[i + 1]) << 4) | nmeaHex(parser.sentence[i + 2])) != sum) {
+    parser.checksumErrors++;
+    return false;
+  }
+  parser.sentences++;
+  return nmeaSentence(parser);
+}
+
+// ---------------------- Locator ----------------------
+/*******************************************************
+ * FUNCTION: maidenheadLocator
+ * DESCRIPTION: 6-character Maidenhead locator (e.g. "JN53hb") of a position.
+ * INPUT: int32_t latitude, int32_t longitude (1e-7 degrees), char* out (7 bytes)
+ * OUTPUT: None
+ *******************************************************/
+void maidenheadLocator(int32_t latitude, int32_t longitude, char* out) {
+  // Shift to positive ranges, in 1e-7 degrees
+  int64_t lon = (int64_t)longitude + 1800000000LL;   // 0 .. 360 deg
+  int64_t lat = (int64_t)latitude + 900000000LL;     // 0 .. 180 deg
+  if (lon < 0) lon = 0;
+  if (lon >= 3600000000LL) lon = 3600000000LL - 1;
+  if (lat < 0) lat = 0;
+  if (lat >= 1800000000LL) lat = 1800000000LL - 1;
+  out[0] = 'A' + lon / 200000000;          // Field: 20 x 10 degrees
+  out[1] = 'A' + lat / 100000000;
+  out[2] = '0' + (lon % 200000000) / 20000000;   // Square: 2 x 1 degrees
+  out[3] = '0' + (lat % 100000000) / 10000000;
+  out[4] = 'a' + (lon % 20000000) * 24 / 20000000;   // Subsquare: 5' x 2.5'
+  out[5] = 'a' + (lat % 10000000) * 24 / 10000000;
+  out[6] = '\0';
+}
+
+#endif
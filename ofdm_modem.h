@@ -0,0 +1,418 @@
+#ifndef __OFDM_MODEM_H
+#define __OFDM_MODEM_H
+
+/*******************************************************
+ * OFDM image modem (HamDRM-style digital mode)
+ * Sends the camera JPEG bytes instead of an analog scan.
+ * Plain C++ with no Arduino dependency: the firmware uses it to
+ * modulate, the host tool in tools/ uses it to build reference
+ * waveforms and to decode loopback recordings.
+ *
+ * Frame: 3x reference, 1x inverted reference, 1 header symbol (QPSK),
+ * then the payload (JPEG + CRC32) convolutionally coded (K=7, r=1/2),
+ * bit-interleaved per symbol and Gray mapped on QPSK/16-QAM/64-QAM.
+ *******************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <string.h>
+#include "crc16.h"
+
+// ---------------------- OFDM Parameters ----------------------
+/*******************************************************
+ * CONSTANT: ofdmSampleRate
+ * DESCRIPTION: Audio sample rate of the OFDM waveform in Hz.
+ *******************************************************/
+const int ofdmSampleRate = 8000;
+/*******************************************************
+ * CONSTANT: ofdmFFTSize
+ * DESCRIPTION: FFT length (256 -> 31.25 Hz carrier spacing, 32 ms symbol body).
+ *******************************************************/
+const int ofdmFFTBits = 8;
+const int ofdmFFTSize = 1 << ofdmFFTBits;
+/*******************************************************
+ * CONSTANT: ofdmCyclicPrefix
+ * DESCRIPTION: Guard interval in samples (4 ms) and resulting symbol length (36 ms).
+ *******************************************************/
+const int ofdmCyclicPrefix = 32;
+const int ofdmSymbolSamples = ofdmFFTSize + ofdmCyclicPrefix;
+/*******************************************************
+ * CONSTANT: ofdmFirstBin / ofdmNumCarriers
+ * DESCRIPTION: Occupied band: bins 12..80, i.e. 375..2500 Hz (69 carriers).
+ *******************************************************/
+const int ofdmFirstBin = 12;
+const int ofdmNumCarriers = 69;
+/*******************************************************
+ * CONSTANT: ofdmPilotSpacing
+ * DESCRIPTION: Every 17th carrier (0, 17, 34, 51, 68) is a pilot,
+ * leaving 64 data carriers per symbol.
+ *******************************************************/
+const int ofdmPilotSpacing = 17;
+const int ofdmDataCarriers = 64;
+/*******************************************************
+ * CONSTANT: ofdmAmplitude
+ * DESCRIPTION: Peak constellation amplitude. With 1/16 scaling inside the
+ * IFFT the worst case sum of all carriers still fits in 16 bits.
+ *******************************************************/
+const int16_t ofdmAmplitude = 2600;
+/*******************************************************
+ * CONSTANT: ofdmOutputShift
+ * DESCRIPTION: Gain (as a left shift, saturating) applied to the IFFT output
+ * to bring the typical RMS level to about -14 dBFS.
+ *******************************************************/
+const int ofdmOutputShift = 2;
+/*******************************************************
+ * CONSTANT: ofdmHeaderMagic / ofdmHeaderBytes
+ * DESCRIPTION: Header symbol layout: magic, bits per carrier,
+ * payload length (24 bit LE), CRC16 of the first five bytes, tail byte.
+ *******************************************************/
+const uint8_t ofdmHeaderMagic = 0xD7;
+const int ofdmHeaderBytes = 8;
+const int ofdmPreambleSymbols = 4;
+const int ofdmMaxBytesPerSymbol = ofdmDataCarriers * 6 / 16;
+
+// ---------------------- Fixed-point FFT ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: ofdmSinTable
+ * DESCRIPTION: sin(2*pi*k/N) in Q15 for k = 0..N-1. cos is read at k + N/4.
+ * Filled once by ofdmInitTables().
+ *******************************************************/
+int16_t ofdmSinTable[ofdmFFTSize];
+
+/*******************************************************
+ * GLOBAL VARIABLE: ofdmReference
+ * DESCRIPTION: Known BPSK value (+1/-1) of each carrier in the reference
+ * symbol. Pilots in every other symbol reuse the same values.
+ *******************************************************/
+int8_t ofdmReference[ofdmNumCarriers];
+
+/*******************************************************
+ * FUNCTION: ofdmInitTables
+ * DESCRIPTION: Builds the twiddle table and the pseudo-random reference
+ * pattern (9-bit LFSR x^9 + x^5 + 1). Must be called before any other
+ * ofdm* function.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void ofdmInitTables() {
+  for (int k = 0; k < ofdmFFTSize; k++) {
+    ofdmSinTable[k] = (int16_t)lrint(32767.0 * sin(2.0 * M_PI * k / ofdmFFTSize));
+  }
+  uint16_t lfsr = 0x1FF;
+  for (int c = 0; c < ofdmNumCarriers; c++) {
+    uint16_t bit = ((lfsr >> 8) ^ (lfsr >> 4)) & 1;
+    lfsr = ((lfsr << 1) | bit) & 0x1FF;
+    ofdmReference[c] = bit ? 1 : -1;
+  }
+}
+
+/*******************************************************
+ * FUNCTION: ofdmSaturate
+ * DESCRIPTION: Clamps a 32-bit intermediate to the int16 range.
+ * INPUT: int32_t v
+ * OUTPUT: int16_t
+ *******************************************************/
+inline int16_t ofdmSaturate(int32_t v) {
+  return v > 32767 ? 32767 : (v < -32768 ? -32768 : (int16_t)v);
+}
+
+/*******************************************************
+ * FUNCTION: ofdmFFT
+ * DESCRIPTION: In-place radix-2 decimation-in-time FFT on Q15 data.
+ * The first `scaledStages` butterfly stages divide by two (block scaling)
+ * to prevent overflow; the remaining stages saturate.
+ * INPUT: int16_t* re, int16_t* im (N samples each), bool inverse (sign of
+ * the exponent), int scaledStages (0..ofdmFFTBits)
+ * OUTPUT: None (re/im hold the transform)
+ *******************************************************/
+void ofdmFFT(int16_t* re, int16_t* im, bool inverse, int scaledStages) {
+  // Bit reversal permutation
+  for (int i = 1, j = 0; i < ofdmFFTSize; i++) {
+    int bit = ofdmFFTSize >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      int16_t t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+  // Butterflies
+  int stage = 0;
+  for (int len = 2; len <= ofdmFFTSize; len <<= 1, stage++) {
+    const int half = len >> 1;
+    const int step = ofdmFFTSize / len;
+    const int shift = (stage < scaledStages) ? 1 : 0;
+    for (int i = 0; i < ofdmFFTSize; i += len) {
+      for (int j = 0; j < half; j++) {
+        const int k = j * step;
+        const int32_t wr = ofdmSinTable[(k + ofdmFFTSize / 4) & (ofdmFFTSize - 1)];
+        const int32_t wi = inverse ? ofdmSinTable[k] : -ofdmSinTable[k];
+        const int a = i + j, b = a + half;
+        const int32_t tr = (re[b] * wr - im[b] * wi) >> 15;
+        const int32_t ti = (re[b] * wi + im[b] * wr) >> 15;
+        const int32_t ar = re[a], ai = im[a];
+        re[a] = ofdmSaturate((ar + tr) >> shift);
+        im[a] = ofdmSaturate((ai + ti) >> shift);
+        re[b] = ofdmSaturate((ar - tr) >> shift);
+        im[b] = ofdmSaturate((ai - ti) >> shift);
+      }
+    }
+  }
+}
+
+// ---------------------- Coding, Interleaving and Mapping ----------------------
+/*******************************************************
+ * CONSTANT: ofdmPolyA / ofdmPolyB
+ * DESCRIPTION: Generator polynomials of the K=7, rate 1/2 convolutional code
+ * (171/133 octal). The register holds the newest bit in its LSB.
+ *******************************************************/
+const uint8_t ofdmPolyA = 0x79;
+const uint8_t ofdmPolyB = 0x5B;
+
+/*******************************************************
+ * FUNCTION: ofdmParity
+ * DESCRIPTION: Parity (XOR of all bits) of a 7-bit value.
+ * INPUT: uint8_t v
+ * OUTPUT: uint8_t (0 or 1)
+ *******************************************************/
+inline uint8_t ofdmParity(uint8_t v) {
+  v ^= v >> 4; v ^= v >> 2; v ^= v >> 1;
+  return v & 1;
+}
+
+/*******************************************************
+ * FUNCTION: ofdmInterleave
+ * DESCRIPTION: Position of coded bit `i` inside a symbol of `bits` coded bits
+ * (16-row block interleaver, written by rows and read by columns), so that
+ * neighbouring code bits land on carriers far apart.
+ * INPUT: int i (Coded bit index), int bits (Coded bits per symbol)
+ * OUTPUT: int (Position of the bit on the carriers)
+ *******************************************************/
+inline int ofdmInterleave(int i, int bits) {
+  return (i % 16) * (bits / 16) + i / 16;
+}
+
+/*******************************************************
+ * FUNCTION: ofdmBytesPerSymbol
+ * DESCRIPTION: Payload bytes carried by one data symbol.
+ * INPUT: int bitsPerCarrier (2 = QPSK, 4 = 16-QAM, 6 = 64-QAM)
+ * OUTPUT: int (8, 16 or 24 bytes)
+ *******************************************************/
+inline int ofdmBytesPerSymbol(int bitsPerCarrier) {
+  return ofdmDataCarriers * bitsPerCarrier / 16;
+}
+
+/*******************************************************
+ * FUNCTION: ofdmIsPilot
+ * DESCRIPTION: True if carrier index `c` (0..68) carries a pilot.
+ *******************************************************/
+inline bool ofdmIsPilot(int c) {
+  return (c % ofdmPilotSpacing) == 0;
+}
+
+/*******************************************************
+ * FUNCTION: ofdmPAMLevel
+ * DESCRIPTION: Maps `m` Gray-coded bits to one axis of the constellation,
+ * returning the odd level -(L-1)..(L-1) with L = 2^m.
+ * INPUT: uint8_t bits (MSB first), int m (Bits per axis)
+ * OUTPUT: int (Level)
+ *******************************************************/
+inline int ofdmPAMLevel(uint8_t bits, int m) {
+  uint8_t g = bits;
+  for (uint8_t s = bits >> 1; s; s >>= 1) g ^= s;   // Gray -> binary
+  return 2 * g - ((1 << m) - 1);
+}
+
+// ---------------------- CRC ----------------------
+/*******************************************************
+ * FUNCTION: ofdmCRC32
+ * DESCRIPTION: CRC-32 (IEEE 802.3, reflected) of the payload.
+ * INPUT: const uint8_t* data, size_t len
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t ofdmCRC32(const uint8_t* data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+// ---------------------- Modulator ----------------------
+/*******************************************************
+ * STRUCT: OFDMModulator
+ * DESCRIPTION: State of one transmission: constellation size, convolutional
+ * encoder register and the FFT work buffers.
+ *******************************************************/
+struct OFDMModulator {
+  int bitsPerCarrier;          // 2 (QPSK), 4 (16-QAM) or 6 (64-QAM)
+  uint8_t encoderState;        // last 6 input bits
+  int16_t re[ofdmFFTSize];
+  int16_t im[ofdmFFTSize];
+};
+
+/*******************************************************
+ * FUNCTION: ofdmBegin
+ * DESCRIPTION: Resets a modulator for a new frame.
+ * INPUT: OFDMModulator &m, int bitsPerCarrier (2, 4 or 6)
+ * OUTPUT: None
+ *******************************************************/
+void ofdmBegin(OFDMModulator &m, int bitsPerCarrier) {
+  m.bitsPerCarrier = bitsPerCarrier;
+  m.encoderState = 0;
+}
+
+/*******************************************************
+ * FUNCTION: ofdmSetCarrier
+ * DESCRIPTION: Places a constellation point on carrier `c` and its mirror
+ * image so that the IFFT output is real.
+ *******************************************************/
+inline void ofdmSetCarrier(OFDMModulator &m, int c, int16_t vr, int16_t vi) {
+  const int bin = ofdmFirstBin + c;
+  m.re[bin] = vr;  m.im[bin] = vi;
+  m.re[ofdmFFTSize - bin] = vr;  m.im[ofdmFFTSize - bin] = -vi;
+}
+
+/*******************************************************
+ * FUNCTION: ofdmSynthesize
+ * DESCRIPTION: Runs the IFFT on the prepared spectrum and writes the symbol
+ * (cyclic prefix + body) to `out` with output gain and saturation.
+ * INPUT: OFDMModulator &m, int16_t* out (ofdmSymbolSamples samples)
+ * OUTPUT: None
+ *******************************************************/
+void ofdmSynthesize(OFDMModulator &m, int16_t* out) {
+  ofdmFFT(m.re, m.im, true, 4);
+  for (int n = 0; n < ofdmFFTSize; n++) {
+    out[ofdmCyclicPrefix + n] = ofdmSaturate((int32_t)m.re[n] << ofdmOutputShift);
+  }
+  for (int n = 0; n < ofdmCyclicPrefix; n++) {
+    out[n] = out[ofdmFFTSize + n];
+  }
+}
+
+/*******************************************************
+ * FUNCTION: ofdmReferenceSymbol
+ * DESCRIPTION: Builds the known reference symbol (BPSK on all carriers)
+ * used for frame detection and channel estimation.
+ * INPUT: OFDMModulator &m, bool inverted (Marks the last preamble symbol),
+ * int16_t* out (ofdmSymbolSamples samples)
+ * OUTPUT: None
+ *******************************************************/
+void ofdmReferenceSymbol(OFDMModulator &m, bool inverted, int16_t* out) {
+  memset(m.re, 0, sizeof(m.re));
+  memset(m.im, 0, sizeof(m.im));
+  for (int c = 0; c < ofdmNumCarriers; c++) {
+    int16_t v = ofdmReference[c] * ofdmAmplitude;
+    ofdmSetCarrier(m, c, inverted ? -v : v, 0);
+  }
+  ofdmSynthesize(m, out);
+}
+
+/*******************************************************
+ * FUNCTION: ofdmCodedSymbol
+ * DESCRIPTION: Convolutionally encodes `bytes`, interleaves the coded bits,
+ * maps them on the data carriers with `bitsPerCarrier` bits each, adds
+ * the pilots and synthesizes the symbol.
+ * INPUT: OFDMModulator &m, const uint8_t* bytes (ofdmBytesPerSymbol(bitsPerCarrier)),
+ * int bitsPerCarrier, int16_t* out (ofdmSymbolSamples samples)
+ * OUTPUT: None
+ *******************************************************/
+void ofdmCodedSymbol(OFDMModulator &m, const uint8_t* bytes, int bitsPerCarrier, int16_t* out) {
+  const int codedBits = ofdmDataCarriers * bitsPerCarrier;
+  uint8_t bits[ofdmDataCarriers * 6];
+  int i = 0;
+  for (int byte = 0; byte < codedBits / 16; byte++) {
+    for (int b = 7; b >= 0; b--) {
+      uint8_t reg = ((m.encoderState << 1) | ((bytes[byte] >> b) & 1)) & 0x7F;
+      m.encoderState = reg & 0x3F;
+      bits[ofdmInterleave(i++, codedBits)] = ofdmParity(reg & ofdmPolyA);
+      bits[ofdmInterleave(i++, codedBits)] = ofdmParity(reg & ofdmPolyB);
+    }
+  }
+
+  memset(m.re, 0, sizeof(m.re));
+  memset(m.im, 0, sizeof(m.im));
+  const int axisBits = bitsPerCarrier / 2;
+  const int scale = ofdmAmplitude / ((1 << axisBits) - 1);
+  const uint8_t* p = bits;
+  for (int c = 0; c < ofdmNumCarriers; c++) {
+    if (ofdmIsPilot(c)) {
+      ofdmSetCarrier(m, c, ofdmReference[c] * ofdmAmplitude, 0);
+      continue;
+    }
+    uint8_t iBits = 0, qBits = 0;
+    for (int b = 0; b < axisBits; b++) iBits = (iBits << 1) | *p++;
+    for (int b = 0; b < axisBits; b++) qBits = (qBits << 1) | *p++;
+    ofdmSetCarrier(m, c, ofdmPAMLevel(iBits, axisBits) * scale, ofdmPAMLevel(qBits, axisBits) * scale);
+  }
+  ofdmSynthesize(m, out);
+}
+
+/*******************************************************
+ * FUNCTION: ofdmHeaderSymbol
+ * DESCRIPTION: Builds the QPSK header symbol announcing the payload length
+ * and the constellation of the data symbols.
+ * INPUT: OFDMModulator &m, uint32_t length (Payload bytes, < 16 MB),
+ * int16_t* out (ofdmSymbolSamples samples)
+ * OUTPUT: None
+ *******************************************************/
+void ofdmHeaderSymbol(OFDMModulator &m, uint32_t length, int16_t* out) {
+  uint8_t header[ofdmHeaderBytes];
+  header[0] = ofdmHeaderMagic;
+  header[1] = m.bitsPerCarrier;
+  header[2] = length & 0xFF;
+  header[3] = (length >> 8) & 0xFF;
+  header[4] = (length >> 16) & 0xFF;
+  uint16_t crc = crc16CCITT(header, 5);
+  header[5] = crc & 0xFF;
+  header[6] = crc >> 8;
+  header[7] = 0;                          // flushes the encoder
+  m.encoderState = 0;
+  ofdmCodedSymbol(m, header, 2, out);
+  m.encoderState = 0;                     // payload starts from a clean encoder
+}
+
+/*******************************************************
+ * FUNCTION: ofdmPayloadSymbolCount
+ * DESCRIPTION: Number of data symbols needed for `length` payload bytes
+ * plus CRC32 and at least one zero tail byte.
+ * INPUT: size_t length, int bitsPerCarrier
+ * OUTPUT: int
+ *******************************************************/
+inline int ofdmPayloadSymbolCount(size_t length, int bitsPerCarrier) {
+  const int perSymbol = ofdmBytesPerSymbol(bitsPerCarrier);
+  return (length + 4 + 1 + perSymbol - 1) / perSymbol;
+}
+
+/*******************************************************
+ * FUNCTION: ofdmPayloadChunk
+ * DESCRIPTION: Copies the bytes of data symbol `symbol` from the payload
+ * stream (data, CRC32 little endian, zero padding) into `out`.
+ * INPUT: const uint8_t* data, size_t length, uint32_t crc, int symbol,
+ * int bitsPerCarrier, uint8_t* out
+ * OUTPUT: None
+ *******************************************************/
+void ofdmPayloadChunk(const uint8_t* data, size_t length, uint32_t crc, int symbol, int bitsPerCarrier, uint8_t* out) {
+  const int perSymbol = ofdmBytesPerSymbol(bitsPerCarrier);
+  size_t pos = (size_t)symbol * perSymbol;
+  for (int i = 0; i < perSymbol; i++, pos++) {
+    if (pos < length) out[i] = data[pos];
+    else if (pos < length + 4) out[i] = (crc >> (8 * (pos - length))) & 0xFF;
+    else out[i] = 0;
+  }
+}
+
+/*******************************************************
+ * FUNCTION: ofdmAirtimeMs
+ * DESCRIPTION: On-air duration of a complete frame in milliseconds.
+ * INPUT: size_t length, int bitsPerCarrier
+ * OUTPUT: uint32_t
+ *******************************************************/
+inline uint32_t ofdmAirtimeMs(size_t length, int bitsPerCarrier) {
+  uint32_t symbols = ofdmPreambleSymbols + 1 + ofdmPayloadSymbolCount(length, bitsPerCarrier);
+  return symbols * ofdmSymbolSamples * 1000 / ofdmSampleRate;
+}
+
+#endif
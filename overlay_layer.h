@@ -0,0 +1,220 @@
+#ifndef __OVERLAY_LAYER_H
+#define __OVERLAY_LAYER_H
+
+/*******************************************************
+ * Cached overlay layers.
+ * An overlay (outlined text) is rasterised once into an 8-bit scratch
+ * canvas the size of its bounding box and run-length encoded; the runs
+ * are composited straight into the RGB565 canvas. Each slot's layer is
+ * kept in NVS under a key hash of text, glyph metrics, size, colours and
+ * position, so later wakes composite it without touching the font.
+ * A layer is written to NVS only when the same key is seen on two
+ * consecutive wakes: an overlay that changes every wake (e.g. with the
+ * GPS time) is rasterised each time and never wears the flash.
+ *******************************************************/
+
+#include "fnv1a.h"
+
+// ---------------------- Layer Format ----------------------
+/*******************************************************
+ * CONSTANT: overlayLayerSlots / overlayLayerMaxRuns / overlayLayerVersion
+ * DESCRIPTION: Number of cached overlays, size limit of one layer (runs of
+ * 2 bytes; a larger layer is drawn but not cached) and format version
+ * (part of the key).
+ *******************************************************/
+const int overlayLayerSlots = 2;
+const int overlayLayerMaxRuns = 4096;
+const uint8_t overlayLayerVersion = 1;
+
+/*******************************************************
+ * STRUCT: OverlayLayerHeader
+ * DESCRIPTION: Bounding box on the canvas and the two colours of a layer,
+ * followed in NVS by runCount runs of 2 bytes:
+ * [0] transparent pixels to skip before the run (row-major over the box),
+ * [1] bit 7 = colour (0 outline, 1 text), bits 0-6 = length (0 = skip only).
+ * A run never crosses the end of a box row.
+ *******************************************************/
+struct OverlayLayerHeader {
+  uint32_t key;
+  int16_t x, y;
+  uint16_t width, height;
+  uint16_t colors[2];
+  uint16_t runCount;
+};
+
+/*******************************************************
+ * GLOBAL VARIABLE: overlaySeenKey (RTC memory)
+ * DESCRIPTION: Key of each slot at the previous wake.
+ *******************************************************/
+RTC_DATA_ATTR uint32_t overlaySeenKey[overlayLayerSlots] = { 0 };
+
+// ---------------------- Key ----------------------
+/*******************************************************
+ * FUNCTION: overlayLayerKey
+ * DESCRIPTION: Hash of everything the rasterised overlay depends on,
+ * including the metrics of the glyphs used (a new font means a new key).
+ * INPUT: const char* text, int x, int y, uint8_t textSize, uint16_t color, uint16_t outline_color
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t overlayLayerKey(const char* text, int x, int y, uint8_t textSize, uint16_t color, uint16_t outline_color) {
+  const int32_t params[6] = { overlayLayerVersion, x, y, textSize, color, outline_color };
+  uint32_t h = fnv1a(params, sizeof(params));
+  h = fnv1a(text, strlen(text), h);
+  const GFXfont* font = &FreeSansBold12pt7b;
+  for (const char* c = text; *c; c++) {
+    uint8_t ch = (uint8_t)*c;
+    if (ch >= font->first && ch <= font->last) h = fnv1a(&font->glyph[ch - font->first], sizeof(GFXglyph), h);
+  }
+  return h;
+}
+
+// ---------------------- Rasterise and Encode ----------------------
+/*******************************************************
+ * FUNCTION: overlayLayerBuild
+ * DESCRIPTION: Rasterises an outlined text into a scratch 8-bit canvas of
+ * its bounding box (clipped to the image) and run-length encodes it.
+ * INPUT: const char* text, int x, int y, uint8_t textSize, uint16_t color,
+ * uint16_t outline_color, OverlayLayerHeader &header, uint8_t* runs
+ * OUTPUT: bool (false if the layer is empty, does not fit overlayLayerMaxRuns
+ * or the scratch canvas cannot be allocated)
+ *******************************************************/
+bool overlayLayerBuild(const char* text, int x, int y, uint8_t textSize, uint16_t color, uint16_t outline_color,
+                       OverlayLayerHeader &header, uint8_t* runs) {
+  int16_t bx, by;
+  uint16_t bw, bh;
+  canvas->setFont(&FreeSansBold12pt7b);
+  canvas->setTextSize(textSize);
+  canvas->getTextBounds(text, x, y, &bx, &by, &bw, &bh);
+  int x0 = max(bx - 1, 0), y0 = max(by - 1, 0);
+  int x1 = min(bx + (int)bw + 1, imageWidth), y1 = min(by + (int)bh + 1, imageHeight);
+  if (x1 <= x0 || y1 <= y0) return false;
+
+  GFXcanvas8 scratch(x1 - x0, y1 - y0);
+  uint8_t* pixels = scratch.getBuffer();
+  if (!pixels) return false;
+  drawOutlinedText(scratch, text, x - x0, y - y0, textSize, 2, 1);   // 1 = outline, 2 = text
+
+  header.x = x0;
+  header.y = y0;
+  header.width = x1 - x0;
+  header.height = y1 - y0;
+  header.colors[0] = outline_color;
+  header.colors[1] = color;
+  int count = 0, skip = 0;
+  for (int row = 0; row < header.height; row++) {
+    const uint8_t* p = pixels + row * header.width;
+    for (int col = 0; col < header.width;) {
+      if (p[col] == 0) {
+        skip++;
+        col++;
+        continue;
+      }
+      int length = 1;
+      while (col + length < header.width && p[col + length] == p[col] && length < 127) length++;
+      while (skip > 255) {
+        if (count >= overlayLayerMaxRuns) return false;
+        runs[2 * count] = 255;
+        runs[2 * count + 1] = 0;
+        count++;
+        skip -= 255;
+      }
+      if (count >= overlayLayerMaxRuns) return false;
+      runs[2 * count] = skip;
+      runs[2 * count + 1] = (p[col] == 2 ? 0x80 : 0) | length;
+      count++;
+      skip = 0;
+      col += length;
+    }
+  }
+  header.runCount = count;
+  return count > 0;
+}
+
+/*******************************************************
+ * FUNCTION: overlayLayerComposite
+ * DESCRIPTION: Writes the runs of a layer into the canvas.
+ * INPUT: const OverlayLayerHeader &header, const uint8_t* runs
+ * OUTPUT: None
+ *******************************************************/
+void overlayLayerComposite(const OverlayLayerHeader &header, const uint8_t* runs) {
+  uint16_t* buffer = canvas->getBuffer();
+  uint32_t position = 0;   // Row-major index inside the box
+  for (int i = 0; i < header.runCount; i++) {
+    position += runs[2 * i];
+    int length = runs[2 * i + 1] & 0x7F;
+    if (length == 0) continue;
+    uint16_t color = header.colors[runs[2 * i + 1] >> 7];
+    uint16_t* out = canvasRow(buffer, header.y + position / header.width) + header.x + position % header.width;
+    for (int k = 0; k < length; k++) out[k] = color;
+    position += length;
+  }
+}
+
+// ---------------------- Cache ----------------------
+/*******************************************************
+ * FUNCTION: prepareOverlayLayer
+ * DESCRIPTION: Returns the layer of an overlay, ready to composite: the NVS
+ * layer of its slot if the key matches, otherwise a freshly rasterised one,
+ * cached in NVS if the key was also seen at the previous wake. All the NVS
+ * and font work happens here, so the caller can do it before PTT.
+ * INPUT: int slot, const char* text, int x, int y, uint8_t textSize,
+ * uint16_t color, uint16_t outline_color
+ * OUTPUT: uint8_t* (OverlayLayerHeader followed by its runs, to be freed by
+ * the caller; NULL if the layer cannot be built)
+ *******************************************************/
+uint8_t* prepareOverlayLayer(int slot, const char* text, int x, int y, uint8_t textSize, uint16_t color, uint16_t outline_color) {
+  if (slot < 0 || slot >= overlayLayerSlots) return NULL;
+  uint32_t key = overlayLayerKey(text, x, y, textSize, color, outline_color);
+  char name[8];
+  snprintf(name, sizeof(name), "ovl%d", slot);
+  // Internal RAM while there is some (radio_memory.h): malloc() puts blocks this large in PSRAM
+  uint8_t* blob = (uint8_t*)heap_caps_malloc(sizeof(OverlayLayerHeader) + 2 * overlayLayerMaxRuns, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  if (!blob) blob = (uint8_t*)malloc(sizeof(OverlayLayerHeader) + 2 * overlayLayerMaxRuns);
+  if (!blob) return NULL;
+  OverlayLayerHeader &header = *(OverlayLayerHeader*)blob;
+  uint8_t* runs = blob + sizeof(OverlayLayerHeader);
+
+  Preferences prefs;
+  prefs.begin("sstv", true);
+  size_t len = prefs.getBytes(name, blob, sizeof(OverlayLayerHeader) + 2 * overlayLayerMaxRuns);
+  prefs.end();
+  bool cached = len >= sizeof(OverlayLayerHeader) && header.key == key && len == sizeof(OverlayLayerHeader) + 2 * header.runCount;
+  if (!cached) {
+    if (!overlayLayerBuild(text, x, y, textSize, color, outline_color, header, runs)) {
+      overlaySeenKey[slot] = key;
+      free(blob);
+      return NULL;
+    }
+    header.key = key;
+    if (overlaySeenKey[slot] == key) {
+      prefs.begin("sstv", false);
+      prefs.putBytes(name, blob, sizeof(OverlayLayerHeader) + 2 * header.runCount);
+      prefs.end();
+      Serial.printf("Overlay %d cached (%u runs)\n", slot, header.runCount);
+    }
+  }
+  overlaySeenKey[slot] = key;
+  // Give back the unused run space: the layer may be held through the transmission
+  uint8_t* shrunk = (uint8_t*)realloc(blob, sizeof(OverlayLayerHeader) + 2 * header.runCount);
+  return shrunk ? shrunk : blob;
+}
+
+/*******************************************************
+ * FUNCTION: drawOverlayLayer
+ * DESCRIPTION: Draws an overlay through its cached layer, or directly with
+ * the font if the layer cannot be built.
+ * INPUT: int slot, const char* text, int x, int y, uint8_t textSize,
+ * uint16_t color, uint16_t outline_color
+ * OUTPUT: None
+ *******************************************************/
+void drawOverlayLayer(int slot, const char* text, int x, int y, uint8_t textSize, uint16_t color, uint16_t outline_color) {
+  uint8_t* layer = prepareOverlayLayer(slot, text, x, y, textSize, color, outline_color);
+  if (!layer) {
+    drawOutlinedText(*canvas, text, x, y, textSize, color, outline_color);
+    return;
+  }
+  overlayLayerComposite(*(OverlayLayerHeader*)layer, layer + sizeof(OverlayLayerHeader));
+  free(layer);
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef __PIPELINE_H
+#define __PIPELINE_H
+
+/*******************************************************
+ * Cooperative coroutine pipeline (C++20).
+ * Each stage is a coroutine that loops over bands (line pairs) and
+ * `co_await pipelineYield()`s whenever it has to wait: for its input
+ * band, for room in its output queue, or for the hardware. A tiny
+ * round-robin executor resumes the stages in turn, so work of one stage
+ * fills the waits of another on a single core.
+ * Plain C++ with no Arduino dependency (also used by tools/pipeline_bench.cpp).
+ *******************************************************/
+
+#include <coroutine>
+#include <stdlib.h>
+
+// ---------------------- Coroutine Task ----------------------
+/*******************************************************
+ * STRUCT: PipelineTask
+ * DESCRIPTION: Handle of a pipeline stage coroutine. Created suspended,
+ * resumed only by the PipelineExecutor, destroyed with the handle.
+ *******************************************************/
+struct PipelineTask {
+  struct promise_type {
+    PipelineTask get_return_object() { return PipelineTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { abort(); }
+  };
+
+  explicit PipelineTask(std::coroutine_handle<promise_type> h) : handle(h) {}
+  PipelineTask(PipelineTask &&other) : handle(other.handle) { other.handle = nullptr; }
+  PipelineTask(const PipelineTask &) = delete;
+  ~PipelineTask() { if (handle) handle.destroy(); }
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+/*******************************************************
+ * STRUCT: PipelineYield
+ * DESCRIPTION: Awaitable that always suspends: gives the core back to the
+ * executor until the next round.
+ *******************************************************/
+struct PipelineYield {
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<>) const noexcept {}
+  void await_resume() const noexcept {}
+};
+
+/*******************************************************
+ * FUNCTION: pipelineYield
+ * DESCRIPTION: `co_await pipelineYield();` inside a stage.
+ *******************************************************/
+inline PipelineYield pipelineYield() { return {}; }
+
+// ---------------------- Bounded Band Queue ----------------------
+/*******************************************************
+ * CLASS: BandQueue
+ * DESCRIPTION: Fixed-capacity FIFO of band (or buffer) indices between two
+ * stages. A full queue stalls the producer, an empty one the consumer:
+ *   while (!queue.push(v)) co_await pipelineYield();
+ *******************************************************/
+template <int N>
+class BandQueue {
+public:
+  bool push(int value) {
+    if (count == N) return false;
+    items[(head + count++) % N] = value;
+    return true;
+  }
+  bool pop(int &value) {
+    if (count == 0) return false;
+    value = items[head];
+    head = (head + 1) % N;
+    count--;
+    return true;
+  }
+  bool empty() const { return count == 0; }
+  bool full() const { return count == N; }
+
+private:
+  int items[N];
+  int head = 0;
+  int count = 0;
+};
+
+// ---------------------- Executor ----------------------
+/*******************************************************
+ * CLASS: PipelineExecutor
+ * DESCRIPTION: Round-robin scheduler for up to 8 stages. run() resumes every
+ * unfinished stage in turn until all of them have returned.
+ *******************************************************/
+class PipelineExecutor {
+public:
+  void spawn(PipelineTask &task) {
+    if (count < 8) tasks[count++] = &task;
+  }
+  void run() {
+    for (bool busy = true; busy;) {
+      busy = false;
+      for (int i = 0; i < count; i++) {
+        if (!tasks[i]->handle.done()) {
+          tasks[i]->handle.resume();
+          rounds++;
+          busy = true;
+        }
+      }
+    }
+  }
+  unsigned long rounds = 0;   // Number of stage resumptions (scheduling overhead)
+
+private:
+  PipelineTask* tasks[8];
+  int count = 0;
+};
+
+#endif
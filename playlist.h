@@ -0,0 +1,381 @@
+#ifndef __PLAYLIST_H
+#define __PLAYLIST_H
+
+/*******************************************************
+ * Playlist (slideshow) of transmissions.
+ * PLAYLIST_ENTRIES (see the sketch) lists what goes on air in turn: the
+ * live camera picture, a static station card, or a 2x2 mosaic of recent
+ * pictures, each in its own SSTV mode. At boot the definition is expanded
+ * into a per-slot schedule kept in RTC memory with the position, so a wake
+ * only looks up its slot (with the GPS clock the slot follows from the UTC
+ * time, so the rotation survives a power cycle too).
+ * Static content is rendered once and cached in the "cache" data partition
+ * (partitions_beacon.csv, layout in playlist_format.h): a card is stored as its
+ * tone level schedule and transmitted straight from memory-mapped flash,
+ * without a canvas or any render, and a mosaic decodes only its new tile
+ * (the other three come from flash). Only LIVE entries and the new mosaic
+ * tile cost camera and decode time.
+ *******************************************************/
+
+#include <esp_partition.h>
+#include "playlist_format.h"
+
+/*******************************************************
+ * CONSTANT: playlistSubtype
+ * DESCRIPTION: Data subtype of the cache partition (custom range 0x40-0xFE).
+ *******************************************************/
+const uint8_t playlistSubtype = 0x41;
+
+/*******************************************************
+ * CONSTANT: playlistEntries / playlistCount
+ * DESCRIPTION: The playlist definition (PLAYLIST_ENTRIES in the sketch).
+ *******************************************************/
+const PlaylistEntry playlistEntries[] = PLAYLIST_ENTRIES;
+const int playlistCount = sizeof(playlistEntries) / sizeof(playlistEntries[0]);
+static_assert(playlistCount <= playlistMaxSlots, "PLAYLIST_ENTRIES: too many entries");
+
+/*******************************************************
+ * CONSTANT: cardBackground / cardTitleColor / cardTextColor / cardOutline
+ * DESCRIPTION: Station card colours (the canvas background of generateBaseImage).
+ *******************************************************/
+const uint16_t cardBackground = 0x29ee;
+const uint16_t cardTitleColor = 0xFFE0;   // Yellow
+const uint16_t cardTextColor = 0xFFFF;
+const uint16_t cardOutline = 0x0000;
+
+// ---------------------- RTC State ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: playlistKey / playlistSchedule / playlistSlots (RTC memory)
+ * DESCRIPTION: Definition the schedule was built from, and the schedule
+ * (entry index of each slot).
+ *******************************************************/
+RTC_DATA_ATTR uint32_t playlistKey = 0;
+RTC_DATA_ATTR uint8_t playlistSchedule[playlistMaxSlots];
+RTC_DATA_ATTR int playlistSlots = 0;
+/*******************************************************
+ * GLOBAL VARIABLE: playlistPosition / playlistTileNext (RTC memory)
+ * DESCRIPTION: Slot of this wake, and per entry the mosaic tile the next
+ * picture replaces.
+ *******************************************************/
+RTC_DATA_ATTR int playlistPosition = 0;
+RTC_DATA_ATTR uint8_t playlistTileNext[playlistMaxSlots];
+
+/*******************************************************
+ * GLOBAL VARIABLE: playlistOffsets / playlistPart
+ * DESCRIPTION: Cache area of each entry (recomputed at boot) and the cache
+ * partition (NULL if missing: static content is rendered every time).
+ *******************************************************/
+uint32_t playlistOffsets[playlistCount];
+const esp_partition_t* playlistPart = NULL;
+
+// ---------------------- Schedule ----------------------
+/*******************************************************
+ * FUNCTION: playlistBegin
+ * DESCRIPTION: Rebuilds the schedule if the definition changed (or after a
+ * power-up), lays out the cache and finds this wake's slot.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void playlistBegin() {
+  uint32_t key = playlistDefinitionKey(playlistEntries, playlistCount);
+  if (key != playlistKey || playlistSlots == 0) {
+    playlistSlots = playlistBuildSchedule(playlistEntries, playlistCount, playlistSchedule);
+    memset(playlistTileNext, 0, sizeof(playlistTileNext));
+    playlistPosition = 0;
+    playlistKey = key;
+    Serial.printf("Playlist: %d entries, %d slots\n", playlistCount, playlistSlots);
+  }
+#ifdef GPS
+  // Wakes are on slot boundaries: the UTC slot number gives the position
+  if (gpsClockSetAt != 0) {
+    uint32_t now = (uint32_t)time(NULL);
+    playlistPosition = (now + TX_SLOT_PERIOD / 2) / TX_SLOT_PERIOD % playlistSlots;
+  }
+#endif
+  if (playlistPosition >= playlistSlots) playlistPosition = 0;
+
+  playlistPart = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)playlistSubtype, "cache");
+  if (!playlistPart) {
+    Serial.println("Playlist: no cache partition (see partitions_beacon.csv), static content rendered every time");
+  }
+  uint32_t used = playlistLayout(playlistEntries, playlistCount, playlistPart ? playlistPart->size : 0, playlistOffsets);
+  if (playlistPart) Serial.printf("Playlist: cache uses %lu of %lu bytes\n", (unsigned long)used, (unsigned long)playlistPart->size);
+}
+
+// ---------------------- Cache Areas ----------------------
+/*******************************************************
+ * FUNCTION: playlistReadHeader
+ * DESCRIPTION: Reads the header of a cache area and checks it.
+ * INPUT: uint32_t offset, uint32_t key, uint32_t maxLength
+ * OUTPUT: uint32_t (Content length, 0 if the area is not valid)
+ *******************************************************/
+uint32_t playlistReadHeader(uint32_t offset, uint32_t key, uint32_t maxLength) {
+  PlaylistCacheHeader h;
+  if (!playlistPart || offset == playlistNoArea) return 0;
+  if (esp_partition_read(playlistPart, offset, &h, sizeof(h)) != ESP_OK) return 0;
+  return playlistHeaderValid(h, key, maxLength) ? h.length : 0;
+}
+
+/*******************************************************
+ * FUNCTION: playlistWriteArea
+ * DESCRIPTION: Erases the sectors a content needs, writes it after the
+ * header space and the header last (a cut-short write stays invalid).
+ * INPUT: uint32_t offset, uint32_t key, const void* data, uint32_t length
+ * OUTPUT: bool
+ *******************************************************/
+bool playlistWriteArea(uint32_t offset, uint32_t key, const void* data, uint32_t length) {
+  if (!playlistPart || offset == playlistNoArea) return false;
+  uint32_t span = (sizeof(PlaylistCacheHeader) + length + playlistSectorSize - 1) / playlistSectorSize * playlistSectorSize;
+  PlaylistCacheHeader h;
+  playlistSealHeader(h, key, length);
+  if (esp_partition_erase_range(playlistPart, offset, span) != ESP_OK ||
+      esp_partition_write(playlistPart, offset + sizeof(h), data, length) != ESP_OK ||
+      esp_partition_write(playlistPart, offset, &h, sizeof(h)) != ESP_OK) {
+    Serial.println("Playlist: cache write failed");
+    return false;
+  }
+  return true;
+}
+
+// ---------------------- Station Card ----------------------
+/*******************************************************
+ * FUNCTION: playlistRenderCard
+ * DESCRIPTION: Draws a card on the canvas: background, colour bar, the
+ * first text line large and the others below it, all centred.
+ * INPUT: const char* text (lines separated by '\n')
+ * OUTPUT: None
+ *******************************************************/
+void playlistRenderCard(const char* text) {
+  canvas->fillScreen(cardBackground);
+  draw64ColorBar(canvas, 0, 480);
+  if (!text) return;
+
+  char line[64];
+  int y = 150;
+  for (int n = 0; *text; n++) {
+    size_t length = strcspn(text, "\n");
+    size_t copy = length < sizeof(line) - 1 ? length : sizeof(line) - 1;
+    memcpy(line, text, copy);
+    line[copy] = 0;
+    text += length + (text[length] == '\n');
+
+    uint8_t size = n == 0 ? 2 : 1;
+    int16_t x1, y1;
+    uint16_t w, h;
+    canvas->setFont(&FreeSansBold12pt7b);
+    canvas->setTextSize(size);
+    canvas->getTextBounds(line, 0, 0, &x1, &y1, &w, &h);
+    drawOutlinedText(*canvas, line, (imageWidth - (int)w) / 2 - x1, y, size,
+                     n == 0 ? cardTitleColor : cardTextColor, cardOutline);
+    y += n == 0 ? 80 : 40;
+  }
+}
+
+/*******************************************************
+ * FUNCTION: playlistCacheCard
+ * DESCRIPTION: Renders a text card and writes its tone level schedule to
+ * the entry's cache area, one schedule line at a time. The canvas is
+ * freed afterwards.
+ * INPUT: int entry, uint32_t key
+ * OUTPUT: bool
+ *******************************************************/
+bool playlistCacheCard(int entry, uint32_t key) {
+  const PlaylistEntry &e = playlistEntries[entry];
+  SSTVMode mode = playlistCanvasMode(e.mode);
+  uint32_t offset = playlistOffsets[entry];
+  int width, lines;
+  scheduleGeometry(mode, width, lines);
+  uint32_t length = (uint32_t)width * lines;
+  uint8_t* levels = (uint8_t*)heap_caps_malloc(width, MALLOC_CAP_INTERNAL);
+  if (!levels) return false;
+
+  uint32_t start = millis();
+  generateBaseImage();
+  playlistRenderCard(e.text);
+  bool ok = esp_partition_erase_range(playlistPart, offset, playlistAreaBytes(e)) == ESP_OK;
+  for (int line = 0; line < lines && ok; line++) {
+    renderScheduleLine(canvas->getBuffer(), mode, line, levels);
+    ok = esp_partition_write(playlistPart, offset + sizeof(PlaylistCacheHeader) + line * width, levels, width) == ESP_OK;
+  }
+  PlaylistCacheHeader h;
+  playlistSealHeader(h, key, length);
+  ok = ok && esp_partition_write(playlistPart, offset, &h, sizeof(h)) == ESP_OK;
+  free(levels);
+  free(canvas->getBuffer());
+  canvas = NULL;
+  Serial.printf("Playlist: card %d %s (%lu bytes, %lu ms)\n", entry, ok ? "cached" : "cache write failed",
+                (unsigned long)length, (unsigned long)(millis() - start));
+  return ok;
+}
+
+/*******************************************************
+ * FUNCTION: playlistSendCard
+ * DESCRIPTION: Transmits a card straight from its cached schedule, mapped
+ * into the address space: no canvas, no render. A text card missing from
+ * the cache is cached first.
+ * INPUT: int entry
+ * OUTPUT: bool (false if the card is not in the cache: render it instead)
+ *******************************************************/
+bool playlistSendCard(int entry) {
+  const PlaylistEntry &e = playlistEntries[entry];
+  uint32_t offset = playlistOffsets[entry];
+  if (!playlistPart || offset == playlistNoArea) return false;
+  uint32_t key = playlistCardKey(e.text, e.mode);
+  if (e.text) key = fnv1a(colourMatrix565, sizeof(colourMatrix565), key);   // Rendered with this unit's correction
+  uint32_t length = playlistScheduleBytes(e.mode);
+  if (playlistReadHeader(offset, key, length) != length) {
+    if (!e.text) {
+      Serial.println("Playlist: no picture flashed for this card (see tools/playlist_plan.cpp)");
+      return false;
+    }
+    if (!playlistCacheCard(entry, key)) return false;
+  }
+
+  const void* mapped = NULL;
+  spi_flash_mmap_handle_t handle;
+  if (esp_partition_mmap(playlistPart, offset + sizeof(PlaylistCacheHeader), length, ESP_PARTITION_MMAP_DATA,
+                         &mapped, &handle) != ESP_OK) {
+    Serial.println("Playlist: cache mapping failed");
+    return false;
+  }
+  Serial.printf("Playlist: card %d from flash\n", entry);
+  cycleTimes.captureMs = cycleTimes.decodeMs = 0;
+  uint32_t stageStart = millis();
+#ifdef APRS_TELEMETRY
+  buildTelemetryPacket();
+#endif
+  prepareTelemetryStripe();
+  cycleTimes.composeMs = millis() - stageStart;
+
+  mappedSchedule = (const uint8_t*)mapped;
+  transmitComposedFrame(NULL, 0);
+  mappedSchedule = NULL;
+  spi_flash_munmap(handle);
+  delay(1000);
+  return true;
+}
+
+// ---------------------- Mosaic ----------------------
+/*******************************************************
+ * FUNCTION: playlistTileKey
+ * DESCRIPTION: Key of a mosaic tile (a new playlist drops the old tiles).
+ * INPUT: int tile
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t playlistTileKey(int tile) {
+  const uint32_t fields[3] = { playlistCacheVersion, playlistKey, (uint32_t)tile };
+  return fnv1a(fields, sizeof(fields));
+}
+
+/*******************************************************
+ * FUNCTION: playlistComposeMosaic
+ * DESCRIPTION: Takes a picture at half scale into the next tile (cached),
+ * and puts the four tiles on the canvas, the others read from the cache
+ * (a tile never filled stays background).
+ * INPUT: int entry
+ * OUTPUT: bool (false if the camera failed)
+ *******************************************************/
+bool playlistComposeMosaic(int entry) {
+  const uint32_t tileLength = mosaicTileWidth * mosaicTileHeight * sizeof(uint16_t);
+  uint32_t base = playlistOffsets[entry];
+  int next = playlistTileNext[entry] % mosaicTiles;
+  uint16_t* buffer = canvas->getBuffer();
+
+  uint32_t stageStart = millis();
+  camera_fb_t* fb = captureFrame();
+  cycleTimes.captureMs = millis() - stageStart;
+  stageStart = millis();
+  bool fresh = false;
+  uint16_t* tile = (uint16_t*)heap_caps_malloc(tileLength, MALLOC_CAP_SPIRAM);
+  if (fb && tile && fb->width == 2 * mosaicTileWidth && fb->height == 2 * mosaicTileHeight) {
+    fresh = jpg2rgb565(fb->buf, fb->len, (uint8_t*)tile, JPG_SCALE_2X);
+  }
+  if (fb) esp_camera_fb_return(fb);
+#if CAMERA_ROTATION
+  if (fresh) {
+    uint16_t* rotated = (uint16_t*)heap_caps_malloc(tileLength, MALLOC_CAP_SPIRAM);
+    fresh = rotated && rotateCameraPicture(tile, mosaicTileWidth, mosaicTileHeight, rotated, mosaicTileWidth,
+                                           mosaicTileWidth, mosaicTileHeight);
+    free(tile);
+    tile = rotated;
+  }
+#endif
+
+  if (fresh) {
+    // Little-endian RGB565 as decoded, the canvas layout
+    for (int y = 0; y < mosaicTileHeight; y++) {
+      memcpy(canvasRow(buffer, y + (next / 2) * mosaicTileHeight) + (next % 2) * mosaicTileWidth,
+             tile + y * mosaicTileWidth, mosaicTileWidth * sizeof(uint16_t));
+    }
+    if (base != playlistNoArea) playlistWriteArea(base + next * playlistTileBytes, playlistTileKey(next), tile, tileLength);
+    playlistTileNext[entry] = (next + 1) % mosaicTiles;
+  } else {
+    Serial.println("Playlist: mosaic picture failed");
+    cycleTimes.frameSkipped = true;
+  }
+  free(tile);
+
+  for (int t = 0; t < mosaicTiles; t++) {
+    if (fresh && t == next) continue;
+    uint32_t offset = base == playlistNoArea ? playlistNoArea : base + t * playlistTileBytes;
+    if (playlistReadHeader(offset, playlistTileKey(t), tileLength) != tileLength) continue;
+    offset += sizeof(PlaylistCacheHeader);
+    for (int y = 0; y < mosaicTileHeight; y++, offset += mosaicTileWidth * sizeof(uint16_t)) {
+      uint16_t* row = canvasRow(buffer, y + (t / 2) * mosaicTileHeight) + (t % 2) * mosaicTileWidth;
+      if (esp_partition_read(playlistPart, offset, row, mosaicTileWidth * sizeof(uint16_t)) != ESP_OK) break;
+    }
+  }
+  cycleTimes.decodeMs = millis() - stageStart;
+  return fresh;
+}
+
+// ---------------------- Wake ----------------------
+/*******************************************************
+ * FUNCTION: playlistRun
+ * DESCRIPTION: Transmits the entry of this wake's slot in its mode, then
+ * advances the position. Cards and mosaics are canvas pictures: in
+ * MODE_OFDM (camera JPEG only) they are sent in PD120. A card that cannot
+ * be played from the cache is rendered on the canvas.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void playlistRun() {
+  int entry = playlistSchedule[playlistPosition];
+  const PlaylistEntry &e = playlistEntries[entry];
+  playlistPosition = (playlistPosition + 1) % playlistSlots;
+  sstvMode = (SSTVMode)e.mode;
+  Serial.printf("Playlist: slot %d, entry %d\n", (playlistPosition + playlistSlots - 1) % playlistSlots, entry);
+
+  if (e.kind == PLAYLIST_LIVE) {
+    takeAndTransmitImageViaSSTV();
+    return;
+  }
+  sstvMode = playlistCanvasMode(e.mode);
+  if (e.kind == PLAYLIST_CARD && playlistSendCard(entry)) return;
+
+  generateBaseImage();
+  if (e.kind == PLAYLIST_CARD) {
+    uint32_t stageStart = millis();
+    playlistRenderCard(e.text);
+    cycleTimes.decodeMs = millis() - stageStart;
+  } else {
+    playlistComposeMosaic(entry);
+  }
+
+  uint32_t stageStart = millis();
+  if (e.kind == PLAYLIST_MOSAIC) {
+    addOverlayText(0, TEXT_TOP, TEXT_TOP_X, TEXT_TOP_Y, TEXT_TOP_SIZE, OVERLAY_COLOR_TOP, OUTLINE_TOP);
+    addOverlayText(1, TEXT_BOTTOM, TEXT_BTM_X, TEXT_BTM_Y, TEXT_BTM_SIZE, OVERLAY_COLOR_BTM, OUTLINE_BTM);
+  }
+#ifdef APRS_TELEMETRY
+  buildTelemetryPacket();
+#endif
+  prepareTelemetryStripe();
+  cycleTimes.composeMs = millis() - stageStart;
+
+  transmitComposedFrame(NULL, 0);
+  free(canvas->getBuffer());
+  delay(1000);
+}
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef __PLAYLIST_FORMAT_H
+#define __PLAYLIST_FORMAT_H
+
+/*******************************************************
+ * Playlist definition, schedule and render cache layout.
+ * A playlist is a list of entries (live camera, static card, 2x2 mosaic
+ * of recent frames), each with its SSTV mode and a repeat count. It is
+ * expanded once into a per-slot schedule (one entry index per
+ * transmission) so a wake only looks up its slot. The static part of each
+ * entry has a fixed area in the "cache" flash partition: a card as the
+ * tone level schedule of its mode (sstv_render.h, played from memory-mapped
+ * flash), a mosaic as four raw RGB565 tiles. Each area starts with a
+ * PlaylistCacheHeader written last, so a write cut short leaves it invalid.
+ * Plain C++ with no Arduino dependency (also used by tools/playlist_plan.cpp).
+ *******************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "fnv1a.h"
+#include "sstv_render.h"
+
+// ---------------------- Definition ----------------------
+/*******************************************************
+ * ENUM: PlaylistKind
+ * DESCRIPTION: Content of an entry. LIVE: camera picture and overlays;
+ * CARD: static text card (text lines separated by '\n', the first one
+ * large), or with no text a picture flashed into its cache area with
+ * tools/playlist_plan.cpp; MOSAIC: the last four camera pictures at half size, one new
+ * per transmission.
+ *******************************************************/
+enum PlaylistKind { PLAYLIST_LIVE, PLAYLIST_CARD, PLAYLIST_MOSAIC };
+
+/*******************************************************
+ * STRUCT: PlaylistEntry
+ * DESCRIPTION: One playlist entry: kind, SSTV mode (SSTVMode), consecutive
+ * transmissions (slots) it gets, and its text (CARD only).
+ *******************************************************/
+struct PlaylistEntry {
+  uint8_t kind;
+  uint8_t mode;
+  uint8_t repeat;
+  const char* text;
+};
+
+/*******************************************************
+ * CONSTANT: playlistMaxSlots
+ * DESCRIPTION: Longest schedule (sum of the repeat counts); longer
+ * playlists are cut.
+ *******************************************************/
+const int playlistMaxSlots = 64;
+
+/*******************************************************
+ * FUNCTION: playlistDefinitionKey
+ * DESCRIPTION: Hash of a playlist definition (a new one restarts the
+ * schedule).
+ * INPUT: const PlaylistEntry* entries, int count
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t playlistDefinitionKey(const PlaylistEntry* entries, int count) {
+  uint32_t h = fnv1a(&count, sizeof(count));
+  for (int i = 0; i < count; i++) {
+    const uint8_t fields[3] = { entries[i].kind, entries[i].mode, entries[i].repeat };
+    h = fnv1a(fields, sizeof(fields), h);
+    if (entries[i].text) h = fnv1a(entries[i].text, strlen(entries[i].text) + 1, h);
+  }
+  return h;
+}
+
+/*******************************************************
+ * FUNCTION: playlistBuildSchedule
+ * DESCRIPTION: Expands the entries into one entry index per slot (an entry
+ * with repeat 0 counts as 1).
+ * INPUT: const PlaylistEntry* entries, int count, uint8_t* schedule (playlistMaxSlots)
+ * OUTPUT: int (Number of slots)
+ *******************************************************/
+int playlistBuildSchedule(const PlaylistEntry* entries, int count, uint8_t* schedule) {
+  int slots = 0;
+  for (int i = 0; i < count; i++) {
+    int repeat = entries[i].repeat ? entries[i].repeat : 1;
+    for (int r = 0; r < repeat && slots < playlistMaxSlots; r++) schedule[slots++] = i;
+  }
+  return slots;
+}
+
+// ---------------------- Cache Layout ----------------------
+/*******************************************************
+ * CONSTANT: playlistSectorSize / playlistCacheMagic / playlistCacheVersion
+ * DESCRIPTION: Flash erase unit; area header magic ("SPLC") and layout
+ * version (part of every key).
+ *******************************************************/
+const uint32_t playlistSectorSize = 4096;
+const uint32_t playlistCacheMagic = 0x434C5053;
+const uint32_t playlistCacheVersion = 2;
+
+/*******************************************************
+ * CONSTANT: mosaicTiles / mosaicTileWidth / mosaicTileHeight
+ * DESCRIPTION: 2x2 mosaic of camera pictures decoded at half scale.
+ *******************************************************/
+const int mosaicTiles = 4;
+const int mosaicTileWidth = 320;
+const int mosaicTileHeight = 240;
+
+/*******************************************************
+ * STRUCT: PlaylistCacheHeader
+ * DESCRIPTION: Start of a cache area (a card, or one mosaic tile), followed
+ * by length bytes of content. crc covers the fields before it.
+ *******************************************************/
+struct PlaylistCacheHeader {
+  uint32_t magic;
+  uint32_t key;      // What the content was made from
+  uint32_t length;
+  uint16_t crc;
+  uint16_t reserved;
+};
+
+/*******************************************************
+ * CONSTANT: playlistTileBytes
+ * DESCRIPTION: Area of one mosaic tile (header and pixels), in whole sectors.
+ *******************************************************/
+const uint32_t playlistTileBytes = (sizeof(PlaylistCacheHeader) + mosaicTileWidth * mosaicTileHeight * 2 +
+                                    playlistSectorSize - 1) / playlistSectorSize * playlistSectorSize;
+
+/*******************************************************
+ * FUNCTION: playlistCanvasMode
+ * DESCRIPTION: Mode a card or mosaic goes on air in: MODE_OFDM sends only
+ * camera JPEGs, so they use PD120.
+ * INPUT: uint8_t mode
+ * OUTPUT: SSTVMode
+ *******************************************************/
+SSTVMode playlistCanvasMode(uint8_t mode) {
+  return mode == MODE_OFDM ? MODE_PD120 : (SSTVMode)mode;
+}
+
+/*******************************************************
+ * FUNCTION: playlistScheduleBytes
+ * DESCRIPTION: Size of the tone level schedule of a card.
+ * INPUT: uint8_t mode
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t playlistScheduleBytes(uint8_t mode) {
+  int width, lines;
+  scheduleGeometry(playlistCanvasMode(mode), width, lines);
+  return (uint32_t)width * lines;
+}
+
+/*******************************************************
+ * FUNCTION: playlistAreaBytes
+ * DESCRIPTION: Cache space an entry needs in whole sectors (0 for LIVE).
+ * INPUT: const PlaylistEntry &entry
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t playlistAreaBytes(const PlaylistEntry &entry) {
+  if (entry.kind == PLAYLIST_CARD) {
+    return (sizeof(PlaylistCacheHeader) + playlistScheduleBytes(entry.mode) + playlistSectorSize - 1) /
+           playlistSectorSize * playlistSectorSize;
+  }
+  if (entry.kind == PLAYLIST_MOSAIC) return mosaicTiles * playlistTileBytes;
+  return 0;
+}
+
+/*******************************************************
+ * FUNCTION: playlistCardKey
+ * DESCRIPTION: Key of a card schedule: its text (NULL for a flashed
+ * picture), mode, canvas size and the cache version (bump it when the card
+ * layout or colours change). The beacon also mixes in its colour
+ * correction for text cards.
+ * INPUT: const char* text, uint8_t mode
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t playlistCardKey(const char* text, uint8_t mode) {
+  const uint32_t fields[4] = { playlistCacheVersion, (uint32_t)playlistCanvasMode(mode),
+                               (uint32_t)imageWidth, (uint32_t)imageHeight };
+  uint32_t h = fnv1a(fields, sizeof(fields));
+  return text ? fnv1a(text, strlen(text) + 1, h) : h;
+}
+
+/*******************************************************
+ * CONSTANT: playlistNoArea
+ * DESCRIPTION: Offset of an entry without a cache area.
+ *******************************************************/
+const uint32_t playlistNoArea = 0xFFFFFFFF;
+
+/*******************************************************
+ * FUNCTION: playlistLayout
+ * DESCRIPTION: Places the entry areas one after the other in the
+ * partition; entries that do not fit get playlistNoArea.
+ * INPUT: const PlaylistEntry* entries, int count, uint32_t partitionSize, uint32_t* offsets
+ * OUTPUT: uint32_t (Bytes used)
+ *******************************************************/
+uint32_t playlistLayout(const PlaylistEntry* entries, int count, uint32_t partitionSize, uint32_t* offsets) {
+  uint32_t used = 0;
+  for (int i = 0; i < count; i++) {
+    uint32_t bytes = playlistAreaBytes(entries[i]);
+    if (bytes == 0 || used + bytes > partitionSize) {
+      offsets[i] = playlistNoArea;
+      continue;
+    }
+    offsets[i] = used;
+    used += bytes;
+  }
+  return used;
+}
+
+/*******************************************************
+ * FUNCTION: playlistSealHeader / playlistHeaderValid
+ * DESCRIPTION: Fill in and check an area header.
+ * INPUT: PlaylistCacheHeader &h, uint32_t key, uint32_t length / const PlaylistCacheHeader &h, uint32_t key, uint32_t maxLength
+ * OUTPUT: None / bool
+ *******************************************************/
+void playlistSealHeader(PlaylistCacheHeader &h, uint32_t key, uint32_t length) {
+  h.magic = playlistCacheMagic;
+  h.key = key;
+  h.length = length;
+  h.reserved = 0;
+  h.crc = (uint16_t)fnv1a(&h, offsetof(PlaylistCacheHeader, crc));
+}
+
+bool playlistHeaderValid(const PlaylistCacheHeader &h, uint32_t key, uint32_t maxLength) {
+  return h.magic == playlistCacheMagic && h.key == key && h.length <= maxLength &&
+         h.crc == (uint16_t)fnv1a(&h, offsetof(PlaylistCacheHeader, crc));
+}
+
+#endif
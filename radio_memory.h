@@ -0,0 +1,52 @@
+#ifndef __RADIO_MEMORY_H
+#define __RADIO_MEMORY_H
+
+/*******************************************************
+ * Radio stack memory (RADIO_MEMORY_RELEASE).
+ * The beacon never starts Bluetooth or Wi-Fi, but the BT controller keeps
+ * its DRAM region reserved and the Bluedroid host its .bss and .data. They
+ * are handed to the heap at boot, as internal RAM, where they take the
+ * buffers the transmitter reads while a picture is on air: the line pair
+ * the pixel callback converts (pairStage, sstv_pd120.h) and the overlay
+ * layer being composited (overlay_layer.h). Both fall back to PSRAM
+ * when internal RAM runs short.
+ * The Arduino core releases the controller region alone when btInUse() is
+ * false, after which the host memory can no longer be released, so the
+ * sketch overrides btInUse() and everything is released here. Wi-Fi
+ * allocates its buffers in esp_wifi_init(), which is never called: there
+ * is nothing of it to release.
+ *******************************************************/
+
+#ifdef CONFIG_BT_ENABLED
+#include <esp_bt.h>
+#endif
+
+/*******************************************************
+ * GLOBAL VARIABLE: radioMemoryGained
+ * DESCRIPTION: Internal heap gained by radioMemoryRelease() (bytes).
+ *******************************************************/
+size_t radioMemoryGained = 0;
+
+/*******************************************************
+ * FUNCTION: radioMemoryRelease
+ * DESCRIPTION: Releases the BT controller and host memory to the heap
+ * (once per boot) and reports the internal heap gained.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void radioMemoryRelease() {
+  size_t before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+#ifdef CONFIG_BT_ENABLED
+  esp_err_t err = esp_bt_mem_release(ESP_BT_MODE_BTDM);
+  if (err != ESP_OK) {
+    Serial.printf("Radio memory: not released (error %d)\n", err);
+    return;
+  }
+#endif
+  size_t after = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+  radioMemoryGained = after > before ? after - before : 0;
+  Serial.printf("Radio memory: +%u bytes of internal heap (%u free, largest block %u)\n", (unsigned)radioMemoryGained,
+                (unsigned)after, (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef __SA818_H
+#define __SA818_H
+
+/*******************************************************
+ * SA818 transceiver control.
+ * The module is held in power-down (PD low) through Deep Sleep and woken
+ * at the start of each wake; it keeps its settings while powered down.
+ * The AT configuration (sa818_protocol.h) is sent only when a command
+ * differs from the one last accepted, whose hash is kept in RTC memory:
+ * after the first wake, nothing is sent and the module is ready as soon
+ * as it has woken up.
+ *******************************************************/
+
+#include "sa818_protocol.h"
+
+#ifndef SA818_WAKE_MS
+#define SA818_WAKE_MS 500
+#endif
+
+/*******************************************************
+ * CONSTANT: sa818Config
+ * DESCRIPTION: Settings from the sketch (simplex on SA818_FREQUENCY).
+ *******************************************************/
+const SA818Config sa818Config = { SA818_FREQUENCY, SA818_FREQUENCY, SA818_BANDWIDTH,
+                                  SA818_CTCSS, SA818_CTCSS, SA818_SQUELCH, SA818_VOLUME };
+
+/*******************************************************
+ * GLOBAL VARIABLE: sa818Applied (RTC memory)
+ * DESCRIPTION: Hash of the last command of each kind the module accepted
+ * (0 = not sent since power-up).
+ *******************************************************/
+RTC_DATA_ATTR uint32_t sa818Applied[SA818_CMD_COUNT] = { 0 };
+
+/*******************************************************
+ * GLOBAL VARIABLE: sa818Serial / sa818WakeAt
+ * DESCRIPTION: Module UART; millis() when PD was raised.
+ *******************************************************/
+HardwareSerial sa818Serial(2);
+uint32_t sa818WakeAt = 0;
+
+/*******************************************************
+ * FUNCTION: sa818WaitReady
+ * DESCRIPTION: Waits until SA818_WAKE_MS have passed since the module was
+ * woken (usually already true: camera setup and capture take longer).
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void sa818WaitReady() {
+  while (millis() - sa818WakeAt < SA818_WAKE_MS) delay(1);
+}
+
+/*******************************************************
+ * STRUCT: SA818Link
+ * DESCRIPTION: sa818Apply() link over sa818Serial. Without SA818_RX_PIN
+ * (-1) the replies cannot be read and a fixed delay is used instead.
+ *******************************************************/
+struct SA818Link {
+  void wake() {
+    sa818Serial.begin(9600, SERIAL_8N1, SA818_RX_PIN, SA818_TX_PIN);
+    sa818Serial.setTimeout(300);
+    sa818WaitReady();
+  }
+
+  bool transact(const char* line, const char* expectedReply) {
+    for (int attempt = 0; attempt < 3; attempt++) {
+      while (sa818Serial.available() > 0) sa818Serial.read();
+      sa818Serial.print(line);
+#if SA818_RX_PIN < 0
+      delay(100);
+      return true;
+#else
+      char reply[32];
+      size_t n = sa818Serial.readBytesUntil('\n', reply, sizeof(reply) - 1);
+      reply[n] = '\0';
+      if (strncmp(reply, expectedReply, strlen(expectedReply)) == 0) return true;
+      Serial.printf("SA818: unexpected reply '%s' to %s", reply, line);
+#endif
+    }
+    return false;
+  }
+};
+
+/*******************************************************
+ * FUNCTION: sa818Begin
+ * DESCRIPTION: Wakes the module and sends the configuration commands that
+ * changed since they were last accepted.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void sa818Begin() {
+  rtc_gpio_hold_dis((gpio_num_t)SA818_PD_PIN);
+  pinMode(SA818_PD_PIN, OUTPUT);
+  digitalWrite(SA818_PD_PIN, HIGH);
+  sa818WakeAt = millis();
+
+  SA818Link link;
+  int sent = sa818Apply(link, sa818Config, sa818Applied);
+  if (sent < 0) {
+    Serial.println("SA818: configuration failed, retrying next wake");
+  } else if (sent == 0) {
+    Serial.println("SA818: configuration unchanged, nothing sent");
+  } else {
+    Serial.printf("SA818: %d command(s) sent\n", sent);
+  }
+  sa818Serial.end();
+}
+
+/*******************************************************
+ * FUNCTION: sa818Sleep
+ * DESCRIPTION: Puts the module in power-down and holds PD low through
+ * Deep Sleep.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void sa818Sleep() {
+  digitalWrite(SA818_PD_PIN, LOW);
+  rtc_gpio_hold_en((gpio_num_t)SA818_PD_PIN);
+}
+
+#endif
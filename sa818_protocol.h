@@ -0,0 +1,104 @@
+#ifndef __SA818_PROTOCOL_H
+#define __SA818_PROTOCOL_H
+
+/*******************************************************
+ * SA818 AT command protocol.
+ * Formats the configuration commands, checks the replies, and applies a
+ * configuration over any serial link, skipping every command whose exact
+ * text was already accepted by the module (hash kept by the caller, in
+ * RTC memory on the beacon).
+ * Plain C++ with no Arduino dependency (also used by tools/sa818_emulator.cpp).
+ *******************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "fnv1a.h"
+
+/*******************************************************
+ * STRUCT: SA818Config
+ * DESCRIPTION: Radio settings. Frequencies in Hz; CTCSS as tone index
+ * (0 = none, 1-38); bandwidth 0 = 12.5 kHz, 1 = 25 kHz; squelch 0-8;
+ * volume 1-8.
+ *******************************************************/
+struct SA818Config {
+  uint32_t txHz;
+  uint32_t rxHz;
+  uint8_t bandwidth;
+  uint8_t txCtcss;
+  uint8_t rxCtcss;
+  uint8_t squelch;
+  uint8_t volume;
+};
+
+/*******************************************************
+ * ENUM: SA818Command
+ * DESCRIPTION: Configuration commands, in the order they are sent.
+ *******************************************************/
+enum SA818Command { SA818_CMD_GROUP, SA818_CMD_VOLUME, SA818_CMD_COUNT };
+
+/*******************************************************
+ * CONSTANT: sa818Handshake / sa818Replies
+ * DESCRIPTION: Connection check and the successful reply of each command.
+ *******************************************************/
+const char* const sa818Handshake = "AT+DMOCONNECT\r\n";
+const char* const sa818HandshakeReply = "+DMOCONNECT:0";
+const char* const sa818Replies[SA818_CMD_COUNT] = { "+DMOSETGROUP:0", "+DMOSETVOLUME:0" };
+
+/*******************************************************
+ * FUNCTION: sa818Format
+ * DESCRIPTION: Text of one configuration command, CR LF included.
+ * INPUT: const SA818Config &cfg, int command, char* out, size_t size
+ * OUTPUT: None
+ *******************************************************/
+void sa818Format(const SA818Config &cfg, int command, char* out, size_t size) {
+  if (command == SA818_CMD_GROUP) {
+    snprintf(out, size, "AT+DMOSETGROUP=%u,%lu.%04lu,%lu.%04lu,%04u,%u,%04u\r\n", cfg.bandwidth,
+             (unsigned long)(cfg.txHz / 1000000), (unsigned long)(cfg.txHz % 1000000 / 100),
+             (unsigned long)(cfg.rxHz / 1000000), (unsigned long)(cfg.rxHz % 1000000 / 100),
+             cfg.txCtcss, cfg.squelch, cfg.rxCtcss);
+  } else {
+    snprintf(out, size, "AT+DMOSETVOLUME=%u\r\n", cfg.volume);
+  }
+}
+
+/*******************************************************
+ * FUNCTION: sa818Hash
+ * DESCRIPTION: FNV-1a hash of a command (never 0, which means "not sent").
+ * INPUT: const char* text
+ * OUTPUT: uint32_t
+ *******************************************************/
+uint32_t sa818Hash(const char* text) {
+  uint32_t h = fnv1a(text, strlen(text));
+  return h ? h : 1;
+}
+
+/*******************************************************
+ * FUNCTION: sa818Apply
+ * DESCRIPTION: Sends the commands whose text differs from the one last
+ * accepted (applied[], updated on success). The link needs
+ * bool transact(const char* line, const char* expectedReply) and
+ * void wake() (called once, before the first command actually sent).
+ * INPUT: Link &link, const SA818Config &cfg, uint32_t* applied
+ * OUTPUT: int (commands sent, -1 if the module did not accept one)
+ *******************************************************/
+template <class Link>
+int sa818Apply(Link &link, const SA818Config &cfg, uint32_t* applied) {
+  char line[64];
+  int sent = 0;
+  for (int c = 0; c < SA818_CMD_COUNT; c++) {
+    sa818Format(cfg, c, line, sizeof(line));
+    uint32_t h = sa818Hash(line);
+    if (applied[c] == h) continue;
+    if (sent == 0) {
+      link.wake();
+      if (!link.transact(sa818Handshake, sa818HandshakeReply)) return -1;
+    }
+    sent++;
+    if (!link.transact(line, sa818Replies[c])) return -1;
+    applied[c] = h;
+  }
+  return sent;
+}
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef __SAMPLE_ENGINE_H
+#define __SAMPLE_ENGINE_H
+
+/*******************************************************
+ * Sample engine: turns the LEDC output on SPEAKER_OUTPUT into a
+ * 10-bit PWM DAC (78.125 kHz carrier, filtered by the radio's audio
+ * input) updated at a fixed sample rate from a hardware timer ISR.
+ * Producers push 16-bit samples into a ring buffer; the ISR pops one
+ * sample per tick. Used by waveforms that cannot be expressed as a
+ * sequence of square-wave tones (OFDM) or that need phase-continuous
+ * frequency changes (AFSK), through the NCO below.
+ *******************************************************/
+
+// ---------------------- Sample Engine Parameters ----------------------
+/*******************************************************
+ * CONSTANT: sampleEngineRate
+ * DESCRIPTION: Output sample rate in Hz.
+ *******************************************************/
+const uint32_t sampleEngineRate = 8000;
+/*******************************************************
+ * CONSTANT: sampleRingSize
+ * DESCRIPTION: Ring buffer length in samples (power of two, 256 ms at 8 kHz).
+ *******************************************************/
+const uint32_t sampleRingSize = 2048;
+/*******************************************************
+ * CONSTANT: sampleDutyBits
+ * DESCRIPTION: PWM resolution. 80 MHz / 2^10 = 78.125 kHz carrier.
+ *******************************************************/
+const int sampleDutyBits = 10;
+
+// ---------------------- Sample Engine State ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: sampleRing
+ * DESCRIPTION: Duty values waiting to be played (internal RAM).
+ *******************************************************/
+uint16_t sampleRing[sampleRingSize];
+/*******************************************************
+ * GLOBAL VARIABLE: sampleHead / sampleTail (volatile)
+ * DESCRIPTION: Free-running write (producer) and read (ISR) counters.
+ *******************************************************/
+volatile uint32_t sampleHead = 0;
+volatile uint32_t sampleTail = 0;
+/*******************************************************
+ * GLOBAL VARIABLE: sampleUnderruns (volatile)
+ * DESCRIPTION: Number of ticks in which the ring was empty.
+ *******************************************************/
+volatile uint32_t sampleUnderruns = 0;
+/*******************************************************
+ * GLOBAL VARIABLE: sampleTimer
+ * DESCRIPTION: Hardware timer that clocks the samples out (NULL when
+ * stopped, or when the isolated clock of tx_isolation.h does).
+ *******************************************************/
+hw_timer_t* sampleTimer = NULL;
+/*******************************************************
+ * GLOBAL VARIABLE: sampleTimerRunning
+ * DESCRIPTION: Whether samples are being clocked out.
+ *******************************************************/
+bool sampleTimerRunning = false;
+
+// ---------------------- Phase-continuous Oscillator (NCO) ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: sineTable
+ * DESCRIPTION: One period of a sine wave, 256 entries in Q15.
+ * Filled by sampleEngineBegin().
+ *******************************************************/
+int16_t sineTable[256];
+/*******************************************************
+ * GLOBAL VARIABLE: ncoPhase
+ * DESCRIPTION: 32-bit phase accumulator; the top 8 bits index sineTable.
+ * Never reset between tones, so frequency changes are phase continuous.
+ *******************************************************/
+uint32_t ncoPhase = 0;
+
+/*******************************************************
+ * FUNCTION: ncoIncrement
+ * DESCRIPTION: Phase increment per sample for a tone of `frequency` Hz.
+ * INPUT: uint32_t frequency (Hz)
+ * OUTPUT: uint32_t
+ *******************************************************/
+inline uint32_t ncoIncrement(uint32_t frequency) {
+  return (uint32_t)(((uint64_t)frequency << 32) / sampleEngineRate);
+}
+
+/*******************************************************
+ * FUNCTION: ncoNext
+ * DESCRIPTION: Advances the oscillator by one sample and returns its value
+ * scaled by `amplitude` (Q15).
+ * INPUT: uint32_t increment (from ncoIncrement), int16_t amplitude
+ * OUTPUT: int16_t (Sample)
+ *******************************************************/
+inline int16_t ncoNext(uint32_t increment, int16_t amplitude) {
+  ncoPhase += increment;
+  return ((int32_t)sineTable[ncoPhase >> 24] * amplitude) >> 15;
+}
+
+// ---------------------- Sample Engine Functions ----------------------
+/*******************************************************
+ * FUNCTION: ledcWriteDutyFromISR
+ * DESCRIPTION: Loads a new duty value into the LEDC channel by writing its
+ * registers directly (the LEDC driver is in flash). The channel must have
+ * been set up by ledc_set_duty() and ledc_update_duty() first.
+ * INPUT: uint32_t duty
+ * OUTPUT: None
+ *******************************************************/
+void IRAM_ATTR ledcWriteDutyFromISR(uint32_t duty) {
+  ledc_dev_t* hw = LEDC_LL_GET_HW();
+  ledc_ll_set_duty_int_part(hw, LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, duty);
+  ledc_ll_set_duty_start(hw, LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, true);
+}
+
+/*******************************************************
+ * FUNCTION: sampleTimerISR
+ * DESCRIPTION: **Timer Interrupt Service Routine**. Writes the next duty value
+ * to the LEDC channel, or counts an underrun if the ring is empty.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void IRAM_ATTR sampleTimerISR() {
+  uint32_t tail = sampleTail;
+  if (tail == sampleHead) {
+    sampleUnderruns++;
+    return;
+  }
+  ledcWriteDutyFromISR(sampleRing[tail & (sampleRingSize - 1)]);
+  sampleTail = tail + 1;
+}
+
+/*******************************************************
+ * FUNCTION: sampleEngineStartTimer
+ * DESCRIPTION: Starts clocking samples out at sampleEngineRate, on the
+ * isolated clock when it is enabled (TX_ISOLATION).
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void sampleEngineStartTimer() {
+  sampleTimerRunning = true;
+  if (txClockEnabled) {
+    txClockStart(1000000 / sampleEngineRate, sampleTimerISR);
+    return;
+  }
+  sampleTimer = timerBegin(1000000);                    // 1 MHz tick
+  timerAttachInterrupt(sampleTimer, &sampleTimerISR);
+  timerAlarm(sampleTimer, 1000000 / sampleEngineRate, true, 0);
+}
+
+/*******************************************************
+ * FUNCTION: sampleEngineBegin
+ * DESCRIPTION: Reconfigures the LEDC output as a PWM DAC at mid-scale and
+ * empties the ring. The timer starts once the ring is half full.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void sampleEngineBegin() {
+  ledc_timer_config_t ledc_timer = {};
+  ledc_timer.speed_mode = LEDC_HIGH_SPEED_MODE;
+  ledc_timer.duty_resolution = (ledc_timer_bit_t)sampleDutyBits;
+  ledc_timer.timer_num = LEDC_TIMER_0;
+  ledc_timer.freq_hz = 80000000 >> sampleDutyBits;
+  ledc_timer.clk_cfg = LEDC_USE_APB_CLK;
+  ledc_timer_config(&ledc_timer);
+  ledc_set_duty(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, 1 << (sampleDutyBits - 1));
+  ledc_update_duty(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0);
+
+  for (int i = 0; i < 256; i++) {
+    sineTable[i] = (int16_t)lrint(32767.0 * sin(2.0 * M_PI * i / 256));
+  }
+
+  sampleHead = 0;
+  sampleTail = 0;
+  sampleUnderruns = 0;
+}
+
+/*******************************************************
+ * FUNCTION: sampleEngineWrite
+ * DESCRIPTION: Queues signed 16-bit samples for output, blocking while
+ * the ring is full.
+ * INPUT: const int16_t* samples, int count
+ * OUTPUT: None
+ *******************************************************/
+void sampleEngineWrite(const int16_t* samples, int count) {
+  for (int i = 0; i < count; i++) {
+    while (sampleHead - sampleTail >= sampleRingSize) {
+      vTaskDelay(1);
+    }
+    sampleRing[sampleHead & (sampleRingSize - 1)] = (uint16_t)(samples[i] + 32768) >> (16 - sampleDutyBits);
+    sampleHead = sampleHead + 1;
+    if (!sampleTimerRunning && sampleHead >= sampleRingSize / 2) {
+      sampleEngineStartTimer();
+    }
+  }
+}
+
+/*******************************************************
+ * FUNCTION: sampleEngineEnd
+ * DESCRIPTION: Waits until every queued sample has been played, stops the
+ * timer and gives the output back to the square-wave tone generator.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void sampleEngineEnd() {
+  if (!sampleTimerRunning) {
+    sampleEngineStartTimer();
+  }
+  while (sampleTail != sampleHead) {
+    vTaskDelay(1);
+  }
+  if (sampleTimer) timerEnd(sampleTimer);
+  else txClockStop();
+  sampleTimer = NULL;
+  sampleTimerRunning = false;
+  if (sampleUnderruns) {
+    Serial.printf("Sample engine: %u underruns\n", sampleUnderruns);
+  }
+  setupToneOutput();
+}
+
+#endif
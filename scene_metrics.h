@@ -0,0 +1,133 @@
+#ifndef __SCENE_METRICS_H
+#define __SCENE_METRICS_H
+
+/*******************************************************
+ * Scene complexity metrics for the automatic mode selection.
+ * Accumulated one canvas row at a time while the decoded picture is copied
+ * onto the canvas (the rows are hot in cache then), so they cost no extra
+ * pass over PSRAM:
+ *   detail        - mean luma gradient |dY/dx| + |dY/dy| per pixel, cored
+ *                   so sensor noise (small steps) does not count as detail
+ *   colourfulness - sqrt(var(Cb) + var(Cr)) + 0.3 * |mean chroma|
+ *                   (Hasler-Suesstrunk form, on B-Y / R-Y)
+ * Plain C++ with no Arduino dependency (also used by tools/mode_psnr.cpp).
+ *******************************************************/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*******************************************************
+ * CONSTANT: sceneGradientCoring
+ * DESCRIPTION: Luma steps up to this size are treated as noise and do not
+ * add to the detail metric.
+ *******************************************************/
+const int sceneGradientCoring = 8;
+
+/*******************************************************
+ * FUNCTION: sceneCoredStep
+ * DESCRIPTION: Contribution of one luma step to the detail metric.
+ * INPUT: int step (Difference of two neighbouring luma values)
+ * OUTPUT: int
+ *******************************************************/
+inline int sceneCoredStep(int step) {
+  step = abs(step) - sceneGradientCoring;
+  return step > 0 ? step : 0;
+}
+
+/*******************************************************
+ * STRUCT: SceneStats
+ * DESCRIPTION: Running sums of the scene metrics.
+ *******************************************************/
+struct SceneStats {
+  uint64_t gradient = 0;              // Sum of cored |dY/dx| + |dY/dy|
+  int64_t  cbSum = 0, crSum = 0;      // Sum of B-Y and R-Y
+  uint64_t cbSquares = 0, crSquares = 0;
+  uint32_t pixels = 0;
+};
+
+/*******************************************************
+ * STRUCT: SceneThresholds
+ * DESCRIPTION: Limits of the automatic mode selection (see selectSceneMode).
+ *******************************************************/
+struct SceneThresholds {
+  float colour;       // Colourfulness above which only PD120 keeps the content
+  float detailPD120;  // Detail above which the full 640 px resolution is needed
+  float detailBW24;   // Detail above which BW24 (320 px) is needed, else BW8
+};
+
+/*******************************************************
+ * FUNCTION: sceneAccumulateRow
+ * DESCRIPTION: Adds one RGB565 row to the statistics. The vertical gradient
+ * is taken against the previous row, if any.
+ * INPUT: SceneStats &stats, const uint16_t* row, const uint16_t* prevRow (or NULL),
+ * int width
+ * OUTPUT: None
+ *******************************************************/
+void sceneAccumulateRow(SceneStats &stats, const uint16_t* row, const uint16_t* prevRow, int width) {
+  uint32_t gradient = 0;
+  int32_t cbSum = 0, crSum = 0;
+  uint32_t cbSquares = 0, crSquares = 0;
+  int left = rgb565ToLuma(row[0]);
+  for (int x = 0; x < width; x++) {
+    const uint16_t pixel = row[x];
+    const int y = rgb565ToLuma(pixel);
+    const int cr = (((pixel >> 11) & 0x1F) * 255) / 31 - y;
+    const int cb = ((pixel & 0x1F) * 255) / 31 - y;
+    gradient += sceneCoredStep(y - left);
+    if (prevRow) gradient += sceneCoredStep(y - rgb565ToLuma(prevRow[x]));
+    left = y;
+    cbSum += cb;
+    crSum += cr;
+    cbSquares += cb * cb;
+    crSquares += cr * cr;
+  }
+  stats.gradient += gradient;
+  stats.cbSum += cbSum;
+  stats.crSum += crSum;
+  stats.cbSquares += cbSquares;
+  stats.crSquares += crSquares;
+  stats.pixels += width;
+}
+
+/*******************************************************
+ * FUNCTION: sceneDetail
+ * DESCRIPTION: Mean luma gradient per pixel (0 for a flat picture).
+ * INPUT: const SceneStats &stats
+ * OUTPUT: float (Luma levels per pixel)
+ *******************************************************/
+float sceneDetail(const SceneStats &stats) {
+  return stats.pixels ? (float)stats.gradient / stats.pixels : 0;
+}
+
+/*******************************************************
+ * FUNCTION: sceneColourfulness
+ * DESCRIPTION: Colourfulness of the picture (0 for a grey picture).
+ * INPUT: const SceneStats &stats
+ * OUTPUT: float (Chroma levels)
+ *******************************************************/
+float sceneColourfulness(const SceneStats &stats) {
+  if (!stats.pixels) return 0;
+  const float cbMean = (float)stats.cbSum / stats.pixels;
+  const float crMean = (float)stats.crSum / stats.pixels;
+  const float variance = (float)stats.cbSquares / stats.pixels - cbMean * cbMean
+                       + (float)stats.crSquares / stats.pixels - crMean * crMean;
+  return sqrtf(variance > 0 ? variance : 0) + 0.3f * sqrtf(cbMean * cbMean + crMean * crMean);
+}
+
+/*******************************************************
+ * FUNCTION: selectSceneMode
+ * DESCRIPTION: Shortest mode that keeps the content of the scene:
+ * colourful or finely detailed scenes need PD120, moderately detailed grey
+ * scenes BW24, flat ones (fog, night) BW8.
+ * INPUT: const SceneStats &stats, const SceneThresholds &limits
+ * OUTPUT: SSTVMode
+ *******************************************************/
+SSTVMode selectSceneMode(const SceneStats &stats, const SceneThresholds &limits) {
+  const float detail = sceneDetail(stats);
+  if (sceneColourfulness(stats) > limits.colour || detail > limits.detailPD120) return MODE_PD120;
+  if (detail > limits.detailBW24) return MODE_BW24;
+  return MODE_BW8;
+}
+
+#endif
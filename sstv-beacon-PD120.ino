@@ -21,6 +21,72 @@
 #define uS_TO_S_FACTOR 1000000   /* Conversion factor for micro seconds (uS) to seconds (S) */
 #define TIME_TO_SLEEP  60     /* Time in seconds (60s = 1 minute) the ESP32 will stay in Deep Sleep */  
 
+// --- SSTV Mode Selection ---
+// MODE_PD120 (colour, 640x496, ~126 s) or the luma-only Robot modes
+// MODE_BW8 (160x120, ~8 s), MODE_BW12 (160x120, ~12 s), MODE_BW24 (320x240, ~24 s)
+// MODE_OFDM sends the camera JPEG digitally (decode with tools/ofdm_host.cpp)
+#define SSTV_MODE  MODE_PD120
+#define USE_PIPELINE   // PD120: decode/overlay/render overlap the transmission (needs C++20)
+// Without the pipeline PD120 converts each pixel in the timer callback; after DEADLINE_OVERRUNS
+// scan segments longer than nominal + DEADLINE_SLACK_US it sends the rest of the frame pre-rendered.
+#define DEADLINE_SLACK_US 190
+#define DEADLINE_OVERRUNS 4
+
+// --- Automatic Mode Selection ---
+// Picks PD120, BW24 or BW8 per picture from the scene content (overrides SSTV_MODE
+// unless it is MODE_OFDM; the mode is known only after decoding, so USE_PIPELINE is not used).
+// Thresholds validated with tools/mode_psnr.cpp
+//#define AUTO_MODE
+#define AUTO_COLOUR_THRESHOLD 10.0   // Colourfulness above which PD120 is kept
+#define AUTO_DETAIL_PD120     0.7    // Detail above which the full 640 px resolution is needed
+#define AUTO_DETAIL_BW24      0.15   // Detail above which BW24 is needed instead of BW8
+
+// --- Quality Gate (blur and obstruction, before decoding) ---
+// Frames much less sharp than the running reference, or with part of the view gone, are
+// retaken while another take fits in the budget. Limits checked with tools/archive_thumbs.cpp.
+//#define QUALITY_GATE
+#define QUALITY_BUDGET_MS       5000   // Time allowed for retakes (a take is about 1.5 s)
+#define QUALITY_MIN_SHARPNESS   10.0f  // Laplacian variance below which a frame is always retaken
+#define QUALITY_SHARPNESS_RATIO 0.5f   // Fraction of the reference sharpness a frame must keep
+#define QUALITY_MAX_OBSTRUCTION 0.3f   // Fraction of obstructed tiles above which it is retaken
+
+// --- GPS (NMEA receiver: locator, UTC clock and transmission slots) ---
+// The receiver is powered through GPS_POWER_PIN and must be off at reset (GPIO 12 is a strapping pin).
+//#define GPS                         // Uncomment if a GPS receiver is fitted
+#define GPS_RX_PIN     12             // GPS TX -> ESP32 RX
+#define GPS_POWER_PIN  2              // HIGH powers the receiver (through a load switch)
+#define GPS_BAUD       9600
+#define GPS_REFRESH_S  3600           // Re-acquire when the clock is older than this (RTC drift)
+#define TX_SLOT_PERIOD 300            // With the GPS clock: transmit on multiples of 5 minutes (UTC)
+
+// --- SA818 Transceiver (AT configuration over UART2, power-down between transmissions) ---
+// The ESP32-CAM has no spare pins left: the defaults reuse the GPS pins and the red LED.
+//#define SA818                         // Uncomment if the beacon drives an SA818 module
+#define SA818_TX_PIN    12            // ESP32 TX -> SA818 RXD
+#define SA818_RX_PIN    2             // SA818 TXD -> ESP32 RX (-1: replies not checked)
+#define SA818_PD_PIN    33            // SA818 PD: HIGH = on, LOW = power-down
+#define SA818_FREQUENCY 145500000     // Hz, simplex
+#define SA818_BANDWIDTH 1             // 0 = 12.5 kHz, 1 = 25 kHz
+#define SA818_CTCSS     0             // 0 = none, 1-38 = CTCSS tone index
+#define SA818_SQUELCH   4             // 0-8
+#define SA818_VOLUME    6             // 1-8
+#define SA818_WAKE_MS   500           // Time from power-down to ready
+
+// --- DTMF Remote Control (light sleep between cycles, listening to the receiver audio) ---
+// Commands: *PIN1# transmit now, *PIN2m# mode m (0 PD120 ... 4 OFDM), *PIN3nnn# interval in
+// minutes, *PIN0# back to these settings. Hold '*' longer than DTMF_SLEEP_MS to wake the listener.
+//#define DTMF_CONTROL                  // Uncomment to listen for DTMF commands between cycles
+#define DTMF_AUDIO_PIN  33            // Receiver audio, AC coupled and biased to mid-range (ADC1: the red LED pad)
+#define DTMF_PIN        "1234"        // Digits after '*' that authorise a command
+#define DTMF_SLEEP_MS   1000          // Light sleep between listen windows
+#define DTMF_WINDOW_MS  100           // Listen window
+#define DTMF_COMMAND_MS 10000         // Stay awake this long after each key
+#define DTMF_MIN_LEVEL  12.0f         // Minimum RMS audio level (ADC counts, 12-bit)
+
+// --- OFDM Digital Mode ---
+#define OFDM_BITS_PER_CARRIER 6   // 2 = QPSK, 4 = 16-QAM, 6 = 64-QAM (clean channels only)
+#define OFDM_JPEG_QUALITY    12   // Camera JPEG quality used in MODE_OFDM (lower = better, larger)
+
 /*******************************************************
  * FUNCTION: print_wakeup_reason
  * DESCRIPTION: Prints the cause of the ESP32 waking up
@@ -58,7 +124,13 @@ void print_wakeup_reason(){
 
 // --- Overlay Text Configuration (Text on Image) ---
 
-#define TEXT_TOP  "IU5HKU JN53HB"   // Content for the top-left text (Callsign and Locator)
+#define CALLSIGN  "IU5HKU"
+#define LOCATOR   "JN53HB"          // Used until the GPS has a fix
+#ifdef GPS
+#define TEXT_TOP  gpsOverlay        // Callsign, locator from the GPS fix and UTC time
+#else
+#define TEXT_TOP  CALLSIGN " " LOCATOR   // Content for the top-left text (Callsign and Locator)
+#endif
 // COLOR, POSITION, and SIZE for the TOP TEXT
 #define OVERLAY_COLOR_TOP RGB565_CONV(255, 0, 255) // MAGENTA
 #define OUTLINE_TOP RGB565_CONV(0 ,0, 0)    // Text outline color (BLACK)
@@ -74,6 +146,88 @@ void print_wakeup_reason(){
 #define TEXT_BTM_Y  475             // Y coordinate (high value for bottom placement)
 #define TEXT_BTM_SIZE 1             // Text scaling factor
 
+// --- APRS Telemetry (AFSK1200 packet keyed before the SSTV header) ---
+//#define APRS_TELEMETRY              // Uncomment to key the telemetry packet before each picture
+#define APRS_CALLSIGN    CALLSIGN "-11" // Source callsign and SSID
+#define APRS_DESTINATION "APZSST"     // Destination (experimental APRS tocall)
+#define APRS_PATH        "WIDE1-1"    // Digipeater path
+//#define TELEMETRY_STRIPE            // PD120: frame id, battery and temperature as blocks in the bottom 8 lines (replaces them)
+
+// --- Telemetry Journal (needs the "journal" partition of partitions_beacon.csv) ---
+// The stock partition table has no journal partition: copy partitions_beacon.csv to
+// partitions.csv in the sketch folder before enabling it (the sketch gets 1.5 MB).
+//#define JOURNAL                     // Per-cycle stage times, jitter and battery kept in flash
+#define JOURNAL_FLUSH_EVERY 16        // Wakes buffered in RTC memory per flash write
+
+// --- SD Card Archive (1-bit SD_MMC: CLK 14, CMD 15, D0 2) ---
+//#define SD_ARCHIVE                  // Pictures sent and an index of 80x62 thumbnails on the card
+#define ARCHIVE_SLOTS 64              // Frames kept (ring)
+#define ARCHIVE_JPEG_QUALITY 80       // On-air picture, re-encoded on the idle core during transmission
+
+// --- Playlist (needs the "cache" partition of partitions_beacon.csv, copied to partitions.csv) ---
+// Entries sent in turn, one per wake: { kind, mode, repeat, text }. PLAYLIST_LIVE is the
+// camera picture, PLAYLIST_CARD a station card (text lines split on '\n', the first one
+// large; NULL text: a picture flashed with tools/playlist_plan.cpp), PLAYLIST_MOSAIC the
+// last four pictures at half size. Cards are sent straight from memory-mapped flash, mosaic
+// tiles are cached there. Plan and check a playlist with tools/playlist_plan.cpp.
+//#define PLAYLIST
+#define PLAYLIST_ENTRIES { \
+  { PLAYLIST_LIVE,   MODE_PD120, 2, NULL }, \
+  { PLAYLIST_CARD,   MODE_PD120, 1, CALLSIGN "\n" LOCATOR "\nESP32-CAM SSTV beacon\n" APRS_CALLSIGN " on APRS" }, \
+  { PLAYLIST_MOSAIC, MODE_BW24,  1, NULL } }
+
+// --- On-device Benchmarks ---
+// Boots into the kernel benchmarks (CCOUNT cycles per pixel / line pair, PSRAM bandwidth)
+// printed on the serial port, instead of a transmission.
+//#define DEVICE_BENCH
+#define DEVICE_BENCH_RUNS 16          // Runs per kernel (minimum and median reported)
+
+// --- Transmit Core Isolation ---
+// The pixel and sample clocks run from a high-level timer interrupt on the loop core, which
+// renders the lines; the camera, UART and SD interrupts are installed from the other core.
+// PD120 without the pipeline then renders every line pair. The clock interrupt runs from IRAM
+// on internal RAM, so the tone keeps going while the flash is written (checked at boot). The
+// pixel clock jitter of both setups is compared by DEVICE_BENCH, and per wake in the journal.
+//#define TX_ISOLATION
+#define TX_ISR_LEVEL     3            // Interrupt level of the transmit clock (1-3)
+#define TX_TASK_PRIORITY 20           // Loop task priority (line rendering, sample ring refill)
+
+// --- Wake Stub (skip idle wakes before the full boot) ---
+// Each Deep Sleep wake first runs a stub from RTC memory, which goes back to sleep within a few
+// ms when the wake has nothing to do: battery below WAKE_MIN_BATTERY_MV (sampled by the ULP
+// during the sleep), a UTC hour not in WAKE_SLOT_HOURS, or night at the GPS position. The last
+// two need the GPS clock. Plan a day with tools/wake_plan.cpp. Skipped wakes do not listen for
+// DTMF commands.
+//#define WAKE_STUB
+#define WAKE_MIN_BATTERY_MV 3300      // Below this the wakes are skipped
+#define WAKE_SLOT_HOURS     0xFFFFFF  // Bit n set: transmit in UTC hour n (0xFFFFFF: all day)
+#define WAKE_SKIP_NIGHT               // Skip the wakes between sunset and sunrise
+#define WAKE_SUN_ALTITUDE   -0.833    // Sun altitude (degrees) of sunset and sunrise
+#define WAKE_MAX_SKIPS      48        // Boot anyway after this many skips in a row (plan refresh)
+#define WAKE_ULP_PERIOD_MS  10000     // ULP battery sampling period during the sleep
+
+// --- Camera Mounting ---
+// For a camera mounted sideways the picture is rotated clockwise and letterboxed into the
+// 640x480 picture area (the sensor can only mirror and flip). PD120 is then not pipelined:
+// the whole picture is decoded before it is rotated.
+#define CAMERA_ROTATION 0             // 0, 90 or 270
+
+// --- Radio Stack Memory ---
+// The BT controller and host memory (the beacon never starts a radio stack) is released at
+// boot; the internal RAM gained holds the line pair the pixel callback reads and the overlay
+// layer being composited, instead of PSRAM.
+#define RADIO_MEMORY_RELEASE
+
+// --- Canvas Layout ---
+// Extra bytes per canvas row, rounded up to the 32-byte cache line (640 px rows are 1280 bytes,
+// already aligned). Pick it from the line-pair stride sweep of DEVICE_BENCH.
+#define CANVAS_ROW_PAD 0
+
+// --- Colour Correction ---
+// Matrix printed by tools/ccm_calibrate.cpp for this camera: define it once, flash,
+// boot (it is stored in NVS), then comment it out again.
+//#define CCM_PROVISION { { { 256, 0, 0 }, { 0, 256, 0 }, { 0, 0, 256 } }, { 0, 0, 0 } }
+
 // --- Hardware Pin Configuration ---
 
 #define USE_FLASH           // Macro to enable/disable the use of the flash/LED
@@ -81,12 +235,79 @@ void print_wakeup_reason(){
 #define PTT      15   // Push-To-Talk Pin. Activates transmission (HIGH active).
 #define LED_RED    33   // Red status LED Pin (Debug/Indication). Activated by LOW level.
 #define SPEAKER_OUTPUT 14   // GPIO Pin used as the PWM audio output. 
+#define BATTERY_PIN    13   // ADC input from the battery voltage divider.
+#define BATTERY_DIVIDER 2   // Ratio of the battery voltage divider (e.g. 2 for 100k/100k).
+
+#if defined(GPS) && defined(SA818) && \
+    (SA818_TX_PIN == GPS_RX_PIN || SA818_TX_PIN == GPS_POWER_PIN || SA818_RX_PIN == GPS_RX_PIN || \
+     SA818_RX_PIN == GPS_POWER_PIN || SA818_PD_PIN == GPS_RX_PIN || SA818_PD_PIN == GPS_POWER_PIN)
+#error "GPS and SA818 share pins: reassign them (the ESP32-CAM has no spare GPIO for both)"
+#endif
+#if defined(SD_ARCHIVE) && (SPEAKER_OUTPUT == 14 || PTT == 15 || (defined(GPS) && GPS_POWER_PIN == 2) || \
+    (defined(SA818) && (SA818_TX_PIN == 2 || SA818_RX_PIN == 2)))
+#error "The SD card uses GPIO 14, 15 and 2: move the speaker, PTT and GPS/SA818 pins"
+#endif
+#if defined(DTMF_CONTROL) && defined(SA818) && SA818_PD_PIN == DTMF_AUDIO_PIN
+#error "SA818_PD_PIN and DTMF_AUDIO_PIN share GPIO 33: the DTMF audio needs the only free ADC1 pin"
+#endif
 
 // Declaration of the timer handle pointer. 
 // Used to manage the timing between sending each SSTV audio pixel.
 esp_timer_handle_t pixelTimerHandle = NULL;
 
+#ifdef RADIO_MEMORY_RELEASE
+#include "radio_memory.h" // BT controller and host memory back to the heap
+// Keeps the Arduino core from releasing the BT controller memory alone at boot:
+// the host memory can only be released together with it (radioMemoryRelease()).
+// C linkage: it overrides the weak C symbol of esp32-hal-misc.c
+extern "C" bool btInUse() { return true; }
+#endif
+#include "telemetry.h"  // Battery, temperature and frame counter
+#ifdef GPS
+#include "gps.h"        // NMEA receiver, cached fix and clock
+#endif
+#ifdef SA818
+#include "sa818.h"      // Transceiver configuration and power-down
+#endif
+#ifdef SD_ARCHIVE
+#include "archive.h"    // Pictures sent and thumbnail index on the SD card
+#endif
+#ifdef DTMF_CONTROL
+#include "dtmf.h"       // Remote commands heard between cycles
+#endif
+#ifdef WAKE_STUB
+#include "wake_stub.h"  // Skips idle wakes before the full boot
+#endif
 #include "sstv_pd120.h" // Inclusion of the specific implementation file for PD120 SSTV mode
+#ifdef PLAYLIST
+#include "playlist.h"   // Rotating entries, static content cached in flash
+#endif
+#ifdef JOURNAL
+#include "journal.h"    // Telemetry journal in flash
+#endif
+#ifdef DEVICE_BENCH
+#include "device_bench.h" // Kernel benchmarks
+#endif
+
+/*******************************************************
+ * FUNCTION: beginPeripherals
+ * DESCRIPTION: Starts the GPS, radio, camera and SD card. With TX_ISOLATION
+ * it runs on the other core, so their interrupts are allocated there.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void beginPeripherals() {
+#ifdef GPS
+  gpsBegin();    // Acquires in the background while the cycle runs
+#endif
+#ifdef SA818
+  sa818Begin();  // Wakes the radio (overrides the red LED on GPIO 33), AT commands only if changed
+#endif
+  setupCamera(); // Function from camera.h driver to initialize the sensor
+#ifdef SD_ARCHIVE
+  archiveBegin();
+#endif
+}
 
 /*******************************************************
  * FUNCTION: setup
@@ -102,6 +323,14 @@ void setup() {
   
   // --- Wakeup Management ---
   print_wakeup_reason(); // Prints the reason for waking up
+#ifdef RADIO_MEMORY_RELEASE
+  radioMemoryRelease();  // Before anything allocates internal RAM
+#endif
+#ifdef WAKE_STUB
+  // Wakes skipped by the stub, battery limit in ULP counts. A refresh boot
+  // that would still be skipped goes back to sleep here, with no transmission
+  if (wakeStubBegin() != WAKE_BOOT) wakeStubSleep();
+#endif
   
   /*
    * Configuration of the wake-up source: the Timer.
@@ -113,45 +342,31 @@ void setup() {
   delay(500);
   
   // --- Hardware Initialization ---
-  setupCamera(); // Function from camera.h driver to initialize the sensor
+#ifdef TX_ISOLATION
+  txIsolationBegin(beginPeripherals);   // Peripheral interrupts on the other core, the TX clock on this one
+  if (txClockEnabled) txFlashSafeCheck(); // Clock interrupt path in IRAM/DRAM (keeps playing during flash writes)
+#else
+  beginPeripherals();
+#endif
   
   // Configuration of control pins
   pinMode(LED_FLASH,OUTPUT);
-  pinMode(LED_RED,OUTPUT);
   pinMode(PTT,OUTPUT);
   
   // Set pins to their initial resting state
   digitalWrite(LED_FLASH,LOW);  // Flash OFF
+#if !defined(DTMF_CONTROL) || LED_RED != DTMF_AUDIO_PIN
+  // With DTMF_CONTROL GPIO 33 is the receiver audio input: never driven
+  pinMode(LED_RED,OUTPUT);
   digitalWrite(LED_RED,HIGH);   // Red LED OFF (if 'low level' active)
+#endif
   
   // Disable Hold on the PTT pin so its state can be changed
   rtc_gpio_hold_dis((gpio_num_t)PTT); 
   digitalWrite(PTT,LOW);      // PTT inactive (Transceiver in receive mode)
   
   // --- PWM Audio Configuration (LEDC) ---
-  
-  // LEDC Timer Configuration (defines the carrier frequency)
-  ledc_timer_config_t ledc_timer;
-  ledc_timer.speed_mode = LEDC_HIGH_SPEED_MODE;
-  ledc_timer.duty_resolution = LEDC_TIMER_12_BIT; // Duty cycle resolution (0-4095)
-  ledc_timer.timer_num = LEDC_TIMER_0;
-  ledc_timer.freq_hz = 2200; // Initial audio carrier frequency (will change during SSTV transmission)
-  ledc_timer.clk_cfg = LEDC_AUTO_CLK;
-  ledc_timer_config(&ledc_timer);
-
-  // LEDC Channel Configuration (connects the timer to the output pin)
-  ledc_channel_config_t ledc_channel;
-  ledc_channel.channel = LEDC_CHANNEL_0;
-  ledc_channel.duty = 2048; // Initial duty cycle (50% for a symmetrical square wave, 4096/2)
-  ledc_channel.intr_type = LEDC_INTR_DISABLE;
-  ledc_channel.gpio_num = SPEAKER_OUTPUT; // Pin connected to the speaker
-  ledc_channel.speed_mode = LEDC_HIGH_SPEED_MODE;
-  ledc_channel.hpoint = 0;
-  ledc_channel.timer_sel = LEDC_TIMER_0;
-  ledc_channel_config(&ledc_channel);
-
-  // Initialize audio output to 0 (silence)
-  ledc_stop(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, 0);
+  setupToneOutput();
 
   // --- ESP-Timer Configuration for SSTV ---
   // Create a periodic timer that will be started/stopped during transmission
@@ -163,12 +378,66 @@ void setup() {
     .name = "pixel_timer"
   };
   esp_timer_create(&timer_args, &pixelTimerHandle);
+
+  // Precompute the level -> frequency table used by the integer render paths
+  initRenderTables();
+  // Per-unit colour correction (NVS), fused into the render conversions
+  loadColourCorrection();
   
+#ifdef DEVICE_BENCH
+  deviceBench();
+#else
   // --- Main Operating Cycle ---
   // Captures the image, processes it, and transmits it via SSTV
+#ifdef GPS
+  gpsPrepareOverlay();
+#endif
+#ifdef DTMF_CONTROL
+  dtmfModeOverride(sstvMode);   // Mode set over the air
+#endif
+#ifdef PLAYLIST
+  playlistBegin();
+  playlistRun();
+#else
   takeAndTransmitImageViaSSTV();
+#endif
+#ifdef JOURNAL
+  journalCommit();
+#endif
+#endif
 
   // --- Preparation for Deep Sleep ---
+#ifdef GPS
+  // Replaces the fixed wake-up: align the next wake to the transmission slots
+  gpsEnd();
+  esp_sleep_enable_timer_wakeup((uint64_t)gpsSleepSeconds() * uS_TO_S_FACTOR);
+#endif
+  bool transmitNow = false;
+#ifdef DTMF_CONTROL
+  // The receiver stays on: light sleep and listen up to the next cycle, or a "transmit now"
+#ifdef GPS
+  transmitNow = dtmfListen(dtmfSleepSeconds(gpsSleepSeconds()));
+#else
+  transmitNow = dtmfListen(dtmfSleepSeconds(TIME_TO_SLEEP));
+#endif
+#elif defined(SA818)
+  sa818Sleep();
+#endif
+#ifdef WAKE_STUB
+  // Wakes after the next one come one cycle period apart
+  uint32_t wakePeriod = TIME_TO_SLEEP;
+#ifdef GPS
+  if (gpsClockSetAt != 0) wakePeriod = TX_SLOT_PERIOD;
+#endif
+#ifdef DTMF_CONTROL
+  wakePeriod = dtmfSleepSeconds(wakePeriod);
+  wakeStubArm(0, wakePeriod, !transmitNow);   // The listening ran up to the next cycle
+#elif defined(GPS)
+  wakeStubArm(gpsSleepSeconds(), wakePeriod, true);
+#else
+  wakeStubArm(TIME_TO_SLEEP, wakePeriod, true);
+#endif
+#endif
   Serial.println("Going to sleep now");
   Serial.flush(); 
   // Enable Hold on the PTT pin to ensure the LOW state (inactive)
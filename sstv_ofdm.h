@@ -0,0 +1,57 @@
+#ifndef __SSTV_OFDM_H
+#define __SSTV_OFDM_H
+
+#include "sample_engine.h"  // PWM DAC output at a fixed sample rate
+#include "ofdm_modem.h"     // Fixed-point OFDM modulator (shared with tools/ofdm_host.cpp)
+
+// ---------------------- OFDM Digital Image Mode ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: ofdmModem
+ * DESCRIPTION: Modulator state and FFT work buffers (internal RAM).
+ *******************************************************/
+OFDMModulator ofdmModem;
+/*******************************************************
+ * GLOBAL VARIABLE: ofdmSymbol
+ * DESCRIPTION: One symbol of audio samples (cyclic prefix + body).
+ *******************************************************/
+int16_t ofdmSymbol[ofdmSymbolSamples];
+
+/*******************************************************
+ * FUNCTION: transmitOFDMImage
+ * DESCRIPTION: Transmits a JPEG file as an OFDM frame: preamble, header
+ * and the coded payload, one symbol every 36 ms. Each symbol is built
+ * (encode, interleave, map, IFFT) while the previous ones are being
+ * played from the sample engine ring, so a single core keeps up in real time.
+ * INPUT: const uint8_t* jpeg (Compressed image), size_t len (Bytes)
+ * OUTPUT: None
+ *******************************************************/
+void transmitOFDMImage(const uint8_t* jpeg, size_t len) {
+  const int bitsPerCarrier = OFDM_BITS_PER_CARRIER;
+  const int numSymbols = ofdmPayloadSymbolCount(len, bitsPerCarrier);
+  const uint32_t crc = ofdmCRC32(jpeg, len);
+  uint8_t chunk[ofdmMaxBytesPerSymbol];
+
+  Serial.printf("Sending OFDM image: %u bytes, %d bits/carrier, %u ms\n",
+                (unsigned)len, bitsPerCarrier, ofdmAirtimeMs(len, bitsPerCarrier));
+  ofdmInitTables();
+  ofdmBegin(ofdmModem, bitsPerCarrier);
+  sampleEngineBegin();
+
+  // Preamble: 3x reference, then inverted reference marking the frame start
+  for (int i = 0; i < ofdmPreambleSymbols; i++) {
+    ofdmReferenceSymbol(ofdmModem, i == ofdmPreambleSymbols - 1, ofdmSymbol);
+    sampleEngineWrite(ofdmSymbol, ofdmSymbolSamples);
+  }
+  ofdmHeaderSymbol(ofdmModem, len, ofdmSymbol);
+  sampleEngineWrite(ofdmSymbol, ofdmSymbolSamples);
+
+  for (int s = 0; s < numSymbols; s++) {
+    ofdmPayloadChunk(jpeg, len, crc, s, bitsPerCarrier, chunk);
+    ofdmCodedSymbol(ofdmModem, chunk, bitsPerCarrier, ofdmSymbol);
+    sampleEngineWrite(ofdmSymbol, ofdmSymbolSamples);
+  }
+
+  sampleEngineEnd();
+}
+
+#endif
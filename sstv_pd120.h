@@ -1,4 +1,5 @@
 #include <Adafruit_GFX.h>
+#include <Preferences.h>
 #include "Fonts/FreeSansBold12pt7b.h"
 
 // PD120-Timing (in microseconds)
@@ -18,17 +19,14 @@ const uint32_t porchDuration      = 2080;      // 2.08 ms
  *******************************************************/
 const uint32_t scanDuration      = 121600;    // 121.6 ms per scan segment
 
-// Image resolution for PD120
-/*******************************************************
- * CONSTANT: imageWidth
- * DESCRIPTION: Width of the SSTV image in pixels (640 for PD120).
- *******************************************************/
-const int imageWidth = 640;
-/*******************************************************
- * CONSTANT: imageHeight
- * DESCRIPTION: Height of the SSTV image in pixels (must be even, 496 for PD120).
- *******************************************************/
-const int imageHeight = 496;  // must be even (e.g., 496 lines = 248 line pairs)
+// Image resolution and integer render kernels (shared with the host tools)
+#include "sstv_render.h"
+// Scene complexity metrics for AUTO_MODE
+#include "scene_metrics.h"
+// Rotation of the picture of a sideways camera (CAMERA_ROTATION)
+#include "image_rotate.h"
+// Isolated transmit clock (TX_ISOLATION)
+#include "tx_isolation.h"
 
 // Duration per pixel in microseconds
 /*******************************************************
@@ -42,21 +40,27 @@ const uint32_t pixelDuration = scanDuration / imageWidth;  // approx. 190 µs
  * CLASS: PSRAMCanvas16
  * DESCRIPTION: Subclass of GFXcanvas16 that allocates the canvas buffer
  * in external PSRAM memory (MALLOC_CAP_SPIRAM) to save internal RAM.
+ * Rows are canvasStride pixels apart and start on a cache line: the base
+ * canvas is made stride pixels wide (GFXcanvas16 indexes rows by WIDTH)
+ * and its drawing width is cut back to w, so the padding is never drawn
+ * on. Direct buffer access goes through canvasRow().
  *******************************************************/
 class PSRAMCanvas16 : public GFXcanvas16 {
 public:
   /*******************************************************
    * FUNCTION: PSRAMCanvas16 (Constructor)
    * DESCRIPTION: Initializes the canvas and allocates the buffer in PSRAM.
-   * INPUT: uint16_t w (Canvas width), uint16_t h (Canvas height)
+   * INPUT: uint16_t w (Canvas width), uint16_t h (Canvas height),
+   * uint16_t stride (Pixels per row, at least w)
    * OUTPUT: None
    *******************************************************/
-  PSRAMCanvas16(uint16_t w, uint16_t h) : GFXcanvas16(w, h) {
+  PSRAMCanvas16(uint16_t w, uint16_t h, uint16_t stride = canvasStride) : GFXcanvas16(stride, h) {
     if (buffer) {
       free(buffer);
       buffer = nullptr;
     }
-    buffer = (uint16_t*)heap_caps_malloc(w * h * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+    _width = w;
+    buffer = (uint16_t*)heap_caps_aligned_alloc(canvasCacheLine, stride * h * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
     if (!buffer) {
       Serial.println("PSRAM Allocation failed!");
     } else {
@@ -73,6 +77,12 @@ public:
  *******************************************************/
 PSRAMCanvas16 *canvas;
 
+/*******************************************************
+ * GLOBAL VARIABLE: sstvMode
+ * DESCRIPTION: Mode used for the next transmission (SSTV_MODE by default).
+ *******************************************************/
+SSTVMode sstvMode = SSTV_MODE;
+
 // ---------------------- Hardware Timer & Global Variables ------------------
 
 // Pixel counter and control for the current scan segment
@@ -93,9 +103,11 @@ volatile bool rowFinished = false;
 /*******************************************************
  * ENUM: SegmentType
  * DESCRIPTION: Defines the three types of scan segments in PD120: Luminance (Y),
- * Red-Difference (R-Y), and Blue-Difference (B-Y).
+ * Red-Difference (R-Y), and Blue-Difference (B-Y). SEG_BUFFER plays a line of
+ * tones that was rendered in advance (used by the luma-only modes), SEG_LEVELS
+ * a line of a tone level schedule (see sstv_render.h).
  *******************************************************/
-enum SegmentType { SEG_Y, SEG_RY, SEG_BY };
+enum SegmentType { SEG_Y, SEG_RY, SEG_BY, SEG_BUFFER, SEG_LEVELS };
 /*******************************************************
  * GLOBAL VARIABLE: currentSegment (volatile)
  * DESCRIPTION: Indicates the type of segment currently being transmitted.
@@ -125,8 +137,200 @@ volatile int currentRowOdd = 0;
  *******************************************************/
 volatile int currentRowEven = 0;
 
+// For the line pair converted in the callback (SEG_Y, SEG_RY, SEG_BY)
+/*******************************************************
+ * GLOBAL VARIABLE: pairStage / stagedPair (volatile)
+ * DESCRIPTION: Copy in internal RAM of the two rows of line pair
+ * `stagedPair` (-1: none); the callback reads it instead of the canvas.
+ *******************************************************/
+uint16_t* pairStage = nullptr;
+volatile int stagedPair = -1;
+
+// For pre-rendered segments (SEG_BUFFER)
+/*******************************************************
+ * GLOBAL VARIABLE: toneBuffer (volatile)
+ * DESCRIPTION: Frequencies (Hz) of the pre-rendered line being transmitted.
+ * Accessed by the periodic timer callback.
+ *******************************************************/
+const uint16_t* volatile toneBuffer = nullptr;
+/*******************************************************
+ * GLOBAL VARIABLE: toneLevels (volatile)
+ * DESCRIPTION: Levels of the schedule line being transmitted (SEG_LEVELS).
+ * Accessed by the periodic timer callback.
+ *******************************************************/
+const uint8_t* volatile toneLevels = nullptr;
+/*******************************************************
+ * GLOBAL VARIABLE: mappedSchedule
+ * DESCRIPTION: When set, the PD120 and Robot B/W transmitters play this
+ * tone level schedule (e.g. memory-mapped flash) instead of the canvas.
+ *******************************************************/
+const uint8_t* mappedSchedule = nullptr;
+/*******************************************************
+ * GLOBAL VARIABLE: segmentLength (volatile)
+ * DESCRIPTION: Number of pixels in the current scan segment (imageWidth for PD120).
+ * Accessed by the periodic timer callback.
+ *******************************************************/
+volatile int segmentLength = imageWidth;
+/*******************************************************
+ * GLOBAL VARIABLE: segmentPeriod (volatile)
+ * DESCRIPTION: Nominal timer period (µs) of the current scan segment, the
+ * reference for the jitter histogram.
+ *******************************************************/
+volatile uint32_t segmentPeriod = pixelDuration;
+
+// Timing telemetry of the pixel timer (written only by the callback)
+/*******************************************************
+ * CONSTANT: jitterBuckets / jitterBucketUs
+ * DESCRIPTION: Jitter histogram: 64 buckets of 2 µs, the last one
+ * collects everything from 126 µs up.
+ *******************************************************/
+const int jitterBuckets = 64;
+const int jitterBucketUs = 2;
+/*******************************************************
+ * GLOBAL VARIABLE: jitterHistogram
+ * DESCRIPTION: Number of timer ticks per deviation |actual - nominal period|.
+ *******************************************************/
+uint32_t jitterHistogram[jitterBuckets];
+/*******************************************************
+ * GLOBAL VARIABLE: jitterMaxUs
+ * DESCRIPTION: Largest tick deviation seen (µs).
+ *******************************************************/
+uint32_t jitterMaxUs = 0;
+/*******************************************************
+ * GLOBAL VARIABLE: lastPixelTime
+ * DESCRIPTION: Time of the previous timer tick (µs since boot).
+ *******************************************************/
+int64_t lastPixelTime = 0;
+
+// Deadline supervisor (segment overruns, written only by the callback)
+#ifndef DEADLINE_SLACK_US
+#define DEADLINE_SLACK_US 190   // A segment this much longer than nominal is an overrun (one pixel)
+#endif
+#ifndef DEADLINE_OVERRUNS
+#define DEADLINE_OVERRUNS 4     // Overruns after which PD120 sends the rest of the frame pre-rendered
+#endif
+/*******************************************************
+ * GLOBAL VARIABLE: segmentStartTime / segmentOverruns
+ * DESCRIPTION: Time of the first tick of the current scan segment, and the
+ * number of segments of this wake whose last tick came more than
+ * DEADLINE_SLACK_US late (the line was stretched on air).
+ *******************************************************/
+int64_t segmentStartTime = 0;
+volatile uint32_t segmentOverruns = 0;
+/*******************************************************
+ * GLOBAL VARIABLE: deadlineFallbacks (RTC memory)
+ * DESCRIPTION: Frames since power-up that switched to the pre-rendered path.
+ *******************************************************/
+RTC_DATA_ATTR uint32_t deadlineFallbacks = 0;
+
+/*******************************************************
+ * STRUCT: CycleTimes
+ * DESCRIPTION: Duration of the stages of the current cycle (ms), whether
+ * the camera picture had to be skipped (capture or decode failure), and the
+ * line pair from which the deadline supervisor switched PD120 to the
+ * pre-rendered path (-1: it did not), the quality gate retakes, and
+ * whether the picture sent still failed the gate.
+ *******************************************************/
+struct CycleTimes {
+  uint32_t captureMs;
+  uint32_t decodeMs;
+  uint32_t composeMs;
+  uint32_t transmitMs;
+  bool frameSkipped;
+  int fallbackPair;
+  int retakes;
+  bool poorFrame;
+};
+/*******************************************************
+ * GLOBAL VARIABLE: cycleTimes
+ * DESCRIPTION: Stage times of this wake, recorded in the journal.
+ *******************************************************/
+CycleTimes cycleTimes = { 0, 0, 0, 0, false, -1, 0, false };
+
+/*******************************************************
+ * FUNCTION: jitterPercentileUs
+ * DESCRIPTION: Percentile of the tick deviation from a jitter histogram
+ * (upper edge of the bucket that contains it).
+ * INPUT: int percent (e.g. 99), const uint32_t* histogram (jitterBuckets, this wake's by default)
+ * OUTPUT: uint32_t (µs)
+ *******************************************************/
+uint32_t jitterPercentileUs(int percent, const uint32_t* histogram = jitterHistogram) {
+  uint64_t total = 0;
+  for (int i = 0; i < jitterBuckets; i++) total += histogram[i];
+  uint64_t rank = (total * percent + 99) / 100, seen = 0;
+  for (int i = 0; i < jitterBuckets; i++) {
+    seen += histogram[i];
+    if (seen >= rank && seen > 0) return (i + 1) * jitterBucketUs;
+  }
+  return 0;
+}
+
+// ---------------------- Colour Correction (NVS) ----------------------
+/*******************************************************
+ * FUNCTION: loadColourCorrection
+ * DESCRIPTION: Loads this unit's colour correction matrix from NVS and fuses
+ * it into the render conversions (identity if none is stored). If
+ * CCM_PROVISION is defined, that matrix (printed by tools/ccm_calibrate.cpp)
+ * is first written to NVS. Call after initRenderTables().
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void loadColourCorrection() {
+  Preferences prefs;
+  ColourCorrection cc;
+#ifdef CCM_PROVISION
+  const ColourCorrection provision = CCM_PROVISION;
+  prefs.begin("sstv", false);
+  prefs.putBytes("ccm", &provision, sizeof(provision));
+  prefs.end();
+  Serial.println("Colour correction written to NVS");
+#endif
+  prefs.begin("sstv", true);
+  size_t len = prefs.getBytes("ccm", &cc, sizeof(cc));
+  prefs.end();
+  if (len == sizeof(cc)) {
+    setColourCorrection(cc);
+    Serial.println("Colour correction loaded from NVS");
+  } else {
+    Serial.println("No colour correction in NVS - using identity");
+  }
+}
+
 // ---------------------- Functions for Pixel Query and SSTV Conversion ----------------------
 
+/*******************************************************
+ * FUNCTION: setupToneOutput
+ * DESCRIPTION: Configures the LEDC timer and channel that generate the audio
+ * square wave on SPEAKER_OUTPUT, and leaves the output silent.
+ * Called at boot and whenever another output mode gives the pin back.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void setupToneOutput() {
+  // LEDC Timer Configuration (defines the carrier frequency)
+  ledc_timer_config_t ledc_timer;
+  ledc_timer.speed_mode = LEDC_HIGH_SPEED_MODE;
+  ledc_timer.duty_resolution = LEDC_TIMER_12_BIT; // Duty cycle resolution (0-4095)
+  ledc_timer.timer_num = LEDC_TIMER_0;
+  ledc_timer.freq_hz = 2200; // Initial audio carrier frequency (will change during SSTV transmission)
+  ledc_timer.clk_cfg = LEDC_USE_APB_CLK; // Fixed source: ledcWriteToneFromISR() computes the divider
+  ledc_timer_config(&ledc_timer);
+
+  // LEDC Channel Configuration (connects the timer to the output pin)
+  ledc_channel_config_t ledc_channel;
+  ledc_channel.channel = LEDC_CHANNEL_0;
+  ledc_channel.duty = 2048; // Initial duty cycle (50% for a symmetrical square wave, 4096/2)
+  ledc_channel.intr_type = LEDC_INTR_DISABLE;
+  ledc_channel.gpio_num = SPEAKER_OUTPUT; // Pin connected to the speaker
+  ledc_channel.speed_mode = LEDC_HIGH_SPEED_MODE;
+  ledc_channel.hpoint = 0;
+  ledc_channel.timer_sel = LEDC_TIMER_0;
+  ledc_channel_config(&ledc_channel);
+
+  // Initialize audio output to 0 (silence)
+  ledc_stop(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, 0);
+}
+
 //write a tone by frequency
 void ledcWriteTone(uint32_t frequency) {
   ledc_set_freq(LEDC_HIGH_SPEED_MODE, LEDC_TIMER_0, frequency);
@@ -134,16 +338,49 @@ void ledcWriteTone(uint32_t frequency) {
   ledc_update_duty(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0);
 }
 
+/*******************************************************
+ * CONSTANT: toneDividerScale
+ * DESCRIPTION: LEDC timer divider (8 fractional bits) times the tone
+ * frequency: 80 MHz APB clock, 4096 steps per period (12-bit duty).
+ *******************************************************/
+const uint32_t toneDividerScale = (80000000 / 4096) << 8;
+
+/*******************************************************
+ * FUNCTION: ledcWriteToneFromISR
+ * DESCRIPTION: Changes the frequency of the running tone by writing the
+ * LEDC timer divider directly (the LEDC driver is in flash). The channel
+ * must already be on, from ledcWriteTone().
+ * INPUT: uint32_t frequency (Hz, 20 or more)
+ * OUTPUT: None
+ *******************************************************/
+void IRAM_ATTR ledcWriteToneFromISR(uint32_t frequency) {
+  ledc_ll_set_clock_divider(LEDC_LL_GET_HW(), LEDC_HIGH_SPEED_MODE, LEDC_TIMER_0, toneDividerScale / frequency);
+}
+
+/*******************************************************
+ * FUNCTION: toneOutputStop
+ * DESCRIPTION: Silences the output at the end of a transmission and stops
+ * the isolated clock, parked by the last segment.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void toneOutputStop() {
+  ledc_stop(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, 0);
+  if (txClockEnabled) txClockStop();
+}
+
 /*******************************************************
  * FUNCTION: getCanvasPixel
- * DESCRIPTION: Reads a pixel (RGB565 format) from the global canvas
- * and converts it to 24-bit RGB (R, G, B components from 0 to 255).
+ * DESCRIPTION: Reads a pixel (RGB565 format) from the global canvas, or
+ * from the staged copy of its line pair, and converts it to 24-bit RGB
+ * (R, G, B components from 0 to 255).
  * INPUT: int x (X-coordinate), int y (Y-coordinate), uint8_t &R (reference for 8-bit Red),
  * uint8_t &G (reference for 8-bit Green), uint8_t &B (reference for 8-bit Blue)
  * OUTPUT: None (R, G, B are updated by reference)
  *******************************************************/
 void getCanvasPixel(int x, int y, uint8_t &R, uint8_t &G, uint8_t &B) {
-  uint16_t pixel = canvas->getBuffer()[y * imageWidth + x];
+  const uint16_t* row = stagedPair == y >> 1 ? pairStage + (y & 1) * imageWidth : canvasRow(canvas->getBuffer(), y);
+  uint16_t pixel = row[x];
   uint8_t r5 = (pixel >> 11) & 0x1F;
   uint8_t g6 = (pixel >> 5)  & 0x3F;
   uint8_t b5 = pixel & 0x1F;
@@ -155,7 +392,8 @@ void getCanvasPixel(int x, int y, uint8_t &R, uint8_t &G, uint8_t &B) {
 /*******************************************************
  * FUNCTION: convertToSSTV
  * DESCRIPTION: Converts 24-bit RGB values into the three SSTV channels:
- * Luminance (Y), Red-Difference (R-Y), and Blue-Difference (B-Y) based on standard formulas.
+ * Luminance (Y), Red-Difference (R-Y), and Blue-Difference (B-Y) based on standard formulas,
+ * after the per-unit colour correction.
  * INPUT: uint8_t R, uint8_t G, uint8_t B (8-bit RGB components),
  * float &Y, float &RY, float &BY (references for float SSTV channels)
  * OUTPUT: None (Y, RY, BY are updated by reference)
@@ -163,10 +401,12 @@ void getCanvasPixel(int x, int y, uint8_t &R, uint8_t &G, uint8_t &B) {
 // Y = 0.299*R + 0.587*G + 0.114*B
 // R-Y = 0.713 * (R - Y)
 // B-Y = 0.564 * (B - Y)
+// (all three rows fused with the per-unit colour correction, see colour_correction.h)
 void convertToSSTV(uint8_t R, uint8_t G, uint8_t B, float &Y, float &RY, float &BY) {
-  Y  = 0.299 * R + 0.587 * G + 0.114 * B;
-  RY = 0.713 * (R - Y);
-  BY = 0.564 * (B - Y);
+  const float (*k)[4] = colourMatrixRGB;
+  Y  = constrain(k[0][0] * R + k[0][1] * G + k[0][2] * B + k[0][3], 0.0f, 255.0f);
+  RY = constrain(k[1][0] * R + k[1][1] * G + k[1][2] * B + k[1][3], -128.0f, 127.0f);
+  BY = constrain(k[2][0] * R + k[2][1] * G + k[2][2] * B + k[2][3], -128.0f, 127.0f);
 }
 
 /*******************************************************
@@ -191,6 +431,84 @@ uint32_t mapDiffToFrequency(float diff) {
   return 1500 + (uint32_t)(((diff + 128.0) / 255.0) * 800);
 }
 
+// ------------------------- Pixel Clock -------------------------
+/*******************************************************
+ * GLOBAL VARIABLE: pixelClockIsolated
+ * DESCRIPTION: Whether the running segment is clocked by the isolated
+ * timer (tx_isolation.h) or by the esp_timer.
+ *******************************************************/
+bool pixelClockIsolated = false;
+
+/*******************************************************
+ * GLOBAL VARIABLE: levelStage
+ * DESCRIPTION: Internal RAM copy of the schedule lines of one line pair
+ * (or one Robot B/W line), for the isolated clock: the schedule is mapped
+ * from flash, which is out of reach while the flash is written.
+ *******************************************************/
+uint8_t levelStage[4 * imageWidth];
+
+/*******************************************************
+ * FUNCTION: stageLevels
+ * DESCRIPTION: Copies `count` schedule levels into levelStage when the
+ * isolated clock will play them (call during the sync pulse).
+ * INPUT: const uint8_t* levels, int count (up to 4 * imageWidth)
+ * OUTPUT: const uint8_t* (levelStage, or `levels` itself)
+ *******************************************************/
+const uint8_t* stageLevels(const uint8_t* levels, int count) {
+  if (!txClockEnabled || esp_ptr_internal(levels)) return levels;
+  memcpy(levelStage, levels, count);
+  return levelStage;
+}
+
+/*******************************************************
+ * FUNCTION: pixelClockStop
+ * DESCRIPTION: Stops the clock of the running segment (the isolated one
+ * is parked, see txClockPark()).
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void IRAM_ATTR pixelClockStop() {
+  if (pixelClockIsolated) txClockPark();
+  else esp_timer_stop(pixelTimerHandle);
+}
+
+/*******************************************************
+ * FUNCTION: pixelTickTiming
+ * DESCRIPTION: Timing telemetry of a pixel clock tick: its deviation from
+ * the nominal period goes into the jitter histogram.
+ * INPUT: int64_t now (µs since boot)
+ * OUTPUT: None
+ *******************************************************/
+inline void IRAM_ATTR pixelTickTiming(int64_t now) {
+  if (pixelCounter > 0) {
+    int deviation = (int)(now - lastPixelTime) - (int)segmentPeriod;
+    if (deviation < 0) deviation = -deviation;
+    int bucket = deviation / jitterBucketUs;
+    jitterHistogram[bucket < jitterBuckets ? bucket : jitterBuckets - 1]++;
+    if ((uint32_t)deviation > jitterMaxUs) jitterMaxUs = deviation;
+  } else {
+    segmentStartTime = now;
+  }
+  lastPixelTime = now;
+}
+
+/*******************************************************
+ * FUNCTION: pixelTickAdvance
+ * DESCRIPTION: Moves to the next pixel. After the last one of the segment
+ * it stops the clock, checks the segment deadline and sets rowFinished.
+ * INPUT: int64_t now (µs since boot, time of this tick)
+ * OUTPUT: None
+ *******************************************************/
+inline void IRAM_ATTR pixelTickAdvance(int64_t now) {
+  pixelCounter++;
+  if (pixelCounter >= segmentLength) {
+    // All pixels of this line have been transmitted: stop the timer and set the flag.
+    pixelClockStop();
+    if (now - segmentStartTime > (int64_t)(segmentLength - 1) * segmentPeriod + DEADLINE_SLACK_US) segmentOverruns++;
+    rowFinished = true;
+  }
+}
+
 // ------------------------- ESP-Timer Callback (Pixel Update) -------------------------
 /*******************************************************
  * FUNCTION: pixelTimerCallback
@@ -203,6 +521,10 @@ uint32_t mapDiffToFrequency(float diff) {
  * OUTPUT: None
  *******************************************************/
 void pixelTimerCallback(void* arg) {
+  // Timing telemetry: deviation of this tick from the nominal period
+  int64_t now = esp_timer_get_time();
+  pixelTickTiming(now);
+
   uint32_t freq = 0;
   if (currentSegment == SEG_Y) {
     // Read pixel from current row (currentRow) at position pixelCounter
@@ -234,15 +556,47 @@ void pixelTimerCallback(void* arg) {
     float avgBY = (BY1 + BY2) / 2.0;
     freq = mapDiffToFrequency(avgBY);
   }
+  else if (currentSegment == SEG_BUFFER) {
+    // Pre-rendered line: the frequency is already computed
+    freq = toneBuffer[pixelCounter];
+  }
+  else if (currentSegment == SEG_LEVELS) {
+    // Schedule line: one table lookup
+    freq = levelToFrequency[toneLevels[pixelCounter]];
+  }
   // Set the LEDC tone to the calculated frequency value.
   ledcWriteTone(freq);
+  pixelTickAdvance(now);
+}
 
-  pixelCounter++;
-  if (pixelCounter >= imageWidth) {
-    // All pixels of this line have been transmitted: stop the timer and set the flag.
-    esp_timer_stop(pixelTimerHandle);
-    rowFinished = true;
-  }
+/*******************************************************
+ * FUNCTION: pixelClockTick
+ * DESCRIPTION: Tick of the isolated clock, called from its interrupt.
+ * Plays rendered segments only (SEG_BUFFER, SEG_LEVELS): the per-pixel
+ * conversion needs the FPU, which interrupt handlers may not use. Runs
+ * from IRAM on internal RAM data, also while the flash is written.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void IRAM_ATTR pixelClockTick() {
+  int64_t now = esp_timer_get_time();
+  pixelTickTiming(now);
+  ledcWriteToneFromISR(currentSegment == SEG_LEVELS ? levelToFrequency[toneLevels[pixelCounter]] : toneBuffer[pixelCounter]);
+  pixelTickAdvance(now);
+}
+
+/*******************************************************
+ * FUNCTION: pixelClockStart
+ * DESCRIPTION: Starts clocking the segment set up in the globals, one
+ * tick every `period` µs: on the isolated clock when it is enabled and the
+ * segment is rendered, on the esp_timer otherwise.
+ * INPUT: uint32_t period (µs)
+ * OUTPUT: None
+ *******************************************************/
+void pixelClockStart(uint32_t period) {
+  pixelClockIsolated = txClockEnabled && (currentSegment == SEG_BUFFER || currentSegment == SEG_LEVELS);
+  if (pixelClockIsolated) txClockStart(period, pixelClockTick);
+  else esp_timer_start_periodic(pixelTimerHandle, period);
 }
 
 // ---------------------- Functions for Transmission of Individual Scan Segments ----------------------
@@ -257,10 +611,12 @@ void pixelTimerCallback(void* arg) {
  *******************************************************/
 void transmitLineY_HW(int row) {
   currentSegment = SEG_Y;
+  segmentLength = imageWidth;
   currentRow = row;
   pixelCounter = 0;
+  segmentPeriod = pixelDuration;
   rowFinished = false;
-  esp_timer_start_periodic(pixelTimerHandle, pixelDuration);
+  pixelClockStart(pixelDuration);
   while (!rowFinished) {
   }
 }
@@ -275,11 +631,13 @@ void transmitLineY_HW(int row) {
  *******************************************************/
 void transmitLineDiffRY_HW(int oddRow, int evenRow) {
   currentSegment = SEG_RY;
+  segmentLength = imageWidth;
   currentRowOdd = oddRow;
   currentRowEven = evenRow;
   pixelCounter = 0;
+  segmentPeriod = pixelDuration;
   rowFinished = false;
-  esp_timer_start_periodic(pixelTimerHandle, pixelDuration);
+  pixelClockStart(pixelDuration);
   while (!rowFinished) { }
 }
 
@@ -293,11 +651,64 @@ void transmitLineDiffRY_HW(int oddRow, int evenRow) {
  *******************************************************/
 void transmitLineDiffBY_HW(int oddRow, int evenRow) {
   currentSegment = SEG_BY;
+  segmentLength = imageWidth;
   currentRowOdd = oddRow;
   currentRowEven = evenRow;
   pixelCounter = 0;
+  segmentPeriod = pixelDuration;
+  rowFinished = false;
+  pixelClockStart(pixelDuration);
+  while (!rowFinished) { }
+}
+
+/*******************************************************
+ * FUNCTION: startToneBuffer_HW
+ * DESCRIPTION: Starts a pre-rendered scan segment: one tone per pixel,
+ * read from `tones`, each held for `pixelPeriod` µs, and returns at once.
+ * `rowFinished` becomes true when the last pixel has been sent.
+ * INPUT: const uint16_t* tones (Frequencies in Hz), int count (Number of pixels),
+ * uint32_t pixelPeriod (Duration of one pixel in microseconds)
+ * OUTPUT: None
+ *******************************************************/
+void startToneBuffer_HW(const uint16_t* tones, int count, uint32_t pixelPeriod) {
+  currentSegment = SEG_BUFFER;
+  toneBuffer = tones;
+  segmentLength = count;
+  pixelCounter = 0;
+  segmentPeriod = pixelPeriod;
   rowFinished = false;
-  esp_timer_start_periodic(pixelTimerHandle, pixelDuration);
+  pixelClockStart(pixelPeriod);
+}
+
+/*******************************************************
+ * FUNCTION: transmitToneBuffer_HW
+ * DESCRIPTION: Transmits a pre-rendered scan segment (see startToneBuffer_HW)
+ * and blocks until the segment is complete.
+ * INPUT: const uint16_t* tones (Frequencies in Hz), int count (Number of pixels),
+ * uint32_t pixelPeriod (Duration of one pixel in microseconds)
+ * OUTPUT: None
+ *******************************************************/
+void transmitToneBuffer_HW(const uint16_t* tones, int count, uint32_t pixelPeriod) {
+  startToneBuffer_HW(tones, count, pixelPeriod);
+  while (!rowFinished) { }
+}
+
+/*******************************************************
+ * FUNCTION: transmitLevelBuffer_HW
+ * DESCRIPTION: Transmits one line of a tone level schedule (levels 0..255,
+ * each held for `pixelPeriod` µs) and blocks until it is complete.
+ * INPUT: const uint8_t* levels, int count (Number of pixels),
+ * uint32_t pixelPeriod (Duration of one pixel in microseconds)
+ * OUTPUT: None
+ *******************************************************/
+void transmitLevelBuffer_HW(const uint8_t* levels, int count, uint32_t pixelPeriod) {
+  currentSegment = SEG_LEVELS;
+  toneLevels = levels;
+  segmentLength = count;
+  pixelCounter = 0;
+  segmentPeriod = pixelPeriod;
+  rowFinished = false;
+  pixelClockStart(pixelPeriod);
   while (!rowFinished) { }
 }
 
@@ -454,39 +865,56 @@ void generateBaseImage() {
 }
 
 /*******************************************************
- * FUNCTION: addOverlayText
- * DESCRIPTION: Adds an overlay text string to the global canvas at a specified
- * position, using the configured font and a specific text size.
- * INPUT: const char* text (The string to add), int posX (X-position),
- * int posY (Y-position), uint8_t textSize (Text size multiplier)
+ * FUNCTION: drawOutlinedText
+ * DESCRIPTION: Draws a text string with a 1 pixel outline (8 offset passes
+ * in the outline colour, then the text itself) on any GFX target.
+ * INPUT: Adafruit_GFX &gfx (Target), const char* text, int x, int y,
+ * uint8_t textSize, uint16_t color, uint16_t outline_color
  * OUTPUT: None
  *******************************************************/
-void addOverlayText(const char* text, int x, int y, uint8_t textSize ,uint16_t color, uint16_t outline_color) {
+void drawOutlinedText(Adafruit_GFX &gfx, const char* text, int x, int y, uint8_t textSize, uint16_t color, uint16_t outline_color) {
  
-  canvas->setFont(&FreeSansBold12pt7b);
-  canvas->setTextSize(textSize);  // Scaling of the text (standard font)
+  gfx.setFont(&FreeSansBold12pt7b);
+  gfx.setTextSize(textSize);  // Scaling of the text (standard font)
   
   // 1. Disegna il Bordo (Nero) - 8 spostamenti
-  canvas->setTextColor(outline_color);
+  gfx.setTextColor(outline_color);
   
   // Bordo laterale e verticale (a 1 pixel di distanza)
-  canvas->setCursor(x - 1, y); canvas->print(text); // Sinistra
-  canvas->setCursor(x + 1, y); canvas->print(text); // Destra
-  canvas->setCursor(x, y - 1); canvas->print(text); // Alto
-  canvas->setCursor(x, y + 1); canvas->print(text); // Basso
+  gfx.setCursor(x - 1, y); gfx.print(text); // Sinistra
+  gfx.setCursor(x + 1, y); gfx.print(text); // Destra
+  gfx.setCursor(x, y - 1); gfx.print(text); // Alto
+  gfx.setCursor(x, y + 1); gfx.print(text); // Basso
   
   // Bordo diagonale (opzionale, per un contorno più omogeneo)
-  canvas->setCursor(x - 1, y - 1); canvas->print(text); // Alto-Sinistra
-  canvas->setCursor(x + 1, y - 1); canvas->print(text); // Alto-Destra
-  canvas->setCursor(x - 1, y + 1); canvas->print(text); // Basso-Sinistra
-  canvas->setCursor(x + 1, y + 1); canvas->print(text); // Basso-Destra
+  gfx.setCursor(x - 1, y - 1); gfx.print(text); // Alto-Sinistra
+  gfx.setCursor(x + 1, y - 1); gfx.print(text); // Alto-Destra
+  gfx.setCursor(x - 1, y + 1); gfx.print(text); // Basso-Sinistra
+  gfx.setCursor(x + 1, y + 1); gfx.print(text); // Basso-Destra
+
+  gfx.setTextColor(color);
+  gfx.setCursor(x, y);
+  gfx.print(text);
+}
 
-  // Optional: Set the desired GFX font, e.g., one of the FreeFonts if included.
+// Cached overlay layers (RLE runs in NVS), composited by addOverlayText()
+#include "overlay_layer.h"
 
-  canvas->setTextColor(color);
-  canvas->setCursor(x, y);
-  canvas->print(text);
+/*******************************************************
+ * FUNCTION: addOverlayText
+ * DESCRIPTION: Adds an overlay text string to the global canvas at a specified
+ * position, using the configured font and a specific text size. The text is
+ * composited from its cached RLE layer in `slot` (rasterised and cached
+ * only when text, font, colours or position change).
+ * INPUT: int slot (Overlay number, 0 - overlayLayerSlots-1), const char* text
+ * (The string to add), int posX (X-position), int posY (Y-position),
+ * uint8_t textSize (Text size multiplier), uint16_t color, uint16_t outline_color
+ * OUTPUT: None
+ *******************************************************/
+void addOverlayText(int slot, const char* text, int x, int y, uint8_t textSize, uint16_t color, uint16_t outline_color) {
+  drawOverlayLayer(slot, text, x, y, textSize, color, outline_color);
 }
+
 // ---------------------- Calibration Header ----------------------
 /*******************************************************
  * FUNCTION: tonePulse
@@ -500,6 +928,54 @@ void tonePulse(uint32_t frequency, uint32_t durationMicros) {
   delayMicroseconds(durationMicros);
 }
 
+/*******************************************************
+ * CONSTANT: visHeaderTones
+ * DESCRIPTION: Number of tones in an SSTV calibration header with VIS code.
+ *******************************************************/
+const int visHeaderTones = 14;
+
+/*******************************************************
+ * FUNCTION: visHeaderSchedule
+ * DESCRIPTION: Builds the tone sequence of the SSTV calibration header
+ * (leader tones, break and start bit) followed by the 7-bit VIS code,
+ * LSB first, with even parity and the stop bit.
+ * INPUT: uint8_t visCode (VIS code of the mode that follows),
+ * uint16_t* freqs, uint32_t* durations (visHeaderTones entries each)
+ * OUTPUT: None (freqs in Hz, durations in microseconds)
+ *******************************************************/
+void visHeaderSchedule(uint8_t visCode, uint16_t* freqs, uint32_t* durations) {
+  int n = 0;
+  freqs[n] = 1900; durations[n++] = 300000;
+  freqs[n] = 1200; durations[n++] = 10000;
+  freqs[n] = 1900; durations[n++] = 300000;
+  freqs[n] = 1200; durations[n++] = 30000;   // Start bit
+  int ones = 0;
+  for (int bit = 0; bit < 7; bit++) {
+    bool one = (visCode >> bit) & 1;
+    ones += one;
+    freqs[n] = one ? 1100 : 1300; durations[n++] = 30000; // 1 = 1100 Hz, 0 = 1300 Hz
+  }
+  freqs[n] = (ones & 1) ? 1100 : 1300; durations[n++] = 30000; // Parity (even)
+  freqs[n] = 1200; durations[n++] = 30000;   // Stop bit
+}
+
+/*******************************************************
+ * FUNCTION: transmitVISHeader
+ * DESCRIPTION: Transmits the SSTV calibration header and VIS code
+ * built by visHeaderSchedule() using the `tonePulse` function.
+ * INPUT: uint8_t visCode (VIS code of the mode that follows)
+ * OUTPUT: None
+ *******************************************************/
+void transmitVISHeader(uint8_t visCode) {
+  uint16_t freqs[visHeaderTones];
+  uint32_t durations[visHeaderTones];
+  visHeaderSchedule(visCode, freqs, durations);
+  Serial.printf("Sending SSTV header (VIS %d)...\n", visCode);
+  for (int i = 0; i < visHeaderTones; i++) {
+    tonePulse(freqs[i], durations[i]);
+  }
+}
+
 /*******************************************************
  * FUNCTION: transmitCalibrationHeader
  * DESCRIPTION: Transmits the complete SSTV calibration header for PD120,
@@ -509,20 +985,7 @@ void tonePulse(uint32_t frequency, uint32_t durationMicros) {
  * OUTPUT: None
  *******************************************************/
 void transmitCalibrationHeader() {
-  Serial.println("Sending SSTV header...");
-  tonePulse(1900, 300000);
-  tonePulse(1200, 10000);
-  tonePulse(1900, 300000);
-  tonePulse(1200, 30000);
-  tonePulse(1100, 30000); // Bit 0: 1
-  tonePulse(1100, 30000); // Bit 1: 1
-  tonePulse(1100, 30000); // Bit 2: 1
-  tonePulse(1100, 30000); // Bit 3: 1
-  tonePulse(1100, 30000); // Bit 4: 1
-  tonePulse(1300, 30000); // Bit 5: 0
-  tonePulse(1100, 30000); // Bit 6: 1
-  tonePulse(1300, 30000); // Parity (even)
-  tonePulse(1200, 30000);
+  transmitVISHeader(95);
 }
 
 // ---------------------- SSTV PD120 Transmission ----------------------
@@ -537,25 +1000,76 @@ void transmitCalibrationHeader() {
  * 5. B-Y Scan (average of both lines)
  * 6. Y-Scan (even line)
  * It uses hardware-assisted transmission functions for precise timing.
+ * The pixels are converted in the timer callback, from a copy of the line
+ * pair made in internal RAM during its sync pulse (PSRAM cache misses
+ * stay out of the callback); once DEADLINE_OVERRUNS
+ * segments have overrun (PSRAM or flash cache stalls stretch the line and
+ * slant the picture), the rest of the frame is rendered during each sync
+ * pulse and played from a buffer, as the telemetry stripe always is.
+ * With mappedSchedule set the pairs are played from the schedule instead
+ * (no canvas needed; the telemetry stripe is still rendered). On the
+ * isolated clock (TX_ISOLATION) every pair is rendered: its interrupt
+ * handler cannot convert pixels.
  * INPUT: None
  * OUTPUT: None
  *******************************************************/
 void transmitPD120Image_HW() {
   Serial.println("Sending SSTV image data...");
   int numPairs = imageHeight / 2;
+  const uint16_t* canvasBuffer = mappedSchedule ? NULL : canvas->getBuffer();
+  // The telemetry stripe is rendered, never drawn on the canvas
+  LinePairTones* tones = NULL;
+  if (stripeEnabled || txClockEnabled) {
+    tones = (LinePairTones*)heap_caps_malloc(sizeof(LinePairTones), MALLOC_CAP_INTERNAL);
+    if (!tones) Serial.println("Error creating buffer for rendered line pairs");
+  }
+  if (!mappedSchedule && !txClockEnabled) {
+    pairStage = (uint16_t*)heap_caps_malloc(2 * imageWidth * sizeof(uint16_t), MALLOC_CAP_INTERNAL);
+  }
+  bool fallback = false;
   for (int pair = 0; pair < numPairs; pair++) {
     int oddLine = pair * 2;
     int evenLine = oddLine + 1;
 
+    // Deadline supervisor: switch the rest of the frame to the pre-rendered path
+    if (!fallback && !mappedSchedule && segmentOverruns >= DEADLINE_OVERRUNS) {
+      if (!tones) tones = (LinePairTones*)heap_caps_malloc(sizeof(LinePairTones), MALLOC_CAP_INTERNAL);
+      fallback = tones != NULL;
+      if (fallback) cycleTimes.fallbackPair = pair;
+    }
+    bool rendered = tones && (fallback || (txClockEnabled && !mappedSchedule) || (stripeEnabled && pair >= stripeFirstPair));
+
     // (1) Sync Pulse: 20 ms @ 1200 Hz
     ledcWriteTone(1200);
     uint32_t start = micros();
+    const uint8_t* levels = mappedSchedule && !rendered ? stageLevels(mappedSchedule + pair * 4 * imageWidth, 4 * imageWidth) : NULL;
+    if (rendered) {
+      renderPD120LinePair(canvasBuffer, pair, *tones, 0, imageWidth);
+    } else if (pairStage) {
+      memcpy(pairStage, canvasRow(canvasBuffer, oddLine), imageWidth * sizeof(uint16_t));
+      memcpy(pairStage + imageWidth, canvasRow(canvasBuffer, evenLine), imageWidth * sizeof(uint16_t));
+      stagedPair = pair;
+    }
     while ((micros() - start) < syncPulseDuration) { }
 
     // (2) Porch: 2.08 ms @ 1500 Hz
     ledcWriteTone(1500);
     start = micros();
     while ((micros() - start) < porchDuration) { }
+
+    if (levels) {
+      // (3)-(6) from the schedule
+      for (int s = 0; s < 4; s++) transmitLevelBuffer_HW(levels + s * imageWidth, imageWidth, pixelDuration);
+      continue;
+    }
+    if (rendered) {
+      // (3)-(6) from the rendered line pair
+      transmitToneBuffer_HW(tones->yOdd, imageWidth, pixelDuration);
+      transmitToneBuffer_HW(tones->ry, imageWidth, pixelDuration);
+      transmitToneBuffer_HW(tones->by, imageWidth, pixelDuration);
+      transmitToneBuffer_HW(tones->yEven, imageWidth, pixelDuration);
+      continue;
+    }
     
     // (3) Y-Scan (odd line)
     transmitLineY_HW(oddLine);
@@ -567,9 +1081,29 @@ void transmitPD120Image_HW() {
     transmitLineY_HW(evenLine);
   }
   // Stop the tone generation after transmission
-  ledc_stop(LEDC_HIGH_SPEED_MODE, LEDC_CHANNEL_0, 0);
+  toneOutputStop();
+  free(tones);
+  stagedPair = -1;
+  free(pairStage);
+  pairStage = nullptr;
+  if (fallback) deadlineFallbacks++;
+  Serial.printf("Deadline: %lu segment overruns", (unsigned long)segmentOverruns);
+  if (fallback) Serial.printf(", pre-rendered from line pair %d", cycleTimes.fallbackPair);
+  Serial.printf(" (%lu fallback frames since power-up)\n", (unsigned long)deadlineFallbacks);
 }
 
+// ---------------------- Robot B/W (luma-only) Modes ----------------------
+#include "sstv_robot_bw.h"
+
+// ---------------------- OFDM Digital Image Mode ----------------------
+#include "sstv_ofdm.h"
+
+// ---------------------- Telemetry Packet (AFSK1200 / APRS) ----------------------
+#include "aprs_afsk.h"
+
+// ---------------------- Flash-safe Transmit Path ----------------------
+#include "tx_flash_safe.h"
+
 /*******************************************************
  * FUNCTION: drawImageFromBuffer
  * DESCRIPTION: Draws an image onto the global canvas from a raw RGB565 buffer.
@@ -592,6 +1126,219 @@ void drawImageFromBuffer(uint8_t* imgBuffer, int imgWidth, int imgHeight) {
   }
 }
 
+/*******************************************************
+ * FUNCTION: takeFrame
+ * DESCRIPTION: Discards the stale frame held by the driver, then takes a
+ * fresh picture (with the flash LED if USE_FLASH is defined).
+ * INPUT: None
+ * OUTPUT: camera_fb_t* (Frame buffer to return with esp_camera_fb_return, or NULL)
+ *******************************************************/
+camera_fb_t* takeFrame() {
+  // get tmp image to avoid getting old image
+  camera_fb_t *fb = esp_camera_fb_get();
+  esp_camera_fb_return(fb);
+  delay(500);
+
+  #ifdef USE_FLASH     
+   digitalWrite(LED_FLASH,HIGH);
+  #endif
+   delay(1000);   
+  
+   fb = esp_camera_fb_get();
+  
+  #ifdef USE_FLASH 
+   digitalWrite(LED_FLASH,LOW);
+  #endif
+  return fb;
+}
+
+#ifdef QUALITY_GATE
+// ---------------------- Quality Gate ----------------------
+#include "jpeg_dc_thumb.h"
+#include "frame_quality.h"
+
+/*******************************************************
+ * GLOBAL VARIABLE: qualityReference (RTC memory)
+ * DESCRIPTION: Running metrics of the frames sent (frame_quality.h).
+ *******************************************************/
+RTC_DATA_ATTR FrameQualityReference qualityReference = {};
+/*******************************************************
+ * GLOBAL VARIABLE: qualityFrames / qualityRetakes / qualityPoorFrames (RTC memory)
+ * DESCRIPTION: Since power-up: frames judged, retakes, and frames sent
+ * although they failed the gate (time budget used up).
+ *******************************************************/
+RTC_DATA_ATTR uint32_t qualityFrames = 0;
+RTC_DATA_ATTR uint32_t qualityRetakes = 0;
+RTC_DATA_ATTR uint32_t qualityPoorFrames = 0;
+
+/*******************************************************
+ * FUNCTION: qualityMeasure
+ * DESCRIPTION: Measures a camera JPEG on its DC thumbnail.
+ * INPUT: camera_fb_t* fb, FrameQuality &q
+ * OUTPUT: bool (false if the thumbnail could not be decoded)
+ *******************************************************/
+bool qualityMeasure(camera_fb_t* fb, FrameQuality &q) {
+  const size_t thumbPixels = 80 * 60;   // VGA at 1/8 scale
+  JpegDCDecoder* decoder = (JpegDCDecoder*)heap_caps_malloc(sizeof(JpegDCDecoder), MALLOC_CAP_INTERNAL);
+  uint16_t* thumb = (uint16_t*)heap_caps_malloc(thumbPixels * sizeof(uint16_t), MALLOC_CAP_INTERNAL);
+  int width, height;
+  bool ok = decoder && thumb && jpegDCThumbnail(*decoder, fb->buf, fb->len, thumb, thumbPixels, width, height);
+  if (ok) q = frameQualityMeasure(thumb, width, height);
+  free(decoder);
+  free(thumb);
+  return ok;
+}
+
+/*******************************************************
+ * FUNCTION: qualityGate
+ * DESCRIPTION: Judges a frame against the reference and retakes it while
+ * it fails and another take fits in QUALITY_BUDGET_MS. The driver holds
+ * one frame, so the last take is the one kept. The frame sent is added to
+ * the reference (also a failing one: a lasting change of the view becomes
+ * the new normal).
+ * INPUT: camera_fb_t* fb
+ * OUTPUT: camera_fb_t* (Frame to use, or NULL)
+ *******************************************************/
+camera_fb_t* qualityGate(camera_fb_t* fb) {
+  uint32_t start = millis();
+  uint32_t takeMs = 0;
+  FrameQuality q;
+  bool pass = true;
+  while (fb && qualityMeasure(fb, q)) {
+    pass = frameQualityJudge(q, qualityReference, QUALITY_MIN_SHARPNESS, QUALITY_SHARPNESS_RATIO, QUALITY_MAX_OBSTRUCTION);
+    Serial.printf("Quality: sharpness %.1f (reference %.1f), obstruction %.2f -> %s\n", q.sharpness,
+                  qualityReference.sharpness, q.obstruction, pass ? "ok" : "poor");
+    if (pass || millis() - start + takeMs > QUALITY_BUDGET_MS) {
+      frameQualityLearn(qualityReference, q);
+      break;
+    }
+    esp_camera_fb_return(fb);
+    uint32_t takeStart = millis();
+    fb = takeFrame();
+    takeMs = millis() - takeStart;
+    cycleTimes.retakes++;
+    qualityRetakes++;
+  }
+  qualityFrames++;
+  cycleTimes.poorFrame = !pass;
+  if (!pass) qualityPoorFrames++;
+  if (cycleTimes.retakes || !pass) {
+    Serial.printf("Quality: %d retakes in %lu ms; since power-up %lu retakes, %lu of %lu frames sent poor\n",
+                  cycleTimes.retakes, (unsigned long)(millis() - start), (unsigned long)qualityRetakes,
+                  (unsigned long)qualityPoorFrames, (unsigned long)qualityFrames);
+  }
+  return fb;
+}
+#endif
+
+/*******************************************************
+ * FUNCTION: captureFrame
+ * DESCRIPTION: Takes a fresh picture; with QUALITY_GATE a blurred or
+ * obstructed one is retaken within the time budget.
+ * INPUT: None
+ * OUTPUT: camera_fb_t* (Frame buffer to return with esp_camera_fb_return, or NULL)
+ *******************************************************/
+camera_fb_t* captureFrame() {
+  camera_fb_t *fb = takeFrame();
+#ifdef QUALITY_GATE
+  fb = qualityGate(fb);
+#endif
+  return fb;
+}
+
+/*******************************************************
+ * FUNCTION: prepareTelemetryStripe
+ * DESCRIPTION: Fills the telemetry stripe record for this picture and enables
+ * it (PD120 only, when TELEMETRY_STRIPE is defined). Call before activating PTT.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void prepareTelemetryStripe() {
+#ifdef TELEMETRY_STRIPE
+  StripeTelemetry t;
+  t.mode = sstvMode;
+  t.temperature = readTemperatureC();
+  t.frameId = frameId;
+  t.batteryMv = readBatteryMillivolts();
+  t.flags = 0;
+  stripePack(t, stripeRecord);
+  stripeEnabled = (sstvMode == MODE_PD120);
+#endif
+}
+
+// ---------------------- Coroutine Pipeline (PD120) ----------------------
+#include "sstv_pipeline.h"
+
+/*******************************************************
+ * FUNCTION: transmitComposedFrame
+ * DESCRIPTION: Transmits the finished canvas (or, in MODE_OFDM, the JPEG,
+ * freed afterwards) with PTT, APRS telemetry and the mode's header, then
+ * advances the frame counter. Telemetry packet and stripe must already be
+ * prepared.
+ * INPUT: uint8_t* jpegCopy (MODE_OFDM only), size_t jpegLen
+ * OUTPUT: None
+ *******************************************************/
+void transmitComposedFrame(uint8_t* jpegCopy, size_t jpegLen) {
+  Serial.print("Starting SSTV transmission");
+  Serial.println(" - Activating PTT");
+#ifdef SA818
+  sa818WaitReady();
+#endif
+  digitalWrite(PTT, HIGH);
+  uint32_t stageStart = millis();
+#ifdef SD_ARCHIVE
+  // The canvas is final: re-encoded on core 0 while it is on air
+  if (sstvMode != MODE_OFDM && !mappedSchedule) archiveCanvasStart(canvas->getBuffer(), &imageHeight, sstvMode != MODE_PD120);
+#endif
+
+#ifdef APRS_TELEMETRY
+  transmitAFSKPacket();
+#endif
+
+  // send SSTV with header
+  if (sstvMode == MODE_PD120) {
+    transmitCalibrationHeader();
+    transmitPD120Image_HW();
+  } else if (sstvMode == MODE_OFDM) {
+    if (jpegCopy) {
+      transmitOFDMImage(jpegCopy, jpegLen);
+      free(jpegCopy);
+    }
+  } else {
+    transmitRobotBWImage_HW(sstvMode);
+  }
+  cycleTimes.transmitMs = millis() - stageStart;
+  
+  Serial.print("SSTV completed");
+  Serial.println(" - Deactivating PTT");
+  digitalWrite(PTT, LOW);
+#ifdef SD_ARCHIVE
+  archiveCanvasFinish(sstvMode);
+#endif
+  frameId++;
+}
+
+#if CAMERA_ROTATION
+/*******************************************************
+ * FUNCTION: rotateCameraPicture
+ * DESCRIPTION: Rotates a decoded camera picture by CAMERA_ROTATION into an
+ * area of a buffer, scaled to fit, with black bars (image_rotate.h).
+ * INPUT: const uint16_t* src, int srcWidth, int srcHeight, uint16_t* dst (Area origin),
+ * int dstStride (pixels), int areaWidth, int areaHeight
+ * OUTPUT: bool (false if the map could not be allocated)
+ *******************************************************/
+bool rotateCameraPicture(const uint16_t* src, int srcWidth, int srcHeight, uint16_t* dst, int dstStride,
+                         int areaWidth, int areaHeight) {
+  RotationMap* map = (RotationMap*)heap_caps_malloc(sizeof(RotationMap), MALLOC_CAP_INTERNAL);
+  if (!map) return false;
+  rotationMapBuild(*map, srcWidth, srcHeight, areaWidth, areaHeight, CAMERA_ROTATION);
+  rotateLetterbox(dst, dstStride, areaWidth, areaHeight, *map, 0x0000);
+  rotateBlocked(src, dst, dstStride, *map);
+  free(map);
+  return true;
+}
+#endif
+
 /*******************************************************
  * FUNCTION: takeAndTransmitImageViaSSTV
  * DESCRIPTION: Main control function for the entire process:
@@ -607,30 +1354,51 @@ void drawImageFromBuffer(uint8_t* imgBuffer, int imgWidth, int imgHeight) {
  * OUTPUT: None
  *******************************************************/
 void takeAndTransmitImageViaSSTV(){
+#if defined(USE_PIPELINE) && !defined(AUTO_MODE) && CAMERA_ROTATION == 0
+  if (sstvMode == MODE_PD120) {
+    takeAndTransmitImagePipelined();
+    return;
+  }
+#endif
+
   Serial.println("Takin a picture...");
   camera_fb_t *fb = NULL;
 
-  generateBaseImage();
-  uint16_t* targetBuffer = canvas->getBuffer();
+  uint16_t* targetBuffer = NULL;
+  if (sstvMode == MODE_OFDM) {
+    // The digital mode sends the JPEG as is (no canvas): trade quality for airtime
+    sensor_t *s = esp_camera_sensor_get();
+    s->set_quality(s, OFDM_JPEG_QUALITY);
+  } else {
+    generateBaseImage();
+    targetBuffer = canvas->getBuffer();
+  }
 
-  // get tmp image to avoid getting old image
-  fb = esp_camera_fb_get();
-  esp_camera_fb_return(fb);
-  delay(500);
+  uint32_t stageStart = millis();
+  fb = captureFrame();
+  cycleTimes.captureMs = millis() - stageStart;
+#ifdef SD_ARCHIVE
+  if (sstvMode == MODE_OFDM) archiveFrame(fb, sstvMode);   // Sent as is
+#endif
+  stageStart = millis();
 
-  #ifdef USE_FLASH     
-   digitalWrite(LED_FLASH,HIGH);
-  #endif
-   delay(1000);   
-  
-   fb = esp_camera_fb_get();
-  
-  #ifdef USE_FLASH 
-   digitalWrite(LED_FLASH,LOW);
-  #endif
+  uint8_t *jpegCopy = NULL;
+  size_t jpegLen = 0;
 
   if (!fb) {
     Serial.println("Camera capture failed! - using black image only");
+    cycleTimes.frameSkipped = true;
+  } else if (sstvMode == MODE_OFDM) {
+    // Digital mode: keep the compressed bytes, no decode needed
+    Serial.printf("Got JPEG from camera (%u bytes)...\n", (unsigned)fb->len);
+    jpegCopy = (uint8_t*)heap_caps_malloc(fb->len, MALLOC_CAP_SPIRAM);
+    if (jpegCopy) {
+      memcpy(jpegCopy, fb->buf, fb->len);
+      jpegLen = fb->len;
+    } else {
+      Serial.println("Error creating buffer for JPEG");
+    }
+    esp_camera_fb_return(fb);
   } else {
     Serial.println("Got image from camera...");
 
@@ -642,6 +1410,7 @@ void takeAndTransmitImageViaSSTV(){
     if (rgb565_buffer == NULL) {
       // Error handling
       Serial.println("Error creating buffer for image");
+      cycleTimes.frameSkipped = true;
       return;
     }
 
@@ -650,6 +1419,7 @@ void takeAndTransmitImageViaSSTV(){
     
     if (!result) {
       Serial.println("Error converting image into buffer!");
+      cycleTimes.frameSkipped = true;
       free(rgb565_buffer);
     } else {
       Serial.println("Image was converted...");
@@ -659,35 +1429,72 @@ void takeAndTransmitImageViaSSTV(){
     int offsetY = 0;
 
     // Move real image onto canvas, leave room on top for Data
+#ifdef AUTO_MODE
+    SceneStats scene;
+#endif
     
+#if CAMERA_ROTATION
+    // Sideways camera: rotated into the same picture area, letterboxed
+    if (!rotateCameraPicture((const uint16_t*)rgb565_buffer, imageWidthCam, imageHeightCam,
+                             canvasRow(targetBuffer, offsetY), canvasStride, imageWidthCam, imageHeightCam)) {
+      Serial.println("Error creating the rotation map");
+    }
+#ifdef AUTO_MODE
+    for (int y = 0; y < imageHeightCam; y++) {
+      const uint16_t* row = canvasRow(targetBuffer, y + offsetY);
+      sceneAccumulateRow(scene, row, y ? canvasRow(targetBuffer, y + offsetY - 1) : NULL, imageWidthCam);
+    }
+#endif
+#else
     for (int y = 0; y < imageHeightCam; y++) {
       for (int x = 0; x < imageWidthCam; x++) {
         int srcIndex = (y * imageWidthCam + x) * 2;
         uint16_t pixel = (((uint16_t)rgb565_buffer[srcIndex + 1]) << 8) | rgb565_buffer[srcIndex];
-        int destIndex = ( (y + offsetY) * canvas->width() + x );
-        targetBuffer[destIndex] = pixel;
+        canvasRow(targetBuffer, y + offsetY)[x] = pixel;
       }
+#ifdef AUTO_MODE
+      // Scene metrics while the row is still in cache
+      const uint16_t* row = canvasRow(targetBuffer, y + offsetY);
+      sceneAccumulateRow(scene, row, y ? canvasRow(targetBuffer, y + offsetY - 1) : NULL, imageWidthCam);
+#endif
     }
+#endif
+
+#ifdef AUTO_MODE
+    SceneThresholds limits = { AUTO_COLOUR_THRESHOLD, AUTO_DETAIL_PD120, AUTO_DETAIL_BW24 };
+    sstvMode = selectSceneMode(scene, limits);
+#ifdef DTMF_CONTROL
+    dtmfModeOverride(sstvMode);   // A mode set over the air wins
+#endif
+    Serial.printf("Scene detail %.2f, colourfulness %.2f -> %s\n", sceneDetail(scene), sceneColourfulness(scene),
+                  sstvMode == MODE_PD120 ? "PD120" : robotBWTimings[sstvMode - MODE_BW8].name);
+#endif
     
     esp_camera_fb_return(fb);
     free(rgb565_buffer);
   }
+  cycleTimes.decodeMs = millis() - stageStart;
+  if (sstvMode == MODE_OFDM && !jpegCopy) {
+    // Nothing to send: skip the cycle before PTT is keyed
+    cycleTimes.frameSkipped = true;
+    return;
+  }
+  stageStart = millis();
 
   // add image overlay (x, y, size, color)
-  addOverlayText(TEXT_TOP, TEXT_TOP_X, TEXT_TOP_Y, TEXT_TOP_SIZE, OVERLAY_COLOR_TOP, OUTLINE_TOP);
-  addOverlayText(TEXT_BOTTOM, TEXT_BTM_X, TEXT_BTM_Y, TEXT_BTM_SIZE, OVERLAY_COLOR_BTM, OUTLINE_BTM);
+  if (sstvMode != MODE_OFDM) {
+    addOverlayText(0, TEXT_TOP, TEXT_TOP_X, TEXT_TOP_Y, TEXT_TOP_SIZE, OVERLAY_COLOR_TOP, OUTLINE_TOP);
+    addOverlayText(1, TEXT_BOTTOM, TEXT_BTM_X, TEXT_BTM_Y, TEXT_BTM_SIZE, OVERLAY_COLOR_BTM, OUTLINE_BTM);
+  }
   
-  Serial.print("Starting SSTV transmission");
-  Serial.println(" - Activating PTT");
-  digitalWrite(PTT, HIGH);
+#ifdef APRS_TELEMETRY
+  // Frame, bit stuffing and NRZI are done before PTT: on air only the packet itself
+  buildTelemetryPacket();
+#endif
+  prepareTelemetryStripe();
+  cycleTimes.composeMs = millis() - stageStart;
 
-  // send SSTV with header
-  transmitCalibrationHeader();
-  transmitPD120Image_HW();
-  
-  Serial.print("SSTV completed");
-  Serial.println(" - Deactivating PTT");
-  digitalWrite(PTT, LOW);
+  transmitComposedFrame(jpegCopy, jpegLen);
 
   // Note: The global 'canvas' pointer is not freed here, only its buffer pointer 'targetBuffer' is implicitly freed when canvas is deleted (if it were deleted).
   // Assuming 'canvas' is re-allocated/re-used, freeing the buffer here prevents memory leak if generateBaseImage re-allocates it later.
@@ -0,0 +1,395 @@
+#ifndef __SSTV_PIPELINE_H
+#define __SSTV_PIPELINE_H
+
+/*******************************************************
+ * PD120 cycle as a band pipeline:
+ *   decode (FreeRTOS task, core 0) -> compose -> render -> transmit
+ * The JPEG is decoded straight into the canvas by a task on the other
+ * core; compose, render and transmit are coroutine stages (pipeline.h)
+ * sharing the loop core. While the transmitter waits for the hardware,
+ * the overlays of the decoded rows are drawn and the next line pairs are
+ * rendered into a small pool of tone buffers.
+ *******************************************************/
+
+#include <esp_jpg_decode.h>
+#include "pipeline.h"
+
+// ---------------------- Pipeline Parameters ----------------------
+/*******************************************************
+ * CONSTANT: pipelineBuffers
+ * DESCRIPTION: Number of rendered line pairs in flight between the render
+ * and the transmit stage (3 x 5 KB of internal RAM).
+ *******************************************************/
+const int pipelineBuffers = 3;
+/*******************************************************
+ * CONSTANT: pipelineRenderChunk
+ * DESCRIPTION: Pixels rendered between two yields of the render stage.
+ * Keeps every resumption short compared with pipelineGuard.
+ *******************************************************/
+const int pipelineRenderChunk = 160;
+/*******************************************************
+ * CONSTANT: pipelineGuard
+ * DESCRIPTION: Time (µs) before a tone edge at which the transmit stage stops
+ * yielding and spins, so no other stage can delay the edge.
+ *******************************************************/
+const int32_t pipelineGuard = 400;
+
+// ---------------------- Decode Stage (core 0) ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: decodedRows (volatile)
+ * DESCRIPTION: Number of canvas rows completely written by the decoder.
+ *******************************************************/
+volatile int decodedRows = 0;
+/*******************************************************
+ * GLOBAL VARIABLE: decodeDone (volatile)
+ * DESCRIPTION: True once the decoder task has finished (or failed).
+ *******************************************************/
+volatile bool decodeDone = false;
+
+/*******************************************************
+ * FUNCTION: pipelineJpegRead
+ * DESCRIPTION: esp_jpg_decode input callback: reads from the camera frame.
+ * INPUT: void* arg (camera_fb_t*), size_t index, uint8_t* buf (NULL = skip), size_t len
+ * OUTPUT: size_t (Bytes consumed)
+ *******************************************************/
+size_t pipelineJpegRead(void* arg, size_t index, uint8_t* buf, size_t len) {
+  camera_fb_t* fb = (camera_fb_t*)arg;
+  if (index + len > fb->len) len = fb->len - index;
+  if (buf) memcpy(buf, fb->buf + index, len);
+  return len;
+}
+
+/*******************************************************
+ * FUNCTION: pipelineJpegWrite
+ * DESCRIPTION: esp_jpg_decode output callback: converts a decoded RGB888 block
+ * to RGB565 directly into the canvas (clipped to the canvas), and publishes
+ * the number of complete rows at the end of every MCU row.
+ * INPUT: void* arg (camera_fb_t*), uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+ * uint8_t* data (RGB888, NULL marks start/end of the image)
+ * OUTPUT: bool (true to continue decoding)
+ *******************************************************/
+bool pipelineJpegWrite(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+  camera_fb_t* fb = (camera_fb_t*)arg;
+  if (!data) return true;
+  uint16_t* targetBuffer = canvas->getBuffer();
+  for (int row = 0; row < h; row++) {
+    if (y + row >= imageHeight) break;
+    uint16_t* out = canvasRow(targetBuffer, y + row) + x;
+    const uint8_t* in = data + row * w * 3;
+    for (int col = 0; col < w && x + col < imageWidth; col++, in += 3) {
+      out[col] = ((in[0] & 0xF8) << 8) | ((in[1] & 0xFC) << 3) | (in[2] >> 3);
+    }
+  }
+  if (x + w >= fb->width) {
+    decodedRows = min(y + h, imageHeight);
+  }
+  return true;
+}
+
+/*******************************************************
+ * FUNCTION: pipelineDecodeTask
+ * DESCRIPTION: FreeRTOS task (pinned to core 0) that decodes the camera JPEG
+ * into the canvas, then flags decodeDone and deletes itself.
+ * INPUT: void* arg (camera_fb_t*)
+ * OUTPUT: None
+ *******************************************************/
+void pipelineDecodeTask(void* arg) {
+  camera_fb_t* fb = (camera_fb_t*)arg;
+  uint32_t start = millis();
+  if (esp_jpg_decode(fb->len, JPG_SCALE_NONE, pipelineJpegRead, pipelineJpegWrite, fb) != ESP_OK) {
+    Serial.println("Error converting image into canvas!");
+    cycleTimes.frameSkipped = true;
+  }
+  cycleTimes.decodeMs = millis() - start;
+  decodeDone = true;
+  vTaskDelete(NULL);
+}
+
+// ---------------------- Compose Stage ----------------------
+/*******************************************************
+ * STRUCT: PipelineOverlay
+ * DESCRIPTION: One overlay text, the canvas rows it covers (text bounds
+ * plus the 1 pixel outline) and its layer, prepared before PTT.
+ *******************************************************/
+struct PipelineOverlay {
+  const char* text;
+  int x, y;
+  uint8_t size;
+  uint16_t color, outline;
+  int top, bottom;   // Covered rows [top, bottom)
+  uint8_t* layer;    // prepareOverlayLayer() result, NULL if skipped
+  bool drawn;
+};
+
+/*******************************************************
+ * GLOBAL VARIABLE: composedRows (volatile)
+ * DESCRIPTION: Number of canvas rows that are final (decoded and overlaid),
+ * i.e. that the render stage may read.
+ *******************************************************/
+volatile int composedRows = 0;
+
+/*******************************************************
+ * FUNCTION: pipelineOverlayPrepare
+ * DESCRIPTION: Fills in the rows covered by an overlay, measured with the
+ * same font and size addOverlayText() uses, and prepares its layer: the NVS
+ * access and the rasterising must not run between two tones.
+ * INPUT: PipelineOverlay &overlay, int slot
+ * OUTPUT: None
+ *******************************************************/
+void pipelineOverlayPrepare(PipelineOverlay &overlay, int slot) {
+  int16_t bx, by;
+  uint16_t bw, bh;
+  canvas->setFont(&FreeSansBold12pt7b);
+  canvas->setTextSize(overlay.size);
+  canvas->getTextBounds(overlay.text, overlay.x, overlay.y, &bx, &by, &bw, &bh);
+  overlay.top = max(by - 1, 0);
+  overlay.bottom = min(by + bh + 1, imageHeight);
+  overlay.drawn = false;
+  overlay.layer = prepareOverlayLayer(slot, overlay.text, overlay.x, overlay.y, overlay.size, overlay.color, overlay.outline);
+  if (!overlay.layer) Serial.printf("Overlay %d could not be prepared - skipped\n", slot);
+}
+
+/*******************************************************
+ * FUNCTION: composeStage
+ * DESCRIPTION: Coroutine: composites each prepared overlay layer as soon as
+ * all the rows it covers are decoded, and advances composedRows up to the
+ * first row still waiting for the decoder or for an overlay. Only the runs
+ * are copied here (no font, no NVS); the time goes to cycleTimes.composeMs.
+ * INPUT: PipelineOverlay* overlays, int count
+ * OUTPUT: PipelineTask
+ *******************************************************/
+PipelineTask composeStage(PipelineOverlay* overlays, int count) {
+  while (composedRows < imageHeight) {
+    int ready = decodeDone ? imageHeight : decodedRows;
+    int limit = ready;
+    for (int i = 0; i < count; i++) {
+      if (overlays[i].drawn) continue;
+      if (overlays[i].bottom <= ready) {
+        if (overlays[i].layer) {
+          uint32_t start = millis();
+          overlayLayerComposite(*(OverlayLayerHeader*)overlays[i].layer, overlays[i].layer + sizeof(OverlayLayerHeader));
+          cycleTimes.composeMs += millis() - start;
+        }
+        overlays[i].drawn = true;
+      } else {
+        limit = min(limit, overlays[i].top);
+      }
+    }
+    composedRows = limit;
+    co_await pipelineYield();
+  }
+}
+
+// ---------------------- Render Stage ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: pipelineTones
+ * DESCRIPTION: Pool of rendered line pairs (internal RAM).
+ *******************************************************/
+LinePairTones* pipelineTones = NULL;
+/*******************************************************
+ * GLOBAL VARIABLE: freeBands / readyBands
+ * DESCRIPTION: Indices into pipelineTones: buffers the render stage may fill,
+ * and rendered buffers waiting for the transmit stage (in pair order).
+ *******************************************************/
+BandQueue<pipelineBuffers> freeBands;
+BandQueue<pipelineBuffers> readyBands;
+/*******************************************************
+ * GLOBAL VARIABLE: pipelineStalls
+ * DESCRIPTION: Line pairs for which the transmitter had to wait for the
+ * renderer after the porch (should stay 0).
+ *******************************************************/
+int pipelineStalls = 0;
+
+/*******************************************************
+ * FUNCTION: renderStage
+ * DESCRIPTION: Coroutine: for every line pair, waits for its two rows to be
+ * composed and for a free buffer, then renders it in chunks of
+ * pipelineRenderChunk pixels and queues it for the transmitter.
+ * INPUT: None
+ * OUTPUT: PipelineTask
+ *******************************************************/
+PipelineTask renderStage() {
+  const uint16_t* canvasBuffer = canvas->getBuffer();
+  for (int pair = 0; pair < imageHeight / 2; pair++) {
+    int band;
+    while (composedRows < 2 * pair + 2 || !freeBands.pop(band)) co_await pipelineYield();
+    for (int x = 0; x < imageWidth; x += pipelineRenderChunk) {
+      renderPD120LinePair(canvasBuffer, pair, pipelineTones[band], x, x + pipelineRenderChunk);
+      co_await pipelineYield();
+    }
+    readyBands.push(band);
+  }
+}
+
+// ---------------------- Transmit Stage ----------------------
+/*******************************************************
+ * FUNCTION: pipelineCanYield
+ * DESCRIPTION: True while the time left before `deadline` is long enough
+ * for another stage to run once.
+ * INPUT: uint32_t deadline (micros() value)
+ * OUTPUT: bool
+ *******************************************************/
+bool pipelineCanYield(uint32_t deadline) {
+  return (int32_t)(deadline - micros()) > pipelineGuard;
+}
+
+/*******************************************************
+ * FUNCTION: transmitStage
+ * DESCRIPTION: Coroutine: sends the calibration header and all the line pairs
+ * with the same timing as transmitCalibrationHeader() + transmitPD120Image_HW(),
+ * yielding the waits to the other stages and spinning only for the last
+ * pipelineGuard µs before each tone edge.
+ * INPUT: None
+ * OUTPUT: PipelineTask
+ *******************************************************/
+PipelineTask transmitStage() {
+  uint16_t freqs[visHeaderTones];
+  uint32_t durations[visHeaderTones];
+  visHeaderSchedule(95, freqs, durations);
+  Serial.println("Sending SSTV header (VIS 95)...");
+  for (int i = 0; i < visHeaderTones; i++) {
+    ledcWriteTone(freqs[i]);
+    uint32_t start = micros();
+    while (pipelineCanYield(start + durations[i])) co_await pipelineYield();
+    while ((micros() - start) < durations[i]) { }
+  }
+
+  Serial.println("Sending SSTV image data...");
+  for (int pair = 0; pair < imageHeight / 2; pair++) {
+    // (1) Sync Pulse: 20 ms @ 1200 Hz
+    ledcWriteTone(1200);
+    uint32_t start = micros();
+    while (pipelineCanYield(start + syncPulseDuration)) co_await pipelineYield();
+    while ((micros() - start) < syncPulseDuration) { }
+
+    // (2) Porch: 2.08 ms @ 1500 Hz
+    ledcWriteTone(1500);
+    start = micros();
+    while (pipelineCanYield(start + porchDuration)) co_await pipelineYield();
+    while ((micros() - start) < porchDuration) { }
+
+    int band;
+    if (!readyBands.pop(band)) {
+      pipelineStalls++;
+      while (!readyBands.pop(band)) co_await pipelineYield();
+    }
+
+    // (3)-(6) Y odd, R-Y, B-Y, Y even from the rendered buffer
+    const uint16_t* segments[4] = { pipelineTones[band].yOdd, pipelineTones[band].ry,
+                                    pipelineTones[band].by, pipelineTones[band].yEven };
+    for (int s = 0; s < 4; s++) {
+      start = micros();
+      startToneBuffer_HW(segments[s], imageWidth, pixelDuration);
+      while (pipelineCanYield(start + scanDuration)) co_await pipelineYield();
+      while (!rowFinished) { }
+    }
+    freeBands.push(band);
+  }
+  // Stop the tone generation after transmission
+  toneOutputStop();
+}
+
+// ---------------------- Pipelined Cycle ----------------------
+/*******************************************************
+ * FUNCTION: takeAndTransmitImagePipelined
+ * DESCRIPTION: PD120 version of takeAndTransmitImageViaSSTV() in which
+ * decoding, overlay, rendering and transmission overlap:
+ * 1. Takes the picture and starts the decoder task on core 0.
+ * 2. Activates PTT (and sends the telemetry packet, if enabled).
+ * 3. Runs the compose, render and transmit stages until the last line pair
+ *    is on air; the header goes out while the first bands are decoded.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void takeAndTransmitImagePipelined() {
+  Serial.println("Takin a picture...");
+  generateBaseImage();
+  uint16_t* targetBuffer = canvas->getBuffer();
+
+  pipelineTones = (LinePairTones*)heap_caps_malloc(pipelineBuffers * sizeof(LinePairTones), MALLOC_CAP_INTERNAL);
+  if (!pipelineTones) {
+    Serial.println("Error creating pipeline buffers");
+    free(targetBuffer);
+    return;
+  }
+
+  uint32_t stageStart = millis();
+  camera_fb_t *fb = captureFrame();
+  cycleTimes.captureMs = millis() - stageStart;
+  cycleTimes.composeMs = 0;
+  decodedRows = 0;
+  decodeDone = false;
+  composedRows = 0;
+  pipelineStalls = 0;
+  if (!fb) {
+    Serial.println("Camera capture failed! - using black image only");
+    cycleTimes.frameSkipped = true;
+    decodeDone = true;
+  } else {
+    Serial.println("Got image from camera, decoding while transmitting...");
+    xTaskCreatePinnedToCore(pipelineDecodeTask, "jpgdecode", 8192, fb, 5, NULL, 0);
+  }
+
+  PipelineOverlay overlays[2] = {
+    { TEXT_TOP, TEXT_TOP_X, TEXT_TOP_Y, TEXT_TOP_SIZE, OVERLAY_COLOR_TOP, OUTLINE_TOP },
+    { TEXT_BOTTOM, TEXT_BTM_X, TEXT_BTM_Y, TEXT_BTM_SIZE, OVERLAY_COLOR_BTM, OUTLINE_BTM },
+  };
+  for (int i = 0; i < 2; i++) pipelineOverlayPrepare(overlays[i], i);
+
+  for (int i = 0; i < pipelineBuffers; i++) freeBands.push(i);
+
+#ifdef APRS_TELEMETRY
+  buildTelemetryPacket();
+#endif
+  prepareTelemetryStripe();
+
+  Serial.print("Starting SSTV transmission");
+  Serial.println(" - Activating PTT");
+#ifdef SA818
+  sa818WaitReady();
+#endif
+  digitalWrite(PTT, HIGH);
+  stageStart = millis();
+#ifdef SD_ARCHIVE
+  // Re-encoded on core 0 behind the compose stage, band by band
+  archiveCanvasStart(targetBuffer, &composedRows, false);
+#endif
+
+#ifdef APRS_TELEMETRY
+  transmitAFSKPacket();
+#endif
+
+  {
+    PipelineTask compose = composeStage(overlays, 2);
+    PipelineTask render = renderStage();
+    PipelineTask transmit = transmitStage();
+    PipelineExecutor executor;
+    executor.spawn(compose);
+    executor.spawn(render);
+    executor.spawn(transmit);
+    executor.run();
+    Serial.printf("Pipeline: %lu resumptions, %d stalls\n", executor.rounds, pipelineStalls);
+  }
+  cycleTimes.transmitMs = millis() - stageStart;
+
+  Serial.print("SSTV completed");
+  Serial.println(" - Deactivating PTT");
+  digitalWrite(PTT, LOW);
+#ifdef SD_ARCHIVE
+  archiveCanvasFinish(sstvMode);
+#endif
+  frameId++;
+
+  // The decoder has long finished (it was needed for the last rows)
+  if (fb) esp_camera_fb_return(fb);
+  int band;
+  while (readyBands.pop(band)) { }
+  while (freeBands.pop(band)) { }
+  free(pipelineTones);
+  pipelineTones = NULL;
+  for (int i = 0; i < 2; i++) free(overlays[i].layer);
+  free(targetBuffer);
+  delay(1000);
+}
+
+#endif
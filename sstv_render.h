@@ -0,0 +1,317 @@
+#ifndef __SSTV_RENDER_H
+#define __SSTV_RENDER_H
+
+/*******************************************************
+ * Integer render kernels: canvas pixels (RGB565) to SSTV tone
+ * frequencies. Plain C++ with no Arduino dependency, so the host tools
+ * run exactly the code the beacon runs.
+ *******************************************************/
+
+#include <stdint.h>
+
+// Image resolution for PD120
+/*******************************************************
+ * CONSTANT: imageWidth
+ * DESCRIPTION: Width of the SSTV image in pixels (640 for PD120).
+ *******************************************************/
+const int imageWidth = 640;
+/*******************************************************
+ * CONSTANT: imageHeight
+ * DESCRIPTION: Height of the SSTV image in pixels (must be even, 496 for PD120).
+ *******************************************************/
+const int imageHeight = 496;  // must be even (e.g., 496 lines = 248 line pairs)
+
+// ---------------------- Canvas Layout ----------------------
+#ifndef CANVAS_ROW_PAD
+#define CANVAS_ROW_PAD 0        // Extra bytes per canvas row (rounded up to whole cache lines)
+#endif
+
+/*******************************************************
+ * CONSTANT: canvasCacheLine
+ * DESCRIPTION: Cache line size of the ESP32 external RAM cache in bytes.
+ * Canvas rows start on a cache line boundary.
+ *******************************************************/
+const int canvasCacheLine = 32;
+
+/*******************************************************
+ * CONSTANT: canvasStride
+ * DESCRIPTION: Pixels from one canvas row to the next: imageWidth plus
+ * CANVAS_ROW_PAD bytes, rounded up to whole cache lines. The padding moves
+ * the two rows of a line pair (read together for R-Y and B-Y) to other
+ * cache sets; the columns beyond imageWidth are never shown.
+ *******************************************************/
+const int canvasStride = (imageWidth * 2 + CANVAS_ROW_PAD + canvasCacheLine - 1) / canvasCacheLine * canvasCacheLine / 2;
+
+/*******************************************************
+ * FUNCTION: canvasRow
+ * DESCRIPTION: First pixel of row y of a canvas buffer (canvasStride
+ * pixels per row). All direct canvas access goes through it.
+ * INPUT: uint16_t* canvasBuffer, int y
+ * OUTPUT: uint16_t*
+ *******************************************************/
+inline uint16_t* canvasRow(uint16_t* canvasBuffer, int y) {
+  return canvasBuffer + y * canvasStride;
+}
+
+inline const uint16_t* canvasRow(const uint16_t* canvasBuffer, int y) {
+  return canvasBuffer + y * canvasStride;
+}
+
+/*******************************************************
+ * ENUM: SSTVMode
+ * DESCRIPTION: SSTV modes the beacon can transmit. PD120 is the full-colour
+ * default; the Robot B/W modes are luma-only and much shorter (8-24 s),
+ * intended for emergency and low-battery operation. MODE_OFDM is digital:
+ * it sends the camera JPEG bytes over an OFDM waveform.
+ *******************************************************/
+enum SSTVMode { MODE_PD120, MODE_BW8, MODE_BW12, MODE_BW24, MODE_OFDM };
+
+// Per-unit colour correction, fused into the conversions below
+#include "colour_correction.h"
+
+// Telemetry stripe record and layout (bottom lines of the image)
+#include "telemetry_stripe.h"
+
+// ---------------------- Level to Frequency ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: levelToFrequency
+ * DESCRIPTION: SSTV frequency for every integer level 0..255
+ * (1500 Hz [black] to 2300 Hz [white], same mapping as mapYToFrequency()),
+ * so the integer render paths never touch floating point.
+ * Filled once by initRenderTables().
+ *******************************************************/
+uint16_t levelToFrequency[256];
+
+/*******************************************************
+ * FUNCTION: initRenderTables
+ * DESCRIPTION: Fills the levelToFrequency lookup table and loads the
+ * identity colour correction (see colour_correction.h).
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void initRenderTables() {
+  for (int level = 0; level < 256; level++) {
+    levelToFrequency[level] = 1500 + (uint32_t)((level / 255.0) * 800);
+  }
+  setColourCorrection(colourIdentity);
+}
+
+// ---------------------- Luma-only Kernel ----------------------
+/*******************************************************
+ * FUNCTION: rgb565ToLuma
+ * DESCRIPTION: Computes the luminance (0..255) of an RGB565 pixel in fixed point.
+ * The 5/6-bit to 8-bit expansion, the colour correction and the
+ * 0.299/0.587/0.114 weights are folded into the Y row of colourMatrix565,
+ * so no chroma is ever computed.
+ * INPUT: uint16_t pixel (RGB565 value)
+ * OUTPUT: uint8_t (Luminance Y)
+ *******************************************************/
+inline uint8_t rgb565ToLuma(uint16_t pixel) {
+  const int32_t r5 = (pixel >> 11) & 0x1F;
+  const int32_t g6 = (pixel >> 5)  & 0x3F;
+  const int32_t b5 = pixel & 0x1F;
+  const int32_t* k = colourMatrix565[0];
+  int32_t y = (k[0] * r5 + k[1] * g6 + k[2] * b5 + k[3]) >> 16;
+  return y < 0 ? 0 : (y > 255 ? 255 : y);
+}
+
+/*******************************************************
+ * FUNCTION: renderLumaLine
+ * DESCRIPTION: Renders one line of a luma-only mode of `width` x `height`
+ * pixels into `tones`. The canvas is downscaled on the fly: each output
+ * pixel is the average luminance of the canvas pixels it covers
+ * horizontally on the nearest canvas row.
+ * INPUT: const uint16_t* canvasBuffer, int line (Output line number),
+ * int width, int height (Output geometry), uint16_t* tones (width frequencies in Hz)
+ * OUTPUT: None
+ *******************************************************/
+void renderLumaLine(const uint16_t* canvasBuffer, int line, int width, int height, uint16_t* tones) {
+  const uint16_t* row = canvasRow(canvasBuffer, line * imageHeight / height);
+  const int step = imageWidth / width;
+  for (int x = 0; x < width; x++) {
+    uint32_t sum = 0;
+    for (int i = 0; i < step; i++) {
+      sum += rgb565ToLuma(*row++);
+    }
+    tones[x] = levelToFrequency[sum / step];
+  }
+}
+
+/*******************************************************
+ * FUNCTION: renderLumaLineLevels
+ * DESCRIPTION: renderLumaLine() producing levels (0..255, the index into
+ * levelToFrequency) instead of frequencies.
+ * INPUT: const uint16_t* canvasBuffer, int line, int width, int height, uint8_t* levels (width)
+ * OUTPUT: None
+ *******************************************************/
+void renderLumaLineLevels(const uint16_t* canvasBuffer, int line, int width, int height, uint8_t* levels) {
+  const uint16_t* row = canvasRow(canvasBuffer, line * imageHeight / height);
+  const int step = imageWidth / width;
+  for (int x = 0; x < width; x++) {
+    uint32_t sum = 0;
+    for (int i = 0; i < step; i++) {
+      sum += rgb565ToLuma(*row++);
+    }
+    levels[x] = sum / step;
+  }
+}
+
+// ---------------------- PD120 Line-pair Kernel ----------------------
+/*******************************************************
+ * STRUCT: LinePairTones
+ * DESCRIPTION: The four scan segments of one PD120 line pair, as tone
+ * frequencies in Hz, in transmission order.
+ *******************************************************/
+struct LinePairTones {
+  uint16_t yOdd[imageWidth];   // Y of the first (odd) line
+  uint16_t ry[imageWidth];     // R-Y averaged over both lines
+  uint16_t by[imageWidth];     // B-Y averaged over both lines
+  uint16_t yEven[imageWidth];  // Y of the second (even) line
+};
+
+/*******************************************************
+ * FUNCTION: pixelToYCC
+ * DESCRIPTION: Integer version of getCanvasPixel() + convertToSSTV():
+ * Y, R-Y and B-Y of an RGB565 pixel, all scaled by 256. One fused 3x4
+ * matrix (colourMatrix565) does the 8-bit expansion, the colour
+ * correction and the conversion at once.
+ * INPUT: uint16_t pixel, int32_t &y, int32_t &ry, int32_t &by
+ * OUTPUT: None (y, ry, by are updated by reference; y is clamped to 0..255*256)
+ *******************************************************/
+inline void pixelToYCC(uint16_t pixel, int32_t &y, int32_t &ry, int32_t &by) {
+  const int32_t r5 = (pixel >> 11) & 0x1F;
+  const int32_t g6 = (pixel >> 5)  & 0x3F;
+  const int32_t b5 = pixel & 0x1F;
+  const int32_t (*k)[4] = colourMatrix565;
+  y  = (k[0][0] * r5 + k[0][1] * g6 + k[0][2] * b5 + k[0][3]) >> 8;
+  ry = (k[1][0] * r5 + k[1][1] * g6 + k[1][2] * b5 + k[1][3]) >> 8;
+  by = (k[2][0] * r5 + k[2][1] * g6 + k[2][2] * b5 + k[2][3]) >> 8;
+  y = y < 0 ? 0 : (y > 255 * 256 ? 255 * 256 : y);
+}
+
+/*******************************************************
+ * FUNCTION: diffToFrequency
+ * DESCRIPTION: Integer version of mapDiffToFrequency() for a difference
+ * value scaled by 256.
+ * INPUT: int32_t diff256
+ * OUTPUT: uint16_t (Frequency in Hz)
+ *******************************************************/
+inline uint16_t diffToFrequency(int32_t diff256) {
+  int32_t level = (diff256 + 128 * 256) >> 8;
+  return levelToFrequency[level < 0 ? 0 : (level > 255 ? 255 : level)];
+}
+
+/*******************************************************
+ * FUNCTION: diffToLevel
+ * DESCRIPTION: Level (0..255) of a difference value scaled by 256, the
+ * index diffToFrequency() looks up.
+ * INPUT: int32_t diff256
+ * OUTPUT: uint8_t
+ *******************************************************/
+inline uint8_t diffToLevel(int32_t diff256) {
+  int32_t level = (diff256 + 128 * 256) >> 8;
+  return level < 0 ? 0 : (level > 255 ? 255 : level);
+}
+
+/*******************************************************
+ * FUNCTION: renderStripeLinePair
+ * DESCRIPTION: Renders columns [x0, x1) of a line pair of the telemetry
+ * stripe: full black/white luminance, zero colour difference.
+ * INPUT: int pair (stripeFirstPair..imageHeight/2-1), LinePairTones &out, int x0, int x1
+ * OUTPUT: None
+ *******************************************************/
+void renderStripeLinePair(int pair, LinePairTones &out, int x0, int x1) {
+  const int row = (2 * (pair - stripeFirstPair)) / stripeCellLines;
+  const uint16_t grey = diffToFrequency(0);
+  for (int x = x0; x < x1; x++) {
+    uint16_t f = levelToFrequency[stripeCell(stripeRecord, row, x / stripeCellWidth) ? 255 : 0];
+    out.yOdd[x] = f;
+    out.yEven[x] = f;
+    out.ry[x] = grey;
+    out.by[x] = grey;
+  }
+}
+
+/*******************************************************
+ * FUNCTION: renderPD120LinePair
+ * DESCRIPTION: Renders columns [x0, x1) of line pair `pair` into `out`,
+ * reading each canvas pixel once. Splitting a pair into column ranges lets
+ * a cooperative caller yield between chunks. With stripeEnabled the bottom
+ * pairs are the telemetry stripe instead of canvas content.
+ * INPUT: const uint16_t* canvasBuffer (imageWidth x imageHeight RGB565, rows canvasStride apart),
+ * int pair (0..imageHeight/2-1), LinePairTones &out, int x0, int x1
+ * OUTPUT: None
+ *******************************************************/
+void renderPD120LinePair(const uint16_t* canvasBuffer, int pair, LinePairTones &out, int x0, int x1) {
+  if (stripeEnabled && pair >= stripeFirstPair) {
+    renderStripeLinePair(pair, out, x0, x1);
+    return;
+  }
+  const uint16_t* odd = canvasRow(canvasBuffer, 2 * pair);
+  const uint16_t* even = canvasRow(canvasBuffer, 2 * pair + 1);
+  for (int x = x0; x < x1; x++) {
+    int32_t y1, ry1, by1, y2, ry2, by2;
+    pixelToYCC(odd[x], y1, ry1, by1);
+    pixelToYCC(even[x], y2, ry2, by2);
+    out.yOdd[x]  = levelToFrequency[y1 >> 8];
+    out.yEven[x] = levelToFrequency[y2 >> 8];
+    out.ry[x] = diffToFrequency((ry1 + ry2) / 2);
+    out.by[x] = diffToFrequency((by1 + by2) / 2);
+  }
+}
+
+// ---------------------- Tone Level Schedules ----------------------
+/*******************************************************
+ * A tone level schedule is a whole picture as the levels (0..255, the
+ * index into levelToFrequency) of its scan segments in transmission
+ * order: Y odd, R-Y, B-Y, Y even of every PD120 line pair, or every line
+ * of a Robot B/W mode. It is as big as the canvas for PD120 but is played
+ * with one table lookup per pixel, so it can go on air straight from
+ * memory-mapped flash. The telemetry stripe is not part of it.
+ *******************************************************/
+
+/*******************************************************
+ * FUNCTION: scheduleGeometry
+ * DESCRIPTION: Levels per schedule line and number of lines of a mode
+ * (a PD120 line is a whole line pair; the Robot sizes are robotBWTimings).
+ * INPUT: SSTVMode mode, int &width, int &lines
+ * OUTPUT: bool (false for MODE_OFDM, which has no scan lines)
+ *******************************************************/
+bool scheduleGeometry(SSTVMode mode, int &width, int &lines) {
+  switch (mode) {
+    case MODE_PD120: width = 4 * imageWidth; lines = imageHeight / 2; return true;
+    case MODE_BW8:
+    case MODE_BW12:  width = 160; lines = 120; return true;
+    case MODE_BW24:  width = 320; lines = 240; return true;
+    default: width = lines = 0; return false;
+  }
+}
+
+/*******************************************************
+ * FUNCTION: renderScheduleLine
+ * DESCRIPTION: Renders line `line` of the tone level schedule of a mode
+ * from the canvas.
+ * INPUT: const uint16_t* canvasBuffer, SSTVMode mode, int line, uint8_t* levels (scheduleGeometry width)
+ * OUTPUT: None
+ *******************************************************/
+void renderScheduleLine(const uint16_t* canvasBuffer, SSTVMode mode, int line, uint8_t* levels) {
+  int width, lines;
+  if (!scheduleGeometry(mode, width, lines)) return;
+  if (mode != MODE_PD120) {
+    renderLumaLineLevels(canvasBuffer, line, width, lines, levels);
+    return;
+  }
+  const uint16_t* odd = canvasRow(canvasBuffer, 2 * line);
+  const uint16_t* even = canvasRow(canvasBuffer, 2 * line + 1);
+  for (int x = 0; x < imageWidth; x++) {
+    int32_t y1, ry1, by1, y2, ry2, by2;
+    pixelToYCC(odd[x], y1, ry1, by1);
+    pixelToYCC(even[x], y2, ry2, by2);
+    levels[x] = y1 >> 8;
+    levels[imageWidth + x] = diffToLevel((ry1 + ry2) / 2);
+    levels[2 * imageWidth + x] = diffToLevel((by1 + by2) / 2);
+    levels[3 * imageWidth + x] = y2 >> 8;
+  }
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef __SSTV_ROBOT_BW_H
+#define __SSTV_ROBOT_BW_H
+
+// ---------------------- Robot B/W Mode Parameters ----------------------
+/*******************************************************
+ * STRUCT: RobotBWTiming
+ * DESCRIPTION: Timing and geometry of one Robot monochrome mode.
+ * Each line is a 1200 Hz sync pulse followed by a single luminance scan.
+ *******************************************************/
+struct RobotBWTiming {
+  const char* name;        // Human readable mode name
+  uint8_t  visCode;        // VIS code sent in the header
+  int      width;          // Pixels per line
+  int      height;         // Lines per image
+  uint32_t syncDuration;   // Sync pulse (1200 Hz) in microseconds
+  uint32_t pixelDuration;  // Duration of one pixel in microseconds
+};
+
+/*******************************************************
+ * CONSTANT: robotBWTimings
+ * DESCRIPTION: Robot B/W 8, 12 and 24 (indexed by mode - MODE_BW8).
+ * Scan times are rounded to a whole number of microseconds per pixel
+ * (BW8: 59.8 ms, BW12/BW24: 93.1 ms per line).
+ *******************************************************/
+const RobotBWTiming robotBWTimings[] = {
+  { "Robot BW8",  2,  160, 120, 7000, 374 },  // approx.  8 s
+  { "Robot BW12", 6,  160, 120, 7000, 582 },  // approx. 12 s
+  { "Robot BW24", 10, 320, 240, 7000, 291 },  // approx. 24 s
+};
+
+/*******************************************************
+ * CONSTANT: robotBWMaxWidth
+ * DESCRIPTION: Widest line of any Robot B/W mode (size of the line buffer).
+ *******************************************************/
+const int robotBWMaxWidth = 320;
+
+/*******************************************************
+ * GLOBAL VARIABLE: bwLineTones
+ * DESCRIPTION: Tones of the line being transmitted, rendered while the
+ * sync pulse of the same line is on air. Kept in internal RAM so the
+ * timer callback never waits on PSRAM.
+ *******************************************************/
+uint16_t bwLineTones[robotBWMaxWidth];
+
+// ---------------------- Luma-only Pipeline ----------------------
+/*******************************************************
+ * FUNCTION: renderRobotBWLine
+ * DESCRIPTION: Renders one line of a Robot B/W mode into `tones`
+ * (renderLumaLine() on the global canvas).
+ * INPUT: const RobotBWTiming &mode (Mode parameters), int line (Output line number),
+ * uint16_t* tones (Destination, mode.width frequencies in Hz)
+ * OUTPUT: None
+ *******************************************************/
+void renderRobotBWLine(const RobotBWTiming &mode, int line, uint16_t* tones) {
+  renderLumaLine(canvas->getBuffer(), line, mode.width, mode.height, tones);
+}
+
+// ---------------------- Robot B/W Transmission ----------------------
+/*******************************************************
+ * FUNCTION: transmitRobotBWImage_HW
+ * DESCRIPTION: Transmits the VIS header and the complete image in one of the
+ * Robot B/W modes. For each line it:
+ * 1. Starts the Sync Pulse (1200 Hz) and renders the line while it is on air
+ * 2. Waits for the rest of the sync duration
+ * 3. Plays the rendered luminance scan through the hardware timer
+ * With mappedSchedule set the lines are played from the schedule instead.
+ * INPUT: SSTVMode mode (MODE_BW8, MODE_BW12 or MODE_BW24)
+ * OUTPUT: None
+ *******************************************************/
+void transmitRobotBWImage_HW(SSTVMode mode) {
+  const RobotBWTiming &timing = robotBWTimings[mode - MODE_BW8];
+
+  transmitVISHeader(timing.visCode);
+  Serial.printf("Sending %s image data...\n", timing.name);
+  for (int line = 0; line < timing.height; line++) {
+    // (1) Sync Pulse @ 1200 Hz, rendering the line meanwhile
+    ledcWriteTone(1200);
+    uint32_t start = micros();
+    const uint8_t* levels = NULL;
+    if (mappedSchedule) levels = stageLevels(mappedSchedule + line * timing.width, timing.width);
+    else renderRobotBWLine(timing, line, bwLineTones);
+    // (2) Remaining sync time
+    while ((micros() - start) < timing.syncDuration) { }
+    // (3) Y-Scan
+    if (levels) {
+      transmitLevelBuffer_HW(levels, timing.width, timing.pixelDuration);
+    } else {
+      transmitToneBuffer_HW(bwLineTones, timing.width, timing.pixelDuration);
+    }
+  }
+  // Stop the tone generation after transmission
+  toneOutputStop();
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+// ---------------------- Telemetry Sources ----------------------
+/*******************************************************
+ * GLOBAL VARIABLE: frameId (RTC memory)
+ * DESCRIPTION: Number of the picture being transmitted. Kept in RTC memory
+ * so it survives Deep Sleep; reset only by a power cycle.
+ *******************************************************/
+RTC_DATA_ATTR uint32_t frameId = 0;
+
+/*******************************************************
+ * FUNCTION: readBatteryMillivolts
+ * DESCRIPTION: Reads the battery voltage through the resistor divider
+ * on BATTERY_PIN.
+ * INPUT: None
+ * OUTPUT: uint32_t (Battery voltage in millivolts)
+ *******************************************************/
+uint32_t readBatteryMillivolts() {
+  return analogReadMilliVolts(BATTERY_PIN) * BATTERY_DIVIDER;
+}
+
+/*******************************************************
+ * FUNCTION: readTemperatureC
+ * DESCRIPTION: Reads the ESP32 internal temperature sensor (chip
+ * temperature, not ambient).
+ * INPUT: None
+ * OUTPUT: int (Temperature in degrees Celsius)
+ *******************************************************/
+int readTemperatureC() {
+  return (int)lrintf(temperatureRead());
+}
+
+#endif
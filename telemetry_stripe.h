@@ -0,0 +1,127 @@
+#ifndef __TELEMETRY_STRIPE_H
+#define __TELEMETRY_STRIPE_H
+
+/*******************************************************
+ * Machine-readable telemetry stripe.
+ * The bottom 8 lines of the PD120 image carry a 16-byte record as black
+ * and white blocks (2 rows of 80 cells, each cell 8 px x 4 lines, grey
+ * chroma). Every cell row starts with a white/black marker pair that the
+ * extractor uses as its threshold reference. The stripe is produced by
+ * the line-pair renderer itself: the canvas is never written.
+ * Included by sstv_render.h (needs imageWidth/imageHeight); plain C++ with
+ * no Arduino dependency (also used by tools/stripe_extract.cpp).
+ *******************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "crc16.h"
+
+// ---------------------- Stripe Layout ----------------------
+/*******************************************************
+ * CONSTANT: stripeLines / stripeCellWidth / stripeCellLines
+ * DESCRIPTION: Height of the stripe and size of one cell, in image pixels.
+ *******************************************************/
+const int stripeLines = 8;
+const int stripeCellWidth = 8;
+const int stripeCellLines = 4;
+/*******************************************************
+ * CONSTANT: stripeRows / stripeCellsPerRow / stripeMarkerCells
+ * DESCRIPTION: Cell grid of the stripe; the first stripeMarkerCells cells of
+ * every row are the white/black marker, the others carry data bits.
+ *******************************************************/
+const int stripeRows = stripeLines / stripeCellLines;
+const int stripeCellsPerRow = imageWidth / stripeCellWidth;
+const int stripeMarkerCells = 2;
+/*******************************************************
+ * CONSTANT: stripeFirstPair
+ * DESCRIPTION: First PD120 line pair replaced by the stripe.
+ *******************************************************/
+const int stripeFirstPair = (imageHeight - stripeLines) / 2;
+/*******************************************************
+ * CONSTANT: stripeBytes / stripeMagic / stripeVersion
+ * DESCRIPTION: Size of the record (fits the 156 data cells) and its
+ * identification bytes.
+ *******************************************************/
+const int stripeBytes = 16;
+const uint8_t stripeMagic = 0x5A;
+const uint8_t stripeVersion = 1;
+
+/*******************************************************
+ * STRUCT: StripeTelemetry
+ * DESCRIPTION: Content of the stripe record. Packed little endian as
+ * magic, version, mode, temperature + 100, frameId (4), batteryMv (2),
+ * flags (2), reserved (2), CRC-16/CCITT-FALSE of bytes 0..13 (2).
+ *******************************************************/
+struct StripeTelemetry {
+  uint8_t  mode;          // SSTVMode of the transmission
+  int      temperature;   // Chip temperature in degrees C
+  uint32_t frameId;       // Picture number
+  uint16_t batteryMv;     // Battery voltage in millivolts
+  uint16_t flags;         // Spare status bits
+};
+
+/*******************************************************
+ * GLOBAL VARIABLE: stripeRecord / stripeEnabled
+ * DESCRIPTION: Packed record drawn by the renderer, and whether the stripe
+ * replaces the bottom lines of the picture at all.
+ *******************************************************/
+uint8_t stripeRecord[stripeBytes];
+bool stripeEnabled = false;
+
+/*******************************************************
+ * FUNCTION: stripePack
+ * DESCRIPTION: Packs a StripeTelemetry into the 16-byte record.
+ * INPUT: const StripeTelemetry &t, uint8_t* out (stripeBytes)
+ * OUTPUT: None
+ *******************************************************/
+void stripePack(const StripeTelemetry &t, uint8_t* out) {
+  int temperature = t.temperature + 100;
+  out[0] = stripeMagic;
+  out[1] = stripeVersion;
+  out[2] = t.mode;
+  out[3] = temperature < 0 ? 0 : (temperature > 255 ? 255 : temperature);
+  for (int i = 0; i < 4; i++) out[4 + i] = t.frameId >> (8 * i);
+  out[8] = t.batteryMv & 0xFF;
+  out[9] = t.batteryMv >> 8;
+  out[10] = t.flags & 0xFF;
+  out[11] = t.flags >> 8;
+  out[12] = 0;
+  out[13] = 0;
+  uint16_t crc = crc16CCITT(out, stripeBytes - 2);
+  out[14] = crc & 0xFF;
+  out[15] = crc >> 8;
+}
+
+/*******************************************************
+ * FUNCTION: stripeUnpack
+ * DESCRIPTION: Checks magic, version and CRC of a record and unpacks it.
+ * INPUT: const uint8_t* in (stripeBytes), StripeTelemetry &t
+ * OUTPUT: bool (true if the record is valid)
+ *******************************************************/
+bool stripeUnpack(const uint8_t* in, StripeTelemetry &t) {
+  if (in[0] != stripeMagic || in[1] != stripeVersion) return false;
+  if (crc16CCITT(in, stripeBytes - 2) != (in[14] | (in[15] << 8))) return false;
+  t.mode = in[2];
+  t.temperature = in[3] - 100;
+  t.frameId = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+  t.batteryMv = in[8] | (in[9] << 8);
+  t.flags = in[10] | (in[11] << 8);
+  return true;
+}
+
+/*******************************************************
+ * FUNCTION: stripeCell
+ * DESCRIPTION: Value of a stripe cell: markers are white then black, data
+ * cells carry the record bits LSB first (1 = white), row by row; cells
+ * past the record are black.
+ * INPUT: const uint8_t* record, int row, int cell
+ * OUTPUT: bool (true = white)
+ *******************************************************/
+inline bool stripeCell(const uint8_t* record, int row, int cell) {
+  if (cell < stripeMarkerCells) return cell == 0;
+  int bit = row * (stripeCellsPerRow - stripeMarkerCells) + cell - stripeMarkerCells;
+  if (bit >= stripeBytes * 8) return false;
+  return (record[bit >> 3] >> (bit & 7)) & 1;
+}
+
+#endif
@@ -0,0 +1,350 @@
+/**
+ * @file: archive_thumbs.cpp
+ * @brief: **Reads and builds the SD archive index (thumbnails of the frames).**
+ * Uses the same archive_format.h, jpeg_dc_thumb.h and jpeg_strip_encoder.h
+ * as the firmware.
+ *
+ *   archive_thumbs thumb <frame.jpg> [thumb.ppm]         DC thumbnail of one JPEG, with timing
+ *   archive_thumbs encode <picture> <out.jpg> [quality] [grey]
+ *                                                        encode a BMP/PPM band by band as the
+ *                                                        beacon does, with timing per band
+ *   archive_thumbs index <index.bin> [sheet.ppm]         list the index, oldest first, and
+ *                                                        draw its thumbnails as a contact sheet
+ *   archive_thumbs rebuild <index.bin> <frame.jpg>...    write a new index for JPEGs copied
+ *                                                        off the card (sequence = argument order)
+ *   archive_thumbs quality <frame.jpg>... [--sharpness <min>] [--ratio <r>] [--obstruction <max>]
+ *                                                        quality gate verdicts for camera JPEGs
+ *                                                        taken one after the other
+ *
+ * The thumbnail is one pixel per 8x8 block, taken from the DC coefficient
+ * alone: `thumb` prints how long the decode takes (entropy decoding of the
+ * whole file, no IDCT), which bounds the time the beacon spends on it.
+ * `encode` converts the picture to RGB565 first (as on the canvas), checks
+ * that the encoder's thumbnail matches the DC thumbnail decoded back from
+ * its output, and prints the PSNR against the RGB565 picture.
+ * `quality` runs the beacon's quality gate (frame_quality.h) on the DC
+ * thumbnails, with the default limits unless given: use it on archived
+ * frames, oldest first, to set the QUALITY_* limits of the sketch.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -o archive_thumbs archive_thumbs.cpp
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "archive_format.h"
+#include "frame_quality.h"
+#include "jpeg_dc_thumb.h"
+#include "jpeg_strip_encoder.h"
+#include "picture_io.h"
+#include <cmath>
+
+static const char* modeNames[] = { "PD120", "BW8", "BW12", "BW24", "OFDM" };
+static JpegDCDecoder decoder;
+
+static bool readFile(const char* path, std::vector<uint8_t> &data) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static void rgb565ToPicture(const uint16_t* pixels, int width, int height, Picture &pic, int x0, int y0) {
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint16_t p = pixels[y * width + x];
+      uint8_t* out = &pic.rgb[((size_t)(y0 + y) * pic.width + x0 + x) * 3];
+      out[0] = (p >> 11) * 255 / 31;
+      out[1] = ((p >> 5) & 63) * 255 / 63;
+      out[2] = (p & 31) * 255 / 31;
+    }
+  }
+}
+
+// ---------------------- Thumbnail ----------------------
+static int thumb(const char* jpegPath, const char* ppmPath) {
+  std::vector<uint8_t> jpeg;
+  if (!readFile(jpegPath, jpeg)) {
+    perror(jpegPath);
+    return 2;
+  }
+  std::vector<uint16_t> pixels(jpegThumbMaxWidth * jpegThumbMaxWidth);
+  int width, height;
+  const int runs = 100;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; i++) {
+    if (!jpegDCThumbnail(decoder, jpeg.data(), jpeg.size(), pixels.data(), pixels.size(), width, height)) {
+      fprintf(stderr, "%s: not a baseline JPEG, or corrupt\n", jpegPath);
+      return 1;
+    }
+  }
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+  printf("%s: %dx%d, %zu bytes, %d component(s), sampling %dx%d, restart interval %u\n", jpegPath,
+         decoder.width, decoder.height, jpeg.size(), decoder.components, decoder.maxH, decoder.maxV,
+         decoder.restartInterval);
+  printf("thumbnail %dx%d in %.0f us\n", width, height, us);
+  if (ppmPath) {
+    Picture pic;
+    pic.width = width;
+    pic.height = height;
+    pic.rgb.resize((size_t)width * height * 3);
+    rgb565ToPicture(pixels.data(), width, height, pic, 0, 0);
+    if (!writePPM(ppmPath, pic)) fprintf(stderr, "%s: cannot write\n", ppmPath);
+  }
+  return 0;
+}
+
+// ---------------------- Strip Encoder ----------------------
+static bool fileWrite(void* context, const uint8_t* data, size_t len) {
+  return fwrite(data, 1, len, (FILE*)context) == len;
+}
+
+static int encode(const char* picturePath, const char* jpegPath, int quality, bool grey) {
+  Picture pic;
+  if (!readPicture(picturePath, pic)) {
+    fprintf(stderr, "%s: cannot read (24/32-bit BMP or binary PPM)\n", picturePath);
+    return 2;
+  }
+  std::vector<uint16_t> canvas((size_t)pic.width * pic.height);
+  for (size_t i = 0; i < canvas.size(); i++) {
+    const uint8_t* p = &pic.rgb[i * 3];
+    canvas[i] = ((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3);
+  }
+  FILE* f = fopen(jpegPath, "wb");
+  if (!f) {
+    perror(jpegPath);
+    return 2;
+  }
+  static JpegStripEncoder encoder;
+  std::vector<uint16_t> thumbnail((size_t)((pic.width + 7) / 8) * ((pic.height + 7) / 8));
+  auto start = std::chrono::steady_clock::now();
+  bool ok = jpegStripBegin(encoder, pic.width, pic.height, grey ? 1 : 3, quality, fileWrite, f, thumbnail.data());
+  double slowestBand = 0;
+  int bands = 0;
+  while (ok && encoder.rowsDone < pic.height) {
+    auto bandStart = std::chrono::steady_clock::now();
+    ok = jpegStripEncodeBand(encoder, canvas.data(), pic.width);
+    slowestBand = std::max(slowestBand, std::chrono::duration<double, std::micro>(
+                                            std::chrono::steady_clock::now() - bandStart).count());
+    bands++;
+  }
+  ok = ok && jpegStripEnd(encoder);
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  fclose(f);
+  if (!ok) {
+    fprintf(stderr, "%s: write failed\n", jpegPath);
+    return 2;
+  }
+  printf("%s: %dx%d %s q%d, %lu bytes, %d bands of %d rows in %.1f ms (slowest band %.0f us)\n", jpegPath,
+         pic.width, pic.height, grey ? "grey" : "4:2:0", quality, (unsigned long)encoder.bytes, bands,
+         jpegStripBandHeight(encoder), ms, slowestBand);
+
+  // The index thumbnail must be what a DC decode of the file gives
+  std::vector<uint8_t> jpeg;
+  std::vector<uint16_t> decoded(thumbnail.size());
+  int width, height;
+  if (!readFile(jpegPath, jpeg) ||
+      !jpegDCThumbnail(decoder, jpeg.data(), jpeg.size(), decoded.data(), decoded.size(), width, height)) {
+    fprintf(stderr, "%s: cannot decode the output\n", jpegPath);
+    return 1;
+  }
+  bool same = decoded == thumbnail;
+  printf("encoder thumbnail %dx%d %s the DC decode\n", width, height, same ? "matches" : "DIFFERS FROM");
+
+  // PSNR of the DC thumbnail against 8x8 block means of the RGB565 picture
+  double error = 0;
+  for (int ty = 0; ty < height; ty++) {
+    for (int tx = 0; tx < width; tx++) {
+      double sum[3] = { 0, 0, 0 };
+      int n = 0;
+      for (int y = ty * 8; y < std::min(ty * 8 + 8, pic.height); y++) {
+        for (int x = tx * 8; x < std::min(tx * 8 + 8, pic.width); x++, n++) {
+          uint16_t p = canvas[(size_t)y * pic.width + x];
+          double l = 0.299 * ((p >> 11) * 255 / 31) + 0.587 * (((p >> 5) & 63) * 255 / 63) + 0.114 * ((p & 31) * 255 / 31);
+          sum[0] += grey ? l : (p >> 11) * 255 / 31;
+          sum[1] += grey ? l : ((p >> 5) & 63) * 255 / 63;
+          sum[2] += grey ? l : (p & 31) * 255 / 31;
+        }
+      }
+      uint16_t t = thumbnail[ty * width + tx];
+      double got[3] = { (t >> 11) * 255 / 31.0, ((t >> 5) & 63) * 255 / 63.0, (t & 31) * 255 / 31.0 };
+      for (int c = 0; c < 3; c++) error += (got[c] - sum[c] / n) * (got[c] - sum[c] / n);
+    }
+  }
+  printf("thumbnail PSNR against 8x8 means: %.1f dB\n", 10 * log10(255.0 * 255.0 / (error / (width * height * 3))));
+  return same ? 0 : 1;
+}
+
+// ---------------------- Index Listing ----------------------
+static int listIndex(const char* indexPath, const char* sheetPath) {
+  std::vector<uint8_t> data;
+  if (!readFile(indexPath, data)) {
+    perror(indexPath);
+    return 2;
+  }
+  ArchiveIndexHeader header;
+  if (data.size() < sizeof(header)) {
+    fprintf(stderr, "%s: too short\n", indexPath);
+    return 1;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != archiveMagic || header.version != archiveVersion ||
+      header.thumbWidth != archiveThumbWidth || header.thumbHeight != archiveThumbHeight) {
+    fprintf(stderr, "%s: not an archive index (or another version)\n", indexPath);
+    return 1;
+  }
+
+  std::vector<ArchiveRecord> records;
+  int torn = 0;
+  for (uint32_t slot = 0; slot < header.slots; slot++) {
+    ArchiveRecord r;
+    if (archiveRecordOffset(slot) + sizeof(r) > data.size()) break;
+    memcpy(&r, &data[archiveRecordOffset(slot)], sizeof(r));
+    if (archiveValid(r)) {
+      records.push_back(r);
+    } else if (r.sequence != 0 || r.crc != 0) {
+      torn++;
+    }
+  }
+  std::sort(records.begin(), records.end(),
+            [](const ArchiveRecord &a, const ArchiveRecord &b) { return a.sequence < b.sequence; });
+
+  printf("sequence,slot,frame,utc,mode,width,height,jpeg_bytes,thumb_us\n");
+  for (const ArchiveRecord &r : records) {
+    char utc[24] = "";
+    if (r.timestamp) {
+      time_t t = r.timestamp;
+      strftime(utc, sizeof(utc), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+    }
+    printf("%lu,%lu,%lu,%s,%s,%u,%u,%lu,%u\n", (unsigned long)r.sequence, (unsigned long)(r.sequence % header.slots),
+           (unsigned long)r.frameId, utc, r.mode < 5 ? modeNames[r.mode] : "?", r.width, r.height,
+           (unsigned long)r.jpegBytes, r.thumbUs);
+  }
+  fprintf(stderr, "%zu frames in %u slots, next sequence %lu, %d torn record(s)\n", records.size(), header.slots,
+          (unsigned long)header.nextSequence, torn);
+
+  if (sheetPath && !records.empty()) {
+    const int columns = 8, gap = 2;
+    int rows = (records.size() + columns - 1) / columns;
+    Picture sheet;
+    sheet.width = columns * (archiveThumbWidth + gap) + gap;
+    sheet.height = rows * (archiveThumbHeight + gap) + gap;
+    sheet.rgb.assign((size_t)sheet.width * sheet.height * 3, 64);
+    for (size_t i = 0; i < records.size(); i++) {
+      if (!(records[i].flags & ARCHIVE_FLAG_THUMB)) continue;
+      rgb565ToPicture(records[i].thumb, archiveThumbWidth, archiveThumbHeight, sheet,
+                      gap + (i % columns) * (archiveThumbWidth + gap), gap + (i / columns) * (archiveThumbHeight + gap));
+    }
+    if (!writePPM(sheetPath, sheet)) fprintf(stderr, "%s: cannot write\n", sheetPath);
+  }
+  return 0;
+}
+
+// ---------------------- Index Rebuild ----------------------
+static int rebuild(const char* indexPath, char** jpegPaths, int count) {
+  ArchiveIndexHeader header = { archiveMagic, archiveVersion, (uint16_t)std::max(count, 1), archiveThumbWidth,
+                                archiveThumbHeight, (uint32_t)count };
+  std::vector<uint8_t> data(archiveRecordOffset(header.slots), 0);
+  memcpy(data.data(), &header, sizeof(header));
+  for (int i = 0; i < count; i++) {
+    std::vector<uint8_t> jpeg;
+    if (!readFile(jpegPaths[i], jpeg)) {
+      perror(jpegPaths[i]);
+      return 2;
+    }
+    ArchiveRecord r;
+    memset(&r, 0, sizeof(r));
+    int width, height;
+    auto start = std::chrono::steady_clock::now();
+    if (jpegDCThumbnail(decoder, jpeg.data(), jpeg.size(), r.thumb, archiveThumbWidth * archiveThumbHeight, width,
+                        height) && width <= archiveThumbWidth) {
+      for (int y = height - 1; y >= 0; y--) {
+        memmove(r.thumb + y * archiveThumbWidth, r.thumb + y * width, width * sizeof(uint16_t));
+        std::fill(r.thumb + y * archiveThumbWidth + width, r.thumb + (y + 1) * archiveThumbWidth, 0);
+      }
+      r.flags |= ARCHIVE_FLAG_THUMB;
+    } else {
+      memset(r.thumb, 0, sizeof(r.thumb));
+      fprintf(stderr, "%s: no thumbnail\n", jpegPaths[i]);
+    }
+    r.thumbUs = std::min<double>(65535, std::chrono::duration<double, std::micro>(
+                                            std::chrono::steady_clock::now() - start).count());
+    r.sequence = i;
+    r.frameId = i;
+    r.jpegBytes = jpeg.size();
+    if (r.flags & ARCHIVE_FLAG_THUMB) {
+      r.width = decoder.width;
+      r.height = decoder.height;
+    }
+    archiveSeal(r);
+    memcpy(&data[archiveRecordOffset(i)], &r, sizeof(r));
+  }
+  FILE* f = fopen(indexPath, "wb");
+  if (!f || fwrite(data.data(), 1, data.size(), f) != data.size()) {
+    perror(indexPath);
+    return 2;
+  }
+  fclose(f);
+  return 0;
+}
+
+// ---------------------- Quality Gate ----------------------
+static int quality(char** args, int count) {
+  float minSharpness = QUALITY_MIN_SHARPNESS, ratio = QUALITY_SHARPNESS_RATIO, maxObstruction = QUALITY_MAX_OBSTRUCTION;
+  std::vector<const char*> paths;
+  for (int i = 0; i < count; i++) {
+    if (!strcmp(args[i], "--sharpness") && i + 1 < count) { minSharpness = atof(args[++i]); continue; }
+    if (!strcmp(args[i], "--ratio") && i + 1 < count) { ratio = atof(args[++i]); continue; }
+    if (!strcmp(args[i], "--obstruction") && i + 1 < count) { maxObstruction = atof(args[++i]); continue; }
+    paths.push_back(args[i]);
+  }
+  std::vector<uint16_t> pixels(jpegThumbMaxWidth * jpegThumbMaxWidth);
+  FrameQualityReference reference = {};
+  int retaken = 0;
+  printf("%10s %9s %11s  verdict  file (sharpness >= %.1f and %.2f x reference, obstruction <= %.2f)\n",
+         "sharpness", "reference", "obstruction", minSharpness, ratio, maxObstruction);
+  for (const char* path : paths) {
+    std::vector<uint8_t> jpeg;
+    int width, height;
+    if (!readFile(path, jpeg) ||
+        !jpegDCThumbnail(decoder, jpeg.data(), jpeg.size(), pixels.data(), pixels.size(), width, height)) {
+      fprintf(stderr, "%s: not a baseline JPEG, or corrupt\n", path);
+      return 2;
+    }
+    // Frames in argument order, as consecutive wakes: those sent build the reference
+    FrameQuality q = frameQualityMeasure(pixels.data(), width, height);
+    bool pass = frameQualityJudge(q, reference, minSharpness, ratio, maxObstruction);
+    printf("%10.1f %9.1f %11.2f  %-7s  %s\n", q.sharpness, reference.sharpness, q.obstruction,
+           pass ? "send" : "retake", path);
+    if (pass) frameQualityLearn(reference, q);
+    retaken += !pass;
+  }
+  printf("%d of %zu frames would be retaken\n", retaken, paths.size());
+  return 0;
+}
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  std::string command = argc > 1 ? argv[1] : "";
+  if (command == "thumb" && (argc == 3 || argc == 4)) return thumb(argv[2], argc == 4 ? argv[3] : NULL);
+  if (command == "encode" && argc >= 4 && argc <= 6) {
+    return encode(argv[2], argv[3], argc >= 5 ? atoi(argv[4]) : 80, argc == 6 && std::string(argv[5]) == "grey");
+  }
+  if (command == "index" && (argc == 3 || argc == 4)) return listIndex(argv[2], argc == 4 ? argv[3] : NULL);
+  if (command == "rebuild" && argc >= 3) return rebuild(argv[2], argv + 3, argc - 3);
+  if (command == "quality" && argc >= 3) return quality(argv + 2, argc - 2);
+  fprintf(stderr,
+          "usage: %s thumb <frame.jpg> [thumb.ppm]\n"
+          "       %s encode <picture.bmp|ppm> <out.jpg> [quality] [grey]\n"
+          "       %s index <index.bin> [sheet.ppm]\n"
+          "       %s rebuild <index.bin> <frame.jpg>...\n"
+          "       %s quality <frame.jpg>... [--sharpness <min>] [--ratio <r>] [--obstruction <max>]\n",
+          argv[0], argv[0], argv[0], argv[0], argv[0]);
+  return 2;
+}
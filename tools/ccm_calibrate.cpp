@@ -0,0 +1,187 @@
+/**
+ * @file: ccm_calibrate.cpp
+ * @brief: **Colour correction matrix from a photo of a colour checker.**
+ * Fits, per output channel, the affine map (3x3 matrix + offset) that takes
+ * the 24 patches as seen by this camera to their reference sRGB values
+ * (least squares, in the gamma-encoded 8-bit domain the firmware works in),
+ * and prints it as the CCM_PROVISION line for the sketch.
+ *
+ *   ccm_calibrate <chart.bmp|chart.ppm> x0 y0 x1 y1 x2 y2 x3 y3 [corrected.ppm]
+ *   ccm_calibrate synth
+ *
+ * The photo should be taken by the beacon itself (same camera settings).
+ * x0 y0 .. x3 y3 are the centres of the four corner patches: dark skin
+ * (top left), bluish green (top right), black (bottom right) and white
+ * (bottom left). `synth` checks the fit on a chart with a known colour cast.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -o ccm_calibrate ccm_calibrate.cpp
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include "colour_correction.h"
+#include "picture_io.h"
+
+// ColorChecker 24, sRGB (D65) reference values, row by row from dark skin
+static const double reference[24][3] = {
+  { 115,  82,  68 }, { 194, 150, 130 }, {  98, 122, 157 }, {  87, 108,  67 }, { 133, 128, 177 }, { 103, 189, 170 },
+  { 214, 126,  44 }, {  80,  91, 166 }, { 193,  90,  99 }, {  94,  60, 108 }, { 157, 188,  64 }, { 224, 163,  46 },
+  {  56,  61, 150 }, {  70, 148,  73 }, { 175,  54,  60 }, { 231, 199,  31 }, { 187,  86, 149 }, {   8, 133, 161 },
+  { 243, 243, 242 }, { 200, 200, 200 }, { 160, 160, 160 }, { 122, 122, 121 }, {  85,  85,  85 }, {  52,  52,  52 },
+};
+
+// ---------------------- Patch Sampling ----------------------
+static void patchCentre(const double corners[4][2], int patch, double &x, double &y) {
+  double u = (patch % 6) / 5.0, v = (patch / 6) / 3.0;
+  for (int i = 0; i < 2; i++) {
+    double top = corners[0][i] + (corners[1][i] - corners[0][i]) * u;
+    double bottom = corners[3][i] + (corners[2][i] - corners[3][i]) * u;
+    (i ? y : x) = top + (bottom - top) * v;
+  }
+}
+
+static void samplePatches(const Picture &pic, const double corners[4][2], double measured[24][3]) {
+  double spacing = hypot(corners[1][0] - corners[0][0], corners[1][1] - corners[0][1]) / 5;
+  int radius = (int)(spacing / 4) > 1 ? (int)(spacing / 4) : 1;
+  for (int p = 0; p < 24; p++) {
+    double cx, cy;
+    patchCentre(corners, p, cx, cy);
+    double sum[3] = { 0, 0, 0 };
+    int count = 0;
+    for (int y = (int)cy - radius; y <= (int)cy + radius; y++) {
+      for (int x = (int)cx - radius; x <= (int)cx + radius; x++) {
+        if (x < 0 || y < 0 || x >= pic.width || y >= pic.height) continue;
+        const uint8_t* px = &pic.rgb[((size_t)y * pic.width + x) * 3];
+        for (int c = 0; c < 3; c++) sum[c] += px[c];
+        count++;
+      }
+    }
+    for (int c = 0; c < 3; c++) measured[p][c] = count ? sum[c] / count : 0;
+  }
+}
+
+// ---------------------- Least Squares Fit ----------------------
+// Solves the 4x4 system a * x = b in place (Gaussian elimination, partial pivoting).
+static bool solve4(double a[4][4], double b[4], double x[4]) {
+  for (int col = 0; col < 4; col++) {
+    int pivot = col;
+    for (int r = col + 1; r < 4; r++) if (fabs(a[r][col]) > fabs(a[pivot][col])) pivot = r;
+    if (fabs(a[pivot][col]) < 1e-9) return false;
+    for (int c = 0; c < 4; c++) std::swap(a[col][c], a[pivot][c]);
+    std::swap(b[col], b[pivot]);
+    for (int r = col + 1; r < 4; r++) {
+      double f = a[r][col] / a[col][col];
+      for (int c = col; c < 4; c++) a[r][c] -= f * a[col][c];
+      b[r] -= f * b[col];
+    }
+  }
+  for (int r = 3; r >= 0; r--) {
+    double s = b[r];
+    for (int c = r + 1; c < 4; c++) s -= a[r][c] * x[c];
+    x[r] = s / a[r][r];
+  }
+  return true;
+}
+
+static bool fitCorrection(const double measured[24][3], ColourCorrection &cc) {
+  for (int out = 0; out < 3; out++) {
+    double a[4][4] = {}, b[4] = {}, x[4];
+    for (int p = 0; p < 24; p++) {
+      const double v[4] = { measured[p][0], measured[p][1], measured[p][2], 1 };
+      for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) a[i][j] += v[i] * v[j];
+        b[i] += v[i] * reference[p][out];
+      }
+    }
+    if (!solve4(a, b, x)) return false;
+    for (int c = 0; c < 3; c++) cc.m[out][c] = (int16_t)lrint(x[c] * 256);
+    cc.offset[out] = (int16_t)lrint(x[3]);
+  }
+  return true;
+}
+
+static void applyCorrection(const ColourCorrection &cc, const double in[3], double out[3]) {
+  for (int r = 0; r < 3; r++) {
+    double v = cc.offset[r];
+    for (int c = 0; c < 3; c++) v += cc.m[r][c] * in[c] / 256.0;
+    out[r] = v < 0 ? 0 : (v > 255 ? 255 : v);
+  }
+}
+
+// RMS and worst patch error (Euclidean, 8-bit RGB) against the reference
+static void report(const char* label, const double values[24][3]) {
+  double total = 0, worst = 0;
+  int worstPatch = 0;
+  for (int p = 0; p < 24; p++) {
+    double e = 0;
+    for (int c = 0; c < 3; c++) e += (values[p][c] - reference[p][c]) * (values[p][c] - reference[p][c]);
+    total += e;
+    if (e > worst) {
+      worst = e;
+      worstPatch = p;
+    }
+  }
+  printf("%-10s RMS error %6.2f, worst patch %2d: %6.2f\n", label, sqrt(total / 24), worstPatch + 1, sqrt(worst));
+}
+
+static int calibrate(const double measured[24][3], ColourCorrection &cc) {
+  if (!fitCorrection(measured, cc)) {
+    fprintf(stderr, "fit failed: patches are not independent (wrong corners?)\n");
+    return 1;
+  }
+  double corrected[24][3];
+  for (int p = 0; p < 24; p++) applyCorrection(cc, measured[p], corrected[p]);
+  report("camera:", measured);
+  report("corrected:", corrected);
+  printf("\n#define CCM_PROVISION { { { %d, %d, %d }, { %d, %d, %d }, { %d, %d, %d } }, { %d, %d, %d } }\n",
+         cc.m[0][0], cc.m[0][1], cc.m[0][2], cc.m[1][0], cc.m[1][1], cc.m[1][2],
+         cc.m[2][0], cc.m[2][1], cc.m[2][2], cc.offset[0], cc.offset[1], cc.offset[2]);
+  return 0;
+}
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  ColourCorrection cc;
+  if (argc == 2 && std::string(argv[1]) == "synth") {
+    // Greenish, low-contrast camera: measured = cast * reference + offset + noise
+    static const double cast[3][3] = { { 0.80, 0.15, 0.00 }, { 0.05, 0.95, 0.05 }, { 0.00, 0.20, 0.70 } };
+    static const double castOffset[3] = { 12, 18, 10 };
+    std::mt19937 rng(3);
+    std::normal_distribution<double> noise(0.0, 1.5);
+    double measured[24][3];
+    for (int p = 0; p < 24; p++) {
+      for (int r = 0; r < 3; r++) {
+        double v = castOffset[r] + noise(rng);
+        for (int c = 0; c < 3; c++) v += cast[r][c] * reference[p][c];
+        measured[p][r] = v;
+      }
+    }
+    return calibrate(measured, cc);
+  }
+  if (argc < 10) {
+    fprintf(stderr, "usage: %s <chart.bmp|chart.ppm> x0 y0 x1 y1 x2 y2 x3 y3 [corrected.ppm]\n       %s synth\n", argv[0], argv[0]);
+    return 2;
+  }
+  Picture pic;
+  if (!readPicture(argv[1], pic)) {
+    fprintf(stderr, "%s: unsupported or unreadable picture\n", argv[1]);
+    return 2;
+  }
+  double corners[4][2];
+  for (int i = 0; i < 8; i++) corners[i / 2][i % 2] = atof(argv[2 + i]);
+  double measured[24][3];
+  samplePatches(pic, corners, measured);
+  int result = calibrate(measured, cc);
+  if (result == 0 && argc > 10) {
+    for (size_t i = 0; i < pic.rgb.size(); i += 3) {
+      double in[3] = { (double)pic.rgb[i], (double)pic.rgb[i + 1], (double)pic.rgb[i + 2] }, out[3];
+      applyCorrection(cc, in, out);
+      for (int c = 0; c < 3; c++) pic.rgb[i + c] = (uint8_t)lrint(out[c]);
+    }
+    if (!writePPM(argv[10], pic)) fprintf(stderr, "%s: cannot write\n", argv[10]);
+  }
+  return result;
+}
@@ -0,0 +1,385 @@
+/**
+ * @file: dtmf_wav.cpp
+ * @brief: **Runs the beacon DTMF decoder on WAV recordings.**
+ * Uses the same dtmf_decoder.h as the firmware.
+ *
+ *   dtmf_wav decode   <in.wav> [pin]
+ *   dtmf_wav generate <keys> <out.wav> [tone_ms] [gap_ms]
+ *   dtmf_wav selftest [dir]
+ *
+ * `decode` prints each key with its time and each completed command (PIN
+ * default 1234). Input is 16-bit PCM at any rate (resampled to 8 kHz,
+ * first channel) and is scaled to the 12-bit ADC range of the beacon, so
+ * full scale on the WAV is full scale on the ADC. Record the receiver
+ * audio with the level it will have on the ADC pin. `generate` writes an
+ * 8 kHz key sequence (default 100 ms tones, 100 ms gaps). `selftest`
+ * writes every case as a WAV (into dir if given, to inspect or replay),
+ * decodes it back and checks the keys: noise, twist, frequency offset,
+ * minimum timing, a held key, and no keys at all from speech-like audio,
+ * SSTV, noise and single tones. It also times the decoder per block.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -o dtmf_wav dtmf_wav.cpp
+ */
+
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "dtmf_decoder.h"
+
+// ---------------------- WAV I/O ----------------------
+static bool readFile(const char* path, std::vector<uint8_t> &data) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static bool writeFile(const char* path, const std::vector<uint8_t> &data) {
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+  return true;
+}
+
+static void put32(std::vector<uint8_t> &v, uint32_t x) { for (int i = 0; i < 4; i++) v.push_back(x >> (8 * i)); }
+static void put16(std::vector<uint8_t> &v, uint16_t x) { v.push_back(x & 0xFF); v.push_back(x >> 8); }
+static uint32_t get32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t get16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+
+static bool writeWav(const char* path, const std::vector<int16_t> &samples) {
+  std::vector<uint8_t> v;
+  v.insert(v.end(), { 'R', 'I', 'F', 'F' });
+  put32(v, 36 + samples.size() * 2);
+  v.insert(v.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+  put32(v, 16); put16(v, 1); put16(v, 1);
+  put32(v, dtmfSampleRate); put32(v, dtmfSampleRate * 2);
+  put16(v, 2); put16(v, 16);
+  v.insert(v.end(), { 'd', 'a', 't', 'a' });
+  put32(v, samples.size() * 2);
+  for (int16_t s : samples) put16(v, (uint16_t)s);
+  return writeFile(path, v);
+}
+
+// 16-bit PCM, first channel, linearly resampled to dtmfSampleRate
+static bool readWav(const char* path, std::vector<int16_t> &samples) {
+  std::vector<uint8_t> v;
+  if (!readFile(path, v) || v.size() < 12 || memcmp(v.data(), "RIFF", 4) || memcmp(v.data() + 8, "WAVE", 4)) return false;
+  int channels = 0, bits = 0;
+  uint32_t rate = 0;
+  for (size_t pos = 12; pos + 8 <= v.size();) {
+    uint32_t size = get32(&v[pos + 4]);
+    const uint8_t* body = &v[pos + 8];
+    if (!memcmp(&v[pos], "fmt ", 4)) {
+      channels = get16(body + 2); rate = get32(body + 4); bits = get16(body + 14);
+    } else if (!memcmp(&v[pos], "data", 4)) {
+      if (bits != 16 || channels < 1 || rate == 0) {
+        fprintf(stderr, "Need 16-bit PCM audio (got %d-bit, %d channels)\n", bits, channels);
+        return false;
+      }
+      size = std::min<size_t>(size, v.size() - pos - 8);
+      size_t frames = size / (2 * channels);
+      std::vector<int16_t> in(frames);
+      for (size_t i = 0; i < frames; i++) in[i] = (int16_t)get16(body + i * 2 * channels);
+      if (rate == (uint32_t)dtmfSampleRate) {
+        samples = in;
+        return true;
+      }
+      size_t out = frames * (uint64_t)dtmfSampleRate / rate;
+      samples.resize(out);
+      for (size_t i = 0; i < out; i++) {
+        double t = (double)i * rate / dtmfSampleRate;
+        size_t a = (size_t)t;
+        double f = t - a;
+        samples[i] = (int16_t)lround(in[a] * (1 - f) + (a + 1 < frames ? in[a + 1] : in[a]) * f);
+      }
+      return true;
+    }
+    pos += 8 + size + (size & 1);
+  }
+  return false;
+}
+
+// ---------------------- Decoding ----------------------
+// WAV samples to ADC counts (16-bit to 12-bit range), block by block
+static std::string decode(const std::vector<int16_t> &wav, const char* pin, bool print,
+                          std::vector<DtmfCommand>* commands = NULL) {
+  DtmfDecoder d;
+  dtmfDecoderInit(d, pin);
+  std::string keys;
+  int16_t block[dtmfBlock];
+  for (size_t start = 0; start + dtmfBlock <= wav.size(); start += dtmfBlock) {
+    for (int i = 0; i < dtmfBlock; i++) block[i] = wav[start + i] / 16;
+    char key;
+    DtmfCommand cmd = dtmfDecodeBlock(d, block, &key);
+    if (!key) continue;
+    keys += key;
+    if (print) printf("%8.3f s  %c\n", (double)start / dtmfSampleRate, key);
+    if (cmd.kind == DTMF_NONE) continue;
+    if (commands) commands->push_back(cmd);
+    if (print) {
+      static const char* names[] = { "", "transmit now", "mode", "interval (min)", "clear overrides", "rejected" };
+      if (cmd.kind == DTMF_MODE || cmd.kind == DTMF_INTERVAL) printf("          -> %s %u\n", names[cmd.kind], cmd.value);
+      else printf("          -> %s\n", names[cmd.kind]);
+    }
+  }
+  return keys;
+}
+
+// ---------------------- Synthesis ----------------------
+struct ToneOptions {
+  int toneMs = 100;
+  int gapMs = 100;
+  double amplitude = 6000;   // Per tone
+  double twistDb = 0;        // Column over row
+  double offset = 0;         // Relative frequency error
+};
+
+static int keyIndex(char key) {
+  const char* p = strchr(dtmfKeys, key);
+  return p && key ? (int)(p - dtmfKeys) : -1;
+}
+
+static void appendSilence(std::vector<double> &out, int ms) { out.insert(out.end(), (size_t)ms * dtmfSampleRate / 1000, 0.0); }
+
+static void appendKeys(std::vector<double> &out, const std::string &keys, const ToneOptions &o) {
+  for (char key : keys) {
+    int k = keyIndex(key);
+    if (k < 0) continue;
+    double row = dtmfTones[k / 4] * (1 + o.offset), column = dtmfTones[4 + k % 4] * (1 + o.offset);
+    double columnAmplitude = o.amplitude * pow(10.0, o.twistDb / 20);
+    int n = o.toneMs * dtmfSampleRate / 1000;
+    for (int i = 0; i < n; i++) {
+      double t = (double)i / dtmfSampleRate;
+      out.push_back(o.amplitude * sin(2 * M_PI * row * t) + columnAmplitude * sin(2 * M_PI * column * t));
+    }
+    appendSilence(out, o.gapMs);
+  }
+}
+
+static void addNoise(std::vector<double> &out, double rms, std::mt19937 &rng) {
+  std::normal_distribution<double> noise(0.0, rms);
+  for (double &s : out) s += noise(rng);
+}
+
+static std::vector<int16_t> toPcm(const std::vector<double> &in) {
+  std::vector<int16_t> out(in.size());
+  for (size_t i = 0; i < in.size(); i++) out[i] = (int16_t)std::max(-32768.0, std::min(32767.0, round(in[i])));
+  return out;
+}
+
+// Voiced speech: harmonics of a gliding pitch (-6 dB/octave) through three
+// formant resonances, with new targets every 150 ms
+static void appendSpeech(std::vector<double> &out, int ms, std::mt19937 &rng) {
+  std::uniform_real_distribution<double> pitch(90, 250), f1(300, 900), f2(900, 2300), f3(2300, 3200);
+  double phase[45] = { 0 };
+  int n = ms * dtmfSampleRate / 1000, segment = dtmfSampleRate * 3 / 20;
+  double from[4] = { pitch(rng), f1(rng), f2(rng), f3(rng) }, to[4] = { pitch(rng), f1(rng), f2(rng), f3(rng) };
+  const double bandwidth[3] = { 90, 110, 160 };
+  for (int i = 0; i < n; i++) {
+    if (i % segment == 0) {
+      for (int k = 0; k < 4; k++) from[k] = to[k];
+      to[0] = pitch(rng); to[1] = f1(rng); to[2] = f2(rng); to[3] = f3(rng);
+    }
+    double u = (double)(i % segment) / segment, track[4];
+    for (int k = 0; k < 4; k++) track[k] = from[k] + (to[k] - from[k]) * u;
+    double s = 0;
+    for (int h = 1; h < 45 && h * track[0] < 3800; h++) {
+      double f = h * track[0], gain = 0;
+      for (int k = 0; k < 3; k++) gain += 1 / sqrt(1 + pow(2 * (f - track[k + 1]) / bandwidth[k], 2));
+      phase[h] += 2 * M_PI * f / dtmfSampleRate;
+      s += gain / h * sin(phase[h]);
+    }
+    out.push_back(4000 * s);
+  }
+}
+
+// SSTV-like: 1200 Hz sync and random 1500-2300 Hz pixels, continuous phase
+static void appendSstv(std::vector<double> &out, int ms, std::mt19937 &rng) {
+  std::uniform_real_distribution<double> pixel(1500, 2300);
+  int n = ms * dtmfSampleRate / 1000;
+  double phase = 0, f = 1200;
+  for (int i = 0; i < n; i++) {
+    int inLine = i % 1600;   // 200 ms lines, 5 ms sync
+    if (inLine < 40) f = 1200;
+    else if (i % 4 == 0) f = pixel(rng);
+    phase += 2 * M_PI * f / dtmfSampleRate;
+    out.push_back(12000 * sin(phase));
+  }
+}
+
+// ---------------------- Self Test ----------------------
+static bool check(bool ok, const char* what) {
+  printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+static std::string selftestDir;
+
+// Writes the case as a WAV, reads it back and decodes it
+static std::string roundTrip(const char* name, const std::vector<double> &audio, std::vector<DtmfCommand>* commands = NULL) {
+  std::string file;
+  for (const char* c = name; *c; c++) {
+    if (isalnum((unsigned char)*c)) file += tolower(*c);
+    else if (*c == '+' || *c == '-') file += *c == '+' ? "plus" : "minus";
+    else if (!file.empty() && file.back() != '_') file += '_';
+  }
+  if (!file.empty() && file.back() == '_') file.pop_back();
+  std::string path = selftestDir.empty() ? std::string("dtmf_selftest.wav") : selftestDir + "/" + file + ".wav";
+  std::vector<int16_t> wav;
+  if (!writeWav(path.c_str(), toPcm(audio)) || !readWav(path.c_str(), wav)) return "<io error>";
+  if (selftestDir.empty()) remove(path.c_str());
+  return decode(wav, "1234", false, commands);
+}
+
+// Decodes the keys at several block alignments
+static bool keysAt(const char* name, const std::string &keys, const ToneOptions &o, double noiseRms,
+                   const std::string &expect, std::mt19937 &rng) {
+  bool ok = true;
+  for (int align = 0; align < 8; align++) {
+    std::vector<double> audio;
+    appendSilence(audio, 50);
+    audio.insert(audio.end(), align * dtmfBlock / 8, 0.0);
+    appendKeys(audio, keys, o);
+    if (noiseRms > 0) addNoise(audio, noiseRms, rng);
+    std::string got = roundTrip(name, audio);
+    if (got != expect) {
+      printf("  %s, alignment %d/8: got \"%s\"\n", name, align, got.c_str());
+      ok = false;
+    }
+  }
+  return check(ok, name);
+}
+
+static int selftest() {
+  std::mt19937 rng(11);
+  const std::string all = "123A456B789C*0#D";
+  bool ok = true;
+  ToneOptions o;
+
+  ok &= keysAt("all 16 keys, clean", all, o, 0, all, rng);
+  // Two tones of amplitude A: signal power A^2; 10 dB SNR over the whole 0-4 kHz band
+  ok &= keysAt("white noise, 10 dB SNR", all, o, o.amplitude / sqrt(10.0), all, rng);
+  ok &= keysAt("white noise, 3 dB SNR", all, o, o.amplitude / sqrt(2.0), all, rng);
+  ToneOptions t = o;
+  t.twistDb = 6;
+  ok &= keysAt("twist +6 dB (column stronger)", all, t, 0, all, rng);
+  t.twistDb = -6;
+  ok &= keysAt("twist -6 dB (row stronger)", all, t, 0, all, rng);
+  t.twistDb = 12;
+  ok &= keysAt("twist +12 dB rejected", all, t, 0, "", rng);
+  ToneOptions f = o;
+  f.offset = 0.015;
+  ok &= keysAt("frequency +1.5%", all, f, 0, all, rng);
+  f.offset = -0.015;
+  ok &= keysAt("frequency -1.5%", all, f, 0, all, rng);
+  ToneOptions fast = o;
+  fast.toneMs = 80;
+  fast.gapMs = 60;
+  ok &= keysAt("80 ms tones, 60 ms gaps", all + all, fast, 0, all + all, rng);
+  ok &= keysAt("repeated key", "7777", fast, 0, "7777", rng);
+  ToneOptions held = o;
+  held.toneMs = 1500;
+  ok &= keysAt("held key counts once", "5", held, 0, "5", rng);
+  ToneOptions quiet = o;
+  quiet.amplitude = 16 * 6;   // About 6 ADC counts
+  ok &= keysAt("below DTMF_MIN_LEVEL ignored", all, quiet, 0, "", rng);
+
+  std::vector<double> speech;
+  appendSpeech(speech, 30000, rng);
+  ok &= check(roundTrip("speech", speech).empty(), "30 s speech-like audio: no keys");
+  std::vector<double> sstv;
+  appendSstv(sstv, 30000, rng);
+  ok &= check(roundTrip("sstv", sstv).empty(), "30 s SSTV-like audio: no keys");
+  std::vector<double> noise;
+  appendSilence(noise, 30000);
+  addNoise(noise, 8000, rng);
+  ok &= check(roundTrip("noise", noise).empty(), "30 s white noise: no keys");
+  bool single = true;
+  for (int k = 0; k < 8; k++) {
+    std::vector<double> tone;
+    for (int i = 0; i < dtmfSampleRate; i++) tone.push_back(8000 * sin(2 * M_PI * dtmfTones[k] * i / dtmfSampleRate));
+    single &= roundTrip("single", tone).empty();
+  }
+  ok &= check(single, "single DTMF tones: no keys");
+
+  // Commands, with the long '*' the sender uses to wake the listener
+  std::vector<double> audio;
+  ToneOptions wake = o;
+  wake.toneMs = 1500;
+  appendKeys(audio, "*", wake);
+  appendKeys(audio, "12341#*123423#*1234315#*99991#*12342#*12340#*12342", o);
+  appendSpeech(audio, 500, rng);
+  appendKeys(audio, "9#", o);
+  std::vector<DtmfCommand> cmds;
+  roundTrip("commands", audio, &cmds);
+  ok &= check(cmds.size() == 7, "7 commands");
+  if (cmds.size() == 7) {
+    ok &= check(cmds[0].kind == DTMF_TRANSMIT, "*12341# transmit now");
+    ok &= check(cmds[1].kind == DTMF_MODE && cmds[1].value == 3, "*123423# mode 3");
+    ok &= check(cmds[2].kind == DTMF_INTERVAL && cmds[2].value == 15, "*1234315# interval 15 min");
+    ok &= check(cmds[3].kind == DTMF_REJECTED, "*99991# wrong PIN rejected");
+    ok &= check(cmds[4].kind == DTMF_REJECTED, "*12342# mode without value rejected");
+    ok &= check(cmds[5].kind == DTMF_CLEAR, "*12340# clear");
+    ok &= check(cmds[6].kind == DTMF_MODE && cmds[6].value == 9, "mode across speech (range checked by beacon)");
+  }
+
+  // Decoder cost per block (the beacon budget is a few percent of a core)
+  std::vector<int16_t> block(dtmfBlock);
+  for (int i = 0; i < dtmfBlock; i++) block[i] = (int16_t)(2048 + 500 * sin(2 * M_PI * 770 * i / dtmfSampleRate));
+  DtmfDecoder d;
+  dtmfDecoderInit(d, "1234");
+  const int runs = 20000;
+  volatile int sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < runs; r++) sink += dtmfDecodeBlock(d, block.data()).kind;
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs;
+  double blockNs = 1e9 * dtmfBlock / dtmfSampleRate;
+  printf("decoder: %.0f ns per %d-sample block, %.3f%% of real time on this host\n", ns, dtmfBlock,
+         100.0 * ns / blockNs);
+  return ok ? 0 : 1;
+}
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  std::string cmd = argc > 1 ? argv[1] : "";
+  if (cmd == "selftest") {
+    if (argc > 2) selftestDir = argv[2];
+    return selftest();
+  }
+  if (cmd == "decode" && (argc == 3 || argc == 4)) {
+    std::vector<int16_t> wav;
+    if (!readWav(argv[2], wav)) {
+      fprintf(stderr, "Cannot read %s\n", argv[2]);
+      return 1;
+    }
+    decode(wav, argc == 4 ? argv[3] : "1234", true);
+    return 0;
+  }
+  if (cmd == "generate" && argc >= 4 && argc <= 6) {
+    ToneOptions o;
+    if (argc > 4) o.toneMs = atoi(argv[4]);
+    if (argc > 5) o.gapMs = atoi(argv[5]);
+    std::vector<double> audio;
+    appendSilence(audio, 200);
+    appendKeys(audio, argv[2], o);
+    if (!writeWav(argv[3], toPcm(audio))) {
+      fprintf(stderr, "Cannot write %s\n", argv[3]);
+      return 1;
+    }
+    return 0;
+  }
+  fprintf(stderr, "usage: %s decode <in.wav> [pin]\n"
+                  "       %s generate <keys> <out.wav> [tone_ms] [gap_ms]\n"
+                  "       %s selftest [dir]\n", argv[0], argv[0], argv[0]);
+  return 2;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file: journal_decode.cpp
+ * @brief: **Decodes a dump of the telemetry journal partition to CSV.**
+ * Uses the same journal_format.h as the firmware.
+ *
+ *   esptool.py read_flash 0x310000 0xE0000 journal.bin
+ *   journal_decode journal.bin > journal.csv
+ *
+ * Valid records are printed oldest first (by sequence number, the ring may
+ * have wrapped). A summary goes to stderr: records, torn slots (power lost
+ * during a write), sequence gaps (records lost with the RTC buffer on a
+ * power cycle, or overwritten by the ring), jitter figures over the whole
+ * journal (apart for the wakes on the esp_timer pixel clock and on the
+ * isolated one of TX_ISOLATION, before and after), and how many frames
+ * fell back to pre-rendered PD120.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -o journal_decode journal_decode.cpp
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "journal_format.h"
+
+static const char* modeNames[] = { "PD120", "BW8", "BW12", "BW24", "OFDM" };
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <journal.bin>\n", argv[0]);
+    return 2;
+  }
+  FILE* f = fopen(argv[1], "rb");
+  if (!f) {
+    perror(argv[1]);
+    return 2;
+  }
+  std::vector<JournalRecord> records;
+  size_t slots = 0, torn = 0;
+  JournalRecord r;
+  while (fread(&r, sizeof(r), 1, f) == 1) {
+    slots++;
+    if (journalValid(r)) {
+      records.push_back(r);
+    } else if (!journalErased(r)) {
+      torn++;
+    }
+  }
+  fclose(f);
+  std::sort(records.begin(), records.end(),
+            [](const JournalRecord &a, const JournalRecord &b) { return a.sequence < b.sequence; });
+
+  printf("sequence,timestamp,frames,mode,capture_ms,decode_ms,compose_ms,transmit_s,"
+         "jitter_p99_us,jitter_max_us,battery_mv,temperature_c,skipped,power_on,frame_skipped,fallback,"
+         "retaken,poor,isolated\n");
+  size_t gaps = 0, lost = 0, fallbacks = 0, retaken = 0, poor = 0;
+  uint32_t worstJitter[2] = { 0, 0 };
+  std::vector<uint16_t> p99[2];   // esp_timer clock, isolated clock
+  for (size_t i = 0; i < records.size(); i++) {
+    const JournalRecord &j = records[i];
+    if (i > 0 && j.sequence != records[i - 1].sequence + 1) {
+      gaps++;
+      lost += j.sequence - records[i - 1].sequence - 1;
+    }
+    printf("%u,%u,%u,%s,%u,%u,%u,%.1f,%u,%u,%u,%d,%u,%d,%d,%d,%d,%d,%d\n",
+           j.sequence, j.timestamp, j.frames, j.mode < 5 ? modeNames[j.mode] : "?",
+           j.captureMs, j.decodeMs, j.composeMs, j.transmitDs / 10.0,
+           j.jitterP99Us, j.jitterMaxUs, j.batteryMv, j.temperature, j.skipped,
+           (j.flags & JOURNAL_FLAG_POWER_ON) != 0, (j.flags & JOURNAL_FLAG_SKIPPED) != 0,
+           (j.flags & JOURNAL_FLAG_FALLBACK) != 0, (j.flags & JOURNAL_FLAG_RETAKEN) != 0,
+           (j.flags & JOURNAL_FLAG_POOR) != 0, (j.flags & JOURNAL_FLAG_ISOLATED) != 0);
+    fallbacks += (j.flags & JOURNAL_FLAG_FALLBACK) != 0;
+    retaken += (j.flags & JOURNAL_FLAG_RETAKEN) != 0;
+    poor += (j.flags & JOURNAL_FLAG_POOR) != 0;
+    int isolated = (j.flags & JOURNAL_FLAG_ISOLATED) != 0;
+    worstJitter[isolated] = std::max<uint32_t>(worstJitter[isolated], j.jitterMaxUs);
+    p99[isolated].push_back(j.jitterP99Us);
+  }
+
+  fprintf(stderr, "slots:   %zu (%zu records, %zu torn)\n", slots, records.size(), torn);
+  if (records.empty()) return torn ? 1 : 0;
+  fprintf(stderr, "range:   sequence %u..%u, %zu gaps (%zu records missing)\n",
+          records.front().sequence, records.back().sequence, gaps, lost);
+  for (int isolated = 0; isolated < 2; isolated++) {
+    std::vector<uint16_t> &p = p99[isolated];
+    if (p.empty()) continue;
+    std::sort(p.begin(), p.end());
+    fprintf(stderr, "jitter:  %s clock, %zu wakes: p99 median %u us, p99 worst %u us, max %u us\n",
+            isolated ? "isolated" : "esp_timer", p.size(), p[p.size() / 2], p.back(), worstJitter[isolated]);
+  }
+  fprintf(stderr, "deadline: %zu of %zu frames fell back to pre-rendered PD120 (%.1f%%)\n",
+          fallbacks, records.size(), 100.0 * fallbacks / records.size());
+  fprintf(stderr, "quality: %zu frames retaken, %zu sent below the gate limits\n", retaken, poor);
+  return 0;
+}
@@ -0,0 +1,310 @@
+/**
+ * @file: mode_psnr.cpp
+ * @brief: **Round-trip PSNR harness for the automatic mode selection.**
+ * Renders each picture with the firmware kernels (sstv_render.h) in PD120,
+ * BW24, BW12 and BW8, decodes the tones back as a receiver would (levels,
+ * YCbCr to RGB, nearest upscale to 640x480) and measures the PSNR against
+ * the camera content. Next to it, the scene metrics (scene_metrics.h) and
+ * the mode AUTO_MODE would pick, compared with the oracle: the shortest
+ * mode whose PSNR reaches the target.
+ *
+ *   mode_psnr [options] [picture.bmp|picture.ppm ...]
+ *     --target dB           PSNR a mode must reach to keep the content (30)
+ *     --colour C            AUTO_COLOUR_THRESHOLD
+ *     --detail-pd120 D      AUTO_DETAIL_PD120
+ *     --detail-bw24 D       AUTO_DETAIL_BW24
+ *     --sweep               search thresholds: no pick below target, least airtime
+ *
+ * Without pictures a built-in set of synthetic scenes (fog, night, snow,
+ * overcast, texture, text, sunset, forest, colour bars) is used.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -o mode_psnr mode_psnr.cpp
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "sstv_render.h"
+#include "scene_metrics.h"
+#include "picture_io.h"
+
+// Same packing as the sketch
+#define RGB565_CONV(r, g, b) ((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | ((b) >> 3))
+
+// Rows of camera content (the colour bar below it is not part of the scene)
+static const int contentHeight = 480;
+
+struct ModeInfo {
+  SSTVMode mode;
+  const char* name;
+  int width, height;   // 0 = PD120 colour
+  double airtime;      // Seconds
+};
+
+// In order of airtime
+static const ModeInfo modes[] = {
+  { MODE_BW8,   "BW8",   160, 120,   8.0 },
+  { MODE_BW12,  "BW12",  160, 120,  12.0 },
+  { MODE_BW24,  "BW24",  320, 240,  24.0 },
+  { MODE_PD120, "PD120",   0,   0, 126.1 },
+};
+static const int modeCount = sizeof(modes) / sizeof(modes[0]);
+
+struct Scene {
+  std::string name;
+  std::vector<uint16_t> canvas;   // imageWidth x imageHeight RGB565
+  SceneStats stats;
+  double psnr[modeCount];
+};
+
+// ---------------------- Canvas ----------------------
+static uint16_t toRGB565(double r, double g, double b) {
+  auto clip = [](double v) { return (int)(v < 0 ? 0 : (v > 255 ? 255 : v + 0.5)); };
+  return RGB565_CONV(clip(r), clip(g), clip(b));
+}
+
+static void expand(uint16_t pixel, double &r, double &g, double &b) {
+  r = (((pixel >> 11) & 0x1F) * 255) / 31;
+  g = (((pixel >> 5) & 0x3F) * 255) / 63;
+  b = ((pixel & 0x1F) * 255) / 31;
+}
+
+static void pictureToCanvas(const Picture &pic, std::vector<uint16_t> &canvas) {
+  canvas.assign((size_t)imageWidth * imageHeight, 0x29ee);
+  for (int y = 0; y < contentHeight; y++) {
+    for (int x = 0; x < imageWidth; x++) {
+      const uint8_t* p = &pic.rgb[((size_t)(y * pic.height / contentHeight) * pic.width + x * pic.width / imageWidth) * 3];
+      canvas[(size_t)y * imageWidth + x] = toRGB565(p[0], p[1], p[2]);
+    }
+  }
+}
+
+// ---------------------- Synthetic Scenes ----------------------
+typedef void (*SceneFn)(int x, int y, std::mt19937 &rng, double &r, double &g, double &b);
+
+static double noise(std::mt19937 &rng, double sigma) {
+  return std::normal_distribution<double>(0.0, sigma)(rng);
+}
+
+static void fog(int, int y, std::mt19937 &rng, double &r, double &g, double &b) {
+  r = g = b = 165 + 25.0 * y / contentHeight + noise(rng, 2);
+  b += 3;
+}
+static void night(int x, int y, std::mt19937 &rng, double &r, double &g, double &b) {
+  r = g = b = 12 + noise(rng, 4);
+  for (int i = 0; i < 6; i++) {
+    int lx = 60 + i * 100, ly = 300 + (i % 3) * 40;
+    if ((x - lx) * (x - lx) + (y - ly) * (y - ly) < 36) r = g = b = 240;
+  }
+}
+static void snow(int x, int y, std::mt19937 &rng, double &r, double &g, double &b) {
+  r = g = b = 235 + 8 * sin(x / 90.0) * cos(y / 70.0) + noise(rng, 2);
+}
+static void overcast(int x, int y, std::mt19937 &rng, double &r, double &g, double &b) {
+  if (y < 200) r = g = b = 200 + noise(rng, 2);
+  else r = g = b = 110 + 35 * sin(x / 23.0) * sin(y / 17.0) + 15 * sin(x / 7.0 + y / 11.0) + noise(rng, 3);
+}
+static void texture(int x, int y, std::mt19937 &rng, double &r, double &g, double &b) {
+  r = g = b = (((x / 2) + (y / 2)) & 1 ? 190 : 60) + noise(rng, 3);
+}
+static void text(int x, int y, std::mt19937 &rng, double &r, double &g, double &b) {
+  bool stroke = (y % 24) < 16 && (x % 11 == 0 || x % 11 == 1 || (y % 24) % 8 == 0) && ((x / 55 + y / 24) % 3);
+  r = g = b = (stroke ? 20 : 230) + noise(rng, 2);
+}
+static void sunset(int, int y, std::mt19937 &rng, double &r, double &g, double &b) {
+  double t = y / (double)contentHeight;
+  r = 60 + 190 * t + noise(rng, 2);
+  g = 60 + 80 * t + noise(rng, 2);
+  b = 170 - 120 * t + noise(rng, 2);
+}
+static void forest(int x, int y, std::mt19937 &rng, double &r, double &g, double &b) {
+  double l = 90 + 40 * sin(x / 5.0) * sin(y / 6.0) + noise(rng, 6);
+  r = 0.6 * l;
+  g = l;
+  b = 0.4 * l;
+}
+static void bars(int x, int, std::mt19937 &rng, double &r, double &g, double &b) {
+  static const uint8_t c[8][3] = { {255,255,255}, {255,255,0}, {0,255,255}, {0,255,0}, {255,0,255}, {255,0,0}, {0,0,255}, {0,0,0} };
+  const uint8_t* p = c[x * 8 / imageWidth];
+  r = p[0] + noise(rng, 2);
+  g = p[1] + noise(rng, 2);
+  b = p[2] + noise(rng, 2);
+}
+
+static void syntheticCanvas(SceneFn fn, std::vector<uint16_t> &canvas) {
+  std::mt19937 rng(7);
+  canvas.assign((size_t)imageWidth * imageHeight, 0x29ee);
+  for (int y = 0; y < contentHeight; y++) {
+    for (int x = 0; x < imageWidth; x++) {
+      double r, g, b;
+      fn(x, y, rng, r, g, b);
+      canvas[(size_t)y * imageWidth + x] = toRGB565(r, g, b);
+    }
+  }
+}
+
+// ---------------------- Round Trip ----------------------
+static double levelOf(uint16_t frequency) {
+  return (frequency - 1500) * 255.0 / 800;
+}
+
+static double psnr(const std::vector<uint16_t> &canvas, const std::vector<double> &rgb) {
+  double se = 0;
+  for (int i = 0; i < imageWidth * contentHeight; i++) {
+    double r, g, b;
+    expand(canvas[i], r, g, b);
+    se += (r - rgb[3 * i]) * (r - rgb[3 * i]) + (g - rgb[3 * i + 1]) * (g - rgb[3 * i + 1]) + (b - rgb[3 * i + 2]) * (b - rgb[3 * i + 2]);
+  }
+  double mse = se / (3.0 * imageWidth * contentHeight);
+  return mse > 0 ? 10 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+static double roundTrip(const std::vector<uint16_t> &canvas, const ModeInfo &mode) {
+  std::vector<double> rgb((size_t)imageWidth * contentHeight * 3);
+  auto clip = [](double v) { return v < 0 ? 0 : (v > 255 ? 255 : v); };
+  if (mode.width == 0) {
+    static LinePairTones tones;
+    for (int pair = 0; pair < contentHeight / 2; pair++) {
+      renderPD120LinePair(canvas.data(), pair, tones, 0, imageWidth);
+      for (int line = 0; line < 2; line++) {
+        for (int x = 0; x < imageWidth; x++) {
+          double y = levelOf(line ? tones.yEven[x] : tones.yOdd[x]);
+          double r = y + (levelOf(tones.ry[x]) - 128) / 0.713;
+          double b = y + (levelOf(tones.by[x]) - 128) / 0.564;
+          double g = (y - 0.299 * r - 0.114 * b) / 0.587;
+          double* out = &rgb[((size_t)(2 * pair + line) * imageWidth + x) * 3];
+          out[0] = clip(r);
+          out[1] = clip(g);
+          out[2] = clip(b);
+        }
+      }
+    }
+  } else {
+    std::vector<uint16_t> tones(mode.width);
+    for (int line = 0; line < mode.height; line++) {
+      renderLumaLine(canvas.data(), line, mode.width, mode.height, tones.data());
+      for (int y = 0; y < contentHeight; y++) {
+        if (y * mode.height / imageHeight != line) continue;
+        for (int x = 0; x < imageWidth; x++) {
+          double* out = &rgb[((size_t)y * imageWidth + x) * 3];
+          out[0] = out[1] = out[2] = levelOf(tones[x * mode.width / imageWidth]);
+        }
+      }
+    }
+  }
+  return psnr(canvas, rgb);
+}
+
+static void analyse(Scene &scene) {
+  for (int y = 0; y < contentHeight; y++) {
+    const uint16_t* row = &scene.canvas[(size_t)y * imageWidth];
+    sceneAccumulateRow(scene.stats, row, y ? row - imageWidth : nullptr, imageWidth);
+  }
+  for (int m = 0; m < modeCount; m++) scene.psnr[m] = roundTrip(scene.canvas, modes[m]);
+}
+
+static int modeIndex(SSTVMode mode) {
+  for (int m = 0; m < modeCount; m++) if (modes[m].mode == mode) return m;
+  return modeCount - 1;
+}
+
+static int oracle(const Scene &scene, double target) {
+  for (int m = 0; m < modeCount; m++) if (scene.psnr[m] >= target) return m;
+  return modeCount - 1;
+}
+
+// Airtime of the automatic picks and number of picks below the target (and below the oracle)
+static double evaluate(const std::vector<Scene> &scenes, const SceneThresholds &limits, double target, int &misses) {
+  double airtime = 0;
+  misses = 0;
+  for (const Scene &scene : scenes) {
+    int m = modeIndex(selectSceneMode(scene.stats, limits));
+    airtime += modes[m].airtime;
+    if (scene.psnr[m] < target && m < oracle(scene, target)) misses++;
+  }
+  return airtime;
+}
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  SceneThresholds limits = { 10.0f, 0.7f, 0.15f };   // AUTO_* defaults of the sketch
+  double target = 30.0;
+  bool sweep = false;
+  std::vector<Scene> scenes;
+  initRenderTables();
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--target" && i + 1 < argc) target = atof(argv[++i]);
+    else if (arg == "--colour" && i + 1 < argc) limits.colour = atof(argv[++i]);
+    else if (arg == "--detail-pd120" && i + 1 < argc) limits.detailPD120 = atof(argv[++i]);
+    else if (arg == "--detail-bw24" && i + 1 < argc) limits.detailBW24 = atof(argv[++i]);
+    else if (arg == "--sweep") sweep = true;
+    else {
+      Picture pic;
+      if (!readPicture(argv[i], pic)) {
+        fprintf(stderr, "%s: unsupported or unreadable picture\n", argv[i]);
+        return 2;
+      }
+      Scene scene;
+      scene.name = arg;
+      pictureToCanvas(pic, scene.canvas);
+      scenes.push_back(scene);
+    }
+  }
+  if (scenes.empty()) {
+    static const struct { const char* name; SceneFn fn; } synthetic[] = {
+      { "fog", fog }, { "night", night }, { "snow", snow }, { "overcast", overcast }, { "texture", texture },
+      { "text", text }, { "sunset", sunset }, { "forest", forest }, { "bars", bars },
+    };
+    for (const auto &s : synthetic) {
+      Scene scene;
+      scene.name = s.name;
+      syntheticCanvas(s.fn, scene.canvas);
+      scenes.push_back(scene);
+    }
+  }
+  for (Scene &scene : scenes) analyse(scene);
+
+  if (sweep) {
+    static const float grid[] = { 0.05f, 0.1f, 0.2f, 0.3f, 0.5f, 0.75f, 1, 1.5f, 2, 3, 4, 5, 6, 8, 10, 12, 15, 20, 25, 30, 40, 50 };
+    double best = 1e30;
+    SceneThresholds found = limits;
+    for (float colour : grid) {
+      for (float pd120 : grid) {
+        for (float bw24 : grid) {
+          if (bw24 > pd120) break;
+          int misses;
+          SceneThresholds candidate = { colour, pd120, bw24 };
+          double airtime = evaluate(scenes, candidate, target, misses);
+          if (misses == 0 && airtime < best) {
+            best = airtime;
+            found = candidate;
+          }
+        }
+      }
+    }
+    limits = found;
+    printf("sweep: least airtime with no pick below %.1f dB: colour %.1f, detail PD120 %.1f, detail BW24 %.1f\n\n",
+           target, limits.colour, limits.detailPD120, limits.detailBW24);
+  }
+
+  printf("%-12s %7s %7s", "scene", "detail", "colour");
+  for (int m = 0; m < modeCount; m++) printf(" %7s", modes[m].name);
+  printf("   %-6s %-6s\n", "auto", "oracle");
+  for (const Scene &scene : scenes) {
+    int pick = modeIndex(selectSceneMode(scene.stats, limits));
+    printf("%-12s %7.2f %7.2f", scene.name.c_str(), sceneDetail(scene.stats), sceneColourfulness(scene.stats));
+    for (int m = 0; m < modeCount; m++) printf(" %7.2f", scene.psnr[m]);
+    printf("   %-6s %-6s\n", modes[pick].name, modes[oracle(scene, target)].name);
+  }
+  int misses;
+  double airtime = evaluate(scenes, limits, target, misses);
+  printf("\nairtime: %.0f s automatic vs %.0f s always PD120, %d pick(s) below %.1f dB\n",
+         airtime, modes[modeCount - 1].airtime * scenes.size(), misses, target);
+  return misses ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file: nmea_replay.cpp
+ * @brief: **Replays recorded NMEA logs through the firmware GPS parser.**
+ * Uses the same nmea_parser.h as the firmware. The log is fed in chunks of
+ * random size, as the UART receive callback would see it.
+ *
+ *   nmea_replay <log.nmea> ...
+ *   nmea_replay selftest
+ *
+ * Prints every fix update (UTC time, position, locator, satellites) and
+ * the sentence/checksum counters. `selftest` runs a built-in log with
+ * known answers: mixed talkers, corrupted and truncated sentences, an
+ * overlong line, no-fix sentences and southern/western coordinates.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -o nmea_replay nmea_replay.cpp
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include "nmea_parser.h"
+
+static void printFix(const GpsFix &fix) {
+  char when[32] = "no time";
+  if (fix.time) {
+    time_t t = fix.time;
+    struct tm utc;
+    gmtime_r(&t, &utc);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%SZ", &utc);
+  }
+  if (fix.valid) {
+    char locator[7];
+    maidenheadLocator(fix.latitude, fix.longitude, locator);
+    printf("%s  %11.7f %12.7f  %s  %d m  %u sats (quality %u)\n", when, fix.latitude / 1e7, fix.longitude / 1e7,
+           locator, fix.altitude, fix.satellites, fix.quality);
+  } else {
+    printf("%s  no position\n", when);
+  }
+}
+
+// Feeds a log in random chunks; returns the number of fix updates
+static int replay(NMEAParser &parser, const std::string &log, std::mt19937 &rng, bool verbose) {
+  std::uniform_int_distribution<size_t> chunk(1, 64);
+  int updates = 0;
+  for (size_t i = 0; i < log.size();) {
+    size_t n = std::min(chunk(rng), log.size() - i);
+    for (size_t k = 0; k < n; k++) {
+      if (nmeaFeed(parser, log[i + k])) {
+        updates++;
+        if (verbose) printFix(parser.fix);
+      }
+    }
+    i += n;
+  }
+  return updates;
+}
+
+// ---------------------- Self Test ----------------------
+static const char* testLog =
+  "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74\r\n"
+  "$GPRMC,235959,V,,,,,,,311299,,,N*53\r\n"                                 // time, no fix
+  "$GNGGA,092750.000,5321.6802,N,00630.3372,W,1,8,1.03,61.7,M,55.2,M,,*68\r\n"
+  "$GNRMC,092751.000,A,5321.6802,N,00630.3371,W,0.02,31.66,280511,,,A*5F\r\n"
+  "$GPRMC,092752.000,A,5321.6802,N,00630.3371,W,0.02,31.66,280511,,,A*00\r\n" // bad checksum
+  "$GPRMC,092753.000,A,5321.68\r\n"                                          // truncated
+  "$GPRMC,0000000000000000000000000000000000000000000000000000000000000000000000000000000000000*00\r\n"
+  "garbage between sentences\r\n"
+  "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n"
+  "$GPRMC,101010.00,A,3351.5310,S,15112.6020,E,0.0,0.0,010326,,,A*45\r\n";
+
+static bool check(bool ok, const char* what) {
+  printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+static int selftest() {
+  std::mt19937 rng(7);
+  bool ok = true;
+  for (int run = 0; run < 200; run++) {
+    NMEAParser parser;
+    memset(&parser, 0, sizeof(parser));
+    int updates = replay(parser, testLog, rng, false);
+    ok &= updates == 4 && parser.sentences == 6 && parser.checksumErrors == 3;
+  }
+  ok &= check(ok, "counters over 200 random chunkings");
+
+  NMEAParser parser;
+  memset(&parser, 0, sizeof(parser));
+  char locator[7];
+  std::string log = testLog;
+  size_t cut = log.find("$GPRMC,092752");
+  replay(parser, log.substr(0, cut), rng, false);
+  maidenheadLocator(parser.fix.latitude, parser.fix.longitude, locator);
+  ok &= check(parser.fix.valid && parser.fix.latitude == 533613366 && parser.fix.longitude == -65056183,
+              "RMC position (53.36 N, 6.51 W)");
+  ok &= check(parser.fix.time == 1306574871, "RMC date and time (2011-05-28 09:27:51Z)");
+  ok &= check(parser.fix.satellites == 8 && parser.fix.altitude == 61 && parser.fix.quality == 1, "GGA satellites, altitude, quality");
+  ok &= check(strcmp(locator, "IO63ri") == 0, "locator IO63ri");
+
+  replay(parser, log.substr(cut), rng, false);
+  maidenheadLocator(parser.fix.latitude, parser.fix.longitude, locator);
+  ok &= check(parser.fix.latitude == -338588500 && parser.fix.longitude == 1512100333, "southern hemisphere (Sydney)");
+  ok &= check(parser.fix.time == 1772359810, "date 2026-03-01 10:10:10Z");
+  ok &= check(strcmp(locator, "QF56od") == 0, "locator QF56od");
+
+  maidenheadLocator(434650000, 110520000, locator);
+  ok &= check(strcmp(locator, "JN53ml") == 0, "locator JN53ml (43.465 N, 11.052 E)");
+  return ok ? 0 : 1;
+}
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <log.nmea> ...\n       %s selftest\n", argv[0], argv[0]);
+    return 2;
+  }
+  if (std::string(argv[1]) == "selftest") return selftest();
+  std::mt19937 rng(1);
+  for (int i = 1; i < argc; i++) {
+    FILE* f = fopen(argv[i], "rb");
+    if (!f) {
+      perror(argv[i]);
+      return 2;
+    }
+    std::string log;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) log.append(buf, n);
+    fclose(f);
+    NMEAParser parser;
+    memset(&parser, 0, sizeof(parser));
+    int updates = replay(parser, log, rng, true);
+    printf("%s: %u sentences, %u dropped, %d fix updates\n", argv[i],
+           (unsigned)parser.sentences, (unsigned)parser.checksumErrors, updates);
+  }
+  return 0;
+}
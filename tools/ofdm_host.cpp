@@ -0,0 +1,363 @@
+/**
+ * @file: ofdm_host.cpp
+ * @brief: **Host modem and decoder for the OFDM image mode.**
+ * Uses the same ofdm_modem.h as the firmware, so a file modulated here is
+ * bit-identical to what the beacon sends.
+ *
+ *   ofdm_host tx   <in.jpg>  <out.wav> [bits_per_carrier]
+ *   ofdm_host rx   <in.wav>  <out.jpg>
+ *   ofdm_host loop <in.jpg>  [bits_per_carrier] [snr_db]
+ *
+ * WAV files are 8 kHz, 16-bit mono. `loop` simulates the 10-bit PWM output
+ * and an AWGN channel, decodes the result and reports airtime and errors.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -o ofdm_host ofdm_host.cpp
+ */
+
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "ofdm_modem.h"
+
+typedef std::complex<double> cplx;
+
+// ---------------------- WAV I/O ----------------------
+static bool readFile(const char* path, std::vector<uint8_t> &data) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static bool writeFile(const char* path, const std::vector<uint8_t> &data) {
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+  return true;
+}
+
+static void put32(std::vector<uint8_t> &v, uint32_t x) { for (int i = 0; i < 4; i++) v.push_back(x >> (8 * i)); }
+static void put16(std::vector<uint8_t> &v, uint16_t x) { v.push_back(x & 0xFF); v.push_back(x >> 8); }
+static uint32_t get32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t get16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+
+static bool writeWav(const char* path, const std::vector<int16_t> &samples) {
+  std::vector<uint8_t> v;
+  v.insert(v.end(), { 'R', 'I', 'F', 'F' });
+  put32(v, 36 + samples.size() * 2);
+  v.insert(v.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+  put32(v, 16); put16(v, 1); put16(v, 1);
+  put32(v, ofdmSampleRate); put32(v, ofdmSampleRate * 2);
+  put16(v, 2); put16(v, 16);
+  v.insert(v.end(), { 'd', 'a', 't', 'a' });
+  put32(v, samples.size() * 2);
+  for (int16_t s : samples) put16(v, (uint16_t)s);
+  return writeFile(path, v);
+}
+
+static bool readWav(const char* path, std::vector<double> &samples) {
+  std::vector<uint8_t> v;
+  if (!readFile(path, v) || v.size() < 12 || memcmp(v.data(), "RIFF", 4) || memcmp(v.data() + 8, "WAVE", 4)) return false;
+  int channels = 0, bits = 0;
+  uint32_t rate = 0;
+  for (size_t pos = 12; pos + 8 <= v.size();) {
+    uint32_t size = get32(&v[pos + 4]);
+    const uint8_t* body = &v[pos + 8];
+    if (!memcmp(&v[pos], "fmt ", 4)) {
+      channels = get16(body + 2); rate = get32(body + 4); bits = get16(body + 14);
+    } else if (!memcmp(&v[pos], "data", 4)) {
+      if (bits != 16 || rate != (uint32_t)ofdmSampleRate) {
+        fprintf(stderr, "Need 16-bit %d Hz audio (got %d-bit %u Hz)\n", ofdmSampleRate, bits, rate);
+        return false;
+      }
+      size = std::min<size_t>(size, v.size() - pos - 8);
+      for (uint32_t i = 0; i + 2 * channels <= size; i += 2 * channels) samples.push_back((int16_t)get16(body + i));
+      return true;
+    }
+    pos += 8 + size + (size & 1);
+  }
+  return false;
+}
+
+// ---------------------- Modulation ----------------------
+static void appendSymbol(std::vector<int16_t> &out, const int16_t* symbol) {
+  out.insert(out.end(), symbol, symbol + ofdmSymbolSamples);
+}
+
+static std::vector<int16_t> modulate(const std::vector<uint8_t> &data, int bitsPerCarrier) {
+  static OFDMModulator modem;
+  int16_t symbol[ofdmSymbolSamples];
+  uint8_t chunk[ofdmMaxBytesPerSymbol];
+  std::vector<int16_t> out;
+
+  ofdmBegin(modem, bitsPerCarrier);
+  for (int i = 0; i < ofdmPreambleSymbols; i++) {
+    ofdmReferenceSymbol(modem, i == ofdmPreambleSymbols - 1, symbol);
+    appendSymbol(out, symbol);
+  }
+  ofdmHeaderSymbol(modem, data.size(), symbol);
+  appendSymbol(out, symbol);
+  const uint32_t crc = ofdmCRC32(data.data(), data.size());
+  const int numSymbols = ofdmPayloadSymbolCount(data.size(), bitsPerCarrier);
+  for (int s = 0; s < numSymbols; s++) {
+    ofdmPayloadChunk(data.data(), data.size(), crc, s, bitsPerCarrier, chunk);
+    ofdmCodedSymbol(modem, chunk, bitsPerCarrier, symbol);
+    appendSymbol(out, symbol);
+  }
+  return out;
+}
+
+// ---------------------- Demodulation ----------------------
+static void fft(std::vector<cplx> &a) {
+  const size_t n = a.size();
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) std::swap(a[i], a[j]);
+  }
+  for (size_t len = 2; len <= n; len <<= 1) {
+    cplx w = std::polar(1.0, -2 * M_PI / len);
+    for (size_t i = 0; i < n; i += len) {
+      cplx wk = 1;
+      for (size_t j = 0; j < len / 2; j++, wk *= w) {
+        cplx t = a[i + j + len / 2] * wk;
+        a[i + j + len / 2] = a[i + j] - t;
+        a[i + j] += t;
+      }
+    }
+  }
+}
+
+// Carrier values of the symbol body starting at `start`
+static std::vector<cplx> carriers(const std::vector<double> &x, long start) {
+  std::vector<cplx> a(ofdmFFTSize);
+  for (int n = 0; n < ofdmFFTSize; n++) {
+    long i = start + n;
+    a[n] = (i >= 0 && i < (long)x.size()) ? x[i] : 0.0;
+  }
+  fft(a);
+  std::vector<cplx> c(ofdmNumCarriers);
+  for (int k = 0; k < ofdmNumCarriers; k++) c[k] = a[ofdmFirstBin + k];
+  return c;
+}
+
+// Finds the body of the inverted reference symbol; -1 if not found
+static long findFrame(const std::vector<double> &x) {
+  static OFDMModulator modem;
+  int16_t symbol[ofdmSymbolSamples];
+  ofdmReferenceSymbol(modem, false, symbol);
+  const int16_t* ref = symbol + ofdmCyclicPrefix;
+  double refEnergy = 0;
+  for (int i = 0; i < ofdmFFTSize; i++) refEnergy += (double)ref[i] * ref[i];
+
+  bool seenPositive = false;
+  double energy = 0;
+  for (int i = 0; i < ofdmFFTSize && i < (int)x.size(); i++) energy += x[i] * x[i];
+  for (long n = 0; n + ofdmFFTSize < (long)x.size(); n++) {
+    double corr = 0;
+    for (int i = 0; i < ofdmFFTSize; i++) corr += x[n + i] * ref[i];
+    double norm = corr / sqrt(refEnergy * energy + 1e-9);
+    if (norm > 0.6) seenPositive = true;
+    if (seenPositive && norm < -0.6) {
+      // refine to the local minimum
+      long best = n;
+      double bestCorr = corr;
+      for (long m = n + 1; m < n + 8 && m + ofdmFFTSize < (long)x.size(); m++) {
+        double c2 = 0;
+        for (int i = 0; i < ofdmFFTSize; i++) c2 += x[m + i] * ref[i];
+        if (c2 < bestCorr) { bestCorr = c2; best = m; }
+      }
+      return best;
+    }
+    energy += x[n + ofdmFFTSize] * x[n + ofdmFFTSize] - x[n] * x[n];
+  }
+  return -1;
+}
+
+// Equalised data carriers (in units of the reference amplitude) of one symbol
+static std::vector<cplx> equalise(const std::vector<cplx> &y, const std::vector<cplx> &h) {
+  std::vector<cplx> z(ofdmNumCarriers);
+  for (int c = 0; c < ofdmNumCarriers; c++) z[c] = y[c] / h[c];
+  // Common phase / timing drift from the pilots: phase = a + b*c, gain = mean |pilot|
+  std::vector<double> pc, pp;
+  double gain = 0, prev = 0;
+  for (int c = 0; c < ofdmNumCarriers; c += ofdmPilotSpacing) {
+    cplx p = z[c] * (double)ofdmReference[c];
+    double ph = std::arg(p);
+    if (!pp.empty()) ph = prev + std::remainder(ph - prev, 2 * M_PI);
+    prev = ph;
+    pc.push_back(c); pp.push_back(ph);
+    gain += std::abs(p);
+  }
+  gain /= pp.size();
+  double mc = 0, mp = 0, scc = 0, scp = 0;
+  for (size_t i = 0; i < pp.size(); i++) { mc += pc[i]; mp += pp[i]; }
+  mc /= pp.size(); mp /= pp.size();
+  for (size_t i = 0; i < pp.size(); i++) { scc += (pc[i] - mc) * (pc[i] - mc); scp += (pc[i] - mc) * (pp[i] - mp); }
+  const double b = scp / scc, a = mp - b * mc;
+  for (int c = 0; c < ofdmNumCarriers; c++) z[c] *= std::polar(1.0 / gain, -(a + b * c));
+  return z;
+}
+
+// Soft bits (positive = 0) of one axis value `v` expressed in constellation levels
+static void axisSoftBits(double v, int m, std::vector<double> &out) {
+  const int levels = 1 << m;
+  for (int bit = m - 1; bit >= 0; bit--) {
+    double d0 = 1e30, d1 = 1e30;
+    for (int g = 0; g < levels; g++) {
+      double d = v - (2 * g - (levels - 1));
+      d *= d;
+      if (((g ^ (g >> 1)) >> bit) & 1) d1 = std::min(d1, d); else d0 = std::min(d0, d);
+    }
+    out.push_back(d1 - d0);
+  }
+}
+
+// Deinterleaved soft coded bits of one symbol
+static std::vector<double> symbolSoftBits(const std::vector<cplx> &z, int bitsPerCarrier) {
+  const int axisBits = bitsPerCarrier / 2;
+  const double levels = (1 << axisBits) - 1;
+  std::vector<double> pos;
+  for (int c = 0; c < ofdmNumCarriers; c++) {
+    if (ofdmIsPilot(c)) continue;
+    axisSoftBits(z[c].real() * levels, axisBits, pos);
+    axisSoftBits(z[c].imag() * levels, axisBits, pos);
+  }
+  const int codedBits = pos.size();
+  std::vector<double> coded(codedBits);
+  for (int i = 0; i < codedBits; i++) coded[i] = pos[ofdmInterleave(i, codedBits)];
+  return coded;
+}
+
+// Soft-decision Viterbi decoder for the K=7 r=1/2 code, terminated in state 0
+static std::vector<uint8_t> viterbi(const std::vector<double> &soft) {
+  const size_t steps = soft.size() / 2;
+  std::vector<uint64_t> decisions(steps);
+  double metric[64], next[64];
+  for (int s = 0; s < 64; s++) metric[s] = s ? -1e30 : 0;
+  for (size_t t = 0; t < steps; t++) {
+    const double la = soft[2 * t], lb = soft[2 * t + 1];
+    uint64_t dec = 0;
+    for (int ns = 0; ns < 64; ns++) {
+      double best = -1e300;
+      for (int x = 0; x < 2; x++) {
+        const int ps = (ns >> 1) | (x << 5);
+        const uint8_t reg = (x << 6) | ns;
+        const double m = metric[ps] + (ofdmParity(reg & ofdmPolyA) ? -la : la) + (ofdmParity(reg & ofdmPolyB) ? -lb : lb);
+        if (m > best) { best = m; if (x) dec |= 1ULL << ns; else dec &= ~(1ULL << ns); }
+      }
+      next[ns] = best;
+    }
+    decisions[t] = dec;
+    memcpy(metric, next, sizeof(metric));
+  }
+  std::vector<uint8_t> bytes(steps / 8);
+  int state = 0;
+  for (size_t t = steps; t-- > 0;) {
+    if (t / 8 < bytes.size() && (state & 1)) bytes[t / 8] |= 0x80 >> (t % 8);
+    state = (state >> 1) | (((decisions[t] >> state) & 1) << 5);
+  }
+  return bytes;
+}
+
+static bool demodulate(const std::vector<double> &x, std::vector<uint8_t> &data) {
+  long anchor = findFrame(x);
+  if (anchor < 0) { fprintf(stderr, "No OFDM frame found\n"); return false; }
+  const long start = anchor - ofdmCyclicPrefix / 8;   // sample inside the guard interval
+
+  // Channel estimate from the last two preamble symbols
+  std::vector<cplx> inv = carriers(x, start), ref = carriers(x, start - ofdmSymbolSamples);
+  std::vector<cplx> h(ofdmNumCarriers);
+  for (int c = 0; c < ofdmNumCarriers; c++) h[c] = (ref[c] - inv[c]) * 0.5 * (double)ofdmReference[c];
+
+  // Header
+  std::vector<uint8_t> header = viterbi(symbolSoftBits(equalise(carriers(x, start + ofdmSymbolSamples), h), 2));
+  const uint32_t length = header[2] | (header[3] << 8) | (header[4] << 16);
+  const int bitsPerCarrier = header[1];
+  const uint16_t crc16 = header[5] | (header[6] << 8);
+  if (header[0] != ofdmHeaderMagic || crc16 != crc16CCITT(header.data(), 5) ||
+      (bitsPerCarrier != 2 && bitsPerCarrier != 4 && bitsPerCarrier != 6)) {
+    fprintf(stderr, "Header corrupted\n");
+    return false;
+  }
+  const int numSymbols = ofdmPayloadSymbolCount(length, bitsPerCarrier);
+  printf("Frame at sample %ld: %u bytes, %d bits/carrier, %d data symbols\n", anchor, length, bitsPerCarrier, numSymbols);
+
+  // Payload
+  std::vector<double> soft;
+  for (int s = 0; s < numSymbols; s++) {
+    std::vector<double> sb = symbolSoftBits(equalise(carriers(x, start + (2 + s) * (long)ofdmSymbolSamples), h), bitsPerCarrier);
+    soft.insert(soft.end(), sb.begin(), sb.end());
+  }
+  std::vector<uint8_t> stream = viterbi(soft);
+  data.assign(stream.begin(), stream.begin() + length);
+  const uint32_t crc = get32(&stream[length]);
+  if (crc != ofdmCRC32(data.data(), length)) {
+    fprintf(stderr, "Payload CRC mismatch\n");
+    return false;
+  }
+  return true;
+}
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  ofdmInitTables();
+  std::string cmd = argc > 1 ? argv[1] : "";
+
+  if (cmd == "tx" && argc >= 4) {
+    std::vector<uint8_t> data;
+    if (!readFile(argv[2], data)) { perror(argv[2]); return 1; }
+    int bpc = argc > 4 ? atoi(argv[4]) : 6;
+    std::vector<int16_t> audio = modulate(data, bpc);
+    if (!writeWav(argv[3], audio)) { perror(argv[3]); return 1; }
+    printf("%zu bytes -> %.1f s of audio\n", data.size(), audio.size() / (double)ofdmSampleRate);
+    return 0;
+  }
+
+  if (cmd == "rx" && argc >= 4) {
+    std::vector<double> audio;
+    std::vector<uint8_t> data;
+    if (!readWav(argv[2], audio)) { fprintf(stderr, "Cannot read %s\n", argv[2]); return 1; }
+    if (!demodulate(audio, data)) return 1;
+    if (!writeFile(argv[3], data)) { perror(argv[3]); return 1; }
+    printf("Decoded %zu bytes, CRC OK\n", data.size());
+    return 0;
+  }
+
+  if (cmd == "loop" && argc >= 3) {
+    std::vector<uint8_t> data, decoded;
+    if (!readFile(argv[2], data)) { perror(argv[2]); return 1; }
+    int bpc = argc > 3 ? atoi(argv[3]) : 6;
+    double snr = argc > 4 ? atof(argv[4]) : 30.0;
+    std::vector<int16_t> audio = modulate(data, bpc);
+
+    // 10-bit PWM quantisation, half a second of leading noise, AWGN
+    double power = 0;
+    for (int16_t s : audio) power += (double)s * s;
+    power /= audio.size();
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0.0, sqrt(power / pow(10.0, snr / 10)));
+    std::vector<double> rx(ofdmSampleRate / 2);
+    for (int16_t s : audio) rx.push_back((s >> 6) << 6);
+    for (double &s : rx) s += noise(rng);
+
+    const double airtime = audio.size() / (double)ofdmSampleRate;
+    printf("%zu bytes, %d bits/carrier: %.1f s on air (PD120: 126.0 s, %.1fx)\n", data.size(), bpc, airtime, 126.0 / airtime);
+    if (!demodulate(rx, decoded)) return 1;
+    printf("Loopback at %.1f dB SNR: %s\n", snr, decoded == data ? "OK" : "MISMATCH");
+    return decoded == data ? 0 : 1;
+  }
+
+  fprintf(stderr, "usage: %s tx <in> <out.wav> [bits_per_carrier]\n"
+                  "       %s rx <in.wav> <out>\n"
+                  "       %s loop <in> [bits_per_carrier] [snr_db]\n", argv[0], argv[0], argv[0]);
+  return 2;
+}
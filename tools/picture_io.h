@@ -0,0 +1,79 @@
+/**
+ * @file: picture_io.h
+ * @brief: **Minimal picture file I/O for the host tools.**
+ * Reads 24/32-bit uncompressed BMP and binary PPM (P6), the formats SSTV
+ * receivers save, and writes PPM.
+ */
+
+#ifndef __PICTURE_IO_H
+#define __PICTURE_IO_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+struct Picture {
+  int width = 0, height = 0;
+  std::vector<uint8_t> rgb;   // width x height x 3, top row first
+
+  uint8_t luma(int x, int y) const {
+    const uint8_t* p = &rgb[((size_t)y * width + x) * 3];
+    return (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8);
+  }
+};
+
+inline bool readPicture(const char* path, Picture &pic) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  std::vector<uint8_t> data;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+
+  if (data.size() > 54 && data[0] == 'B' && data[1] == 'M') {
+    auto le32 = [&](int o) { return (int32_t)(data[o] | (data[o + 1] << 8) | (data[o + 2] << 16) | (data[o + 3] << 24)); };
+    int offset = le32(10), w = le32(18), h = le32(22), bpp = data[28] | (data[29] << 8);
+    if ((bpp != 24 && bpp != 32) || le32(30) != 0) return false;
+    bool bottomUp = h > 0;
+    h = abs(h);
+    int stride = ((w * bpp / 8) + 3) & ~3;
+    if ((size_t)offset + (size_t)stride * h > data.size()) return false;
+    pic.width = w;
+    pic.height = h;
+    pic.rgb.resize((size_t)w * h * 3);
+    for (int y = 0; y < h; y++) {
+      const uint8_t* row = &data[offset + (size_t)stride * (bottomUp ? h - 1 - y : y)];
+      uint8_t* out = &pic.rgb[(size_t)y * w * 3];
+      for (int x = 0; x < w; x++, row += bpp / 8, out += 3) {
+        out[0] = row[2];
+        out[1] = row[1];
+        out[2] = row[0];
+      }
+    }
+    return true;
+  }
+  if (data.size() > 2 && data[0] == 'P' && data[1] == '6') {
+    int w, h, maxval, used = 0;
+    if (sscanf((const char*)data.data(), "P6 %d %d %d%n", &w, &h, &maxval, &used) != 3 || maxval != 255) return false;
+    size_t offset = used + 1;
+    if (offset + (size_t)w * h * 3 > data.size()) return false;
+    pic.width = w;
+    pic.height = h;
+    pic.rgb.assign(data.begin() + offset, data.begin() + offset + (size_t)w * h * 3);
+    return true;
+  }
+  return false;
+}
+
+inline bool writePPM(const char* path, const Picture &pic) {
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+  fprintf(f, "P6\n%d %d\n255\n", pic.width, pic.height);
+  bool ok = fwrite(pic.rgb.data(), 1, pic.rgb.size(), f) == pic.rgb.size();
+  fclose(f);
+  return ok;
+}
+
+#endif
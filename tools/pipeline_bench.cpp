@@ -0,0 +1,136 @@
+/**
+ * @file: pipeline_bench.cpp
+ * @brief: **Host test and benchmark of the PD120 band pipeline.**
+ * Runs the same coroutine executor (pipeline.h) and render kernel
+ * (sstv_render.h) as the firmware, with a synthetic image:
+ *   decode  - writes the canvas one 16-row MCU band per resumption
+ *   compose - fills an overlay box once its rows are decoded
+ *   render  - renders line pairs into a pool of 3 buffers, 160 px per resumption
+ *   transmit- yields `waits` times per line pair (the on-air waits), then
+ *             checks the buffer against a direct render of the final canvas
+ *
+ *   pipeline_bench [waits_per_pair]
+ *
+ * Reports the render cost per line pair (PD120 airtime per pair is 508 ms),
+ * executor resumptions, transmitter stalls and output mismatches.
+ *
+ * Build: g++ -O2 -std=c++20 -I.. -o pipeline_bench pipeline_bench.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "pipeline.h"
+#include "sstv_render.h"
+
+typedef std::chrono::steady_clock benchClock;
+
+static std::vector<uint16_t> canvasBuffer(canvasStride * imageHeight);
+static int decodedRows = 0;
+static int composedRows = 0;
+static const int overlayTop = 200, overlayBottom = 240;
+static const int mcuRows = 16;
+static const int bufferCount = 3;
+static LinePairTones tones[bufferCount];
+static BandQueue<bufferCount> freeBands, readyBands;
+static int stalls = 0, mismatches = 0;
+
+static uint16_t syntheticPixel(int x, int y) {
+  return (uint16_t)(((x * 31 / imageWidth) << 11) | (((x + y) & 0x3F) << 5) | ((y * 31 / imageHeight) & 0x1F));
+}
+
+// ---------------------- Stages ----------------------
+static PipelineTask decodeStage() {
+  for (int y = 0; y < imageHeight; y += mcuRows) {
+    for (int row = y; row < y + mcuRows && row < imageHeight; row++) {
+      for (int x = 0; x < imageWidth; x++) canvasRow(canvasBuffer.data(), row)[x] = syntheticPixel(x, row);
+    }
+    decodedRows = y + mcuRows < imageHeight ? y + mcuRows : imageHeight;
+    co_await pipelineYield();
+  }
+}
+
+static PipelineTask composeStage() {
+  bool drawn = false;
+  while (composedRows < imageHeight) {
+    if (!drawn && decodedRows >= overlayBottom) {
+      for (int row = overlayTop; row < overlayBottom; row++) {
+        for (int x = 100; x < 400; x++) canvasRow(canvasBuffer.data(), row)[x] = 0xF81F;
+      }
+      drawn = true;
+    }
+    composedRows = drawn || decodedRows < overlayTop ? decodedRows : overlayTop;
+    co_await pipelineYield();
+  }
+}
+
+static PipelineTask renderStage() {
+  for (int pair = 0; pair < imageHeight / 2; pair++) {
+    int band;
+    while (composedRows < 2 * pair + 2 || !freeBands.pop(band)) co_await pipelineYield();
+    for (int x = 0; x < imageWidth; x += 160) {
+      renderPD120LinePair(canvasBuffer.data(), pair, tones[band], x, x + 160);
+      co_await pipelineYield();
+    }
+    readyBands.push(band);
+  }
+}
+
+static PipelineTask transmitStage(int waits, const std::vector<LinePairTones> &reference) {
+  for (int pair = 0; pair < imageHeight / 2; pair++) {
+    for (int i = 0; i < waits; i++) co_await pipelineYield();
+    int band;
+    if (!readyBands.pop(band)) {
+      stalls++;
+      while (!readyBands.pop(band)) co_await pipelineYield();
+    }
+    if (memcmp(&tones[band], &reference[pair], sizeof(LinePairTones)) != 0) mismatches++;
+    freeBands.push(band);
+  }
+}
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  int waits = argc > 1 ? atoi(argv[1]) : 8;
+  initRenderTables();
+
+  // Reference: the final canvas rendered in one go
+  for (int y = 0; y < imageHeight; y++) {
+    for (int x = 0; x < imageWidth; x++) canvasRow(canvasBuffer.data(), y)[x] = syntheticPixel(x, y);
+  }
+  for (int row = overlayTop; row < overlayBottom; row++) {
+    for (int x = 100; x < 400; x++) canvasRow(canvasBuffer.data(), row)[x] = 0xF81F;
+  }
+  std::vector<LinePairTones> reference(imageHeight / 2);
+  auto t0 = benchClock::now();
+  for (int pair = 0; pair < imageHeight / 2; pair++) {
+    renderPD120LinePair(canvasBuffer.data(), pair, reference[pair], 0, imageWidth);
+  }
+  double renderUs = std::chrono::duration<double, std::micro>(benchClock::now() - t0).count();
+
+  std::fill(canvasBuffer.begin(), canvasBuffer.end(), 0);
+  for (int i = 0; i < bufferCount; i++) freeBands.push(i);
+  t0 = benchClock::now();
+  PipelineExecutor executor;
+  {
+    PipelineTask decode = decodeStage();
+    PipelineTask compose = composeStage();
+    PipelineTask render = renderStage();
+    PipelineTask transmit = transmitStage(waits, reference);
+    executor.spawn(decode);
+    executor.spawn(compose);
+    executor.spawn(render);
+    executor.spawn(transmit);
+    executor.run();
+  }
+  double pipelineUs = std::chrono::duration<double, std::micro>(benchClock::now() - t0).count();
+
+  printf("render:     %.2f us per line pair (%.1f ms per image)\n", renderUs / (imageHeight / 2), renderUs / 1000);
+  printf("pipeline:   %.1f ms, %lu resumptions (%.1f ns each incl. work)\n",
+         pipelineUs / 1000, executor.rounds, pipelineUs * 1000 / executor.rounds);
+  printf("stalls:     %d of %d line pairs (waits per pair = %d)\n", stalls, imageHeight / 2, waits);
+  printf("mismatches: %d\n", mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+/**
+ * @file: playlist_plan.cpp
+ * @brief: **Plans a beacon playlist: schedule, cache layout and flash wear.**
+ * Uses the same playlist_format.h as the firmware.
+ *
+ *   playlist_plan plan live:PD120:2 card:PD120 mosaic:BW24
+ *   playlist_plan card card.ppm PD120 card.bin
+ *   playlist_plan selftest
+ *
+ * plan: entries are kind:mode[:repeat] (kind live, card or mosaic; mode
+ * PD120, BW8, BW12, BW24 or OFDM). Prints the per-slot schedule, where each
+ * entry's cache area lands in the 1.5 MB "cache" partition (--cache <bytes>
+ * for another size) and how long the mosaic tiles last at one wake per
+ * --period <s> (default 300, the GPS slot period).
+ * card: turns a picture (any size, scaled to the canvas; e.g. a receiver's
+ * save of an earlier frame) into the cache area of a card with no text in
+ * the given mode, to be flashed at the partition offset plus the area
+ * offset printed by plan.
+ * selftest: schedule render, header and layout checks.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -o playlist_plan playlist_plan.cpp
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "playlist_format.h"
+#include "picture_io.h"
+
+static const char* kindNames[] = { "live", "card", "mosaic" };
+static const char* modeNames[] = { "PD120", "BW8", "BW12", "BW24", "OFDM" };
+static const uint32_t cacheSize = 0x180000;      // partitions_beacon.csv
+static const uint32_t cacheAddress = 0x190000;   // partitions_beacon.csv
+static const uint32_t eraseCycles = 100000;      // Typical NOR flash sector endurance
+
+// ---------------------- Plan ----------------------
+static bool parseEntry(const std::string &text, PlaylistEntry &e) {
+  size_t a = text.find(':');
+  if (a == std::string::npos) return false;
+  size_t b = text.find(':', a + 1);
+  std::string kind = text.substr(0, a);
+  std::string mode = text.substr(a + 1, b == std::string::npos ? std::string::npos : b - a - 1);
+  e.kind = 255;
+  e.mode = 255;
+  for (int k = 0; k < 3; k++) if (kind == kindNames[k]) e.kind = k;
+  for (int m = 0; m < 5; m++) if (mode == modeNames[m]) e.mode = m;
+  int repeat = b == std::string::npos ? 1 : atoi(text.c_str() + b + 1);
+  e.repeat = repeat < 0 ? 0 : repeat > 255 ? 255 : repeat;
+  e.text = e.kind == PLAYLIST_CARD ? "" : NULL;
+  return e.kind != 255 && e.mode != 255;
+}
+
+static int plan(char** args, int count) {
+  std::vector<PlaylistEntry> entries;
+  uint32_t partition = cacheSize, period = 300;
+  for (int i = 0; i < count; i++) {
+    if (!strcmp(args[i], "--cache") && i + 1 < count) { partition = strtoul(args[++i], NULL, 0); continue; }
+    if (!strcmp(args[i], "--period") && i + 1 < count) { period = strtoul(args[++i], NULL, 0); continue; }
+    PlaylistEntry e;
+    if (!parseEntry(args[i], e)) {
+      fprintf(stderr, "bad entry '%s' (kind:mode[:repeat])\n", args[i]);
+      return 2;
+    }
+    entries.push_back(e);
+  }
+  if (entries.empty() || entries.size() > (size_t)playlistMaxSlots || period == 0) {
+    fprintf(stderr, "need 1-%d entries and a non-zero period\n", playlistMaxSlots);
+    return 2;
+  }
+
+  uint8_t schedule[playlistMaxSlots];
+  int slots = playlistBuildSchedule(entries.data(), entries.size(), schedule);
+  printf("schedule (%d slots, %.1f min per lap):", slots, slots * period / 60.0);
+  for (int s = 0; s < slots; s++) printf(" %d", schedule[s]);
+  printf("\n\n");
+
+  std::vector<uint32_t> offsets(entries.size());
+  uint32_t used = playlistLayout(entries.data(), entries.size(), partition, offsets.data());
+  printf("entry kind    mode  slots  cache area\n");
+  bool missing = false, fallback = false;
+  for (size_t i = 0; i < entries.size(); i++) {
+    const PlaylistEntry &e = entries[i];
+    int share = 0;
+    for (int s = 0; s < slots; s++) share += schedule[s] == i;
+    const char* mode = modeNames[e.mode];
+    if (e.kind != PLAYLIST_LIVE && e.mode == 4) {
+      mode = "PD120*";
+      fallback = true;
+    }
+    printf("%5zu %-7s %-6s %5d  ", i, kindNames[e.kind], mode, share);
+    if (e.kind == PLAYLIST_LIVE) {
+      printf("-\n");
+    } else if (offsets[i] == playlistNoArea) {
+      printf("does not fit (rendered every time)\n");
+      missing = true;
+    } else {
+      printf("0x%06x-0x%06x\n", offsets[i], offsets[i] + playlistAreaBytes(e) - 1);
+    }
+  }
+  printf("\ncache: %u of %u bytes\n", used, partition);
+  if (fallback) printf("* OFDM sends only camera JPEGs: sent in PD120\n");
+
+  // A mosaic wake rewrites one tile: each tile sector is erased every mosaicTiles mosaic wakes
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (entries[i].kind != PLAYLIST_MOSAIC || offsets[i] == playlistNoArea) continue;
+    int share = 0;
+    for (int s = 0; s < slots; s++) share += schedule[s] == i;
+    double wakesPerDay = 86400.0 / period * share / slots;
+    double years = (double)eraseCycles * mosaicTiles / wakesPerDay / 365.0;
+    printf("mosaic %zu: %u sectors erased per wake, %.0f wakes/day, tiles last %.1f years (%u erase cycles)\n",
+           i, playlistTileBytes / playlistSectorSize, wakesPerDay, years, eraseCycles);
+  }
+  return missing ? 1 : 0;
+}
+
+// ---------------------- Card ----------------------
+static bool parseMode(const char* name, uint8_t &mode) {
+  for (int m = 0; m < 5; m++) {
+    if (!strcmp(name, modeNames[m])) {
+      mode = m;
+      return true;
+    }
+  }
+  return false;
+}
+
+static int card(const char* path, const char* modeName, const char* outPath) {
+  Picture pic;
+  uint8_t mode;
+  if (!parseMode(modeName, mode)) {
+    fprintf(stderr, "bad mode '%s'\n", modeName);
+    return 2;
+  }
+  if (!readPicture(path, pic)) {
+    fprintf(stderr, "%s: not a 24/32-bit BMP or P6 PPM\n", path);
+    return 2;
+  }
+  // Nearest-neighbour scale to the canvas
+  std::vector<uint16_t> canvas((size_t)canvasStride * imageHeight);
+  for (int y = 0; y < imageHeight; y++) {
+    for (int x = 0; x < imageWidth; x++) {
+      const uint8_t* p = &pic.rgb[((size_t)(y * pic.height / imageHeight) * pic.width + x * pic.width / imageWidth) * 3];
+      canvasRow(canvas.data(), y)[x] = ((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3);
+    }
+  }
+
+  initRenderTables();
+  SSTVMode canvasMode = playlistCanvasMode(mode);
+  int width, lines;
+  scheduleGeometry(canvasMode, width, lines);
+  std::vector<uint8_t> area(sizeof(PlaylistCacheHeader) + (size_t)width * lines);
+  for (int line = 0; line < lines; line++) {
+    renderScheduleLine(canvas.data(), canvasMode, line, &area[sizeof(PlaylistCacheHeader) + (size_t)line * width]);
+  }
+  PlaylistCacheHeader h;
+  playlistSealHeader(h, playlistCardKey(NULL, mode), (uint32_t)(area.size() - sizeof(h)));
+  memcpy(area.data(), &h, sizeof(h));
+
+  FILE* f = fopen(outPath, "wb");
+  if (!f || fwrite(area.data(), 1, area.size(), f) != area.size()) {
+    fprintf(stderr, "%s: write failed\n", outPath);
+    if (f) fclose(f);
+    return 1;
+  }
+  fclose(f);
+  printf("%s: %dx%d -> %s schedule, %zu bytes\n", path, pic.width, pic.height, modeNames[canvasMode], area.size());
+  printf("flash with: esptool.py write_flash <0x%x + area offset from plan> %s\n", cacheAddress, outPath);
+  return 0;
+}
+
+// ---------------------- Self Test ----------------------
+static int selftest() {
+  int failures = 0;
+  initRenderTables();
+  std::vector<uint16_t> canvas((size_t)canvasStride * imageHeight);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < canvas.size(); i++) {
+    seed = seed * 1103515245 + 12345;
+    canvas[i] = seed >> 16;
+  }
+
+  // A schedule plays the same tones as the live render paths
+  static LinePairTones tones;
+  std::vector<uint8_t> levels(4 * imageWidth);
+  std::vector<uint16_t> luma(imageWidth);
+  bool pd120 = true;
+  for (int pair = 0; pair < imageHeight / 2; pair++) {
+    renderScheduleLine(canvas.data(), MODE_PD120, pair, levels.data());
+    renderPD120LinePair(canvas.data(), pair, tones, 0, imageWidth);
+    for (int x = 0; x < imageWidth; x++) {
+      pd120 = pd120 && levelToFrequency[levels[x]] == tones.yOdd[x] &&
+              levelToFrequency[levels[imageWidth + x]] == tones.ry[x] &&
+              levelToFrequency[levels[2 * imageWidth + x]] == tones.by[x] &&
+              levelToFrequency[levels[3 * imageWidth + x]] == tones.yEven[x];
+    }
+  }
+  bool robot = true;
+  for (int mode = MODE_BW8; mode <= MODE_BW24; mode++) {
+    int width, lines;
+    scheduleGeometry((SSTVMode)mode, width, lines);
+    for (int line = 0; line < lines; line++) {
+      renderScheduleLine(canvas.data(), (SSTVMode)mode, line, levels.data());
+      renderLumaLine(canvas.data(), line, width, lines, luma.data());
+      for (int x = 0; x < width; x++) robot = robot && levelToFrequency[levels[x]] == luma[x];
+    }
+  }
+  printf("schedule PD120 %s, Robot B/W %s\n", pd120 ? "ok" : "FAILED", robot ? "ok" : "FAILED");
+  failures += !pd120 + !robot;
+
+  // Header: a torn or foreign area is invalid
+  PlaylistCacheHeader h;
+  playlistSealHeader(h, 1234, 5000);
+  bool valid = playlistHeaderValid(h, 1234, 8000) && !playlistHeaderValid(h, 1235, 8000) &&
+               !playlistHeaderValid(h, 1234, 4000);
+  h.length ^= 1;
+  valid = valid && !playlistHeaderValid(h, 1234, 8000);
+  memset(&h, 0xFF, sizeof(h));
+  valid = valid && !playlistHeaderValid(h, 0xFFFFFFFF, 0xFFFFFFFF);
+  printf("header checks %s\n", valid ? "ok" : "FAILED");
+  failures += !valid;
+
+  // Default playlist of the sketch fits the partition
+  PlaylistEntry entries[] = { { PLAYLIST_LIVE, 0, 2, NULL }, { PLAYLIST_CARD, 0, 1, "" }, { PLAYLIST_MOSAIC, 3, 1, NULL } };
+  uint32_t offsets[3];
+  uint32_t used = playlistLayout(entries, 3, cacheSize, offsets);
+  uint32_t cardBytes = playlistAreaBytes(entries[1]);
+  bool layout = offsets[0] == playlistNoArea && offsets[1] == 0 && offsets[2] == cardBytes &&
+                cardBytes % playlistSectorSize == 0 && cardBytes >= sizeof(PlaylistCacheHeader) + playlistScheduleBytes(0) &&
+                used == cardBytes + mosaicTiles * playlistTileBytes && used <= cacheSize;
+  printf("layout %s (%u bytes)\n", layout ? "ok" : "FAILED", used);
+  failures += !layout;
+
+  printf("%s\n", failures ? "FAILED" : "all passed");
+  return failures ? 1 : 0;
+}
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  std::string command = argc > 1 ? argv[1] : "";
+  if (command == "plan" && argc >= 3) return plan(argv + 2, argc - 2);
+  if (command == "card" && argc == 5) return card(argv[2], argv[3], argv[4]);
+  if (command == "selftest") return selftest();
+  fprintf(stderr,
+          "usage: %s plan <kind:mode[:repeat]>... [--cache <bytes>] [--period <s>]\n"
+          "       %s card <picture.bmp|ppm> <mode> <area.bin>\n"
+          "       %s selftest\n",
+          argv[0], argv[0], argv[0]);
+  return 2;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file: rotate_bench.cpp
+ * @brief: **Host test and benchmark of the camera picture rotation.**
+ * Uses the same image_rotate.h as the firmware.
+ *
+ *   rotate_bench rotate <in.bmp|in.ppm> <out.ppm> <90|270>
+ *   rotate_bench selftest
+ *   rotate_bench bench
+ *
+ * `rotate` puts a picture (scaled to the 640x480 camera size first) through
+ * the beacon rotation into the 640x480 picture area, bars included.
+ * `selftest` checks the tiled rotation against the row-by-row one and
+ * against the rotation done pixel by pixel from its definition: both
+ * directions, exact (no scaling) and scaled, sizes that are not multiples
+ * of the tile. `bench` times both on the 640x480 camera picture into a
+ * canvas. On the host the whole picture fits in the cache, so the gap is
+ * small; DEVICE_BENCH measures them on PSRAM.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -o rotate_bench rotate_bench.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "image_rotate.h"
+#include "picture_io.h"
+
+typedef std::chrono::steady_clock benchClock;
+
+static bool check(bool ok, const char* what) {
+  printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Rotates by the definition: destination pixel -> rotated picture -> source
+static uint16_t definitionPixel(const std::vector<uint16_t> &src, int w, int h, int rotation, const RotationMap &m,
+                                int x, int y) {
+  int rx = (int)((int64_t)x * h / m.width), ry = (int)((int64_t)y * w / m.height);
+  int sx = rotation == 90 ? ry : w - 1 - ry;
+  int sy = rotation == 90 ? h - 1 - rx : rx;
+  return src[(size_t)sy * w + sx];
+}
+
+static bool rotateCase(int w, int h, int areaWidth, int areaHeight, int rotation, std::mt19937 &rng) {
+  std::vector<uint16_t> src((size_t)w * h);
+  for (uint16_t &p : src) p = (uint16_t)rng();
+  auto m = std::make_unique<RotationMap>();
+  rotationMapBuild(*m, w, h, areaWidth, areaHeight, rotation);
+  const int stride = areaWidth + 7;
+  std::vector<uint16_t> naive((size_t)stride * areaHeight, 0xAAAA), blocked(naive);
+  rotateLetterbox(naive.data(), stride, areaWidth, areaHeight, *m, 0);
+  rotateNaive(src.data(), naive.data(), stride, *m);
+  rotateLetterbox(blocked.data(), stride, areaWidth, areaHeight, *m, 0);
+  rotateBlocked(src.data(), blocked.data(), stride, *m);
+
+  bool ok = naive == blocked && m->width <= areaWidth && m->height <= areaHeight;
+  for (int y = 0; y < areaHeight && ok; y++) {
+    for (int x = 0; x < areaWidth && ok; x++) {
+      uint16_t got = naive[(size_t)y * stride + x];
+      bool inside = x >= m->left && x < m->left + m->width && y >= m->top && y < m->top + m->height;
+      ok = inside ? got == definitionPixel(src, w, h, rotation, *m, x - m->left, y - m->top) : got == 0;
+    }
+    ok &= naive[(size_t)y * stride + areaWidth] == 0xAAAA;   // Nothing past the area
+  }
+  return ok;
+}
+
+static int selftest() {
+  std::mt19937 rng(5);
+  bool ok = true;
+  char what[64];
+  for (int rotation : { 90, 270 }) {
+    snprintf(what, sizeof(what), "%d: 640x480 into 640x480 (scaled 3/4)", rotation);
+    ok &= check(rotateCase(640, 480, 640, 480, rotation, rng), what);
+    snprintf(what, sizeof(what), "%d: 320x240 into 320x240 (mosaic tile)", rotation);
+    ok &= check(rotateCase(320, 240, 320, 240, rotation, rng), what);
+    snprintf(what, sizeof(what), "%d: 100x37 into 64x120 (exact, odd sizes)", rotation);
+    ok &= check(rotateCase(100, 37, 64, 120, rotation, rng), what);
+    snprintf(what, sizeof(what), "%d: 333x77 into 50x200 (scaled, odd)", rotation);
+    ok &= check(rotateCase(333, 77, 50, 200, rotation, rng), what);
+  }
+
+  // Exact 90 then 270 is the identity; both of a known 3x2 picture
+  const int w = 45, h = 70;
+  std::vector<uint16_t> src((size_t)w * h), once((size_t)h * w), back((size_t)w * h);
+  for (size_t i = 0; i < src.size(); i++) src[i] = (uint16_t)(i * 7919);
+  auto m = std::make_unique<RotationMap>();
+  rotationMapBuild(*m, w, h, h, w, 90);
+  rotateBlocked(src.data(), once.data(), h, *m);
+  rotationMapBuild(*m, h, w, w, h, 270);
+  rotateBlocked(once.data(), back.data(), w, *m);
+  ok &= check(back == src, "90 then 270 gives the picture back");
+  const uint16_t small[6] = { 1, 2, 3, 4, 5, 6 };   // 3 wide, 2 tall: 1 2 3 / 4 5 6
+  const uint16_t clockwise[6] = { 4, 1, 5, 2, 6, 3 }, anticlockwise[6] = { 3, 6, 2, 5, 1, 4 };
+  uint16_t turned[6];
+  rotationMapBuild(*m, 3, 2, 2, 3, 90);
+  rotateBlocked(small, turned, 2, *m);
+  ok &= check(!memcmp(turned, clockwise, sizeof(turned)), "90 clockwise: 123/456 -> 41/52/63");
+  rotationMapBuild(*m, 3, 2, 2, 3, 270);
+  rotateBlocked(small, turned, 2, *m);
+  ok &= check(!memcmp(turned, anticlockwise, sizeof(turned)), "270 clockwise: 123/456 -> 36/25/14");
+  return ok ? 0 : 1;
+}
+
+static int bench() {
+  const int w = 640, h = 480, runs = 50;
+  std::vector<uint16_t> src((size_t)w * h), canvas((size_t)canvasStride * imageHeight);
+  for (size_t i = 0; i < src.size(); i++) src[i] = (uint16_t)(i * 2654435761u >> 16);
+  auto m = std::make_unique<RotationMap>();
+  rotationMapBuild(*m, w, h, w, h, 90);
+  printf("640x480 -> %dx%d at (%d, %d), canvas stride %d px, %d x %d tiles\n", m->width, m->height, m->left, m->top,
+         canvasStride, rotateTile, rotateTile);
+  for (int pass = 0; pass < 2; pass++) {
+    auto start = benchClock::now();
+    for (int r = 0; r < runs; r++) {
+      if (pass == 0) rotateNaive(src.data(), canvas.data(), canvasStride, *m);
+      else rotateBlocked(src.data(), canvas.data(), canvasStride, *m);
+    }
+    double us = std::chrono::duration<double, std::micro>(benchClock::now() - start).count() / runs;
+    printf("%-8s %8.1f us per picture, %.2f ns per pixel\n", pass == 0 ? "naive" : "blocked", us,
+           1000.0 * us / (m->width * m->height));
+  }
+  return 0;
+}
+
+static int rotateFile(const char* in, const char* out, int rotation) {
+  Picture pic;
+  if (!readPicture(in, pic)) {
+    fprintf(stderr, "Cannot read %s\n", in);
+    return 1;
+  }
+  // Camera-sized RGB565 source (nearest scaling)
+  const int w = 640, h = 480;
+  std::vector<uint16_t> src((size_t)w * h);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      const uint8_t* p = &pic.rgb[((size_t)(y * pic.height / h) * pic.width + x * pic.width / w) * 3];
+      src[(size_t)y * w + x] = (uint16_t)(((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3));
+    }
+  }
+  auto m = std::make_unique<RotationMap>();
+  rotationMapBuild(*m, w, h, w, h, rotation);
+  std::vector<uint16_t> area((size_t)w * h);
+  rotateLetterbox(area.data(), w, w, h, *m, 0);
+  rotateBlocked(src.data(), area.data(), w, *m);
+  Picture result;
+  result.width = w;
+  result.height = h;
+  result.rgb.resize((size_t)w * h * 3);
+  for (size_t i = 0; i < area.size(); i++) {
+    uint16_t p = area[i];
+    result.rgb[i * 3] = (uint8_t)((p >> 11) << 3);
+    result.rgb[i * 3 + 1] = (uint8_t)(((p >> 5) & 0x3F) << 2);
+    result.rgb[i * 3 + 2] = (uint8_t)((p & 0x1F) << 3);
+  }
+  if (!writePPM(out, result)) {
+    fprintf(stderr, "Cannot write %s\n", out);
+    return 1;
+  }
+  return 0;
+}
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  std::string cmd = argc > 1 ? argv[1] : "";
+  if (cmd == "selftest" && argc == 2) return selftest();
+  if (cmd == "bench" && argc == 2) return bench();
+  if (cmd == "rotate" && argc == 5 && (atoi(argv[4]) == 90 || atoi(argv[4]) == 270)) {
+    return rotateFile(argv[2], argv[3], atoi(argv[4]));
+  }
+  fprintf(stderr, "usage: %s rotate <in.bmp|in.ppm> <out.ppm> <90|270>\n"
+                  "       %s selftest\n"
+                  "       %s bench\n", argv[0], argv[0], argv[0]);
+  return 2;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file: sa818_emulator.cpp
+ * @brief: **SA818 stand-in: emulates the module's AT interface.**
+ * Uses the same sa818_protocol.h as the firmware.
+ *
+ *   sa818_emulator /dev/ttyUSB0     act as the module on a serial port (9600 8N1)
+ *   sa818_emulator selftest         run the beacon's configuration logic
+ *                                   against the emulator over simulated wakes
+ *
+ * Serial mode: wire the USB-serial adapter to SA818_TX_PIN/SA818_RX_PIN of
+ * the beacon; every command and the resulting radio state are printed.
+ * `selftest` checks that a configuration is sent once and then skipped,
+ * that only changed commands are resent, that everything is resent after
+ * a power cycle (RTC memory lost) and that a rejected command is retried,
+ * and reports the time saved per wake (link at 9600 baud plus the
+ * module's reply latency).
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -o sa818_emulator sa818_emulator.cpp
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "sa818_protocol.h"
+
+// ---------------------- Emulated Module ----------------------
+struct SA818Emulator {
+  bool connected = false;
+  SA818Config state = { 0, 0, 0, 0, 0, 0, 0 };
+  int commands = 0;
+
+  // Frequencies of the VHF model (SA818-V)
+  static bool frequencyOk(double mhz) { return mhz >= 134.0 && mhz <= 174.0; }
+
+  // Returns the reply line (CR LF included), empty for unknown commands
+  std::string handle(const std::string &line) {
+    commands++;
+    if (line == "AT+DMOCONNECT") {
+      connected = true;
+      return "+DMOCONNECT:0\r\n";
+    }
+    unsigned bw, txc, sq, rxc, volume;
+    double tx, rx;
+    if (sscanf(line.c_str(), "AT+DMOSETGROUP=%u,%lf,%lf,%u,%u,%u", &bw, &tx, &rx, &txc, &sq, &rxc) == 6) {
+      bool ok = connected && bw <= 1 && frequencyOk(tx) && frequencyOk(rx) && txc <= 38 && rxc <= 38 && sq <= 8;
+      if (ok) {
+        state.bandwidth = bw;
+        state.txHz = (uint32_t)(tx * 1e6 + 0.5);
+        state.rxHz = (uint32_t)(rx * 1e6 + 0.5);
+        state.txCtcss = txc;
+        state.rxCtcss = rxc;
+        state.squelch = sq;
+      }
+      return ok ? "+DMOSETGROUP:0\r\n" : "+DMOSETGROUP:1\r\n";
+    }
+    if (sscanf(line.c_str(), "AT+DMOSETVOLUME=%u", &volume) == 1) {
+      bool ok = connected && volume >= 1 && volume <= 8;
+      if (ok) state.volume = volume;
+      return ok ? "+DMOSETVOLUME:0\r\n" : "+DMOSETVOLUME:1\r\n";
+    }
+    return "";
+  }
+
+  void print() const {
+    printf("  state: %lu.%04lu/%lu.%04lu MHz, %s kHz, CTCSS %u/%u, squelch %u, volume %u\n",
+           (unsigned long)(state.txHz / 1000000), (unsigned long)(state.txHz % 1000000 / 100),
+           (unsigned long)(state.rxHz / 1000000), (unsigned long)(state.rxHz % 1000000 / 100),
+           state.bandwidth ? "25" : "12.5", state.txCtcss, state.rxCtcss, state.squelch, state.volume);
+  }
+};
+
+// ---------------------- Serial Stand-in ----------------------
+static int serve(const char* device) {
+  int fd = open(device, O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    perror(device);
+    return 2;
+  }
+  struct termios tio;
+  tcgetattr(fd, &tio);
+  cfmakeraw(&tio);
+  cfsetispeed(&tio, B9600);
+  cfsetospeed(&tio, B9600);
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  tcsetattr(fd, TCSANOW, &tio);
+  printf("SA818 emulator on %s (9600 8N1)\n", device);
+
+  SA818Emulator module;
+  std::string line;
+  char c;
+  while (read(fd, &c, 1) == 1) {
+    if (c == '\r') continue;
+    if (c != '\n') {
+      if (line.size() < 128) line += c;
+      continue;
+    }
+    std::string reply = module.handle(line);
+    printf("> %s\n< %s", line.c_str(), reply.empty() ? "(no reply)\n" : reply.c_str());
+    if (!reply.empty()) {
+      if (write(fd, reply.data(), reply.size()) < 0) break;
+      module.print();
+    }
+    line.clear();
+  }
+  close(fd);
+  return 0;
+}
+
+// ---------------------- Self Test ----------------------
+// Link with the timing of the real one: 9600 baud 8N1 plus reply latency
+struct EmulatedLink {
+  SA818Emulator &module;
+  double ms = 0;
+  int woken = 0;
+  static constexpr double wakeMs = 500, replyLatencyMs = 60, msPerByte = 10.0 / 9.6;
+
+  void wake() {
+    woken++;
+    ms += wakeMs;
+  }
+  bool transact(const char* line, const char* expectedReply) {
+    std::string text(line);
+    std::string reply = module.handle(text.substr(0, text.find('\r')));
+    ms += (text.size() + reply.size()) * msPerByte + replyLatencyMs;
+    return reply.compare(0, strlen(expectedReply), expectedReply) == 0;
+  }
+};
+
+static bool check(bool ok, const char* what) {
+  printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+static int selftest() {
+  SA818Emulator module;
+  SA818Config cfg = { 145500000, 145500000, 1, 0, 0, 4, 6 };
+  uint32_t applied[SA818_CMD_COUNT] = { 0 };   // RTC memory
+  bool ok = true;
+
+  EmulatedLink first = { module };
+  ok &= check(sa818Apply(first, cfg, applied) == 2 && module.state.txHz == 145500000 && module.state.volume == 6,
+              "first wake: group and volume sent");
+  EmulatedLink cached = { module };
+  int before = module.commands;
+  ok &= check(sa818Apply(cached, cfg, applied) == 0 && module.commands == before && cached.woken == 0,
+              "next wake: nothing sent, no wait");
+
+  cfg.volume = 3;
+  EmulatedLink volume = { module };
+  before = module.commands;
+  ok &= check(sa818Apply(volume, cfg, applied) == 1 && module.commands == before + 2 && module.state.volume == 3,
+              "volume changed: handshake + volume only");
+
+  cfg.txCtcss = cfg.rxCtcss = 12;
+  EmulatedLink tone = { module };
+  ok &= check(sa818Apply(tone, cfg, applied) == 1 && module.state.txCtcss == 12, "CTCSS changed: group only");
+
+  memset(applied, 0, sizeof(applied));   // power cycle
+  EmulatedLink power = { module };
+  ok &= check(sa818Apply(power, cfg, applied) == 2, "after power cycle: everything resent");
+
+  SA818Config bad = cfg;
+  bad.txHz = bad.rxHz = 435000000;        // UHF on a VHF module
+  EmulatedLink rejected = { module };
+  ok &= check(sa818Apply(rejected, bad, applied) == -1 && module.state.txHz == 145500000,
+              "rejected frequency: error, state unchanged");
+  EmulatedLink retry = { module };
+  ok &= check(sa818Apply(retry, bad, applied) == -1, "rejected command retried next wake");
+
+  printf("\nconfiguration on every wake: %.0f ms, cached: %.0f ms\n", first.ms, cached.ms);
+  return ok ? 0 : 1;
+}
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <serial device>\n       %s selftest\n", argv[0], argv[0]);
+    return 2;
+  }
+  if (std::string(argv[1]) == "selftest") return selftest();
+  return serve(argv[1]);
+}
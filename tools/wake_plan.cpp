@@ -0,0 +1,228 @@
+/**
+ * @file: wake_plan.cpp
+ * @brief: **Host test and planner of the deep sleep wake stub.**
+ * Uses the same wake_plan.h as the firmware.
+ *
+ *   wake_plan day <lat> <lon> <YYYY-MM-DD> [--interval <s>] [--hours <mask>] [--altitude <deg>]
+ *                 [--max-skips <n>]
+ *   wake_plan selftest
+ *
+ * `day` prints the night window of that date at the position and runs one
+ * UTC day of wakes through the stub decision (GPS clock, battery fine):
+ * which wakes transmit, which are skipped and why, and the refresh boots
+ * forced by --max-skips (which go back to sleep while the wake would still
+ * be skipped). Defaults: --interval 300, --hours 0xFFFFFF, --altitude
+ * -0.833, --max-skips 48 (the sketch settings). `selftest` checks the
+ * decision against hand-made plans and the sunset and sunrise against
+ * published times.
+ *
+ * Build: g++ -O2 -std=c++17 -I.. -o wake_plan wake_plan.cpp
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "wake_plan.h"
+
+static bool check(bool ok, const char* what) {
+  printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Days since 1970 of a date (proleptic Gregorian)
+static uint32_t utcOfDate(int y, int m, int d) {
+  y -= m <= 2;
+  int era = y / 400, yoe = y - era * 400;
+  int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return (uint32_t)(era * 146097 + doe - 719468) * wakeDaySeconds;
+}
+
+static void printTime(uint32_t second) {
+  printf("%02u:%02u", second / 3600, second / 60 % 60);
+}
+
+static WakePlan basePlan(uint32_t utc) {
+  WakePlan p = {};
+  p.armed = 1;
+  p.clockValid = 1;
+  p.nextUtc = utc;
+  p.intervalS = 300;
+  p.slotHours = 0xFFFFFF;
+  p.maxSkips = 48;
+  return p;
+}
+
+// ---------------------- Self Test ----------------------
+static bool sunCase(const char* what, double lat, double lon, uint32_t date, int setH, int setM, int riseH, int riseM) {
+  uint32_t start, end;
+  wakeNightWindow(lat, lon, date, -0.833, start, end);
+  int setError = (int)start - (setH * 3600 + setM * 60), riseError = (int)end - (riseH * 3600 + riseM * 60);
+  char text[80];
+  snprintf(text, sizeof(text), "%s (errors %+d / %+d s)", what, setError, riseError);
+  return check(abs(setError) <= 300 && abs(riseError) <= 300, text);
+}
+
+static int selftest() {
+  bool ok = true;
+  uint32_t noon = utcOfDate(2024, 6, 1) + 12 * 3600;
+  WakePlan p = basePlan(noon);
+  ok &= check(wakePlanDecide(p, 0, false) == WAKE_BOOT, "plain plan boots");
+  p.armed = 0;
+  p.slotHours = 0;
+  ok &= check(wakePlanDecide(p, 0, false) == WAKE_BOOT, "disarmed plan boots whatever it says");
+  p = basePlan(noon);
+  p.slotHours = ~(1u << 12);
+  ok &= check(wakePlanDecide(p, 0, false) == WAKE_OFF_SLOT, "hour 12 not in the slot table: skipped");
+  p.clockValid = 0;
+  ok &= check(wakePlanDecide(p, 0, false) == WAKE_BOOT, "no clock: slot table not used");
+  p = basePlan(noon);
+  p.batteryMinRaw = 2000;
+  ok &= check(wakePlanDecide(p, 1999, true) == WAKE_LOW_BATTERY, "battery below the limit: skipped");
+  ok &= check(wakePlanDecide(p, 1999, false) == WAKE_BOOT, "no ULP sample since the sleep: boots");
+  ok &= check(wakePlanDecide(p, 2000, true) == WAKE_BOOT, "battery at the limit: boots");
+  p = basePlan(noon);
+  p.nightStart = 20 * 3600;
+  p.nightEnd = 5 * 3600;
+  ok &= check(wakePlanDecide(p, 0, false) == WAKE_BOOT, "noon outside a 20:00-05:00 night");
+  p.nextUtc = noon + 11 * 3600;
+  ok &= check(wakePlanDecide(p, 0, false) == WAKE_NIGHT, "23:00 inside it (wraps at midnight)");
+  p.nextUtc = noon - 8 * 3600;
+  ok &= check(wakePlanDecide(p, 0, false) == WAKE_NIGHT, "04:00 inside it");
+  p.nextUtc = noon - 7 * 3600;
+  ok &= check(wakePlanDecide(p, 0, false) == WAKE_BOOT, "05:00 (sunrise) outside it");
+  p.nightStart = 0;
+  p.nightEnd = wakeDaySeconds;
+  ok &= check(wakePlanDecide(p, 0, false) == WAKE_NIGHT, "polar night window covers noon");
+
+  // Skips advance the plan and stop at maxSkips
+  p = basePlan(noon);
+  p.slotHours = 0;
+  p.maxSkips = 3;
+  int skips = 0;
+  while (wakePlanStub(p, 0, false) != WAKE_BOOT) skips++;
+  ok &= check(skips == 3 && p.skippedBy[WAKE_OFF_SLOT] == 3 && p.nextUtc == noon + 900,
+              "3 skips move the wake 3 intervals, then it boots");
+  ok &= check(p.forced == WAKE_OFF_SLOT, "that boot is marked forced (off slot)");
+
+  // A forced boot refreshes the plan only: at night it does not transmit
+  p = basePlan(noon - 9 * 3600);   // 03:00
+  p.nightStart = 20 * 3600;
+  p.nightEnd = 5 * 3600;
+  p.maxSkips = 2;
+  while (wakePlanStub(p, 0, false) != WAKE_BOOT) { }
+  ok &= check(p.forced == WAKE_NIGHT && wakePlanRecheck(p, 0, false) == WAKE_NIGHT,
+              "forced boot at night: recheck says no transmission");
+  ok &= check(p.forced == WAKE_BOOT && p.skipped == 0, "recheck clears the mark and the skips");
+  ok &= check(wakePlanStub(p, 0, false) == WAKE_NIGHT, "next night wake skipped again by the stub");
+  p = basePlan(noon);
+  p.batteryMinRaw = 2000;
+  p.maxSkips = 1;
+  while (wakePlanStub(p, 1500, true) != WAKE_BOOT) { }
+  ok &= check(wakePlanRecheck(p, 1500, true) == WAKE_LOW_BATTERY, "forced boot on a low battery: no transmission");
+  p = basePlan(noon);
+  p.batteryMinRaw = 2000;
+  p.maxSkips = 1;
+  while (wakePlanStub(p, 1500, true) != WAKE_BOOT) { }
+  ok &= check(wakePlanRecheck(p, 2100, true) == WAKE_BOOT, "forced boot, battery recovered: transmits");
+  p = basePlan(noon);
+  ok &= check(wakePlanStub(p, 0, false) == WAKE_BOOT && wakePlanRecheck(p, 0, false) == WAKE_BOOT,
+              "normal boot: recheck lets it transmit");
+
+  // Published sunset and sunrise (UTC), same day: set of that day, rise of that day
+  ok &= sunCase("London 2024-03-20 set 18:14 rise 06:03", 51.5074, -0.1278, utcOfDate(2024, 3, 20), 18, 14, 6, 3);
+  ok &= sunCase("London 2024-06-21 set 20:21 rise 03:43", 51.5074, -0.1278, utcOfDate(2024, 6, 21), 20, 21, 3, 43);
+  ok &= sunCase("Rome 2024-12-21 set 15:42 rise 06:35", 41.9028, 12.4964, utcOfDate(2024, 12, 21), 15, 42, 6, 35);
+  ok &= sunCase("Sydney 2024-12-21 set 09:05 rise 18:41", -33.8688, 151.2093, utcOfDate(2024, 12, 21), 9, 5, 18, 41);
+  uint32_t start, end;
+  wakeNightWindow(69.6492, 18.9553, utcOfDate(2024, 12, 21), -0.833, start, end);
+  ok &= check(start == 0 && end == wakeDaySeconds, "Tromso 2024-12-21: polar night");
+  wakeNightWindow(69.6492, 18.9553, utcOfDate(2024, 6, 21), -0.833, start, end);
+  ok &= check(start == end, "Tromso 2024-06-21: midnight sun, no night");
+  return ok ? 0 : 1;
+}
+
+// ---------------------- Day Plan ----------------------
+static int day(double lat, double lon, uint32_t date, uint32_t interval, uint32_t hours, double altitude, int maxSkips) {
+  WakePlan p = basePlan(date);
+  p.intervalS = interval;
+  p.slotHours = hours;
+  p.maxSkips = (uint16_t)maxSkips;
+  wakeNightWindow(lat, lon, date, altitude, p.nightStart, p.nightEnd);
+  printf("Night (sun below %.3f deg): ", altitude);
+  if (p.nightStart == p.nightEnd) printf("none\n");
+  else if (p.nightEnd - p.nightStart == wakeDaySeconds) printf("all day\n");
+  else {
+    printTime(p.nightStart);
+    printf(" - ");
+    printTime(p.nightEnd);
+    printf(" UTC\n");
+  }
+  int boots = 0, refreshes = 0, skipped[WAKE_REASONS] = {};
+  WakeReason last = WAKE_REASONS;
+  uint32_t runStart = 0;
+  for (uint32_t t = date; t < date + wakeDaySeconds; t = p.nextUtc) {
+    WakeReason r = wakePlanStub(p, 0, false);
+    if (r == WAKE_BOOT && p.forced != WAKE_BOOT) {
+      // Refresh boot: the full boot checks again and sleeps while still skipped
+      WakeReason again = wakePlanRecheck(p, 0, false);
+      if (again != WAKE_BOOT) {
+        refreshes++;
+        p.nextUtc += interval;
+        r = again;
+      }
+    } else if (r != WAKE_BOOT) {
+      skipped[r]++;
+    }
+    if (r != last) {
+      if (last != WAKE_REASONS) {
+        printTime(runStart);
+        printf(" - ");
+        printTime((t - 1) % wakeDaySeconds);
+        printf("  %s\n", wakeReasonNames[last]);
+      }
+      last = r;
+      runStart = t % wakeDaySeconds;
+    }
+    if (r == WAKE_BOOT) {
+      boots++;
+      p.skipped = 0;
+      p.nextUtc += interval;
+    }
+  }
+  printTime(runStart);
+  printf(" - 24:00  %s\n", wakeReasonNames[last]);
+  int wakes = boots + refreshes + skipped[WAKE_OFF_SLOT] + skipped[WAKE_NIGHT];
+  printf("%d wakes: %d transmissions, %d refresh boots forced by --max-skips (no transmission), "
+         "%d skipped off slot, %d skipped at night\n", wakes, boots, refreshes, skipped[WAKE_OFF_SLOT], skipped[WAKE_NIGHT]);
+  return 0;
+}
+
+// ---------------------- Main ----------------------
+int main(int argc, char** argv) {
+  std::string cmd = argc > 1 ? argv[1] : "";
+  if (cmd == "selftest" && argc == 2) return selftest();
+  int y, m, d;
+  if (cmd == "day" && argc >= 5 && sscanf(argv[4], "%d-%d-%d", &y, &m, &d) == 3) {
+    uint32_t interval = 300, hours = 0xFFFFFF;
+    double altitude = -0.833;
+    int maxSkips = 48;
+    bool ok = true;
+    for (int i = 5; i < argc && ok; i += 2) {
+      ok = i + 1 < argc;
+      if (!ok) break;
+      if (!strcmp(argv[i], "--interval")) interval = (uint32_t)strtoul(argv[i + 1], NULL, 0);
+      else if (!strcmp(argv[i], "--hours")) hours = (uint32_t)strtoul(argv[i + 1], NULL, 0);
+      else if (!strcmp(argv[i], "--altitude")) altitude = atof(argv[i + 1]);
+      else if (!strcmp(argv[i], "--max-skips")) maxSkips = atoi(argv[i + 1]);
+      else ok = false;
+    }
+    if (ok && interval > 0 && maxSkips > 0) return day(atof(argv[2]), atof(argv[3]), utcOfDate(y, m, d), interval, hours,
+                                                       altitude, maxSkips);
+  }
+  fprintf(stderr, "usage: %s day <lat> <lon> <YYYY-MM-DD> [--interval <s>] [--hours <mask>] [--altitude <deg>]\n"
+                  "                [--max-skips <n>]\n"
+                  "       %s selftest\n", argv[0], argv[0]);
+  return 2;
+}
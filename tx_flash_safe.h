@@ -0,0 +1,69 @@
+#ifndef __TX_FLASH_SAFE_H
+#define __TX_FLASH_SAFE_H
+
+/*******************************************************
+ * Flash-write safety of the isolated transmit clock (TX_ISOLATION).
+ * While the flash is written or erased the cache is off on both cores:
+ * code in flash, constants in flash, PSRAM and lines mapped from flash are
+ * out of reach, and only interrupts allocated IRAM-safe keep running. A
+ * single function or table of the clock path left in flash stalls the
+ * tone for the whole write (up to tens of ms for a sector erase).
+ * txFlashSafeCheck() looks up where the linker actually put every piece
+ * the clock interrupt touches, so a missing IRAM_ATTR, or an ESP-IDF
+ * function the sdkconfig leaves in flash, shows at boot rather than as a
+ * glitch on air. The interrupt itself is allocated with ESP_INTR_FLAG_IRAM
+ * by txClockBegin(), whatever the core build. DEVICE_BENCH plays segments
+ * while a task writes NVS and shows the jitter histogram.
+ *******************************************************/
+
+/*******************************************************
+ * STRUCT: TxHotItem
+ * DESCRIPTION: Function or data the clock interrupt uses, and whether it
+ * is code (must be in IRAM) or data (must be in internal RAM).
+ *******************************************************/
+struct TxHotItem {
+  const char* name;
+  const void* address;
+  bool code;
+};
+
+/*******************************************************
+ * FUNCTION: txFlashSafeCheck
+ * DESCRIPTION: Checks the placement of the clock interrupt path and
+ * prints every piece found in flash or PSRAM, then a summary line.
+ * INPUT: None
+ * OUTPUT: bool (true if the whole path runs while the flash is written)
+ *******************************************************/
+bool txFlashSafeCheck() {
+  const TxHotItem items[] = {
+    { "txClockISR", (const void*)txClockISR, true },
+    { "txClockIdle", (const void*)txClockIdle, true },
+    { "txClockPark", (const void*)txClockPark, true },
+    { "pixelClockTick", (const void*)pixelClockTick, true },
+    { "pixelTickTiming", (const void*)pixelTickTiming, true },
+    { "pixelTickAdvance", (const void*)pixelTickAdvance, true },
+    { "pixelClockStop", (const void*)pixelClockStop, true },
+    { "ledcWriteToneFromISR", (const void*)ledcWriteToneFromISR, true },
+    { "sampleTimerISR", (const void*)sampleTimerISR, true },
+    { "ledcWriteDutyFromISR", (const void*)ledcWriteDutyFromISR, true },
+    { "esp_timer_get_time", (const void*)esp_timer_get_time, true },
+    { "levelToFrequency", levelToFrequency, false },
+    { "levelStage", levelStage, false },
+    { "sampleRing", sampleRing, false },
+    { "jitterHistogram", jitterHistogram, false },
+    { "segment state", (const void*)&pixelCounter, false },
+    { "txTick", (const void*)&txTick, false },
+  };
+  int misplaced = 0;
+  for (const TxHotItem &item : items) {
+    bool ok = item.code ? esp_ptr_in_iram(item.address) : esp_ptr_internal(item.address);
+    if (ok) continue;
+    Serial.printf("Flash-safe TX: %s at %p is not in %s\n", item.name, item.address, item.code ? "IRAM" : "internal RAM");
+    misplaced++;
+  }
+  Serial.printf("Flash-safe TX: %d of %d functions and tables in internal RAM, interrupt IRAM-safe\n",
+                (int)(sizeof(items) / sizeof(items[0])) - misplaced, (int)(sizeof(items) / sizeof(items[0])));
+  return misplaced == 0;
+}
+
+#endif
@@ -0,0 +1,272 @@
+#ifndef __TX_ISOLATION_H
+#define __TX_ISOLATION_H
+
+/*******************************************************
+ * Interrupt isolation of the transmit core (TX_ISOLATION).
+ * By default the pixel clock is an esp_timer: its interrupt and the task
+ * that runs the callback sit on core 0 with every other esp_timer user,
+ * and the camera, UART and SD interrupts land on the loop core, where they
+ * were installed. Each hop (interrupt, task switch, callbacks queued
+ * first) moves the pixel edges.
+ * With TX_ISOLATION the transmit path owns the loop core (txCore):
+ * - the pixel and sample engine clocks are one hardware timer (group 0,
+ *   timer 0), whose interrupt is allocated on txCore at TX_ISR_LEVEL (the
+ *   other drivers take level 1) and sets the tone itself;
+ * - the loop task, which renders the lines and fills the sample ring,
+ *   runs at TX_TASK_PRIORITY;
+ * - the peripherals are started by a task pinned to the other core. An
+ *   ESP-IDF interrupt stays on the core that allocated it, so theirs end
+ *   up there, with the esp_timer, decode and archive tasks.
+ * An interrupt handler may not use the FPU, so the clock only plays lines
+ * rendered in advance (SEG_BUFFER, SEG_LEVELS): PD120 without the pipeline
+ * renders each line pair during its sync pulse, as the deadline fallback
+ * does. The tick and cross-core interrupts of each core stay where they are.
+ * The clock also keeps the tone going while the flash is written (NVS, the
+ * journal, OTA): the cache is then off on both cores, the tasks wait, and
+ * only interrupts allocated with ESP_INTR_FLAG_IRAM, whose code and data
+ * are all in internal RAM, run. The GPTimer driver asks for that flag only
+ * when the core was built with CONFIG_GPTIMER_ISR_IRAM_SAFE, so the
+ * driver only reserves the timer: the interrupt is allocated here, and
+ * the counter and alarm are driven through the timer_ll HAL (inline
+ * register writes). The handler, the tick functions it calls and the LEDC
+ * register writes are IRAM_ATTR, the tables and line buffers they read in
+ * DRAM (lines mapped from flash are staged first), and tx_flash_safe.h
+ * checks it all at boot.
+ * The canvas is in PSRAM, behind the same cache, so it is never read from
+ * the handler.
+ *******************************************************/
+
+#include <driver/gptimer.h>
+#include <esp_intr_alloc.h>
+#include <soc/periph_defs.h>
+#include <hal/timer_ll.h>
+#include <freertos/semphr.h>
+#include <hal/ledc_ll.h>
+#include <esp_memory_utils.h>
+
+#ifndef TX_ISR_LEVEL
+#define TX_ISR_LEVEL 3          // 1-3 (3: the highest a C handler can take)
+#endif
+#ifndef TX_TASK_PRIORITY
+#define TX_TASK_PRIORITY 20     // Below the esp_timer (22) and IPC (24) tasks
+#endif
+
+/*******************************************************
+ * FUNCTION: txClockIdle
+ * DESCRIPTION: Tick of the parked clock (does nothing).
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void IRAM_ATTR txClockIdle() {
+}
+
+/*******************************************************
+ * GLOBAL VARIABLE: txTimer / txIntr / txTick
+ * DESCRIPTION: GPTimer handle that reserves the timer of the isolated
+ * clock (NULL until txClockBegin()), its interrupt, and the function the
+ * interrupt calls on each alarm.
+ *******************************************************/
+gptimer_handle_t txTimer = NULL;
+intr_handle_t txIntr = NULL;
+void (*volatile txTick)() = txClockIdle;
+/*******************************************************
+ * GLOBAL VARIABLE: txClockEnabled / txCore
+ * DESCRIPTION: Whether the pixel and sample clocks run on txTimer, and the
+ * core its interrupt was allocated on (-1: none).
+ *******************************************************/
+bool txClockEnabled = false;
+int txCore = -1;
+
+// ---------------------- Isolated Clock ----------------------
+/*******************************************************
+ * CONSTANT: txTimerReserved
+ * DESCRIPTION: Count the reserved timer is loaded with by the driver, to
+ * find it in timer group 0 (timer 0, the first one the driver hands out).
+ *******************************************************/
+const uint64_t txTimerReserved = 0x5A5A5A;
+
+/*******************************************************
+ * FUNCTION: txClockISR
+ * DESCRIPTION: **Timer Interrupt Service Routine**. Runs the tick of the
+ * clock user and re-arms the alarm (the ESP32 clears it on each alarm)
+ * while the clock is not parked. IRAM-safe: registers and DRAM only.
+ * INPUT: void* arg (unused)
+ * OUTPUT: None
+ *******************************************************/
+void IRAM_ATTR txClockISR(void* arg) {
+  timg_dev_t* hw = TIMER_LL_GET_HW(0);
+  timer_ll_clear_intr_status(hw, TIMER_LL_EVENT_ALARM(0));
+  txTick();
+  if (txTick != txClockIdle) timer_ll_enable_alarm(hw, 0, true);
+}
+
+/*******************************************************
+ * FUNCTION: txClockBegin
+ * DESCRIPTION: Creates the isolated clock: reserves timer 0 of group 0
+ * through the GPTimer driver (so timerBegin() never gets it), 1 µs per
+ * count, and allocates its interrupt IRAM-safe on the calling core, which
+ * becomes txCore.
+ * INPUT: None
+ * OUTPUT: bool (false if the timer was taken or no interrupt was free)
+ *******************************************************/
+bool txClockBegin() {
+  if (txTimer) return true;
+  gptimer_config_t config = {};
+  config.clk_src = GPTIMER_CLK_SRC_DEFAULT;
+  config.direction = GPTIMER_COUNT_UP;
+  config.resolution_hz = 1000000;       // 1 µs
+  if (gptimer_new_timer(&config, &txTimer) != ESP_OK) {
+    Serial.println("TX isolation: no timer free");
+    txTimer = NULL;
+    return false;
+  }
+  timg_dev_t* hw = TIMER_LL_GET_HW(0);
+  gptimer_set_raw_count(txTimer, txTimerReserved);
+  timer_ll_trigger_soft_capture(hw, 0);
+  if (timer_ll_get_counter_value(hw, 0) != txTimerReserved) {
+    Serial.println("TX isolation: timer 0 of group 0 already in use");
+    gptimer_del_timer(txTimer);
+    txTimer = NULL;
+    return false;
+  }
+  timer_ll_enable_intr(hw, TIMER_LL_EVENT_ALARM(0), false);
+  timer_ll_clear_intr_status(hw, TIMER_LL_EVENT_ALARM(0));
+  int flags = ESP_INTR_FLAG_IRAM | (ESP_INTR_FLAG_LEVEL1 << (TX_ISR_LEVEL - 1));
+  if (esp_intr_alloc(ETS_TG0_T0_LEVEL_INTR_SOURCE, flags, txClockISR, NULL, &txIntr) != ESP_OK) {
+    Serial.printf("TX isolation: no level %d interrupt free\n", TX_ISR_LEVEL);
+    gptimer_del_timer(txTimer);
+    txTimer = NULL;
+    return false;
+  }
+  timer_ll_enable_intr(hw, TIMER_LL_EVENT_ALARM(0), true);
+  txCore = xPortGetCoreID();
+  return true;
+}
+
+/*******************************************************
+ * FUNCTION: txClockStart
+ * DESCRIPTION: Calls `tick` from the isolated clock interrupt every
+ * `periodUs`, the first time one period from now. A parked or running
+ * clock is restarted from zero.
+ * INPUT: uint32_t periodUs, void (*tick)()
+ * OUTPUT: None
+ *******************************************************/
+void txClockStart(uint32_t periodUs, void (*tick)()) {
+  timg_dev_t* hw = TIMER_LL_GET_HW(0);
+  timer_ll_enable_counter(hw, 0, false);
+  timer_ll_enable_alarm(hw, 0, false);
+  timer_ll_set_reload_value(hw, 0, 0);
+  timer_ll_trigger_soft_reload(hw, 0);
+  timer_ll_set_alarm_value(hw, 0, periodUs);
+  timer_ll_enable_auto_reload(hw, 0, true);
+  timer_ll_clear_intr_status(hw, TIMER_LL_EVENT_ALARM(0));
+  txTick = tick;
+  timer_ll_enable_alarm(hw, 0, true);
+  timer_ll_enable_counter(hw, 0, true);
+}
+
+/*******************************************************
+ * FUNCTION: txClockPark
+ * DESCRIPTION: Ends the ticks, from the clock's own interrupt: the alarm
+ * is not re-armed after this one, and the timer counts on silently until
+ * the next txClockStart() or txClockStop().
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void IRAM_ATTR txClockPark() {
+  txTick = txClockIdle;
+}
+
+/*******************************************************
+ * FUNCTION: txClockStop
+ * DESCRIPTION: Stops the isolated clock (from a task).
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void txClockStop() {
+  timg_dev_t* hw = TIMER_LL_GET_HW(0);
+  txTick = txClockIdle;
+  timer_ll_enable_alarm(hw, 0, false);
+  timer_ll_enable_counter(hw, 0, false);
+}
+
+// ---------------------- Interrupt Placement ----------------------
+/*******************************************************
+ * STRUCT: TxCoreJob
+ * DESCRIPTION: Function run by txRunOnCore() and the semaphore it gives
+ * when done.
+ *******************************************************/
+struct TxCoreJob {
+  void (*fn)();
+  SemaphoreHandle_t done;
+};
+
+/*******************************************************
+ * FUNCTION: txCoreJobTask
+ * DESCRIPTION: FreeRTOS task that runs one TxCoreJob and ends.
+ * INPUT: void* arg (TxCoreJob)
+ * OUTPUT: None
+ *******************************************************/
+void txCoreJobTask(void* arg) {
+  TxCoreJob* job = (TxCoreJob*)arg;
+  job->fn();
+  xSemaphoreGive(job->done);
+  vTaskDelete(NULL);
+}
+
+/*******************************************************
+ * FUNCTION: txRunOnCore
+ * DESCRIPTION: Runs fn() on `core` (at the caller's priority) and waits
+ * for it: the interrupts it installs are allocated on that core.
+ * INPUT: int core, void (*fn)()
+ * OUTPUT: None
+ *******************************************************/
+void txRunOnCore(int core, void (*fn)()) {
+  TxCoreJob job = { fn, xSemaphoreCreateBinary() };
+  xTaskCreatePinnedToCore(txCoreJobTask, "txplace", 8192, &job, uxTaskPriorityGet(NULL), NULL, core);
+  xSemaphoreTake(job.done, portMAX_DELAY);
+  vSemaphoreDelete(job.done);
+}
+
+/*******************************************************
+ * GLOBAL VARIABLE: txPeripherals
+ * DESCRIPTION: Peripheral setup handed to txIsolationBegin().
+ *******************************************************/
+void (*txPeripherals)() = NULL;
+
+/*******************************************************
+ * FUNCTION: txPeripheralsSetup
+ * DESCRIPTION: Runs on the other core: restarts the serial port, so the
+ * UART0 interrupt moves there, then sets up the peripherals.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void txPeripheralsSetup() {
+  uint32_t baud = Serial.baudRate();
+  Serial.end();
+  Serial.begin(baud);
+  txPeripherals();
+}
+
+/*******************************************************
+ * FUNCTION: txIsolationBegin
+ * DESCRIPTION: Call from the loop task in place of the peripheral setup:
+ * runs `peripherals` on the other core, then creates the isolated clock
+ * on this one and raises the loop task to TX_TASK_PRIORITY. Without a
+ * free timer the esp_timer clock is kept.
+ * INPUT: void (*peripherals)() (Camera, UARTs, SD card, ...)
+ * OUTPUT: None
+ *******************************************************/
+void txIsolationBegin(void (*peripherals)()) {
+  int core = xPortGetCoreID();
+  Serial.flush();
+  txPeripherals = peripherals;
+  txRunOnCore(1 - core, txPeripheralsSetup);
+  if (!txClockBegin()) return;
+  txClockEnabled = true;
+  vTaskPrioritySet(NULL, TX_TASK_PRIORITY);
+  Serial.printf("TX isolation: clock interrupt on core %d (level %d), peripherals on core %d, loop priority %d\n",
+                txCore, TX_ISR_LEVEL, 1 - core, TX_TASK_PRIORITY);
+}
+
+#endif
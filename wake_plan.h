@@ -0,0 +1,197 @@
+#ifndef __WAKE_PLAN_H
+#define __WAKE_PLAN_H
+
+/*******************************************************
+ * Skip plan of the deep sleep wake stub (wake_stub.h): what a wake needs
+ * to know, before the full boot, to tell whether it has anything to do.
+ * The beacon fills a WakePlan in RTC memory before it sleeps; the stub
+ * checks the coming wake against it with integer arithmetic only (no
+ * flash, no FPU), and either boots or goes back to sleep for another
+ * interval. A wake is skipped when
+ * - the battery, sampled by the ULP during the sleep, is below the limit,
+ * - its UTC hour is not in the slot table (a 24-bit mask of hours),
+ * - it falls in the night at the beacon position (sunset to sunrise,
+ *   computed by the beacon from the GPS fix when it arms the plan);
+ * the last two need the GPS clock. After maxSkips skips in a row the wake
+ * boots anyway, so the plan, the night and the battery calibration are
+ * refreshed: the stub marks that boot as forced, and the full boot checks
+ * the wake again (wakePlanRecheck()) and goes back to sleep, without
+ * transmitting, while it would still be skipped.
+ * Plain C++ with no Arduino dependency (also used by tools/wake_plan.cpp).
+ *******************************************************/
+
+#include <stdint.h>
+#include <math.h>
+
+#ifndef RTC_IRAM_ATTR
+#define RTC_IRAM_ATTR
+#endif
+
+/*******************************************************
+ * CONSTANT: wakeDaySeconds
+ * DESCRIPTION: Seconds in a UTC day.
+ *******************************************************/
+const uint32_t wakeDaySeconds = 86400;
+
+/*******************************************************
+ * ENUM: WakeReason
+ * DESCRIPTION: Outcome of the stub for one wake: boot, or the reason it
+ * was skipped.
+ *******************************************************/
+enum WakeReason : uint8_t { WAKE_BOOT, WAKE_LOW_BATTERY, WAKE_OFF_SLOT, WAKE_NIGHT, WAKE_REASONS };
+
+/*******************************************************
+ * CONSTANT: wakeReasonNames
+ * DESCRIPTION: Printable name of each WakeReason.
+ *******************************************************/
+const char* const wakeReasonNames[WAKE_REASONS] = { "boot", "low battery", "off slot", "night" };
+
+/*******************************************************
+ * STRUCT: WakePlan
+ * DESCRIPTION: Kept in RTC memory across the sleeps. nightStart and
+ * nightEnd are seconds of the UTC day (the window may wrap at midnight;
+ * equal: no night, 0 and wakeDaySeconds: all night). batteryMinRaw is the
+ * battery limit in ULP ADC counts (0: not checked). skippedBy counts the
+ * skips since the last boot per WakeReason. forced is the reason the wake
+ * would have been skipped when the stub let it boot for the refresh
+ * (WAKE_BOOT: a normal boot).
+ *******************************************************/
+struct WakePlan {
+  uint8_t armed;          // 0: the next wake boots whatever the plan says
+  uint8_t clockValid;     // nextUtc is known (GPS clock): slot table and night apply
+  uint8_t ulpRunning;     // The ULP samples the battery
+  uint8_t forced;         // WakeReason of a refresh boot after maxSkips skips
+  uint32_t nextUtc;       // UTC of the coming wake (seconds since 1970)
+  uint32_t intervalS;     // Sleep after a skipped wake
+  uint32_t slotHours;     // Bit n set: wakes in UTC hour n may transmit
+  uint32_t nightStart;
+  uint32_t nightEnd;
+  uint16_t batteryMinRaw;
+  uint16_t maxSkips;
+  uint16_t skipped;       // Skips in a row
+  uint16_t skippedBy[WAKE_REASONS];
+};
+
+// ---------------------- Stub Decision ----------------------
+/*******************************************************
+ * FUNCTION: wakeInWindow
+ * DESCRIPTION: Whether a second of the day is in [start, end), the window
+ * wrapping at midnight when start > end.
+ * INPUT: uint32_t second, uint32_t start, uint32_t end
+ * OUTPUT: bool
+ *******************************************************/
+inline bool RTC_IRAM_ATTR wakeInWindow(uint32_t second, uint32_t start, uint32_t end) {
+  return start <= end ? second >= start && second < end : second >= start || second < end;
+}
+
+/*******************************************************
+ * FUNCTION: wakePlanDecide
+ * DESCRIPTION: Checks the skip conditions of the coming wake
+ * (plan.nextUtc). Runs in the wake stub: integer only, no calls out of RTC
+ * memory.
+ * INPUT: const WakePlan &plan, uint32_t batteryRaw (Last ULP sample), bool batteryFresh (sampled during this sleep)
+ * OUTPUT: WakeReason (WAKE_BOOT: continue to the full boot)
+ *******************************************************/
+inline WakeReason RTC_IRAM_ATTR wakePlanDecide(const WakePlan &plan, uint32_t batteryRaw, bool batteryFresh) {
+  if (!plan.armed) return WAKE_BOOT;
+  if (batteryFresh && batteryRaw < plan.batteryMinRaw) return WAKE_LOW_BATTERY;
+  if (plan.clockValid) {
+    uint32_t second = plan.nextUtc % wakeDaySeconds;
+    if (!((plan.slotHours >> (second / 3600)) & 1)) return WAKE_OFF_SLOT;
+    if (wakeInWindow(second, plan.nightStart, plan.nightEnd)) return WAKE_NIGHT;
+  }
+  return WAKE_BOOT;
+}
+
+/*******************************************************
+ * FUNCTION: wakePlanSkip
+ * DESCRIPTION: Counts a skipped wake and moves the plan to the next one,
+ * one interval later.
+ * INPUT: WakePlan &plan, WakeReason reason
+ * OUTPUT: None
+ *******************************************************/
+inline void RTC_IRAM_ATTR wakePlanSkip(WakePlan &plan, WakeReason reason) {
+  plan.skipped++;
+  plan.skippedBy[reason]++;
+  plan.nextUtc += plan.intervalS;
+}
+
+/*******************************************************
+ * FUNCTION: wakePlanStub
+ * DESCRIPTION: Decision of the wake stub: skips the wake (counted, plan
+ * moved on), or lets it boot. After maxSkips skips a wake that would be
+ * skipped boots all the same, marked forced, to refresh the plan.
+ * INPUT: WakePlan &plan, uint32_t batteryRaw (Last ULP sample), bool batteryFresh (sampled during this sleep)
+ * OUTPUT: WakeReason (WAKE_BOOT: continue to the full boot, else the wake was skipped)
+ *******************************************************/
+inline WakeReason RTC_IRAM_ATTR wakePlanStub(WakePlan &plan, uint32_t batteryRaw, bool batteryFresh) {
+  WakeReason reason = wakePlanDecide(plan, batteryRaw, batteryFresh);
+  if (reason == WAKE_BOOT) return WAKE_BOOT;
+  if (plan.skipped >= plan.maxSkips) {
+    plan.forced = reason;
+    return WAKE_BOOT;
+  }
+  wakePlanSkip(plan, reason);
+  return reason;
+}
+
+/*******************************************************
+ * FUNCTION: wakePlanRecheck
+ * DESCRIPTION: Full boot side of a refresh boot: checks the wake again,
+ * with no limit on the skips, once the plan has been refreshed (clock,
+ * night, battery calibration). Clears the forced mark and the skip count.
+ * INPUT: WakePlan &plan, uint32_t batteryRaw, bool batteryFresh
+ * OUTPUT: WakeReason (WAKE_BOOT: transmit, else go back to sleep without transmitting)
+ *******************************************************/
+inline WakeReason wakePlanRecheck(WakePlan &plan, uint32_t batteryRaw, bool batteryFresh) {
+  WakeReason forced = (WakeReason)plan.forced;
+  plan.forced = WAKE_BOOT;
+  plan.skipped = 0;
+  if (forced == WAKE_BOOT) return WAKE_BOOT;
+  return wakePlanDecide(plan, batteryRaw, batteryFresh);
+}
+
+// ---------------------- Night ----------------------
+/*******************************************************
+ * FUNCTION: wakeNightWindow
+ * DESCRIPTION: Sunset and sunrise, as seconds of the UTC day, on the day
+ * of `utc` at a position: the sun below `altitude` degrees (-0.833 for
+ * the usual sunset, lower to keep the twilight). Low precision solar
+ * position (declination and equation of time from the day of the year),
+ * within a few minutes away from the polar circles. Polar night gives
+ * the whole day, midnight sun no window.
+ * INPUT: double latitude, double longitude (degrees, east positive), uint32_t utc, double altitude,
+ * uint32_t &start, uint32_t &end
+ * OUTPUT: None
+ *******************************************************/
+void wakeNightWindow(double latitude, double longitude, uint32_t utc, double altitude, uint32_t &start, uint32_t &end) {
+  const double rad = M_PI / 180.0;
+  // Day of the year (0-based) from days since 1970, within a few hours
+  double year = (utc / 86400.0) / 365.2425;
+  double day = (year - floor(year)) * 365.2425;
+  double g = 2.0 * M_PI / 365.0 * day;
+  double declination = 0.006918 - 0.399912 * cos(g) + 0.070257 * sin(g) - 0.006758 * cos(2 * g) +
+                       0.000907 * sin(2 * g) - 0.002697 * cos(3 * g) + 0.00148 * sin(3 * g);
+  double equationMin = 229.18 * (0.000075 + 0.001868 * cos(g) - 0.032077 * sin(g) - 0.014615 * cos(2 * g) -
+                                 0.040849 * sin(2 * g));
+  double cosHour = (sin(altitude * rad) - sin(latitude * rad) * sin(declination)) /
+                   (cos(latitude * rad) * cos(declination));
+  if (cosHour >= 1.0) {          // Polar night
+    start = 0;
+    end = wakeDaySeconds;
+    return;
+  }
+  if (cosHour <= -1.0) {         // Midnight sun
+    start = end = 0;
+    return;
+  }
+  double noonS = (720.0 - 4.0 * longitude - equationMin) * 60.0;
+  double halfDayS = acos(cosHour) / rad * 4.0 * 60.0;
+  double sunset = fmod(noonS + halfDayS, (double)wakeDaySeconds), sunrise = fmod(noonS - halfDayS, (double)wakeDaySeconds);
+  if (sunset < 0) sunset += wakeDaySeconds;
+  if (sunrise < 0) sunrise += wakeDaySeconds;
+  start = (uint32_t)sunset;
+  end = (uint32_t)sunrise;
+}
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef __WAKE_STUB_H
+#define __WAKE_STUB_H
+
+/*******************************************************
+ * Deep sleep wake stub (WAKE_STUB).
+ * Every wake from Deep Sleep first runs wakeStub() from RTC fast memory,
+ * before the bootloader loads the app. It checks the coming wake against
+ * the WakePlan the beacon left in RTC memory (wake_plan.h: battery, slot
+ * table, night) and, when there is nothing to do, sets the timer for the
+ * next interval and sleeps again: a few ms awake, instead of the
+ * bootloader, the app start, the camera and Serial of a full cycle.
+ * The battery is read during the sleep by the ULP coprocessor, every
+ * WAKE_ULP_PERIOD_MS, from BATTERY_PIN into RTC slow memory. The ULP
+ * gives raw ADC counts: at each full boot the last ULP sample is paired
+ * with readBatteryMillivolts() to turn WAKE_MIN_BATTERY_MV into counts.
+ * The slot table and the night need the GPS clock (and the night the
+ * cached GPS position); without it only the battery is checked. A boot
+ * the stub forces after WAKE_MAX_SKIPS skips only refreshes the plan:
+ * wakeStubBegin() checks the wake again and, if it would still be
+ * skipped, wakeStubSleep() goes back to sleep before the camera and PTT.
+ * The stub and the data it reads are all in RTC memory: it calls nothing
+ * in flash (esp_wake_stub_*() are RTC functions of ESP-IDF).
+ *******************************************************/
+
+#include <esp_wake_stub.h>
+#include <esp32/ulp.h>
+#include <ulp_adc.h>
+#include "wake_plan.h"
+
+#ifndef WAKE_MIN_BATTERY_MV
+#define WAKE_MIN_BATTERY_MV 3300
+#endif
+#ifndef WAKE_SLOT_HOURS
+#define WAKE_SLOT_HOURS 0xFFFFFF
+#endif
+#ifndef WAKE_SUN_ALTITUDE
+#define WAKE_SUN_ALTITUDE -0.833
+#endif
+#ifndef WAKE_MAX_SKIPS
+#define WAKE_MAX_SKIPS 48
+#endif
+#ifndef WAKE_ULP_PERIOD_MS
+#define WAKE_ULP_PERIOD_MS 10000
+#endif
+#if WAKE_MAX_SKIPS < 1 || WAKE_MAX_SKIPS > 65535
+#error "WAKE_MAX_SKIPS must be 1-65535"
+#endif
+#if !defined(CONFIG_ULP_COPROC_RESERVE_MEM) || CONFIG_ULP_COPROC_RESERVE_MEM < 264
+#error "WAKE_STUB needs the ULP coprocessor with at least 264 bytes of RTC slow memory reserved"
+#endif
+
+/*******************************************************
+ * CONSTANT: wakeUlpData
+ * DESCRIPTION: RTC slow memory word of the ULP results, after its program:
+ * [0] last battery sample (ADC counts), [1] samples since the plan was
+ * armed (the ULP stores 16 bits per word).
+ *******************************************************/
+const int wakeUlpData = 64;
+
+/*******************************************************
+ * GLOBAL VARIABLE: wakePlan (RTC memory)
+ * DESCRIPTION: Plan the stub checks each wake against.
+ *******************************************************/
+RTC_DATA_ATTR WakePlan wakePlan = {};
+
+// ---------------------- Wake Stub ----------------------
+/*******************************************************
+ * FUNCTION: wakeStub
+ * DESCRIPTION: Runs at every wake from Deep Sleep, before the bootloader.
+ * Returns to boot the beacon, or sleeps one more interval.
+ * INPUT: None
+ * OUTPUT: None
+ *******************************************************/
+void RTC_IRAM_ATTR wakeStub() {
+  esp_default_wake_deep_sleep();
+  uint32_t raw = RTC_SLOW_MEM[wakeUlpData] & 0xFFFF;
+  bool fresh = wakePlan.ulpRunning && (RTC_SLOW_MEM[wakeUlpData + 1] & 0xFFFF) != 0;
+  if (wakePlanStub(wakePlan, raw, fresh) == WAKE_BOOT) return;
+  esp_wake_stub_set_wakeup_time((uint64_t)wakePlan.intervalS * 1000000);
+  esp_wake_stub_sleep(&wakeStub);
+}
+
+// ---------------------- ULP Battery Sampler ----------------------
+/*******************************************************
+ * FUNCTION: wakeUlpStart
+ * DESCRIPTION: Hands BATTERY_PIN to the ULP and starts a program that
+ * samples it every WAKE_ULP_PERIOD_MS into wakeUlpData.
+ * INPUT: None
+ * OUTPUT: bool (false if the pin or the ADC cannot be used by the ULP)
+ *******************************************************/
+bool wakeUlpStart() {
+  adc_unit_t unit;
+  adc_channel_t channel;
+  if (adc_oneshot_io_to_channel(BATTERY_PIN, &unit, &channel) != ESP_OK) return false;
+  pinMode(BATTERY_PIN, INPUT);   // Detaches the pin from the Arduino ADC driver
+  ulp_adc_cfg_t config = {};
+  config.adc_n = unit;
+  config.channel = channel;
+  config.atten = ADC_ATTEN_DB_12;
+  config.width = ADC_BITWIDTH_12;
+  config.ulp_mode = ADC_ULP_MODE_FSM;
+  if (ulp_adc_init(&config) != ESP_OK) return false;
+  const ulp_insn_t program[] = {
+    I_ADC(R0, unit == ADC_UNIT_1 ? 0 : 1, channel),
+    I_MOVI(R1, wakeUlpData),
+    I_ST(R0, R1, 0),        // Sample
+    I_LD(R2, R1, 1),
+    I_ADDI(R2, R2, 1),
+    I_ST(R2, R1, 1),        // Count
+    I_HALT(),
+  };
+  RTC_SLOW_MEM[wakeUlpData] = 0;
+  RTC_SLOW_MEM[wakeUlpData + 1] = 0;
+  size_t size = sizeof(program) / sizeof(ulp_insn_t);
+  if (ulp_process_macros_and_load(0, program, &size) != ESP_OK) return false;
+  ulp_set_wakeup_period(0, WAKE_ULP_PERIOD_MS * 1000);
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);   // SAR ADC during the sleep
+  return ulp_run(0) == ESP_OK;
+}
+
+// ---------------------- Full Boot Side ----------------------
+/*******************************************************
+ * FUNCTION: wakeStubPlan
+ * DESCRIPTION: Fills the plan for the wake `firstS` seconds from now and
+ * the ones after it, `intervalS` apart: clock, night at the GPS position.
+ * With `skippable` false the wake boots whatever the plan says.
+ * INPUT: uint32_t firstS, uint32_t intervalS, bool skippable
+ * OUTPUT: None
+ *******************************************************/
+void wakeStubPlan(uint32_t firstS, uint32_t intervalS, bool skippable) {
+  wakePlan.armed = skippable;
+  wakePlan.intervalS = intervalS;
+  wakePlan.slotHours = WAKE_SLOT_HOURS;
+  wakePlan.maxSkips = WAKE_MAX_SKIPS;
+  wakePlan.clockValid = 0;
+  wakePlan.nightStart = wakePlan.nightEnd = 0;
+#ifdef GPS
+  if (gpsClockSetAt != 0) {
+    wakePlan.clockValid = 1;
+    wakePlan.nextUtc = (uint32_t)time(NULL) + firstS;
+#ifdef WAKE_SKIP_NIGHT
+    if (gpsCachedFix.valid) {
+      wakeNightWindow(gpsCachedFix.latitude / 1e7, gpsCachedFix.longitude / 1e7, wakePlan.nextUtc, WAKE_SUN_ALTITUDE,
+                      wakePlan.nightStart, wakePlan.nightEnd);
+    }
+#endif
+  }
+#endif
+}
+
+/*******************************************************
+ * FUNCTION: wakeStubArm
+ * DESCRIPTION: Call before esp_deep_sleep_start(): fills the plan (see
+ * wakeStubPlan()), starts the ULP and installs the stub. With `skippable`
+ * false the next wake boots whatever the plan says (a transmission was
+ * asked for).
+ * INPUT: uint32_t firstS, uint32_t intervalS, bool skippable
+ * OUTPUT: None
+ *******************************************************/
+void wakeStubArm(uint32_t firstS, uint32_t intervalS, bool skippable) {
+  wakeStubPlan(firstS, intervalS, skippable);
+  wakePlan.ulpRunning = wakeUlpStart();
+  if (!wakePlan.ulpRunning) Serial.println("Wake stub: ULP battery sampler not started, battery not checked");
+  esp_set_deep_sleep_wake_stub(&wakeStub);
+  Serial.printf("Wake stub: %s, then every %lu s; clock %s, night %02lu:%02lu-%02lu:%02lu UTC\n",
+                skippable ? "next wake checked" : "next wake boots", (unsigned long)intervalS,
+                wakePlan.clockValid ? "set" : "not set", (unsigned long)(wakePlan.nightStart / 3600),
+                (unsigned long)(wakePlan.nightStart / 60 % 60), (unsigned long)(wakePlan.nightEnd / 3600),
+                (unsigned long)(wakePlan.nightEnd / 60 % 60));
+}
+
+/*******************************************************
+ * FUNCTION: wakeStubBegin
+ * DESCRIPTION: Call early in setup(): stops the ULP (the app reads the
+ * battery itself), reports the wakes the stub skipped since the last
+ * boot, and calibrates the battery limit from the last ULP sample. A
+ * refresh boot forced by the stub is then checked again on the refreshed
+ * plan (clock and night of this wake).
+ * INPUT: None
+ * OUTPUT: WakeReason (WAKE_BOOT: go on, else call wakeStubSleep() without transmitting)
+ *******************************************************/
+WakeReason wakeStubBegin() {
+  bool slept = esp_reset_reason() == ESP_RST_DEEPSLEEP;
+  bool sampled = slept && wakePlan.ulpRunning && (RTC_SLOW_MEM[wakeUlpData + 1] & 0xFFFF) != 0;
+  uint32_t raw = RTC_SLOW_MEM[wakeUlpData] & 0xFFFF;
+  if (wakePlan.ulpRunning) ulp_timer_stop();
+  wakePlan.ulpRunning = 0;
+  if (slept && wakePlan.skipped) {
+    Serial.printf("Wake stub: %u wakes skipped (battery %u, off slot %u, night %u)%s\n", wakePlan.skipped,
+                  wakePlan.skippedBy[WAKE_LOW_BATTERY], wakePlan.skippedBy[WAKE_OFF_SLOT], wakePlan.skippedBy[WAKE_NIGHT],
+                  wakePlan.skipped >= wakePlan.maxSkips ? ", boot forced" : "");
+  }
+  wakePlan.skipped = 0;
+  memset(wakePlan.skippedBy, 0, sizeof(wakePlan.skippedBy));
+  if (!slept) wakePlan.batteryMinRaw = 0;   // RTC slow memory is not kept over a reset
+  uint32_t mv = readBatteryMillivolts();
+  if (sampled && raw && mv) {
+    uint32_t limit = (uint32_t)((uint64_t)WAKE_MIN_BATTERY_MV * raw / mv);
+    wakePlan.batteryMinRaw = limit > 0xFFFF ? 0xFFFF : limit;
+    Serial.printf("Wake stub: battery %lu mV = %lu ULP counts, limit %d mV = %u counts\n", (unsigned long)mv,
+                  (unsigned long)raw, WAKE_MIN_BATTERY_MV, wakePlan.batteryMinRaw);
+  }
+  if (!slept) wakePlan.forced = WAKE_BOOT;
+  if (wakePlan.forced == WAKE_BOOT) return wakePlanRecheck(wakePlan, raw, sampled);
+  WakeReason forced = (WakeReason)wakePlan.forced;
+  wakeStubPlan(0, wakePlan.intervalS, true);
+  WakeReason reason = wakePlanRecheck(wakePlan, raw, sampled);
+  Serial.printf("Wake stub: refresh boot (skipped for %s), %s\n", wakeReasonNames[forced],
+                reason == WAKE_BOOT ? "transmitting" : "no transmission");
+  return reason;
+}
+
+/*******************************************************
+ * FUNCTION: wakeStubSleep
+ * DESCRIPTION: Ends a refresh boot that has nothing to send: re-arms the
+ * stub and goes back to Deep Sleep up to the next wake (the next slot
+ * with the GPS clock), before the camera, the radio and PTT are touched.
+ * INPUT: None
+ * OUTPUT: None (does not return)
+ *******************************************************/
+void wakeStubSleep() {
+  uint32_t sleepS = wakePlan.intervalS;
+#ifdef GPS
+  if (gpsClockSetAt != 0) sleepS = gpsSleepSeconds();
+#endif
+  wakeStubArm(sleepS, wakePlan.intervalS, true);
+  esp_sleep_enable_timer_wakeup((uint64_t)sleepS * 1000000);
+  Serial.println("Going to sleep now");
+  Serial.flush();
+  esp_deep_sleep_start();
+}
+
+#endif